@@ -0,0 +1,724 @@
+#pragma once
+
+#include <Arduino.h>
+#include <WebServer.h>
+#include <WiFi.h>
+#include <string.h>
+
+// Persistent-connection HTTP server for the firmwares' pollers. The core
+// WebServer closes every connection after one response, so a 200 ms poller
+// pays a TCP handshake and teardown per request and ties up a lwIP PCB in
+// TIME_WAIT each time. KeepAliveServer keeps up to kHttpConnections sockets
+// open. Each handleClient() call serves at most one request per connection,
+// starting one slot further along each time, so one busy client cannot
+// starve the others. Requests pipelined on a connection queue in its buffer
+// and are served on later rounds.
+//
+// It offers the subset of the WebServer API the firmwares use, so handlers
+// are unchanged. A handler that takes server.client() and sends no response
+// (an event stream) gets the socket; the server forgets it.
+//
+// -DHTTP_KEEPALIVE=0 builds the firmwares on the core WebServer again.
+
+#ifndef HTTP_KEEPALIVE
+#define HTTP_KEEPALIVE 1
+#endif
+
+static const uint8_t kHttpConnections = 4;
+static const size_t kHttpRequestMax = 1536;  // request line + headers + body
+static const uint32_t kHttpIdleTimeoutMs = 5000;
+static const uint32_t kHttpRequestTimeoutMs = 2000;  // to finish a started request
+static const uint8_t kHttpMaxArgs = 16;
+static const uint8_t kHttpMaxHeaders = 8;  // response headers per request
+static const uint8_t kHttpMaxCollected = 4;
+static const size_t kHttpTxMax = 1024;  // head + body sent as one write
+
+class KeepAliveServer {
+public:
+  typedef std::function<void(void)> THandlerFunction;
+
+  explicit KeepAliveServer(int port = 80) : listener_(port) {}
+
+  void begin() {
+    listener_.begin();
+    listener_.setNoDelay(true);
+  }
+
+  void on(const char *uri, THandlerFunction handler) {
+    on(uri, HTTP_ANY, handler);
+  }
+
+  void on(const char *uri, HTTPMethod method, THandlerFunction handler) {
+    Route *route = new Route{uri, method, handler, nullptr};
+    *routesTail_ = route;
+    routesTail_ = &route->next;
+  }
+
+  void onNotFound(THandlerFunction handler) {
+    notFound_ = handler;
+  }
+
+  void collectHeaders(const char *headerKeys[], size_t count) {
+    collectedCount_ = count < kHttpMaxCollected ? static_cast<uint8_t>(count) : kHttpMaxCollected;
+    for (uint8_t i = 0; i < collectedCount_; i++) {
+      collectedKeys_[i] = headerKeys[i];
+    }
+  }
+
+  void handleClient() {
+    uint32_t now = millis();
+    acceptPending(now);
+    uint8_t start = nextSlot_;
+    nextSlot_ = static_cast<uint8_t>((nextSlot_ + 1) % kHttpConnections);
+    for (uint8_t k = 0; k < kHttpConnections; k++) {
+      Connection &c = conns_[(start + k) % kHttpConnections];
+      if (c.open) {
+        service(c, now);
+      }
+    }
+  }
+
+  // ---- request -------------------------------------------------------------
+
+  String uri() const {
+    return String(uri_);
+  }
+
+  HTTPMethod method() const {
+    return method_;
+  }
+
+  int args() const {
+    return argCount_;
+  }
+
+  String arg(const String &name) const {
+    for (uint8_t i = 0; i < argCount_; i++) {
+      if (name == argNames_[i]) {
+        return String(argValues_[i]);
+      }
+    }
+    return String();
+  }
+
+  String arg(int i) const {
+    return i >= 0 && i < argCount_ ? String(argValues_[i]) : String();
+  }
+
+  String argName(int i) const {
+    return i >= 0 && i < argCount_ ? String(argNames_[i]) : String();
+  }
+
+  bool hasArg(const String &name) const {
+    for (uint8_t i = 0; i < argCount_; i++) {
+      if (name == argNames_[i]) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  String header(const String &name) const {
+    for (uint8_t i = 0; i < collectedCount_; i++) {
+      if (strcasecmp(collectedKeys_[i], name.c_str()) == 0 && collectedValues_[i] != nullptr) {
+        return String(collectedValues_[i]);
+      }
+    }
+    return String();
+  }
+
+  // Handing the client to a handler that sends no response gives it the
+  // socket for good.
+  WiFiClient client() {
+    clientTaken_ = true;
+    return current_ != nullptr ? current_->client : WiFiClient();
+  }
+
+  // ---- response ------------------------------------------------------------
+
+  void sendHeader(const String &name, const String &value, bool first = false) {
+    if (headerCount_ >= kHttpMaxHeaders) {
+      return;
+    }
+    if (first) {
+      for (uint8_t i = headerCount_; i > 0; i--) {
+        headerNames_[i] = headerNames_[i - 1];
+        headerValues_[i] = headerValues_[i - 1];
+      }
+      headerNames_[0] = name;
+      headerValues_[0] = value;
+    } else {
+      headerNames_[headerCount_] = name;
+      headerValues_[headerCount_] = value;
+    }
+    headerCount_++;
+  }
+
+  void setContentLength(size_t contentLength) {
+    contentLength_ = contentLength;
+  }
+
+  void send(int code, const char *contentType = nullptr, const String &content = String()) {
+    send_P(code, contentType, content.c_str(), content.length());
+  }
+
+  void send(int code, const String &contentType, const String &content) {
+    send_P(code, contentType.c_str(), content.c_str(), content.length());
+  }
+
+  void send(int code, const char *contentType, const char *content) {
+    send_P(code, contentType, content, strlen(content));
+  }
+
+  void send_P(int code, PGM_P contentType, PGM_P content) {
+    send_P(code, contentType, content, strlen(content));
+  }
+
+  void send_P(int code, PGM_P contentType, PGM_P content, size_t contentLength) {
+    if (current_ == nullptr || responded_) {
+      return;
+    }
+    char tx[kHttpTxMax];
+    if (contentLength_ == CONTENT_LENGTH_UNKNOWN) {
+      size_t headLen = formatHead(tx, sizeof(tx), code, contentType, CONTENT_LENGTH_UNKNOWN);
+      write(tx, headLen);
+      if (contentLength > 0) {
+        sendContent(content, contentLength);
+      }
+      return;
+    }
+    size_t headLen = formatHead(tx, sizeof(tx), code, contentType, contentLength);
+    // Small responses leave in one segment.
+    if (headLen + contentLength <= sizeof(tx)) {
+      memcpy(tx + headLen, content, contentLength);
+      write(tx, headLen + contentLength);
+    } else {
+      write(tx, headLen);
+      write(content, contentLength);
+    }
+  }
+
+  void sendContent(const String &content) {
+    sendContent(content.c_str(), content.length());
+  }
+
+  // Zero-length content ends a chunked body, as in the core.
+  void sendContent(const char *content, size_t size) {
+    if (current_ == nullptr) {
+      return;
+    }
+    if (!chunked_) {
+      write(content, size);
+      return;
+    }
+    char tx[kHttpTxMax];
+    int n = snprintf(tx, sizeof(tx), "%x\r\n", static_cast<unsigned>(size));
+    if (n + size + 2 <= sizeof(tx)) {
+      memcpy(tx + n, content, size);
+      memcpy(tx + n + size, "\r\n", 2);
+      write(tx, n + size + 2);
+    } else {
+      write(tx, static_cast<size_t>(n));
+      write(content, size);
+      write("\r\n", 2);
+    }
+    if (size == 0) {
+      chunked_ = false;
+    }
+  }
+
+  // Requests served since boot, and connections accepted.
+  uint32_t requests() const {
+    return requests_;
+  }
+
+  uint32_t connections() const {
+    return accepted_;
+  }
+
+private:
+  struct Route {
+    const char *uri;
+    HTTPMethod method;
+    THandlerFunction handler;
+    Route *next;
+  };
+
+  struct Connection {
+    WiFiClient client;
+    bool open = false;
+    bool closeAfter = false;  // answer the next request with Connection: close
+    uint32_t openedMs = 0;
+    uint32_t lastMs = 0;
+    size_t len = 0;
+    char buf[kHttpRequestMax + 1];
+  };
+
+  // A new connection takes a free slot, else the one idle longest. While
+  // every slot is mid-request one newcomer waits here and the connection
+  // open longest is closed after its next response, so a waiting client
+  // gets in within a round or so however busy the others are.
+  void acceptPending(uint32_t now) {
+    for (uint8_t n = 0; n < kHttpConnections; n++) {
+      if (!waiting_) {
+        waiting_ = listener_.available();
+        if (!waiting_) {
+          return;
+        }
+      }
+      Connection *slot = nullptr;
+      for (uint8_t i = 0; i < kHttpConnections && slot == nullptr; i++) {
+        if (!conns_[i].open) {
+          slot = &conns_[i];
+        }
+      }
+      for (uint8_t i = 0; i < kHttpConnections; i++) {
+        Connection &c = conns_[i];
+        if (c.open && c.len == 0 && c.client.available() == 0 &&
+            (slot == nullptr || (slot->open && now - c.lastMs > now - slot->lastMs))) {
+          slot = &c;
+        }
+      }
+      if (slot == nullptr) {
+        Connection *oldest = &conns_[0];
+        for (uint8_t i = 1; i < kHttpConnections; i++) {
+          if (now - conns_[i].openedMs > now - oldest->openedMs) {
+            oldest = &conns_[i];
+          }
+        }
+        oldest->closeAfter = true;
+        return;
+      }
+      if (slot->open) {
+        slot->client.stop();
+      }
+      waiting_.setNoDelay(true);
+      slot->client = waiting_;
+      waiting_ = WiFiClient();
+      slot->open = true;
+      slot->closeAfter = false;
+      slot->len = 0;
+      slot->openedMs = now;
+      slot->lastMs = now;
+      accepted_++;
+    }
+  }
+
+  void service(Connection &c, uint32_t now) {
+    int avail = c.client.available();
+    if (avail > 0 && c.len < kHttpRequestMax) {
+      size_t room = kHttpRequestMax - c.len;
+      int n = c.client.read(reinterpret_cast<uint8_t *>(c.buf + c.len),
+                            static_cast<size_t>(avail) < room ? static_cast<size_t>(avail) : room);
+      if (n > 0) {
+        c.len += static_cast<size_t>(n);
+        c.lastMs = now;
+      }
+    }
+    size_t requestLen = completeRequest(c);
+    if (requestLen > 0) {
+      serve(c, requestLen);
+      return;
+    }
+    if (c.len >= kHttpRequestMax) {
+      current_ = &c;
+      resetResponse();
+      keepAlive_ = false;
+      send(413, "text/plain", "Request too large");
+      close(c);
+      current_ = nullptr;
+      return;
+    }
+    uint32_t limit = c.len > 0 ? kHttpRequestTimeoutMs : kHttpIdleTimeoutMs;
+    if (now - c.lastMs > limit || (avail <= 0 && !c.client.connected())) {
+      close(c);
+    }
+  }
+
+  void close(Connection &c) {
+    c.client.stop();
+    c.client = WiFiClient();
+    c.open = false;
+    c.len = 0;
+  }
+
+  static const char *findHeadEnd(const char *buf, size_t len) {
+    for (size_t i = 3; i < len; i++) {
+      if (buf[i] == '\n' && buf[i - 1] == '\r' && buf[i - 2] == '\n' && buf[i - 3] == '\r') {
+        return buf + i + 1;
+      }
+    }
+    return nullptr;
+  }
+
+  // Content-Length value up to its line end: digits between optional
+  // blanks, kHttpRequestMax at most. Anything else, including a value that
+  // would overflow, gives kHttpRequestMax + 1.
+  static size_t parseContentLength(const char *value, const char *eol) {
+    while (value < eol && (*value == ' ' || *value == '\t')) {
+      value++;
+    }
+    const char *digits = value;
+    size_t len = 0;
+    while (value < eol && *value >= '0' && *value <= '9') {
+      len = len * 10 + static_cast<size_t>(*value - '0');
+      if (len > kHttpRequestMax) {
+        return kHttpRequestMax + 1;
+      }
+      value++;
+    }
+    if (value == digits) {
+      return kHttpRequestMax + 1;
+    }
+    while (value < eol && (*value == ' ' || *value == '\t' || *value == '\r')) {
+      value++;
+    }
+    return value == eol ? len : kHttpRequestMax + 1;
+  }
+
+  // Length of the first buffered request with its body, 0 if it is not all
+  // here yet.
+  static size_t completeRequest(const Connection &c) {
+    const char *headEnd = findHeadEnd(c.buf, c.len);
+    if (headEnd == nullptr) {
+      return 0;
+    }
+    size_t headLen = static_cast<size_t>(headEnd - c.buf);
+    size_t bodyLen = 0;
+    bool lengthSeen = false;
+    const char *line = static_cast<const char *>(memchr(c.buf, '\n', headLen)) + 1;
+    while (line < headEnd) {
+      const char *eol = static_cast<const char *>(memchr(line, '\n', headEnd - line));
+      if (strncasecmp(line, "Content-Length:", 15) == 0) {
+        size_t len = parseContentLength(line + 15, eol);
+        // Repeats must agree, or the body's end is ambiguous.
+        bodyLen = lengthSeen && len != bodyLen ? kHttpRequestMax + 1 : len;
+        lengthSeen = true;
+      }
+      line = eol + 1;
+    }
+    // Both terms are at most kHttpRequestMax + 1 here, so the sum cannot wrap.
+    if (headLen + bodyLen > kHttpRequestMax) {
+      return kHttpRequestMax + 1;  // never fits: serve() rejects it
+    }
+    return c.len >= headLen + bodyLen ? headLen + bodyLen : 0;
+  }
+
+  static int hexValue(char ch) {
+    if (ch >= '0' && ch <= '9') {
+      return ch - '0';
+    }
+    if (ch >= 'a' && ch <= 'f') {
+      return ch - 'a' + 10;
+    }
+    if (ch >= 'A' && ch <= 'F') {
+      return ch - 'A' + 10;
+    }
+    return -1;
+  }
+
+  // Decodes %XX and '+' in place and terminates the text.
+  static char *urlDecode(char *text, size_t len) {
+    size_t out = 0;
+    for (size_t i = 0; i < len; i++) {
+      if (text[i] == '+') {
+        text[out++] = ' ';
+      } else if (text[i] == '%' && i + 2 < len && hexValue(text[i + 1]) >= 0 && hexValue(text[i + 2]) >= 0) {
+        text[out++] = static_cast<char>(hexValue(text[i + 1]) * 16 + hexValue(text[i + 2]));
+        i += 2;
+      } else {
+        text[out++] = text[i];
+      }
+    }
+    text[out] = '\0';
+    return text;
+  }
+
+  void parseArgs(char *text, size_t len) {
+    char *end = text + len;
+    while (text < end && argCount_ < kHttpMaxArgs) {
+      char *amp = static_cast<char *>(memchr(text, '&', end - text));
+      char *pairEnd = amp != nullptr ? amp : end;
+      char *eq = static_cast<char *>(memchr(text, '=', pairEnd - text));
+      if (pairEnd > text) {
+        char *valueStart = eq != nullptr ? eq + 1 : pairEnd;
+        size_t valueLen = static_cast<size_t>(pairEnd - valueStart);
+        argValues_[argCount_] = urlDecode(valueStart, valueLen);
+        argNames_[argCount_] = urlDecode(text, static_cast<size_t>((eq != nullptr ? eq : pairEnd) - text));
+        argCount_++;
+      }
+      text = pairEnd + 1;
+    }
+  }
+
+  static HTTPMethod parseMethod(const char *name, size_t len) {
+    static const struct {
+      const char *name;
+      HTTPMethod method;
+    } kMethods[] = {{"GET", HTTP_GET},     {"HEAD", HTTP_HEAD},     {"POST", HTTP_POST},      {"PUT", HTTP_PUT},
+                    {"PATCH", HTTP_PATCH}, {"DELETE", HTTP_DELETE}, {"OPTIONS", HTTP_OPTIONS}};
+    for (const auto &m : kMethods) {
+      if (strlen(m.name) == len && memcmp(m.name, name, len) == 0) {
+        return m.method;
+      }
+    }
+    return HTTP_ANY;
+  }
+
+  // Splits the request in the connection buffer in place: names and values
+  // point into it until the next request is shifted down.
+  bool parse(Connection &c, size_t requestLen) {
+    char *buf = c.buf;
+    char *headEnd = const_cast<char *>(findHeadEnd(buf, requestLen));
+    if (headEnd == nullptr) {
+      return false;
+    }
+    char *lineEnd = static_cast<char *>(memchr(buf, '\r', headEnd - buf));
+    char *sp1 = static_cast<char *>(memchr(buf, ' ', lineEnd - buf));
+    char *sp2 = sp1 != nullptr ? static_cast<char *>(memchr(sp1 + 1, ' ', lineEnd - sp1 - 1)) : nullptr;
+    if (sp2 == nullptr) {
+      return false;
+    }
+    method_ = parseMethod(buf, static_cast<size_t>(sp1 - buf));
+    bool http10 = lineEnd - sp2 - 1 == 8 && memcmp(sp2 + 1, "HTTP/1.0", 8) == 0;
+    keepAlive_ = !http10;
+
+    bool formBody = false;
+    char *line = lineEnd + 2;
+    while (line < headEnd - 2) {
+      char *eol = static_cast<char *>(memchr(line, '\r', headEnd - line));
+      char *colon = static_cast<char *>(memchr(line, ':', eol - line));
+      if (colon != nullptr) {
+        *colon = '\0';
+        char *value = colon + 1;
+        while (*value == ' ') {
+          value++;
+        }
+        *eol = '\0';
+        if (strcasecmp(line, "Connection") == 0) {
+          if (strcasecmp(value, "close") == 0) {
+            keepAlive_ = false;
+          } else if (strcasecmp(value, "keep-alive") == 0) {
+            keepAlive_ = true;
+          }
+        } else if (strcasecmp(line, "Content-Type") == 0) {
+          formBody = strncmp(value, "application/x-www-form-urlencoded", 33) == 0;
+        }
+        for (uint8_t i = 0; i < collectedCount_; i++) {
+          if (strcasecmp(line, collectedKeys_[i]) == 0) {
+            collectedValues_[i] = value;
+          }
+        }
+      }
+      line = eol + 2;
+    }
+
+    // The target and the body are decoded last: decoding shortens them, and
+    // the terminators it writes must not cut a header still being read.
+    char *target = sp1 + 1;
+    char *query = static_cast<char *>(memchr(target, '?', sp2 - target));
+    size_t bodyLen = requestLen - static_cast<size_t>(headEnd - buf);
+    if (bodyLen > 0) {
+      // The byte after the body, which decoding may overwrite with a
+      // terminator, belongs to the next request; serve() puts it back.
+      bodyEnd_ = headEnd[bodyLen];
+      bodyEndAt_ = headEnd + bodyLen;
+      if (formBody) {
+        parseArgs(headEnd, bodyLen);
+      } else if (argCount_ < kHttpMaxArgs) {
+        headEnd[bodyLen] = '\0';
+        argNames_[argCount_] = "plain";
+        argValues_[argCount_] = headEnd;
+        argCount_++;
+      }
+    }
+    if (query != nullptr) {
+      parseArgs(query + 1, static_cast<size_t>(sp2 - query - 1));
+      *query = '\0';
+    } else {
+      *sp2 = '\0';
+    }
+    uri_ = target;
+    return true;
+  }
+
+  void resetResponse() {
+    headerCount_ = 0;
+    contentLength_ = 0;
+    chunked_ = false;
+    responded_ = false;
+    clientTaken_ = false;
+  }
+
+  void resetRequest() {
+    argCount_ = 0;
+    uri_ = "";
+    bodyEndAt_ = nullptr;
+    for (uint8_t i = 0; i < collectedCount_; i++) {
+      collectedValues_[i] = nullptr;
+    }
+  }
+
+  void serve(Connection &c, size_t requestLen) {
+    current_ = &c;
+    resetRequest();
+    resetResponse();
+    bool parsed = requestLen <= c.len && parse(c, requestLen);
+    if (c.closeAfter) {
+      keepAlive_ = false;
+    }
+    if (!parsed) {
+      keepAlive_ = false;
+      send(400, "text/plain", "Bad request");
+      close(c);
+      current_ = nullptr;
+      return;
+    }
+
+    THandlerFunction *handler = &notFound_;
+    for (Route *r = routes_; r != nullptr; r = r->next) {
+      if (strcmp(r->uri, uri_) == 0 && (r->method == HTTP_ANY || r->method == method_)) {
+        handler = &r->handler;
+        break;
+      }
+    }
+#ifdef HOST_WEBSERVER_STATS
+    uint64_t allocsBefore = hostThreadAllocations();
+    uint64_t startNs = hostNowNs();
+#endif
+    if (*handler) {
+      (*handler)();
+    } else {
+      send(404, "text/plain", "Not found");
+    }
+    if (chunked_) {
+      sendContent("", 0);
+    }
+#ifdef HOST_WEBSERVER_STATS
+    HostServerStats &stats = hostServerStats();
+    stats.handlerNs += hostNowNs() - startNs;
+    stats.handlerAllocations += hostThreadAllocations() - allocsBefore;
+    stats.requests++;
+#endif
+    requests_++;
+    current_ = nullptr;
+
+    if (!responded_ && clientTaken_) {
+      // Event stream: the handler's copy owns the socket now.
+      c.client = WiFiClient();
+      c.open = false;
+      c.len = 0;
+      return;
+    }
+    if (!responded_ || !keepAlive_ || !c.client.connected()) {
+      close(c);
+      return;
+    }
+    if (bodyEndAt_ != nullptr) {
+      *bodyEndAt_ = bodyEnd_;
+    }
+    // Pipelined bytes move to the front for the next round.
+    c.len -= requestLen;
+    memmove(c.buf, c.buf + requestLen, c.len);
+    c.lastMs = millis();
+  }
+
+  size_t formatHead(char *out, size_t size, int code, const char *contentType, size_t contentLength) {
+    size_t len = 0;
+    append(out, size, len, "HTTP/1.1 %d %s\r\n", code, reasonPhrase(code));
+    if (contentType != nullptr && contentType[0] != '\0') {
+      append(out, size, len, "Content-Type: %s\r\n", contentType);
+    }
+    if (contentLength == CONTENT_LENGTH_UNKNOWN) {
+      chunked_ = true;
+      append(out, size, len, "Transfer-Encoding: chunked\r\n");
+    } else {
+      append(out, size, len, "Content-Length: %u\r\n", static_cast<unsigned>(contentLength));
+    }
+    for (uint8_t i = 0; i < headerCount_; i++) {
+      append(out, size, len, "%s: %s\r\n", headerNames_[i].c_str(), headerValues_[i].c_str());
+    }
+    if (keepAlive_) {
+      append(out, size, len, "Connection: keep-alive\r\nKeep-Alive: timeout=%lu\r\n\r\n",
+             static_cast<unsigned long>(kHttpIdleTimeoutMs / 1000));
+    } else {
+      append(out, size, len, "Connection: close\r\n\r\n");
+    }
+    responded_ = true;
+    return len;
+  }
+
+  static void append(char *out, size_t size, size_t &len, const char *fmt, ...) {
+    if (len + 1 >= size) {
+      return;
+    }
+    va_list args;
+    va_start(args, fmt);
+    int written = vsnprintf(out + len, size - len, fmt, args);
+    va_end(args);
+    if (written > 0) {
+      len = (len + written < size) ? len + written : size - 1;
+    }
+  }
+
+  static const char *reasonPhrase(int code) {
+    switch (code) {
+      case 200: return "OK";
+      case 204: return "No Content";
+      case 304: return "Not Modified";
+      case 400: return "Bad Request";
+      case 404: return "Not Found";
+      case 406: return "Not Acceptable";
+      case 409: return "Conflict";
+      case 413: return "Payload Too Large";
+      case 500: return "Internal Server Error";
+      case 503: return "Service Unavailable";
+      default: return "";
+    }
+  }
+
+  void write(const char *data, size_t size) {
+    if (current_ != nullptr && size > 0) {
+      current_->client.write(reinterpret_cast<const uint8_t *>(data), size);
+    }
+  }
+
+  WiFiServer listener_;
+  Route *routes_ = nullptr;
+  Route **routesTail_ = &routes_;
+  THandlerFunction notFound_;
+  Connection conns_[kHttpConnections];
+  WiFiClient waiting_;
+  uint8_t nextSlot_ = 0;
+  uint32_t requests_ = 0;
+  uint32_t accepted_ = 0;
+
+  // The request being served; strings point into its connection buffer.
+  Connection *current_ = nullptr;
+  HTTPMethod method_ = HTTP_GET;
+  const char *uri_ = "";
+  uint8_t argCount_ = 0;
+  const char *argNames_[kHttpMaxArgs];
+  const char *argValues_[kHttpMaxArgs];
+  const char *collectedKeys_[kHttpMaxCollected];
+  const char *collectedValues_[kHttpMaxCollected] = {};
+  uint8_t collectedCount_ = 0;
+  bool keepAlive_ = true;
+  char *bodyEndAt_ = nullptr;
+  char bodyEnd_ = 0;
+
+  // The response being sent.
+  String headerNames_[kHttpMaxHeaders];
+  String headerValues_[kHttpMaxHeaders];
+  uint8_t headerCount_ = 0;
+  size_t contentLength_ = 0;
+  bool chunked_ = false;
+  bool responded_ = false;
+  bool clientTaken_ = false;
+};
+
+#if HTTP_KEEPALIVE
+typedef KeepAliveServer HttpServer;
+#else
+typedef WebServer HttpServer;
+#endif
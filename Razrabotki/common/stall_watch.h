@@ -0,0 +1,192 @@
+#pragma once
+
+#include <Arduino.h>
+#include <esp_timer.h>
+#include <string.h>
+
+#include <atomic>
+
+// Loop stall detector shared by the firmwares (both add -I../common).
+//
+// The loop marks the stage it is in (sampling, HTTP, rendering, flash...)
+// with one relaxed store of a packed micros()-and-stage word; nothing else
+// runs on the loop. A periodic esp_timer, whose task outranks loopTask,
+// compares the open stage against its budget. A stage past its budget is
+// recorded once, then its duration is kept current until the stage ends, so
+// a stall that never ends (watchdog, panic) still leaves a record.
+//
+// The ring lives in RTC memory the owner declares RTC_NOINIT_ATTR, which
+// survives any reset but a power cycle; the owner also copies it to NVS
+// whenever closed() moves and restores that copy when the RTC one is gone.
+
+static const uint8_t kStallRingSize = 16;
+static const uint8_t kStallStageMax = 15;
+static const uint32_t kStallCheckMs = 5;
+static const uint32_t kStallRingMagic = 0x314C5453;  // "STL1"
+
+struct StallRecord {
+  uint32_t bootId;
+  uint32_t atMs;        // millis() when the stage was entered
+  uint32_t durationMs;  // so far, while open
+  uint16_t budgetMs;
+  uint8_t stage;
+  uint8_t open;         // still running at the last check; from an earlier
+                        // boot, the stage never returned before the reset
+};
+
+struct StallRing {
+  uint32_t magic;
+  uint32_t total;  // stalls ever recorded, including overwritten ones
+  uint8_t head;    // next slot to write
+  uint8_t count;
+  uint16_t reserved;
+  StallRecord records[kStallRingSize];
+};
+
+static inline bool stallRingValid(const StallRing &ring) {
+  return ring.magic == kStallRingMagic && ring.head < kStallRingSize && ring.count <= kStallRingSize;
+}
+
+class StallWatch {
+public:
+  // Adopts the ring if it holds a valid image (retained across a reset or
+  // restored from NVS by the caller), clears it otherwise, and starts
+  // checking.
+  void begin(StallRing *ring, uint32_t bootId) {
+    ring_ = ring;
+    bootId_ = bootId;
+    if (!stallRingValid(*ring)) {
+      clear();
+    }
+    esp_timer_create_args_t args = {};
+    args.callback = &StallWatch::onTimer;
+    args.arg = this;
+    args.dispatch_method = ESP_TIMER_TASK;
+    args.name = "stall_watch";
+    if (esp_timer_create(&args, &timer_) == ESP_OK) {
+      esp_timer_start_periodic(timer_, kStallCheckMs * 1000);
+    }
+  }
+
+  // 0 turns the check off for the stage.
+  void setBudget(uint8_t stage, uint16_t ms) {
+    if (stage < kStallStageMax) {
+      budgets_[stage].store(ms);
+    }
+  }
+
+  uint16_t budget(uint8_t stage) const {
+    return stage < kStallStageMax ? budgets_[stage].load() : 0;
+  }
+
+  // Returns the mark to hand back to leave(). Stages nest: the outer stage
+  // pauses while an inner one runs and restarts its clock when it leaves, so
+  // a stall is charged to the innermost stage.
+  uint32_t enter(uint8_t stage) {
+    uint32_t outer = mark_.load(std::memory_order_relaxed);
+    mark_.store(markNow(stage + 1u), std::memory_order_relaxed);
+    return outer;
+  }
+
+  void leave(uint32_t outer) {
+    mark_.store(outer == 0 ? 0 : markNow(outer & kStageMask), std::memory_order_relaxed);
+  }
+
+  // Counts stalls that have ended; the owner persists the ring when this
+  // moves.
+  uint32_t closed() const {
+    return closed_.load();
+  }
+
+  void clear() {
+    memset(ring_, 0, sizeof(StallRing));
+    ring_->magic = kStallRingMagic;
+  }
+
+  const StallRing &ring() const {
+    return *ring_;
+  }
+
+  // The i-th most recent record, i < ring().count.
+  const StallRecord &recent(uint8_t i) const {
+    return ring_->records[(ring_->head + kStallRingSize - 1 - i) % kStallRingSize];
+  }
+
+private:
+  static const uint32_t kStageMask = 0xF;  // low bits of the mark: stage + 1
+  static const uint8_t kNoSlot = 0xFF;
+
+  static uint32_t markNow(uint32_t stageBits) {
+    return (static_cast<uint32_t>(micros()) & ~kStageMask) | stageBits;
+  }
+
+  static void onTimer(void *arg) {
+    static_cast<StallWatch *>(arg)->check();
+  }
+
+  void check() {
+    uint32_t mark = mark_.load(std::memory_order_relaxed);
+    uint32_t elapsedMs = (static_cast<uint32_t>(micros()) - (mark & ~kStageMask)) / 1000;
+    if (openSlot_ != kNoSlot) {
+      if (mark == openMark_) {
+        ring_->records[openSlot_].durationMs = elapsedMs;
+        return;
+      }
+      ring_->records[openSlot_].open = 0;
+      openSlot_ = kNoSlot;
+      closed_++;
+    }
+    if (mark == 0 || mark == reportedMark_) {
+      return;
+    }
+    uint8_t stage = static_cast<uint8_t>((mark & kStageMask) - 1);
+    uint16_t budgetMs = budget(stage);
+    if (budgetMs == 0 || elapsedMs < budgetMs) {
+      return;
+    }
+    StallRecord &r = ring_->records[ring_->head];
+    r.bootId = bootId_;
+    r.atMs = static_cast<uint32_t>(millis()) - elapsedMs;
+    r.durationMs = elapsedMs;
+    r.budgetMs = budgetMs;
+    r.stage = stage;
+    r.open = 1;
+    openSlot_ = ring_->head;
+    openMark_ = mark;
+    reportedMark_ = mark;
+    ring_->head = static_cast<uint8_t>((ring_->head + 1) % kStallRingSize);
+    if (ring_->count < kStallRingSize) {
+      ring_->count++;
+    }
+    ring_->total++;
+  }
+
+  StallRing *ring_ = nullptr;
+  uint32_t bootId_ = 0;
+  esp_timer_handle_t timer_ = nullptr;
+  std::atomic<uint32_t> mark_{0};
+  std::atomic<uint16_t> budgets_[kStallStageMax] = {};
+  std::atomic<uint32_t> closed_{0};
+
+  // Timer side.
+  uint8_t openSlot_ = kNoSlot;
+  uint32_t openMark_ = 0;
+  uint32_t reportedMark_ = 0;
+};
+
+// Marks a stage for the enclosing block.
+class StallScope {
+public:
+  StallScope(StallWatch &watch, uint8_t stage) : watch_(watch), outer_(watch.enter(stage)) {}
+
+  ~StallScope() {
+    watch_.leave(outer_);
+  }
+
+  StallScope(const StallScope &) = delete;
+  StallScope &operator=(const StallScope &) = delete;
+
+private:
+  StallWatch &watch_;
+  uint32_t outer_;
+};
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <Arduino.h>
+
+class Adafruit_GFX : public Print {
+public:
+  Adafruit_GFX(int16_t w, int16_t h) : width_(w), height_(h) {}
+  size_t write(uint8_t) override { return 1; }
+  using Print::write;
+  void setTextSize(uint8_t) {}
+  void setTextColor(uint16_t) {}
+  void setCursor(int16_t, int16_t) {}
+  void drawPixel(int16_t, int16_t, uint16_t) {}
+  void fillRect(int16_t, int16_t, int16_t, int16_t, uint16_t) {}
+  int16_t width() const { return width_; }
+  int16_t height() const { return height_; }
+
+private:
+  int16_t width_;
+  int16_t height_;
+};
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <Adafruit_GFX.h>
+#include <Wire.h>
+
+#include <vector>
+
+#define SSD1306_SWITCHCAPVCC 0x02
+#define SSD1306_BLACK 0
+#define SSD1306_WHITE 1
+
+class Adafruit_SSD1306 : public Adafruit_GFX {
+public:
+  Adafruit_SSD1306(uint8_t w, uint8_t h, TwoWire *wire, int8_t resetPin)
+      : Adafruit_GFX(w, h), buffer_(w * ((h + 7) / 8), 0) {}
+  bool begin(uint8_t vcs, uint8_t addr) { return true; }
+  void clearDisplay() { std::fill(buffer_.begin(), buffer_.end(), 0); }
+  void display() {}
+  uint8_t *getBuffer() { return buffer_.data(); }
+
+private:
+  std::vector<uint8_t> buffer_;
+};
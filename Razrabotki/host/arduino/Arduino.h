@@ -0,0 +1,190 @@
+#pragma once
+
+// Host stand-in for the subset of the ESP32 Arduino core used by the
+// firmwares in Razrabotki/. Only for host builds (see ../README.md); the
+// behaviour follows the real core where the firmware depends on it.
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+
+#define PROGMEM
+#define PGM_P const char *
+#define IRAM_ATTR
+#define RTC_NOINIT_ATTR
+
+#define HIGH 0x1
+#define LOW 0x0
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define INPUT_PULLUP 0x05
+
+#define SDA 21
+#define SCL 22
+
+#define ADC_0db 0
+#define ADC_11db 3
+
+typedef bool boolean;
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield();
+
+void pinMode(uint8_t pin, uint8_t mode);
+int digitalRead(uint8_t pin);
+void digitalWrite(uint8_t pin, uint8_t value);
+int analogRead(uint8_t pin);
+void analogReadResolution(uint8_t bits);
+void analogSetPinAttenuation(uint8_t pin, int attenuation);
+
+long random(long howbig);
+long random(long howsmall, long howbig);
+void randomSeed(unsigned long seed);
+uint32_t esp_random();
+
+bool setCpuFrequencyMhz(uint32_t mhz);
+uint32_t getCpuFrequencyMhz();
+
+// Host-only hooks.
+// Level returned by analogRead(); defaults to a quiet baseline.
+void hostSetAnalogValue(uint8_t pin, int value);
+// Heap allocations made so far by the calling thread.
+uint64_t hostThreadAllocations();
+
+class String {
+public:
+  String() {}
+  String(const char *text) : s_(text ? text : "") {}
+  String(const std::string &text) : s_(text) {}
+  explicit String(char c) : s_(1, c) {}
+  explicit String(int value) : s_(std::to_string(value)) {}
+  explicit String(unsigned int value) : s_(std::to_string(value)) {}
+  explicit String(long value) : s_(std::to_string(value)) {}
+  explicit String(unsigned long value) : s_(std::to_string(value)) {}
+
+  unsigned int length() const { return static_cast<unsigned int>(s_.size()); }
+  const char *c_str() const { return s_.c_str(); }
+  bool isEmpty() const { return s_.empty(); }
+  void reserve(unsigned int size) { s_.reserve(size); }
+
+  int indexOf(const String &pattern) const {
+    size_t pos = s_.find(pattern.s_);
+    return pos == std::string::npos ? -1 : static_cast<int>(pos);
+  }
+  String substring(unsigned int from) const { return from < s_.size() ? String(s_.substr(from)) : String(); }
+  String substring(unsigned int from, unsigned int to) const {
+    return from < to && from < s_.size() ? String(s_.substr(from, to - from)) : String();
+  }
+  bool startsWith(const String &prefix) const { return s_.compare(0, prefix.s_.size(), prefix.s_) == 0; }
+  bool startsWith(const String &prefix, unsigned int offset) const {
+    return offset <= s_.size() && s_.compare(offset, prefix.s_.size(), prefix.s_) == 0;
+  }
+  long toInt() const { return strtol(s_.c_str(), nullptr, 10); }
+
+  char operator[](unsigned int index) const { return index < s_.size() ? s_[index] : 0; }
+  bool operator==(const String &other) const { return s_ == other.s_; }
+  bool operator==(const char *other) const { return s_ == (other ? other : ""); }
+  bool operator!=(const String &other) const { return s_ != other.s_; }
+  bool operator!=(const char *other) const { return !(*this == other); }
+
+  String &operator+=(const String &other) { s_ += other.s_; return *this; }
+  String &operator+=(const char *other) { s_ += other; return *this; }
+  String &operator+=(char c) { s_ += c; return *this; }
+
+  friend String operator+(const String &a, const String &b) { return String(a.s_ + b.s_); }
+  friend String operator+(const String &a, const char *b) { return String(a.s_ + b); }
+  friend String operator+(const char *a, const String &b) { return String(a + b.s_); }
+
+private:
+  std::string s_;
+};
+
+class Print {
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t *buffer, size_t size) {
+    size_t n = 0;
+    while (n < size && write(buffer[n])) {
+      n++;
+    }
+    return n;
+  }
+  size_t write(const char *buffer, size_t size) { return write(reinterpret_cast<const uint8_t *>(buffer), size); }
+
+  size_t print(const char *text) { return write(text, strlen(text)); }
+  size_t print(const String &text) { return write(text.c_str(), text.length()); }
+  size_t print(char c) { return write(static_cast<uint8_t>(c)); }
+  size_t print(int value) { return printf("%d", value); }
+  size_t print(unsigned int value) { return printf("%u", value); }
+  size_t print(long value) { return printf("%ld", value); }
+  size_t print(unsigned long value) { return printf("%lu", value); }
+  size_t println() { return print("\r\n"); }
+  template <typename T>
+  size_t println(const T &value) { return print(value) + println(); }
+
+  size_t printf(const char *format, ...) __attribute__((format(printf, 2, 3))) {
+    char buf[256];
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(buf, sizeof(buf), format, args);
+    va_end(args);
+    if (len <= 0) {
+      return 0;
+    }
+    return write(buf, static_cast<size_t>(len) < sizeof(buf) ? len : sizeof(buf) - 1);
+  }
+
+  virtual void flush() {}
+};
+
+class HardwareSerial : public Print {
+public:
+  void begin(unsigned long baud);
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t *buffer, size_t size) override;
+  using Print::write;
+  int available() { return 0; }
+  int read() { return -1; }
+  int availableForWrite() { return 4096; }
+  size_t setTxBufferSize(size_t size) { return size; }
+  void updateBaudRate(unsigned long baud) {}
+  void flush() override;
+  operator bool() const { return true; }
+};
+
+extern HardwareSerial Serial;
+
+class IPAddress {
+public:
+  IPAddress() : bytes_{0, 0, 0, 0} {}
+  IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : bytes_{a, b, c, d} {}
+  String toString() const {
+    char buf[16];
+    snprintf(buf, sizeof(buf), "%u.%u.%u.%u", bytes_[0], bytes_[1], bytes_[2], bytes_[3]);
+    return String(buf);
+  }
+
+private:
+  uint8_t bytes_[4];
+};
+
+// FreeRTOS task API, mapped onto detached std::threads.
+typedef void (*TaskFunction_t)(void *);
+typedef void *TaskHandle_t;
+typedef int BaseType_t;
+#define pdPASS 1
+#define pdFAIL 0
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stackDepth, void *arg,
+                       unsigned priority, TaskHandle_t *handle);
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stackDepth, void *arg,
+                                   unsigned priority, TaskHandle_t *handle, int core);
+void vTaskDelete(TaskHandle_t handle);
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+// In-memory NVS stand-in. Values live for the life of the process; counts
+// of writes per key are kept so host runs can check write amplification.
+class Preferences {
+public:
+  bool begin(const char *name, bool readOnly = false);
+  void end() {}
+  bool clear();
+  bool remove(const char *key);
+  bool isKey(const char *key);
+
+  size_t putBool(const char *key, bool value) { return putBytes(key, &value, sizeof(value)); }
+  size_t putUChar(const char *key, uint8_t value) { return putBytes(key, &value, sizeof(value)); }
+  size_t putUShort(const char *key, uint16_t value) { return putBytes(key, &value, sizeof(value)); }
+  size_t putInt(const char *key, int32_t value) { return putBytes(key, &value, sizeof(value)); }
+  size_t putUInt(const char *key, uint32_t value) { return putBytes(key, &value, sizeof(value)); }
+  size_t putULong(const char *key, uint32_t value) { return putBytes(key, &value, sizeof(value)); }
+  size_t putBytes(const char *key, const void *value, size_t len);
+
+  bool getBool(const char *key, bool defaultValue = false) { return get(key, defaultValue); }
+  uint8_t getUChar(const char *key, uint8_t defaultValue = 0) { return get(key, defaultValue); }
+  uint16_t getUShort(const char *key, uint16_t defaultValue = 0) { return get(key, defaultValue); }
+  int32_t getInt(const char *key, int32_t defaultValue = 0) { return get(key, defaultValue); }
+  uint32_t getUInt(const char *key, uint32_t defaultValue = 0) { return get(key, defaultValue); }
+  uint32_t getULong(const char *key, uint32_t defaultValue = 0) { return get(key, defaultValue); }
+  size_t getBytesLength(const char *key);
+  size_t getBytes(const char *key, void *buf, size_t maxLen);
+
+  static uint64_t hostWriteCount();
+
+private:
+  template <typename T>
+  T get(const char *key, T defaultValue) {
+    T value;
+    return getBytes(key, &value, sizeof(value)) == sizeof(value) ? value : defaultValue;
+  }
+
+  std::string ns_;
+};
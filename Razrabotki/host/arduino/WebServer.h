@@ -0,0 +1,95 @@
+#pragma once
+
+#include <Arduino.h>
+#include <WiFi.h>
+
+#include <atomic>
+#include <functional>
+#include <utility>
+#include <vector>
+
+enum HTTPMethod { HTTP_ANY, HTTP_GET, HTTP_HEAD, HTTP_POST, HTTP_PUT, HTTP_PATCH, HTTP_DELETE, HTTP_OPTIONS };
+
+#define CONTENT_LENGTH_UNKNOWN ((size_t)-1)
+
+// Host-side counters of the stand-in server, read by the load-test tool.
+struct HostServerStats {
+  std::atomic<uint64_t> requests{0};
+  std::atomic<uint64_t> handlerAllocations{0};
+  std::atomic<uint64_t> handlerNs{0};
+};
+
+HostServerStats &hostServerStats();
+
+// KeepAliveServer (common/http_server.h) feeds the same counters on a host.
+#define HOST_WEBSERVER_STATS 1
+uint64_t hostNowNs();
+
+// Socket-backed stand-in for the ESP32 WebServer. Like the original it is
+// driven from loop() via handleClient(), serves one request per call and
+// closes the connection after the response. The listening port is 8000 +
+// the firmware port unless HOST_HTTP_PORT is set.
+class WebServer {
+public:
+  typedef std::function<void(void)> THandlerFunction;
+
+  explicit WebServer(int port = 80) : port_(port) {}
+  ~WebServer();
+
+  void begin();
+  void handleClient();
+
+  void on(const String &uri, THandlerFunction handler) { on(uri, HTTP_ANY, handler); }
+  void on(const String &uri, HTTPMethod method, THandlerFunction handler) {
+    routes_.push_back(Route{uri, method, handler});
+  }
+  void onNotFound(THandlerFunction handler) { notFound_ = handler; }
+
+  void send(int code, const char *contentType = nullptr, const String &content = String());
+  void send(int code, const String &contentType, const String &content) {
+    send(code, contentType.c_str(), content);
+  }
+  void send(int code, const char *contentType, const char *content) { send_P(code, contentType, content); }
+  void send_P(int code, PGM_P contentType, PGM_P content) { send_P(code, contentType, content, strlen(content)); }
+  void send_P(int code, PGM_P contentType, PGM_P content, size_t contentLength);
+  void sendHeader(const String &name, const String &value, bool first = false);
+  void setContentLength(size_t contentLength) { contentLength_ = contentLength; }
+  void sendContent(const String &content) { sendContent(content.c_str(), content.length()); }
+  void sendContent(const char *content, size_t size);
+
+  String arg(const String &name) const;
+  String arg(int i) const;
+  String argName(int i) const;
+  int args() const { return static_cast<int>(args_.size()); }
+  bool hasArg(const String &name) const;
+  String header(const String &name) const;
+  bool hasHeader(const String &name) const;
+  void collectHeaders(const char *headerKeys[], size_t count) {}
+  String uri() const { return uri_; }
+  HTTPMethod method() const { return method_; }
+  WiFiClient client() { return WiFiClient(current_); }
+
+private:
+  struct Route {
+    String uri;
+    HTTPMethod method;
+    THandlerFunction handler;
+  };
+
+  bool readRequest();
+  void writeHead(int code, const char *contentType, size_t contentLength);
+
+  int port_;
+  int listenFd_ = -1;
+  std::vector<Route> routes_;
+  THandlerFunction notFound_;
+  std::shared_ptr<HostSocket> current_;
+  String uri_;
+  HTTPMethod method_ = HTTP_GET;
+  std::vector<std::pair<String, String>> args_;
+  std::vector<std::pair<String, String>> requestHeaders_;
+  std::vector<std::pair<String, String>> responseHeaders_;
+  size_t contentLength_ = 0;
+  bool chunked_ = false;
+  bool responded_ = false;
+};
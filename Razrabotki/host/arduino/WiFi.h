@@ -0,0 +1,65 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include <memory>
+
+#define WIFI_OFF 0
+#define WIFI_STA 1
+#define WIFI_AP 2
+
+struct HostSocket;
+
+// Shared handle to an accepted TCP connection, like the core's WiFiClient:
+// copies refer to the same socket, which closes when the last copy goes.
+class WiFiClient : public Print {
+public:
+  WiFiClient() {}
+  explicit WiFiClient(std::shared_ptr<HostSocket> socket) : socket_(socket) {}
+
+  size_t write(uint8_t c) override { return write(&c, 1); }
+  size_t write(const uint8_t *buffer, size_t size) override;
+  using Print::write;
+  int available();
+  int read();
+  int read(uint8_t *buffer, size_t size);
+  uint8_t connected();
+  void stop();
+  void setNoDelay(bool noDelay);
+  operator bool() const { return static_cast<bool>(socket_); }
+
+private:
+  std::shared_ptr<HostSocket> socket_;
+};
+
+// Listening socket, the counterpart of the core's WiFiServer: available()
+// accepts one pending connection without blocking. The port is 8000 + the
+// firmware port unless HOST_HTTP_PORT is set, as for WebServer.
+// HOST_TCP_SNDBUF caps the send buffer of accepted sockets, for both servers,
+// e.g. 5744 for lwIP's default TCP_SND_BUF.
+class WiFiServer {
+public:
+  explicit WiFiServer(uint16_t port = 80) : port_(port) {}
+  ~WiFiServer();
+
+  void begin();
+  WiFiClient available();
+  void setNoDelay(bool noDelay) { noDelay_ = noDelay; }
+
+private:
+  uint16_t port_;
+  int listenFd_ = -1;
+  bool noDelay_ = false;
+};
+
+class WiFiClass {
+public:
+  bool mode(int) { return true; }
+  bool setSleep(bool) { return true; }
+  bool softAPConfig(IPAddress, IPAddress, IPAddress) { return true; }
+  bool softAP(const char *, const char * = nullptr) { return true; }
+  IPAddress softAPIP() { return IPAddress(127, 0, 0, 1); }
+  uint8_t softAPgetStationNum() { return 0; }
+};
+
+extern WiFiClass WiFi;
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <Arduino.h>
+
+// No I2C devices on the host: every probe reports a missing device.
+class TwoWire {
+public:
+  bool begin(int sda = -1, int scl = -1, uint32_t frequency = 0) { return true; }
+  bool setClock(uint32_t frequency) { return true; }
+  void beginTransmission(uint8_t address) {}
+  uint8_t endTransmission(bool sendStop = true) { return 2; }
+};
+
+extern TwoWire Wire;
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <esp_err.h>
+
+// Microseconds since start on the host's monotonic clock, plus a virtual
+// offset. HOST_CLOCK_START_US sets where the clock starts, so a run can begin
+// just short of a 32-bit millis()/micros() wrap; millis() and micros() are
+// derived from this clock and wrap with it.
+int64_t esp_timer_get_time();
+
+// Host-only: moves the clock forward without waiting.
+void hostAdvanceClockUs(int64_t us);
+
+// Host-only: detaches the clock from real time. It reads startUs and then
+// moves on by stepUs at every read, so a run on a single thread sees the same
+// times whenever it runs; busy-wait loops still progress. stepUs 0 goes back
+// to real time from where the stepped clock stood.
+void hostStepClock(int64_t startUs, int64_t stepUs);
+
+// Periodic and one-shot timers run their callback on a thread of their own,
+// the host counterpart of the esp_timer task. Periods are in real
+// microseconds; the virtual clock offset does not speed them up.
+typedef struct HostTimer *esp_timer_handle_t;
+typedef void (*esp_timer_cb_t)(void *arg);
+
+typedef enum {
+  ESP_TIMER_TASK,
+  ESP_TIMER_ISR,
+} esp_timer_dispatch_t;
+
+typedef struct {
+  esp_timer_cb_t callback;
+  void *arg;
+  esp_timer_dispatch_t dispatch_method;
+  const char *name;
+  bool skip_unhandled_events;
+} esp_timer_create_args_t;
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *out);
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period_us);
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us);
+esp_err_t esp_timer_stop(esp_timer_handle_t timer);
@@ -0,0 +1,475 @@
+// Host implementation of the Arduino.h, Preferences.h, esp_partition.h and
+// esp_timer.h stand-ins: a virtual monotonic clock and periodic timers, stdout
+// serial, in-memory NVS and flash, and the allocation counters the load-test tool reports per
+// request.
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include <Wire.h>
+#include <esp_partition.h>
+#include <esp_timer.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <new>
+#include <random>
+#include <thread>
+#include <vector>
+
+HardwareSerial Serial;
+TwoWire Wire;
+
+namespace {
+
+const std::chrono::steady_clock::time_point kStart = std::chrono::steady_clock::now();
+
+std::atomic<int64_t> &clockOffsetUs() {
+  static const char *start = getenv("HOST_CLOCK_START_US");
+  static std::atomic<int64_t> offset(start ? strtoll(start, nullptr, 10) : 0);
+  return offset;
+}
+
+thread_local uint64_t threadAllocations = 0;
+
+int analogLevels[64];
+uint8_t digitalLevels[64];
+std::mt19937 randomEngine(1);
+
+// HOST_SERIAL=1 sends Serial to stdout, any other value names a file (for
+// binary output such as a sample capture).
+FILE *serialOut() {
+  static FILE *out = [] {
+    const char *target = getenv("HOST_SERIAL");
+    if (target == nullptr) {
+      return static_cast<FILE *>(nullptr);
+    }
+    return strcmp(target, "1") == 0 ? stdout : fopen(target, "wb");
+  }();
+  return out;
+}
+
+} // namespace
+
+// ---- heap accounting -------------------------------------------------------
+
+void *operator new(size_t size) {
+  threadAllocations++;
+  void *p = malloc(size ? size : 1);
+  if (p == nullptr) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void *operator new[](size_t size) {
+  return operator new(size);
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept {
+  threadAllocations++;
+  return malloc(size ? size : 1);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept {
+  return operator new(size, std::nothrow);
+}
+
+void operator delete(void *p) noexcept {
+  free(p);
+}
+
+void operator delete[](void *p) noexcept {
+  free(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+  free(p);
+}
+
+void operator delete[](void *p, size_t) noexcept {
+  free(p);
+}
+
+uint64_t hostThreadAllocations() {
+  return threadAllocations;
+}
+
+// ---- core ------------------------------------------------------------------
+
+namespace {
+
+std::atomic<int64_t> clockStepUs(0);
+std::atomic<int64_t> steppedClockUs(0);
+
+int64_t realClockUs() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - kStart).count() +
+         clockOffsetUs().load();
+}
+
+} // namespace
+
+int64_t esp_timer_get_time() {
+  int64_t step = clockStepUs.load();
+  return step != 0 ? steppedClockUs.fetch_add(step) : realClockUs();
+}
+
+void hostStepClock(int64_t startUs, int64_t stepUs) {
+  if (stepUs == 0) {
+    clockOffsetUs() += steppedClockUs.load() - realClockUs();
+  } else {
+    steppedClockUs.store(startUs);
+  }
+  clockStepUs.store(stepUs);
+}
+
+void hostAdvanceClockUs(int64_t us) {
+  clockOffsetUs() += us;
+  steppedClockUs += us;
+}
+
+struct HostTimer {
+  esp_timer_create_args_t args;
+  std::mutex lock;
+  std::condition_variable changed;
+  bool running = false;
+  bool oneShot = false;
+  uint64_t periodUs = 0;
+  uint32_t generation = 0;
+};
+
+namespace {
+
+// One thread per timer, parked while the timer is stopped. A stop or a
+// restart bumps the generation so a pending tick of the old run is dropped.
+void runHostTimer(HostTimer *timer) {
+  std::unique_lock<std::mutex> guard(timer->lock);
+  for (;;) {
+    timer->changed.wait(guard, [timer] { return timer->running; });
+    uint32_t generation = timer->generation;
+    auto next = std::chrono::steady_clock::now();
+    while (timer->running && timer->generation == generation) {
+      next += std::chrono::microseconds(timer->periodUs);
+      if (timer->changed.wait_until(guard, next, [timer, generation] {
+            return !timer->running || timer->generation != generation;
+          })) {
+        break;
+      }
+      if (timer->oneShot) {
+        timer->running = false;
+      }
+      guard.unlock();
+      timer->args.callback(timer->args.arg);
+      guard.lock();
+    }
+  }
+}
+
+esp_err_t startHostTimer(esp_timer_handle_t timer, uint64_t us, bool oneShot) {
+  std::lock_guard<std::mutex> guard(timer->lock);
+  if (timer->running) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  timer->running = true;
+  timer->oneShot = oneShot;
+  timer->periodUs = us;
+  timer->generation++;
+  timer->changed.notify_all();
+  return ESP_OK;
+}
+
+} // namespace
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *out) {
+  if (args == nullptr || args->callback == nullptr || out == nullptr) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  HostTimer *timer = new HostTimer;
+  timer->args = *args;
+  std::thread(runHostTimer, timer).detach();
+  *out = timer;
+  return ESP_OK;
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period_us) {
+  return startHostTimer(timer, period_us, false);
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us) {
+  return startHostTimer(timer, timeout_us, true);
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer) {
+  std::lock_guard<std::mutex> guard(timer->lock);
+  if (!timer->running) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  timer->running = false;
+  timer->generation++;
+  timer->changed.notify_all();
+  return ESP_OK;
+}
+
+unsigned long millis() {
+  return static_cast<unsigned long>(static_cast<uint32_t>(esp_timer_get_time() / 1000));
+}
+
+unsigned long micros() {
+  return static_cast<unsigned long>(static_cast<uint32_t>(esp_timer_get_time()));
+}
+
+void delay(unsigned long ms) {
+  std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void delayMicroseconds(unsigned int us) {
+  std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+
+void yield() {
+  std::this_thread::yield();
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+  if (pin < 64 && mode == INPUT_PULLUP) {
+    digitalLevels[pin] = HIGH;
+  }
+}
+
+int digitalRead(uint8_t pin) {
+  return pin < 64 ? digitalLevels[pin] : LOW;
+}
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+  if (pin < 64) {
+    digitalLevels[pin] = value ? HIGH : LOW;
+  }
+}
+
+int analogRead(uint8_t pin) {
+  return pin < 64 ? analogLevels[pin] : 0;
+}
+
+void hostSetAnalogValue(uint8_t pin, int value) {
+  if (pin < 64) {
+    analogLevels[pin] = value;
+  }
+}
+
+void analogReadResolution(uint8_t) {}
+
+void analogSetPinAttenuation(uint8_t, int) {}
+
+long random(long howbig) {
+  return howbig > 0 ? static_cast<long>(randomEngine() % static_cast<unsigned long>(howbig)) : 0;
+}
+
+long random(long howsmall, long howbig) {
+  return howsmall < howbig ? howsmall + random(howbig - howsmall) : howsmall;
+}
+
+void randomSeed(unsigned long seed) {
+  if (seed != 0) {
+    randomEngine.seed(static_cast<uint32_t>(seed));
+  }
+}
+
+// Fixed sequence so host runs are repeatable.
+uint32_t esp_random() {
+  static std::mt19937 engine(0xE5B32);
+  static std::mutex lock;
+  std::lock_guard<std::mutex> guard(lock);
+  return engine();
+}
+
+// Only recorded; the host clock does not scale with it.
+static std::atomic<uint32_t> cpuMhz{240};
+
+bool setCpuFrequencyMhz(uint32_t mhz) {
+  cpuMhz = mhz;
+  return true;
+}
+
+uint32_t getCpuFrequencyMhz() {
+  return cpuMhz;
+}
+
+void HardwareSerial::begin(unsigned long) {}
+
+size_t HardwareSerial::write(uint8_t c) {
+  return write(&c, 1);
+}
+
+size_t HardwareSerial::write(const uint8_t *buffer, size_t size) {
+  if (serialOut() != nullptr) {
+    fwrite(buffer, 1, size, serialOut());
+  }
+  return size;
+}
+
+void HardwareSerial::flush() {
+  if (serialOut() != nullptr) {
+    fflush(serialOut());
+  }
+}
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stackDepth, void *arg,
+                       unsigned priority, TaskHandle_t *handle) {
+  std::thread(fn, arg).detach();
+  if (handle != nullptr) {
+    *handle = nullptr;
+  }
+  return pdPASS;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stackDepth, void *arg,
+                                   unsigned priority, TaskHandle_t *handle, int core) {
+  return xTaskCreate(fn, name, stackDepth, arg, priority, handle);
+}
+
+// Tasks here are threads that end when their function returns.
+void vTaskDelete(TaskHandle_t) {}
+
+// ---- Preferences -----------------------------------------------------------
+
+namespace {
+
+std::mutex nvsLock;
+std::map<std::string, std::vector<uint8_t>> nvsStore;
+uint64_t nvsWrites = 0;
+
+} // namespace
+
+bool Preferences::begin(const char *name, bool) {
+  ns_ = std::string(name) + ":";
+  return true;
+}
+
+bool Preferences::clear() {
+  std::lock_guard<std::mutex> guard(nvsLock);
+  for (auto it = nvsStore.begin(); it != nvsStore.end();) {
+    it = it->first.compare(0, ns_.size(), ns_) == 0 ? nvsStore.erase(it) : std::next(it);
+  }
+  return true;
+}
+
+bool Preferences::remove(const char *key) {
+  std::lock_guard<std::mutex> guard(nvsLock);
+  return nvsStore.erase(ns_ + key) > 0;
+}
+
+bool Preferences::isKey(const char *key) {
+  std::lock_guard<std::mutex> guard(nvsLock);
+  return nvsStore.count(ns_ + key) > 0;
+}
+
+size_t Preferences::putBytes(const char *key, const void *value, size_t len) {
+  // Same limit as NVS; catches keys that would fail on the device.
+  if (strlen(key) > 15) {
+    return 0;
+  }
+  std::lock_guard<std::mutex> guard(nvsLock);
+  const uint8_t *bytes = static_cast<const uint8_t *>(value);
+  nvsStore[ns_ + key].assign(bytes, bytes + len);
+  nvsWrites++;
+  return len;
+}
+
+size_t Preferences::getBytesLength(const char *key) {
+  std::lock_guard<std::mutex> guard(nvsLock);
+  auto it = nvsStore.find(ns_ + key);
+  return it == nvsStore.end() ? 0 : it->second.size();
+}
+
+size_t Preferences::getBytes(const char *key, void *buf, size_t maxLen) {
+  std::lock_guard<std::mutex> guard(nvsLock);
+  auto it = nvsStore.find(ns_ + key);
+  if (it == nvsStore.end() || it->second.size() > maxLen) {
+    return 0;
+  }
+  memcpy(buf, it->second.data(), it->second.size());
+  return it->second.size();
+}
+
+uint64_t Preferences::hostWriteCount() {
+  std::lock_guard<std::mutex> guard(nvsLock);
+  return nvsWrites;
+}
+
+// ---- esp_partition ---------------------------------------------------------
+
+namespace {
+
+const uint32_t kFlashSectorSize = 4096;
+
+esp_partition_t spiffsPartition = {ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_SPIFFS, 0x290000, 0,
+                                   "spiffs"};
+std::vector<uint8_t> spiffsData;
+std::atomic<uint64_t> spiffsBytesRead{0};
+
+std::vector<uint8_t> &partitionData() {
+  if (spiffsData.empty()) {
+    const char *kb = getenv("HOST_PARTITION_KB");
+    uint32_t size = (kb ? static_cast<uint32_t>(strtoul(kb, nullptr, 10)) : 64) * 1024;
+    size -= size % kFlashSectorSize;
+    spiffsData.assign(size, 0xFF);
+    spiffsPartition.size = size;
+  }
+  return spiffsData;
+}
+
+bool inRange(const esp_partition_t *partition, size_t offset, size_t size) {
+  return partition == &spiffsPartition && offset <= partition->size && size <= partition->size - offset;
+}
+
+} // namespace
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype,
+                                                const char *label) {
+  partitionData();
+  if (type != spiffsPartition.type || spiffsPartition.size == 0) {
+    return nullptr;
+  }
+  if (subtype != ESP_PARTITION_SUBTYPE_ANY && subtype != spiffsPartition.subtype) {
+    return nullptr;
+  }
+  if (label != nullptr && strcmp(label, spiffsPartition.label) != 0) {
+    return nullptr;
+  }
+  return &spiffsPartition;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *partition, size_t offset, void *dst, size_t size) {
+  if (!inRange(partition, offset, size)) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  memcpy(dst, partitionData().data() + offset, size);
+  spiffsBytesRead += size;
+  return ESP_OK;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t *partition, size_t offset, const void *src, size_t size) {
+  if (!inRange(partition, offset, size)) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  uint8_t *flash = partitionData().data() + offset;
+  const uint8_t *bytes = static_cast<const uint8_t *>(src);
+  for (size_t i = 0; i < size; i++) {
+    flash[i] &= bytes[i];
+  }
+  return ESP_OK;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t *partition, size_t offset, size_t size) {
+  if (!inRange(partition, offset, size) || offset % kFlashSectorSize != 0 || size % kFlashSectorSize != 0) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  memset(partitionData().data() + offset, 0xFF, size);
+  return ESP_OK;
+}
+
+uint64_t hostPartitionBytesRead() {
+  return spiffsBytesRead;
+}
@@ -0,0 +1,513 @@
+// Socket-backed WebServer, WiFiServer and WiFiClient stand-ins. One request per
+// handleClient() call, HTTP/1.1 responses with "Connection: close", chunked
+// bodies for CONTENT_LENGTH_UNKNOWN. A handler that keeps server.client()
+// and sends nothing (an event stream) keeps the connection open.
+
+#include <WebServer.h>
+#include <WiFi.h>
+
+#include <arpa/inet.h>
+#include <chrono>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+WiFiClass WiFi;
+
+struct HostSocket {
+  explicit HostSocket(int fd) : fd(fd) {}
+  ~HostSocket() {
+    close();
+  }
+  void close() {
+    if (fd >= 0) {
+      ::close(fd);
+      fd = -1;
+    }
+  }
+  int fd;
+};
+
+namespace {
+
+const size_t kMaxHead = 8192;
+const size_t kMaxBody = 16384;
+const int kReadTimeoutMs = 2000;
+
+bool writeAll(HostSocket &socket, const char *data, size_t size) {
+  while (size > 0 && socket.fd >= 0) {
+    ssize_t n = ::send(socket.fd, data, size, MSG_NOSIGNAL);
+    if (n <= 0) {
+      socket.close();
+      return false;
+    }
+    data += n;
+    size -= static_cast<size_t>(n);
+  }
+  return socket.fd >= 0;
+}
+
+bool waitReadable(int fd, int timeoutMs) {
+  pollfd p = {fd, POLLIN, 0};
+  return ::poll(&p, 1, timeoutMs) > 0;
+}
+
+int hexValue(char c) {
+  if (c >= '0' && c <= '9') {
+    return c - '0';
+  }
+  if (c >= 'a' && c <= 'f') {
+    return c - 'a' + 10;
+  }
+  if (c >= 'A' && c <= 'F') {
+    return c - 'A' + 10;
+  }
+  return -1;
+}
+
+std::string urlDecode(const char *p, size_t len) {
+  std::string out;
+  out.reserve(len);
+  for (size_t i = 0; i < len; i++) {
+    if (p[i] == '+') {
+      out += ' ';
+    } else if (p[i] == '%' && i + 2 < len && hexValue(p[i + 1]) >= 0 && hexValue(p[i + 2]) >= 0) {
+      out += static_cast<char>(hexValue(p[i + 1]) * 16 + hexValue(p[i + 2]));
+      i += 2;
+    } else {
+      out += p[i];
+    }
+  }
+  return out;
+}
+
+void parseArgs(const std::string &text, std::vector<std::pair<String, String>> &args) {
+  size_t pos = 0;
+  while (pos < text.size()) {
+    size_t end = text.find('&', pos);
+    if (end == std::string::npos) {
+      end = text.size();
+    }
+    size_t eq = text.find('=', pos);
+    if (eq == std::string::npos || eq > end) {
+      eq = end;
+    }
+    if (end > pos) {
+      String name(urlDecode(text.data() + pos, eq - pos));
+      String value(eq < end ? urlDecode(text.data() + eq + 1, end - eq - 1) : std::string());
+      args.emplace_back(name, value);
+    }
+    pos = end + 1;
+  }
+}
+
+HTTPMethod parseMethod(const std::string &name) {
+  static const struct {
+    const char *name;
+    HTTPMethod method;
+  } kMethods[] = {{"GET", HTTP_GET},     {"HEAD", HTTP_HEAD},     {"POST", HTTP_POST},      {"PUT", HTTP_PUT},
+                  {"PATCH", HTTP_PATCH}, {"DELETE", HTTP_DELETE}, {"OPTIONS", HTTP_OPTIONS}};
+  for (const auto &m : kMethods) {
+    if (name == m.name) {
+      return m.method;
+    }
+  }
+  return HTTP_ANY;
+}
+
+const char *reasonPhrase(int code) {
+  switch (code) {
+    case 200: return "OK";
+    case 204: return "No Content";
+    case 304: return "Not Modified";
+    case 400: return "Bad Request";
+    case 404: return "Not Found";
+    case 406: return "Not Acceptable";
+    case 500: return "Internal Server Error";
+    case 503: return "Service Unavailable";
+    default: return "";
+  }
+}
+
+bool equalsIgnoreCase(const String &a, const char *b) {
+  return strcasecmp(a.c_str(), b) == 0;
+}
+
+} // namespace
+
+HostServerStats &hostServerStats() {
+  static HostServerStats stats;
+  return stats;
+}
+
+uint64_t hostNowNs() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+namespace {
+
+int listenOn(int firmwarePort) {
+  const char *env = getenv("HOST_HTTP_PORT");
+  int port = env ? atoi(env) : firmwarePort + 8000;
+
+  int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+  int yes = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+  // Accepted sockets inherit the send buffer. The host's grows to megabytes,
+  // so without this a streamed response never waits for its client.
+  const char *sndbuf = getenv("HOST_TCP_SNDBUF");
+  if (sndbuf != nullptr) {
+    int size = atoi(sndbuf);
+    setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+  }
+  sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(static_cast<uint16_t>(port));
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (::bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 || ::listen(fd, 128) != 0) {
+    fprintf(stderr, "host server: cannot listen on 127.0.0.1:%d\n", port);
+    exit(1);
+  }
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+  return fd;
+}
+
+} // namespace
+
+// ---- WiFiClient ------------------------------------------------------------
+
+size_t WiFiClient::write(const uint8_t *buffer, size_t size) {
+  if (!socket_ || !writeAll(*socket_, reinterpret_cast<const char *>(buffer), size)) {
+    return 0;
+  }
+  return size;
+}
+
+int WiFiClient::available() {
+  if (!socket_ || socket_->fd < 0) {
+    return 0;
+  }
+  int pending = 0;
+  return ::ioctl(socket_->fd, FIONREAD, &pending) == 0 ? pending : 0;
+}
+
+int WiFiClient::read(uint8_t *buffer, size_t size) {
+  if (!socket_ || socket_->fd < 0) {
+    return -1;
+  }
+  ssize_t n = ::recv(socket_->fd, buffer, size, MSG_DONTWAIT);
+  return n > 0 ? static_cast<int>(n) : -1;
+}
+
+int WiFiClient::read() {
+  unsigned char c;
+  if (!available() || ::recv(socket_->fd, &c, 1, 0) != 1) {
+    return -1;
+  }
+  return c;
+}
+
+uint8_t WiFiClient::connected() {
+  if (!socket_ || socket_->fd < 0) {
+    return 0;
+  }
+  char c;
+  ssize_t n = ::recv(socket_->fd, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+  if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+    socket_->close();
+    return 0;
+  }
+  return 1;
+}
+
+void WiFiClient::stop() {
+  if (socket_) {
+    socket_->close();
+  }
+}
+
+void WiFiClient::setNoDelay(bool noDelay) {
+  if (socket_ && socket_->fd >= 0) {
+    int flag = noDelay ? 1 : 0;
+    setsockopt(socket_->fd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+  }
+}
+
+// ---- WiFiServer ------------------------------------------------------------
+
+WiFiServer::~WiFiServer() {
+  if (listenFd_ >= 0) {
+    ::close(listenFd_);
+  }
+}
+
+void WiFiServer::begin() {
+  listenFd_ = listenOn(port_);
+}
+
+WiFiClient WiFiServer::available() {
+  int fd = listenFd_ >= 0 ? ::accept(listenFd_, nullptr, nullptr) : -1;
+  if (fd < 0) {
+    return WiFiClient();
+  }
+  if (noDelay_) {
+    int yes = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+  }
+  return WiFiClient(std::make_shared<HostSocket>(fd));
+}
+
+// ---- WebServer -------------------------------------------------------------
+
+WebServer::~WebServer() {
+  if (listenFd_ >= 0) {
+    ::close(listenFd_);
+  }
+}
+
+void WebServer::begin() {
+  listenFd_ = listenOn(port_);
+}
+
+void WebServer::handleClient() {
+  if (listenFd_ < 0) {
+    return;
+  }
+  int fd = ::accept(listenFd_, nullptr, nullptr);
+  if (fd < 0) {
+    return;
+  }
+  int yes = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+  current_ = std::make_shared<HostSocket>(fd);
+  responseHeaders_.clear();
+  contentLength_ = 0;
+  chunked_ = false;
+  responded_ = false;
+
+  if (readRequest()) {
+    THandlerFunction handler = notFound_;
+    for (const Route &route : routes_) {
+      if (route.uri == uri_ && (route.method == HTTP_ANY || route.method == method_)) {
+        handler = route.handler;
+        break;
+      }
+    }
+
+    HostServerStats &stats = hostServerStats();
+    uint64_t allocsBefore = hostThreadAllocations();
+    auto start = std::chrono::steady_clock::now();
+    if (handler) {
+      handler();
+    } else {
+      send(404, "text/plain", "Not found");
+    }
+    if (chunked_) {
+      sendContent("", 0);
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    stats.handlerNs += std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+    stats.handlerAllocations += hostThreadAllocations() - allocsBefore;
+    stats.requests++;
+  }
+
+  // Dropping our reference closes the socket unless the handler kept a
+  // WiFiClient copy for streaming.
+  current_.reset();
+  args_.clear();
+  requestHeaders_.clear();
+}
+
+bool WebServer::readRequest() {
+  std::string data;
+  size_t headEnd = std::string::npos;
+  char buf[2048];
+  while (headEnd == std::string::npos) {
+    if (data.size() > kMaxHead || !waitReadable(current_->fd, kReadTimeoutMs)) {
+      return false;
+    }
+    ssize_t n = ::recv(current_->fd, buf, sizeof(buf), 0);
+    if (n <= 0) {
+      return false;
+    }
+    data.append(buf, static_cast<size_t>(n));
+    headEnd = data.find("\r\n\r\n");
+  }
+
+  size_t lineEnd = data.find("\r\n");
+  std::string line = data.substr(0, lineEnd);
+  size_t sp1 = line.find(' ');
+  size_t sp2 = line.find(' ', sp1 + 1);
+  if (sp1 == std::string::npos || sp2 == std::string::npos) {
+    return false;
+  }
+  method_ = parseMethod(line.substr(0, sp1));
+  std::string target = line.substr(sp1 + 1, sp2 - sp1 - 1);
+  size_t q = target.find('?');
+  uri_ = String(target.substr(0, q));
+  if (q != std::string::npos) {
+    parseArgs(target.substr(q + 1), args_);
+  }
+
+  size_t bodyLength = 0;
+  bool formBody = false;
+  size_t pos = lineEnd + 2;
+  while (pos < headEnd) {
+    size_t end = data.find("\r\n", pos);
+    size_t colon = data.find(':', pos);
+    if (colon != std::string::npos && colon < end) {
+      size_t valueStart = data.find_first_not_of(' ', colon + 1);
+      String name(data.substr(pos, colon - pos));
+      String value(valueStart < end ? data.substr(valueStart, end - valueStart) : std::string());
+      if (equalsIgnoreCase(name, "Content-Length")) {
+        bodyLength = static_cast<size_t>(value.toInt());
+      } else if (equalsIgnoreCase(name, "Content-Type")) {
+        formBody = value.startsWith("application/x-www-form-urlencoded");
+      }
+      requestHeaders_.emplace_back(name, value);
+    }
+    pos = end + 2;
+  }
+  if (bodyLength > kMaxBody) {
+    return false;
+  }
+
+  std::string body = data.substr(headEnd + 4);
+  while (body.size() < bodyLength) {
+    if (!waitReadable(current_->fd, kReadTimeoutMs)) {
+      return false;
+    }
+    ssize_t n = ::recv(current_->fd, buf, sizeof(buf), 0);
+    if (n <= 0) {
+      return false;
+    }
+    body.append(buf, static_cast<size_t>(n));
+  }
+  body.resize(bodyLength);
+  if (bodyLength > 0) {
+    if (formBody) {
+      parseArgs(body, args_);
+    } else {
+      args_.emplace_back(String("plain"), String(body));
+    }
+  }
+  return true;
+}
+
+void WebServer::writeHead(int code, const char *contentType, size_t contentLength) {
+  char head[1024];
+  int len = snprintf(head, sizeof(head), "HTTP/1.1 %d %s\r\n", code, reasonPhrase(code));
+  if (contentType != nullptr && contentType[0] != '\0') {
+    len += snprintf(head + len, sizeof(head) - len, "Content-Type: %s\r\n", contentType);
+  }
+  if (contentLength == CONTENT_LENGTH_UNKNOWN) {
+    chunked_ = true;
+    len += snprintf(head + len, sizeof(head) - len, "Transfer-Encoding: chunked\r\n");
+  } else {
+    len += snprintf(head + len, sizeof(head) - len, "Content-Length: %zu\r\n", contentLength);
+  }
+  for (const auto &h : responseHeaders_) {
+    len += snprintf(head + len, sizeof(head) - len, "%s: %s\r\n", h.first.c_str(), h.second.c_str());
+  }
+  len += snprintf(head + len, sizeof(head) - len, "Connection: close\r\n\r\n");
+  if (len > static_cast<int>(sizeof(head))) {
+    len = sizeof(head);
+  }
+  writeAll(*current_, head, static_cast<size_t>(len));
+  responded_ = true;
+}
+
+void WebServer::send(int code, const char *contentType, const String &content) {
+  send_P(code, contentType, content.c_str(), content.length());
+}
+
+void WebServer::send_P(int code, PGM_P contentType, PGM_P content, size_t contentLength) {
+  if (!current_ || responded_) {
+    return;
+  }
+  if (contentLength_ == CONTENT_LENGTH_UNKNOWN) {
+    writeHead(code, contentType, CONTENT_LENGTH_UNKNOWN);
+    if (contentLength > 0) {
+      sendContent(content, contentLength);
+    }
+    return;
+  }
+  writeHead(code, contentType, contentLength);
+  writeAll(*current_, content, contentLength);
+}
+
+void WebServer::sendHeader(const String &name, const String &value, bool first) {
+  if (first) {
+    responseHeaders_.insert(responseHeaders_.begin(), std::make_pair(name, value));
+  } else {
+    responseHeaders_.emplace_back(name, value);
+  }
+}
+
+// Zero-length content ends a chunked body, as in the core.
+void WebServer::sendContent(const char *content, size_t size) {
+  if (!current_) {
+    return;
+  }
+  if (!chunked_) {
+    writeAll(*current_, content, size);
+    return;
+  }
+  char prefix[16];
+  int len = snprintf(prefix, sizeof(prefix), "%zx\r\n", size);
+  writeAll(*current_, prefix, static_cast<size_t>(len));
+  writeAll(*current_, content, size);
+  writeAll(*current_, "\r\n", 2);
+  if (size == 0) {
+    chunked_ = false;
+  }
+}
+
+String WebServer::arg(const String &name) const {
+  for (const auto &a : args_) {
+    if (a.first == name) {
+      return a.second;
+    }
+  }
+  return String();
+}
+
+String WebServer::arg(int i) const {
+  return i >= 0 && i < args() ? args_[i].second : String();
+}
+
+String WebServer::argName(int i) const {
+  return i >= 0 && i < args() ? args_[i].first : String();
+}
+
+bool WebServer::hasArg(const String &name) const {
+  for (const auto &a : args_) {
+    if (a.first == name) {
+      return true;
+    }
+  }
+  return false;
+}
+
+String WebServer::header(const String &name) const {
+  for (const auto &h : requestHeaders_) {
+    if (equalsIgnoreCase(h.first, name.c_str())) {
+      return h.second;
+    }
+  }
+  return String();
+}
+
+bool WebServer::hasHeader(const String &name) const {
+  for (const auto &h : requestHeaders_) {
+    if (equalsIgnoreCase(h.first, name.c_str())) {
+      return true;
+    }
+  }
+  return false;
+}
@@ -0,0 +1,217 @@
+// Cost of schetotgim's OLED count: blitBigNumber() (big_digits.h) against
+// the setTextSize(3) text path it replaced.
+//
+// The stand-in Adafruit_GFX in arduino/ draws nothing, so the text path is
+// reproduced here the way the libraries run it for a white-on-clear print():
+// Print turns the number into characters, Adafruit_GFX::write() wraps and
+// calls drawChar(), which issues a 3x3 fillRect() per lit font pixel, the
+// default fillRect() splits into drawFastVLine() calls, and the SSD1306
+// driver masks each into the page buffer. Calls stay virtual as in the
+// libraries. Both paths are also compared pixel for pixel, with the text
+// drawn at the blit's row (page 2, y 16).
+//
+// Build (from this directory):
+//   g++ -std=gnu++17 -O2 -I../schetotgim/src big_digits_bench.cpp -o big_digits_bench
+//
+// Usage:
+//   ./big_digits_bench [iterations]
+//
+// Exits non-zero if the two paths draw different pixels.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "big_digits.h"
+
+namespace {
+
+const int16_t kWidth = 128;
+const int16_t kHeight = 64;
+const uint8_t kCountPage = 2;
+const size_t kBufferSize = kWidth * kHeight / 8;
+
+typedef std::chrono::steady_clock BenchClock;
+
+class GfxText {
+public:
+  explicit GfxText(uint8_t *buffer) : buffer_(buffer) {}
+  virtual ~GfxText() {}
+
+  void setCursor(int16_t x, int16_t y) {
+    cursorX_ = x;
+    cursorY_ = y;
+  }
+
+  void setTextSize(uint8_t size) {
+    size_ = size;
+  }
+
+  // Print::print(unsigned long).
+  void print(uint32_t value) {
+    char buf[11];
+    char *str = &buf[sizeof(buf) - 1];
+    *str = '\0';
+    do {
+      *--str = static_cast<char>('0' + value % 10);
+      value /= 10;
+    } while (value != 0);
+    while (*str != '\0') {
+      write(static_cast<uint8_t>(*str++));
+    }
+  }
+
+  // Adafruit_GFX::write() for the classic font, wrap on.
+  virtual size_t write(uint8_t c) {
+    if (cursorX_ + size_ * 6 > kWidth) {
+      cursorX_ = 0;
+      cursorY_ += size_ * 8;
+    }
+    drawChar(cursorX_, cursorY_, c);
+    cursorX_ += size_ * 6;
+    return 1;
+  }
+
+  // Adafruit_GFX::drawChar() with bg == color: only lit pixels are drawn.
+  void drawChar(int16_t x, int16_t y, uint8_t c) {
+    if (x >= kWidth || y >= kHeight || x + 6 * size_ - 1 < 0 || y + 8 * size_ - 1 < 0) {
+      return;
+    }
+    const uint8_t *glyph = BIG_DIGIT_FONT[c - '0'];
+    for (int8_t i = 0; i < 5; i++) {
+      uint8_t line = glyph[i];
+      for (int8_t j = 0; j < 8; j++, line >>= 1) {
+        if (line & 1) {
+          fillRect(x + i * size_, y + j * size_, size_, size_);
+        }
+      }
+    }
+  }
+
+  // Adafruit_GFX::fillRect(): one vertical line per column.
+  virtual void fillRect(int16_t x, int16_t y, int16_t w, int16_t h) {
+    for (int16_t i = x; i < x + w; i++) {
+      drawFastVLine(i, y, h);
+    }
+  }
+
+  // Adafruit_SSD1306::drawFastVLineInternal(), white.
+  virtual void drawFastVLine(int16_t x, int16_t y, int16_t h) {
+    static const uint8_t kPremask[8] = {0x00, 0x80, 0xC0, 0xE0, 0xF0, 0xF8, 0xFC, 0xFE};
+    static const uint8_t kPostmask[8] = {0x00, 0x01, 0x03, 0x07, 0x0F, 0x1F, 0x3F, 0x7F};
+    if (x < 0 || x >= kWidth) {
+      return;
+    }
+    if (y < 0) {
+      h += y;
+      y = 0;
+    }
+    if (y + h > kHeight) {
+      h = kHeight - y;
+    }
+    if (h <= 0) {
+      return;
+    }
+    uint8_t *p = &buffer_[(y / 8) * kWidth + x];
+    uint8_t mod = y & 7;
+    if (mod) {
+      mod = 8 - mod;
+      uint8_t mask = kPremask[mod];
+      if (h < mod) {
+        mask &= 0xFF >> (mod - h);
+      }
+      *p |= mask;
+      if (h < mod) {
+        return;
+      }
+      h -= mod;
+      p += kWidth;
+    }
+    while (h >= 8) {
+      *p = 0xFF;
+      p += kWidth;
+      h -= 8;
+    }
+    if (h) {
+      *p |= kPostmask[h & 7];
+    }
+  }
+
+private:
+  uint8_t *buffer_;
+  int16_t cursorX_ = 0;
+  int16_t cursorY_ = 0;
+  uint8_t size_ = 1;
+};
+
+void drawText(uint8_t *buffer, uint32_t value) {
+  GfxText gfx(buffer);
+  gfx.setTextSize(3);
+  gfx.setCursor(0, kCountPage * 8);
+  gfx.print(value);
+}
+
+// Values with 1..7 digits, i.e. all that fit on one line.
+const uint32_t kValues[] = {0, 7, 42, 318, 1089, 25467, 999999, 8765432};
+const size_t kValueCount = sizeof(kValues) / sizeof(kValues[0]);
+
+bool checkPixels() {
+  bool ok = true;
+  for (size_t i = 0; i < kValueCount; i++) {
+    uint8_t text[kBufferSize] = {};
+    uint8_t blit[kBufferSize] = {};
+    drawText(text, kValues[i]);
+    blitBigNumber(blit, kWidth, kCountPage, 0, kValues[i]);
+    if (memcmp(text, blit, kBufferSize) != 0) {
+      printf("%lu: pixels differ\n", static_cast<unsigned long>(kValues[i]));
+      ok = false;
+    }
+  }
+  // Too wide: clamped to seven nines instead of dropping low digits.
+  uint8_t clamped[kBufferSize] = {};
+  uint8_t nines[kBufferSize] = {};
+  blitBigNumber(clamped, kWidth, kCountPage, 0, 123456789);
+  blitBigNumber(nines, kWidth, kCountPage, 0, 9999999);
+  if (memcmp(clamped, nines, kBufferSize) != 0) {
+    printf("123456789: not clamped to 9999999\n");
+    ok = false;
+  }
+  return ok;
+}
+
+template <typename Draw>
+double nsPerDraw(unsigned iterations, uint8_t *buffer, Draw draw) {
+  auto start = BenchClock::now();
+  for (unsigned i = 0; i < iterations; i++) {
+    // The firmware clears the buffer before every frame.
+    memset(buffer, 0, kBufferSize);
+    draw(buffer, kValues[i % kValueCount]);
+  }
+  auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(BenchClock::now() - start);
+  return static_cast<double>(elapsed.count()) / iterations;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  unsigned iterations = argc > 1 ? static_cast<unsigned>(strtoul(argv[1], nullptr, 10)) : 500000;
+  if (iterations == 0) {
+    iterations = 1;
+  }
+  bool ok = checkPixels();
+
+  static uint8_t buffer[kBufferSize];
+  double clearNs = nsPerDraw(iterations, buffer, [](uint8_t *, uint32_t) {});
+  double textNs = nsPerDraw(iterations, buffer, drawText);
+  double blitNs = nsPerDraw(iterations, buffer, [](uint8_t *fb, uint32_t value) {
+    blitBigNumber(fb, kWidth, kCountPage, 0, value);
+  });
+
+  printf("path              ns/draw  (clear of %zu bytes excluded, %.0f ns)\n", kBufferSize, clearNs);
+  printf("setTextSize(3)    %7.0f\n", textNs - clearNs);
+  printf("blitBigNumber     %7.0f\n", blitNs - clearNs);
+  printf("ratio             %7.1fx\n", (textNs - clearNs) / (blitNs - clearNs));
+  printf("pixels            %s\n", ok ? "identical" : "DIFFERENT");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,109 @@
+// Check that kickshield sessions do not notice the 32-bit clock wraps.
+//
+// Compiles the firmware's main.cpp into this file and runs the same timed
+// session in simulate mode three times, on the stepped host clock
+// (hostStepClock() in arduino/esp_timer.h) so every run sees identical
+// sample times: once from near zero, once straddling the micros() wrap at
+// 2^32 us and once straddling the millis() wrap at 2^32 ms. The loop is
+// driven as loop() drives it, minus HTTP. Every hit time and peak, the
+// instant tempo after each sample window, and the session's stop time,
+// hit count and average tempo must match the first run, all relative to
+// the session start.
+//
+// Build (from this directory):
+//   g++ -std=gnu++17 -O2 -pthread -Iarduino -I../common -I../kickshield_counter/src
+//       clock_wrap_test.cpp arduino/*.cpp -o clock_wrap_test
+//
+// Usage:
+//   ./clock_wrap_test
+//
+// Exits non-zero if a run differs from the first.
+
+#include "../kickshield_counter/src/main.cpp"
+
+#include <cstdio>
+#include <vector>
+
+namespace {
+
+const uint32_t kSessionMs = 12000;
+const int64_t kLeadUs = 5000000;  // session start before the wrap
+const int64_t kStepUs = 1;
+
+struct SessionTrace {
+  std::vector<uint64_t> hitAtUs;
+  std::vector<int> hitPeaks;
+  std::vector<uint32_t> tempo;
+  uint64_t stopAtUs = 0;
+  uint32_t hits = 0;
+  uint32_t maxSeries = 0;
+  uint32_t tempoAvg = 0;
+};
+
+SessionTrace runSession(int64_t startUs) {
+  hostStepClock(startUs, kStepUs);
+  SynthStrikeConfig synthConfig;
+  synthConfig.sampleRateHz = 1000000UL / kSampleIntervalUs * kOversampleRatio;
+  synthConfig.hitsPerMinute = 240;
+  synthConfig.seed = 7;
+  synthSource.reset(synthConfig);
+  startSession(singlePhaseProgram("wrap", kSessionMs), -1, false);
+
+  SessionTrace trace;
+  while (running) {
+    if (advanceSession()) {
+      break;
+    }
+    processSensor();
+    uint64_t now = nowUs();
+    if (hits != trace.hitAtUs.size()) {
+      trace.hitAtUs.push_back(lastHitUs - sessionStartUs);
+      trace.hitPeaks.push_back(lastPeak);
+    }
+    trace.tempo.push_back(tempoHpm(now));
+  }
+  trace.stopAtUs = sessionStopUs - sessionStartUs;
+  trace.hits = hits;
+  trace.maxSeries = maxSeries;
+  trace.tempoAvg = tempoFromSession(sessionStopUs);
+  return trace;
+}
+
+bool sameTrace(const char *name, const SessionTrace &a, const SessionTrace &b) {
+  const char *problem = nullptr;
+  if (a.hits != b.hits || a.hitAtUs != b.hitAtUs) {
+    problem = "hit times";
+  } else if (a.hitPeaks != b.hitPeaks) {
+    problem = "hit peaks";
+  } else if (a.tempo != b.tempo) {
+    problem = "instant tempo";
+  } else if (a.stopAtUs != b.stopAtUs) {
+    problem = "stop time";
+  } else if (a.maxSeries != b.maxSeries || a.tempoAvg != b.tempoAvg) {
+    problem = "session summary";
+  }
+  printf("%-14s hits=%u stop=%llu us max_series=%u tempo_avg=%u windows=%zu  %s%s\n", name, b.hits,
+         static_cast<unsigned long long>(b.stopAtUs), b.maxSeries, b.tempoAvg, b.tempo.size(),
+         problem ? "FAIL: " : "ok", problem ? problem : "");
+  return problem == nullptr;
+}
+
+} // namespace
+
+int main() {
+  loadConfig();
+  config.simulate = true;
+  configureDetector();
+
+  const int64_t microsWrapUs = 1LL << 32;
+  const int64_t millisWrapUs = (1LL << 32) * 1000;
+  SessionTrace reference = runSession(1000000);
+  if (reference.hits < 10) {
+    printf("reference session: only %u hits\n", reference.hits);
+    return 1;
+  }
+  bool ok = sameTrace("from 1 s", reference, reference);
+  ok &= sameTrace("micros() wrap", reference, runSession(microsWrapUs - kLeadUs));
+  ok &= sameTrace("millis() wrap", reference, runSession(millisWrapUs - kLeadUs));
+  return ok ? 0 : 1;
+}
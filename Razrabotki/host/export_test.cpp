@@ -0,0 +1,427 @@
+// End-to-end check of schetotgim's /api/log export (chunked_export.h).
+//
+// Compiles the firmware's main.cpp into this file, serves its routes from a
+// thread of their own and fetches /api/log over a socket as CSV and as
+// NDJSON. Each response's chunked framing is decoded strictly and the body
+// compared with text built here from a RepLogReader walk of the log: for a
+// log holding only its boot mark, for a few known events, and for a log that
+// has wrapped around the partition. Other requests must be answered while
+// a slowly read export is still running. A client that reads a little of an
+// export and then resets the connection must stop the export early, counted
+// in partition bytes read, and the server must go on answering.
+//
+// Build (from this directory):
+//   g++ -std=gnu++17 -O2 -pthread -Iarduino -I../common -I../schetotgim/src
+//       export_test.cpp arduino/*.cpp -o export_test
+//
+// Usage:
+//   ./export_test [--port N]
+//
+// Exits non-zero on the first check that fails, after printing it.
+
+#include "../schetotgim/src/main.cpp"
+
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <netinet/in.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+int port = 18081;
+
+struct Response {
+  int status = 0;
+  std::string head;
+  std::string body;  // decoded when the response is chunked
+};
+
+struct LoggedEvent {
+  uint8_t exercise;
+  RepLogKind kind;
+};
+
+int connectTo(int rcvBuf) {
+  int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+  if (rcvBuf > 0) {
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvBuf, sizeof(rcvBuf));
+  }
+  sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(static_cast<uint16_t>(port));
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (::connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0) {
+    ::close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+bool sendRequest(int fd, const char *method, const char *target) {
+  char msg[256];
+  int n = snprintf(msg, sizeof(msg), "%s %s HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n%s\r\n", method,
+                   target, strcmp(method, "POST") == 0 ? "Content-Length: 0\r\n" : "");
+  return ::send(fd, msg, n, MSG_NOSIGNAL) == n;
+}
+
+int hexDigit(char c) {
+  if (c >= '0' && c <= '9') {
+    return c - '0';
+  }
+  if (c >= 'a' && c <= 'f') {
+    return c - 'a' + 10;
+  }
+  if (c >= 'A' && c <= 'F') {
+    return c - 'A' + 10;
+  }
+  return -1;
+}
+
+// Strict chunked decoding: hex sizes without extensions, CRLF after every
+// chunk, nothing after the last one. Chunks may not exceed the exporter's
+// buffer, which is what keeps its memory constant.
+bool decodeChunked(const std::string &raw, std::string &out, const char *&error) {
+  size_t pos = 0;
+  for (;;) {
+    size_t eol = raw.find("\r\n", pos);
+    if (eol == std::string::npos || eol == pos) {
+      error = "chunk size line missing";
+      return false;
+    }
+    size_t size = 0;
+    for (size_t i = pos; i < eol; i++) {
+      int digit = hexDigit(raw[i]);
+      if (digit < 0 || size > EXPORT_CHUNK_SIZE) {
+        error = "bad chunk size";
+        return false;
+      }
+      size = size * 16 + static_cast<size_t>(digit);
+    }
+    if (size > EXPORT_CHUNK_SIZE) {
+      error = "chunk larger than the export buffer";
+      return false;
+    }
+    pos = eol + 2;
+    if (size == 0) {
+      if (raw.compare(pos, std::string::npos, "\r\n") != 0) {
+        error = "bad end of the chunked body";
+        return false;
+      }
+      return true;
+    }
+    if (raw.size() < pos + size + 2 || raw.compare(pos + size, 2, "\r\n") != 0) {
+      error = "truncated chunk";
+      return false;
+    }
+    out.append(raw, pos, size);
+    pos += size + 2;
+  }
+}
+
+// One request on a fresh connection, read until the server closes it.
+bool fetch(const char *method, const char *target, Response &out) {
+  int fd = connectTo(0);
+  if (fd < 0 || !sendRequest(fd, method, target)) {
+    if (fd >= 0) {
+      ::close(fd);
+    }
+    printf("%s %s: cannot send\n", method, target);
+    return false;
+  }
+  std::string data;
+  char buf[4096];
+  ssize_t n;
+  while ((n = ::recv(fd, buf, sizeof(buf), 0)) > 0) {
+    data.append(buf, static_cast<size_t>(n));
+  }
+  ::close(fd);
+
+  size_t headEnd = data.find("\r\n\r\n");
+  if (data.compare(0, 9, "HTTP/1.1 ") != 0 || headEnd == std::string::npos) {
+    printf("%s %s: no response head\n", method, target);
+    return false;
+  }
+  out.status = atoi(data.c_str() + 9);
+  out.head = data.substr(0, headEnd + 2);
+  out.body.clear();
+  std::string raw = data.substr(headEnd + 4);
+  if (out.head.find("Transfer-Encoding: chunked\r\n") == std::string::npos) {
+    out.body = raw;
+    return true;
+  }
+  const char *error = nullptr;
+  if (!decodeChunked(raw, out.body, error)) {
+    printf("%s %s: %s\n", method, target, error);
+    return false;
+  }
+  return true;
+}
+
+bool post(const char *target) {
+  Response r;
+  if (!fetch("POST", target, r) || r.status != 200) {
+    printf("POST %s: status %d\n", target, r.status);
+    return false;
+  }
+  return true;
+}
+
+// The log as the firmware holds it. The server thread only writes to the log
+// while serving a request, and every request here, exports included, has
+// been answered by the time this runs.
+std::vector<RepLogEvent> logEvents() {
+  std::vector<RepLogEvent> events;
+  RepLogReader reader(repLog);
+  RepLogEvent ev;
+  while (reader.next(ev)) {
+    events.push_back(ev);
+  }
+  return events;
+}
+
+std::string expectedBody(ExportFormat format, const std::vector<RepLogEvent> &events) {
+  static const char *const kKinds[] = {"rep", "set_end", "reset"};
+  std::string text = format == EXPORT_CSV ? "boot,ms,exercise,event\n" : "";
+  for (const RepLogEvent &ev : events) {
+    char line[128];
+    const char *kind = ev.kind < 3 ? kKinds[ev.kind] : "?";
+    const char *exercise = ev.exercise < EXERCISE_COUNT ? EXERCISES[ev.exercise].id : "?";
+    if (format == EXPORT_CSV) {
+      snprintf(line, sizeof(line), "%lu,%lu,%s,%s\n", static_cast<unsigned long>(ev.bootId),
+               static_cast<unsigned long>(ev.ms), exercise, kind);
+    } else {
+      snprintf(line, sizeof(line), "{\"boot\":%lu,\"ms\":%lu,\"exercise\":\"%s\",\"event\":\"%s\"}\n",
+               static_cast<unsigned long>(ev.bootId), static_cast<unsigned long>(ev.ms), exercise, kind);
+    }
+    text += line;
+  }
+  return text;
+}
+
+// Fetches the log in both formats and compares each with the log contents.
+bool checkExport(const char *name, const std::vector<RepLogEvent> &events) {
+  static const struct {
+    ExportFormat format;
+    const char *target;
+    const char *contentType;
+  } kFormats[] = {
+    {EXPORT_CSV, "/api/log?format=csv", "Content-Type: text/csv; charset=utf-8\r\n"},
+    {EXPORT_NDJSON, "/api/log?format=ndjson", "Content-Type: application/x-ndjson\r\n"},
+  };
+  bool ok = true;
+  for (const auto &f : kFormats) {
+    Response r;
+    if (!fetch("GET", f.target, r)) {
+      return false;
+    }
+    std::string expected = expectedBody(f.format, events);
+    const char *problem = nullptr;
+    if (r.status != 200) {
+      problem = "status";
+    } else if (r.head.find("Transfer-Encoding: chunked\r\n") == std::string::npos) {
+      problem = "not chunked";
+    } else if (r.head.find(f.contentType) == std::string::npos) {
+      problem = "content type";
+    } else if (r.body != expected) {
+      problem = "rows differ from the log";
+    }
+    printf("%-8s %-24s rows=%-6zu bytes=%-7zu %s%s\n", name, f.target, events.size(), r.body.size(),
+           problem ? "FAIL: " : "ok", problem ? problem : "");
+    if (problem != nullptr && r.body != expected) {
+      size_t at = 0;
+      while (at < r.body.size() && at < expected.size() && r.body[at] == expected[at]) {
+        at++;
+      }
+      printf("  first difference at byte %zu of %zu (expected %zu)\n", at, r.body.size(), expected.size());
+    }
+    ok &= problem == nullptr;
+  }
+  return ok;
+}
+
+// The events a short session leaves, in order, against the log.
+bool checkKnownEvents(const std::vector<RepLogEvent> &events) {
+  const LoggedEvent kExpected[] = {
+    {0, REPLOG_REP}, {0, REPLOG_REP}, {0, REPLOG_REP}, {0, REPLOG_SET_END}, {2, REPLOG_REP}, {2, REPLOG_RESET},
+  };
+  const size_t count = sizeof(kExpected) / sizeof(kExpected[0]);
+  bool ok = events.size() == count;
+  for (size_t i = 0; ok && i < count; i++) {
+    ok = events[i].bootId == bootId && events[i].exercise == kExpected[i].exercise &&
+         events[i].kind == kExpected[i].kind && (i == 0 || events[i].ms >= events[i - 1].ms);
+  }
+  if (!ok) {
+    printf("known events: the log holds %zu events, not the %zu the session made\n", events.size(), count);
+  }
+  return ok;
+}
+
+// Reads a CSV export a little at a time on a thread of its own and asks
+// for /api/state once the export has started: the answer must come while
+// the export is still open, and the export must still be whole.
+bool checkServedDuringExport(const std::vector<RepLogEvent> &events) {
+  int fd = connectTo(4096);
+  if (fd < 0 || !sendRequest(fd, "GET", "/api/log?format=csv")) {
+    printf("during: cannot send\n");
+    return false;
+  }
+  std::atomic<size_t> got{0};
+  std::atomic<bool> finished{false};
+  std::string data;
+  std::thread reader([&] {
+    char buf[1024];
+    ssize_t n;
+    while ((n = ::recv(fd, buf, sizeof(buf), 0)) > 0) {
+      data.append(buf, static_cast<size_t>(n));
+      got += static_cast<size_t>(n);
+      std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+    finished = true;
+  });
+  while (got < 4096 && !finished) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  Response r;
+  bool answered = fetch("GET", "/api/state", r) && r.status == 200;
+  bool interleaved = answered && !finished;
+  reader.join();
+  ::close(fd);
+
+  std::string body;
+  const char *problem = nullptr;
+  size_t headEnd = data.find("\r\n\r\n");
+  if (!answered) {
+    problem = "the server stopped answering";
+  } else if (!interleaved) {
+    problem = "answered only after the export";
+  } else if (headEnd == std::string::npos || !decodeChunked(data.substr(headEnd + 4), body, problem)) {
+    problem = problem ? problem : "no response head";
+  } else if (body != expectedBody(EXPORT_CSV, events)) {
+    problem = "rows differ from the log";
+  }
+  printf("%-8s %-24s rows=%-6zu bytes=%-7zu %s%s\n", "during", "/api/log?format=csv", events.size(), body.size(),
+         problem ? "FAIL: " : "ok", problem ? problem : "");
+  return problem == nullptr;
+}
+
+// Starts a CSV export, reads a little of it and resets the connection.
+// Returns the partition bytes the export read.
+bool abandonExport(uint64_t &bytesRead) {
+  uint64_t before = hostPartitionBytesRead();
+  int fd = connectTo(4096);
+  if (fd < 0 || !sendRequest(fd, "GET", "/api/log?format=csv")) {
+    printf("disconnect: cannot send\n");
+    return false;
+  }
+  char buf[1024];
+  size_t got = 0;
+  ssize_t n;
+  while (got < 2048 && (n = ::recv(fd, buf, sizeof(buf), 0)) > 0) {
+    got += static_cast<size_t>(n);
+  }
+  // Let the server fill the socket buffers and block in send().
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  linger reset = {1, 0};
+  setsockopt(fd, SOL_SOCKET, SO_LINGER, &reset, sizeof(reset));
+  ::close(fd);
+
+  Response r;
+  if (!fetch("GET", "/api/state", r) || r.status != 200) {
+    printf("disconnect: the server stopped answering\n");
+    return false;
+  }
+  // The export notices the reset on its next chunk; wait until it reads no
+  // more.
+  uint64_t read = hostPartitionBytesRead();
+  for (int i = 0; i < 100; i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    uint64_t now = hostPartitionBytesRead();
+    if (now == read) {
+      break;
+    }
+    read = now;
+  }
+  bytesRead = read - before;
+  return true;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  for (int i = 1; i + 1 < argc; i++) {
+    if (strcmp(argv[i], "--port") == 0) {
+      port = atoi(argv[++i]);
+    }
+  }
+  setenv("HOST_HTTP_PORT", std::to_string(port).c_str(), 1);
+  // The device's send buffer, so an export waits for its client as it would
+  // there instead of disappearing into the host's.
+  setenv("HOST_TCP_SNDBUF", "5744", 1);
+
+  prefs.begin("pushup", false);
+  bootId = 1;
+  if (!repLog.begin(bootId)) {
+    printf("no rep log partition\n");
+    return 1;
+  }
+  setupStallWatch();
+  setupHttpServer();
+
+  std::atomic<bool> serving{true};
+  std::thread serverThread([&serving] {
+    while (serving) {
+      server.handleClient();
+      tickLogExport();
+      std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+  });
+
+  bool ok = true;
+  std::vector<RepLogEvent> events = logEvents();
+  ok = ok && events.empty() && checkExport("empty", events);
+
+  ok = ok && post("/api/inc?delta=3") && post("/api/set") && post("/api/exercise?id=2") && post("/api/inc") &&
+       post("/api/reset");
+  events = logEvents();
+  ok = ok && checkKnownEvents(events) && checkExport("known", events);
+
+  // Past the partition size, so the export starts in the middle of the ring.
+  uint32_t sectors = repLog.sectorCount();
+  for (uint32_t i = 0; ok && i < sectors * 12; i++) {
+    char target[48];
+    snprintf(target, sizeof(target), "/api/exercise?id=%lu", static_cast<unsigned long>(i / 16 % EXERCISE_COUNT));
+    ok = post(target) && post("/api/inc?delta=100");
+  }
+  events = logEvents();
+  if (ok && repLog.oldestSector() == 0) {
+    printf("wrapped: the log did not wrap\n");
+    ok = false;
+  }
+  uint64_t before = hostPartitionBytesRead();
+  ok = ok && checkExport("wrapped", events);
+  uint64_t fullRead = (hostPartitionBytesRead() - before) / 2;
+  ok = ok && checkServedDuringExport(events);
+
+  uint64_t abandonedRead = 0;
+  if (ok && abandonExport(abandonedRead)) {
+    bool early = abandonedRead < fullRead / 2;
+    printf("%-8s %-24s read %llu of %llu bytes  %s\n", "reset", "/api/log?format=csv",
+           static_cast<unsigned long long>(abandonedRead), static_cast<unsigned long long>(fullRead),
+           early ? "ok" : "FAIL: export ran on");
+    ok = early;
+  } else {
+    ok = false;
+  }
+  // The next export after the reset is whole again.
+  ok = ok && checkExport("after", events);
+
+  serving = false;
+  serverThread.join();
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,151 @@
+// Malformed-request check of KeepAliveServer (common/http_server.h).
+//
+// Serves an echo route from a thread of its own and sends it raw requests
+// over a socket, each on a fresh connection: Content-Length values that
+// overflow, are negative, non-numeric, larger than kHttpRequestMax or
+// repeated with different values, heads that never end, request lines
+// without a target. Every one must get its expected status, and a good
+// request afterwards must still be answered. The same bad requests also go
+// down a kept-alive connection behind a good one. Build with the sanitizers
+// so a read past a connection buffer fails the run.
+//
+// Build (from this directory):
+//   g++ -std=gnu++17 -O1 -g -fsanitize=address,undefined -pthread -Iarduino -I../common
+//       http_server_test.cpp arduino/*.cpp -o http_server_test
+//
+// Usage:
+//   ./http_server_test [--port N]
+//
+// Exits non-zero if a request gets an unexpected answer.
+
+#include <Arduino.h>
+#include <WebServer.h>
+
+#include "http_server.h"
+
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <netinet/in.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+namespace {
+
+int port = 18082;
+
+KeepAliveServer server(80);
+
+std::string post(const char *contentLength, const char *body) {
+  return std::string("POST /echo HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\nContent-Length: ") +
+         contentLength + "\r\n\r\n" + body;
+}
+
+const std::string kGood = "GET /echo?x=ok HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n";
+
+int connectTo() {
+  int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(static_cast<uint16_t>(port));
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (::connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0) {
+    ::close(fd);
+    return -1;
+  }
+  timeval timeout = {5, 0};
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  return fd;
+}
+
+// Sends the bytes and reads until the server closes. Returns every status
+// line's code in order, as text, e.g. "200 400".
+std::string exchange(const std::string &request) {
+  int fd = connectTo();
+  if (fd < 0) {
+    return "no connection";
+  }
+  ::send(fd, request.data(), request.size(), MSG_NOSIGNAL);
+  std::string data;
+  char buf[4096];
+  ssize_t n;
+  while ((n = ::recv(fd, buf, sizeof(buf), 0)) > 0) {
+    data.append(buf, static_cast<size_t>(n));
+  }
+  ::close(fd);
+  std::string codes;
+  for (size_t at = data.find("HTTP/1.1 "); at != std::string::npos; at = data.find("HTTP/1.1 ", at + 1)) {
+    codes += (codes.empty() ? "" : " ") + data.substr(at + 9, 3);
+  }
+  return codes;
+}
+
+bool check(const char *name, const std::string &request, const char *expected) {
+  std::string got = exchange(request);
+  bool ok = got == expected;
+  printf("%-46s %-8s %s%s\n", name, got.c_str(), ok ? "ok" : "FAIL: expected ", ok ? "" : expected);
+  return ok;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  for (int i = 1; i + 1 < argc; i++) {
+    if (strcmp(argv[i], "--port") == 0) {
+      port = atoi(argv[++i]);
+    }
+  }
+  setenv("HOST_HTTP_PORT", std::to_string(port).c_str(), 1);
+
+  server.on("/echo", []() {
+    server.send(200, "text/plain", server.arg(server.hasArg("plain") ? "plain" : "x"));
+  });
+  server.begin();
+  std::atomic<bool> serving{true};
+  std::thread serverThread([&serving] {
+    while (serving) {
+      server.handleClient();
+      std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+  });
+
+  const std::string tooLong(kHttpRequestMax + 16, 'a');
+  const std::string bad[][2] = {
+    {"length 2^32 - 1", post("4294967295", "")},
+    {"length -1", post("-1", "")},
+    {"length 2^64 - 1", post("18446744073709551615", "")},
+    {"length 2^64", post("18446744073709551616", "")},
+    {"length past kHttpRequestMax", post("1537", "x")},
+    {"length not a number", post("abc", "")},
+    {"length with trailing text", post("5abc", "hello")},
+    {"length empty", post("", "")},
+    {"length repeated, different", "POST /echo HTTP/1.1\r\nContent-Length: 5\r\nContent-Length: 0\r\n\r\nhello"},
+    {"no target", "GET\r\n\r\n"},
+  };
+
+  bool ok = true;
+  for (const auto &c : bad) {
+    ok &= check(c[0].c_str(), c[1], "400");
+    ok &= check("  then a good request", kGood, "200");
+  }
+  ok &= check("head past kHttpRequestMax", "GET /" + tooLong + " HTTP/1.1\r\n", "413");
+  ok &= check("length 5, spaces around", post(" 5 ", "hello"), "200");
+  ok &= check("length 0", post("0", ""), "200");
+  ok &= check("length repeated, same",
+              "POST /echo HTTP/1.1\r\nConnection: close\r\nContent-Length: 5\r\nContent-Length: 5\r\n\r\nhello", "200");
+
+  // Behind a good request on a kept-alive connection: the good one is
+  // answered, the bad one rejected and the connection closed.
+  const std::string keepAliveGood = "GET /echo?x=ok HTTP/1.1\r\nHost: localhost\r\n\r\n";
+  for (const auto &c : bad) {
+    std::string name = "after keep-alive: " + c[0];
+    ok &= check(name.c_str(), keepAliveGood + c[1], "200 400");
+  }
+
+  serving = false;
+  serverThread.join();
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,177 @@
+// Cost of parsing a /api/config body: JsonObjectScanner (json_scan.h) as
+// handleConfig() uses it, against the extractJsonInt()/extractJsonBool()
+// helpers it replaced, which searched the body once per config key.
+//
+// Compiles the firmware's main.cpp into this file for the config table and
+// the stand-in String; the old helpers are copied here as they were. Both
+// paths must produce the same config from every body.
+//
+// Build (from this directory):
+//   g++ -std=gnu++17 -O2 -pthread -Iarduino -I../common -I../kickshield_counter/src
+//       json_scan_bench.cpp arduino/*.cpp -o json_scan_bench
+//
+// Usage:
+//   ./json_scan_bench [iterations]
+
+#include "../kickshield_counter/src/main.cpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+namespace {
+
+typedef std::chrono::steady_clock BenchClock;
+
+volatile int benchSink = 0;
+
+bool extractJsonInt(const String &body, const char *key, int &out) {
+  String pattern = String('"') + key + "\":";
+  int idx = body.indexOf(pattern);
+  if (idx < 0) {
+    return false;
+  }
+  int start = idx + pattern.length();
+  while (start < body.length() && (body[start] == ' ' || body[start] == '\t')) {
+    start++;
+  }
+  int end = start;
+  while (end < body.length() && (body[end] == '-' || (body[end] >= '0' && body[end] <= '9'))) {
+    end++;
+  }
+  if (end == start) {
+    return false;
+  }
+  out = body.substring(start, end).toInt();
+  return true;
+}
+
+bool extractJsonBool(const String &body, const char *key, bool &out) {
+  String pattern = String('"') + key + "\":";
+  int idx = body.indexOf(pattern);
+  if (idx < 0) {
+    return false;
+  }
+  int start = idx + pattern.length();
+  while (start < body.length() && (body[start] == ' ' || body[start] == '\t')) {
+    start++;
+  }
+  if (body.startsWith("true", start)) {
+    out = true;
+    return true;
+  }
+  if (body.startsWith("false", start)) {
+    out = false;
+    return true;
+  }
+  int val = 0;
+  int end = start;
+  while (end < body.length() && (body[end] >= '0' && body[end] <= '9')) {
+    end++;
+  }
+  if (end == start) {
+    return false;
+  }
+  val = body.substring(start, end).toInt();
+  out = (val != 0);
+  return true;
+}
+
+Config parseOld(const String &body) {
+  Config next = config;
+  for (size_t i = 0; i < kConfigFieldCount; i++) {
+    const ConfigField &field = kConfigFields[i];
+    int value = 0;
+    bool flag = false;
+    if (field.type == CONFIG_BOOL) {
+      if (extractJsonBool(body, field.key, flag)) {
+        setConfigValue(next, field, flag ? 1 : 0);
+      }
+    } else if (extractJsonInt(body, field.key, value)) {
+      setConfigValue(next, field, value);
+    }
+  }
+  return next;
+}
+
+// handleConfig()'s body pass.
+Config parseNew(const String &body) {
+  Config next = config;
+  jsonForEachMember(body.c_str(), body.length(), [&next](const JsonMember &member) {
+    const ConfigField *field = findConfigField(member.key);
+    int value = 0;
+    if (field != nullptr && parseConfigJson(*field, member, value)) {
+      setConfigValue(next, *field, value);
+    }
+  });
+  return next;
+}
+
+bool sameConfig(const Config &a, const Config &b) {
+  for (size_t i = 0; i < kConfigFieldCount; i++) {
+    if (configValue(a, kConfigFields[i]) != configValue(b, kConfigFields[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// The body the settings page sends: every field.
+String fullBody() {
+  String body = "{";
+  for (size_t i = 0; i < kConfigFieldCount; i++) {
+    const ConfigField &field = kConfigFields[i];
+    char member[64];
+    int value = field.type == CONFIG_BOOL ? 1 : (field.minValue + field.maxValue) / 2;
+    snprintf(member, sizeof(member), "%s\"%s\":%s", i == 0 ? "" : ",", field.key,
+             field.type == CONFIG_BOOL ? "true" : String(value).c_str());
+    body += member;
+  }
+  body += "}";
+  return body;
+}
+
+template <typename Parse>
+double nsPerParse(unsigned iterations, const String &body, Parse parse) {
+  auto start = BenchClock::now();
+  for (unsigned i = 0; i < iterations; i++) {
+    Config next = parse(body);
+    benchSink = benchSink + next.threshold;
+  }
+  auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(BenchClock::now() - start);
+  return static_cast<double>(elapsed.count()) / iterations;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  unsigned iterations = argc > 1 ? static_cast<unsigned>(strtoul(argv[1], nullptr, 10)) : 100000;
+  if (iterations == 0) {
+    iterations = 1;
+  }
+  loadConfig();
+
+  struct Body {
+    const char *name;
+    String text;
+  };
+  const Body bodies[] = {
+    {"one key", String("{\"threshold\":1500}")},
+    {"five keys", String("{\"threshold\":1500,\"lockout_ms\":90,\"series_gap_ms\":700,"
+                         "\"sample_window_ms\":10,\"simulate\":true}")},
+    {"all keys", fullBody()},
+  };
+
+  bool ok = true;
+  printf("body        bytes   old ns   new ns   ratio\n");
+  for (const Body &b : bodies) {
+    if (!sameConfig(parseOld(b.text), parseNew(b.text))) {
+      printf("%s: the two parsers disagree\n", b.name);
+      ok = false;
+    }
+    double oldNs = nsPerParse(iterations, b.text, parseOld);
+    double newNs = nsPerParse(iterations, b.text, parseNew);
+    printf("%-10s  %5u  %7.0f  %7.0f  %5.1fx\n", b.name, b.text.length(), oldNs, newNs, oldNs / newNs);
+  }
+  return ok ? 0 : 1;
+}
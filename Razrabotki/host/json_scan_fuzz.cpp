@@ -0,0 +1,251 @@
+// Fuzz check of kickshield's JsonObjectScanner (json_scan.h).
+//
+// Runs a table of hand-written bodies with known results, every truncation
+// of a few valid bodies, and random mutations of them (byte flips,
+// insertions and deletions of structural characters, splices), each from an
+// exactly sized heap copy so a sanitizer build catches any read past the
+// end. For every input it checks that the scanner terminates, that each
+// key and value span lies inside the input, that an accepted body's nested
+// values have matching brackets, and that no proper prefix of a valid body
+// is accepted.
+//
+// Build (from this directory), preferably with the sanitizers:
+//   g++ -std=gnu++17 -O1 -g -fsanitize=address,undefined -I../kickshield_counter/src
+//       json_scan_fuzz.cpp -o json_scan_fuzz
+//
+// Usage:
+//   ./json_scan_fuzz [iterations] [seed]
+//
+// Exits non-zero on the first input that breaks a check, after printing it.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "json_scan.h"
+
+namespace {
+
+struct Case {
+  const char *body;
+  bool ok;
+  int members;  // reported before the end or the error
+};
+
+const Case kCases[] = {
+  {"{}", true, 0},
+  {" { } ", true, 0},
+  {"{\"threshold\":1500}", true, 1},
+  {"{\"a\":1,\"b\":true,\"c\":false,\"d\":null,\"e\":\"x\"}", true, 5},
+  {"{\"a\":{\"b\":[1,{\"c\":\"}\"}]},\"d\":2}", true, 2},
+  {"{\"a\":\"q\\\"uote\",\"b\":-7}", true, 2},
+  {"{\"a\":[[[]]]}", true, 1},
+  {"", false, 0},
+  {"{", false, 0},
+  {"[]", false, 0},
+  {"{\"a\"}", false, 0},
+  {"{\"a\":}", false, 0},
+  {"{\"a\":1,}", false, 1},
+  {"{\"a\":1 \"b\":2}", false, 1},
+  {"{\"a\":-}", false, 0},
+  {"{\"a\":tru}", false, 0},
+  {"{\"a\":\"open}", false, 0},
+  {"{\"a\":\"ctl\x01\"}", false, 0},
+  {"{\"a\":{]}", false, 0},
+  {"{\"a\":[}}", false, 0},
+  {"{\"a\":{\"b\":[1,2}]}", false, 0},
+  {"{\"a\":[1,2]]}", false, 1},
+  {"{\"a\":{}", false, 1},
+  {"{\"a\":{\"b\":1}", false, 1},
+};
+
+const char *const kSeeds[] = {
+  "{\"threshold\":1500,\"lockout_ms\":120,\"simulate\":true,\"sim_noise\":12}",
+  "{\"name\":\"A \\\"B\\\"\",\"nested\":{\"x\":[1,2,{\"y\":\"]}\"}]},\"flag\":false,\"n\":null}",
+  "{ \"a\" : [ [ ], { } ] , \"b\" : -1.5e3 }",
+};
+
+uint32_t rngState = 1;
+
+uint32_t rng() {
+  uint32_t x = rngState;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  rngState = x;
+  return x;
+}
+
+bool within(const JsonSpan &span, const char *data, size_t len) {
+  return span.ptr >= data && span.len <= len && span.ptr + span.len <= data + len;
+}
+
+// Bracket match of a nested value's raw text, strings skipped.
+bool bracketsMatch(const JsonSpan &span) {
+  std::vector<char> stack;
+  for (size_t i = 0; i < span.len; i++) {
+    char c = span.ptr[i];
+    if (c == '"') {
+      for (i++; i < span.len && span.ptr[i] != '"'; i++) {
+        i += span.ptr[i] == '\\' ? 1 : 0;
+      }
+    } else if (c == '{' || c == '[') {
+      stack.push_back(c == '{' ? '}' : ']');
+    } else if (c == '}' || c == ']') {
+      if (stack.empty() || stack.back() != c) {
+        return false;
+      }
+      stack.pop_back();
+    }
+  }
+  return stack.empty();
+}
+
+struct Result {
+  bool ok;
+  int members;
+  const char *problem;
+};
+
+// Scans an exactly sized heap copy of text.
+Result scan(const std::string &text) {
+  char *data = static_cast<char *>(malloc(text.size() + 1));
+  memcpy(data, text.data(), text.size());
+  Result r = {false, 0, nullptr};
+  JsonObjectScanner scanner(data, text.size());
+  JsonMember member;
+  while (scanner.next(member)) {
+    r.members++;
+    if (!within(member.key, data, text.size()) || !within(member.value, data, text.size())) {
+      r.problem = "span outside the input";
+    } else if ((member.type == JSON_OBJECT || member.type == JSON_ARRAY) && !bracketsMatch(member.value)) {
+      r.problem = "nested value with mismatched brackets";
+    } else if (r.members > static_cast<int>(text.size())) {
+      r.problem = "more members than bytes";
+    }
+    if (r.problem != nullptr) {
+      break;
+    }
+  }
+  r.ok = !scanner.failed();
+  // A second call after the end must keep returning false.
+  if (r.problem == nullptr && scanner.next(member)) {
+    r.problem = "member after the end";
+  }
+  free(data);
+  return r;
+}
+
+void printInput(const std::string &text) {
+  printf("  input (%zu bytes): \"", text.size());
+  for (unsigned char c : text) {
+    if (c >= 0x20 && c < 0x7F && c != '"' && c != '\\') {
+      putchar(c);
+    } else {
+      printf("\\x%02x", c);
+    }
+  }
+  printf("\"\n");
+}
+
+bool checkCases() {
+  bool ok = true;
+  for (const Case &c : kCases) {
+    Result r = scan(c.body);
+    if (r.problem != nullptr || r.ok != c.ok || r.members != c.members) {
+      printf("case: got ok=%d members=%d, expected ok=%d members=%d %s\n", r.ok, r.members, c.ok, c.members,
+             r.problem ? r.problem : "");
+      printInput(c.body);
+      ok = false;
+    }
+  }
+  printf("cases: %zu %s\n", sizeof(kCases) / sizeof(kCases[0]), ok ? "ok" : "FAIL");
+  return ok;
+}
+
+bool checkTruncations() {
+  size_t inputs = 0;
+  for (const char *seed : kSeeds) {
+    std::string body(seed);
+    for (size_t n = 0; n <= body.size(); n++) {
+      std::string prefix = body.substr(0, n);
+      Result r = scan(prefix);
+      inputs++;
+      bool expectOk = n == body.size();
+      if (r.problem != nullptr || r.ok != expectOk) {
+        printf("truncation: %s\n", r.problem ? r.problem : (r.ok ? "prefix accepted" : "full body rejected"));
+        printInput(prefix);
+        return false;
+      }
+    }
+  }
+  printf("truncations: %zu ok\n", inputs);
+  return true;
+}
+
+std::string mutate(std::string text) {
+  static const char kStructural[] = "{}[]\":,\\ -0etfn";
+  int edits = 1 + rng() % 4;
+  for (int e = 0; e < edits; e++) {
+    size_t at = text.empty() ? 0 : rng() % (text.size() + 1);
+    switch (rng() % 5) {
+      case 0:
+        if (at < text.size()) {
+          text[at] = static_cast<char>(rng());
+        }
+        break;
+      case 1:
+        if (at < text.size()) {
+          text[at] = kStructural[rng() % (sizeof(kStructural) - 1)];
+        }
+        break;
+      case 2:
+        text.insert(at, 1, kStructural[rng() % (sizeof(kStructural) - 1)]);
+        break;
+      case 3:
+        if (at < text.size()) {
+          text.erase(at, 1 + rng() % 3);
+        }
+        break;
+      default: {
+        const char *other = kSeeds[rng() % (sizeof(kSeeds) / sizeof(kSeeds[0]))];
+        size_t from = rng() % strlen(other);
+        text.insert(at, other + from, rng() % (strlen(other) - from + 1));
+        break;
+      }
+    }
+  }
+  return text;
+}
+
+bool checkMutations(uint32_t iterations) {
+  uint32_t accepted = 0;
+  for (uint32_t i = 0; i < iterations; i++) {
+    std::string text = mutate(kSeeds[i % (sizeof(kSeeds) / sizeof(kSeeds[0]))]);
+    Result r = scan(text);
+    if (r.problem != nullptr) {
+      printf("mutation %u: %s\n", i, r.problem);
+      printInput(text);
+      return false;
+    }
+    accepted += r.ok ? 1 : 0;
+  }
+  printf("mutations: %u ok, %u still well-formed\n", iterations, accepted);
+  return true;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  uint32_t iterations = argc > 1 ? static_cast<uint32_t>(strtoul(argv[1], nullptr, 10)) : 200000;
+  rngState = argc > 2 ? static_cast<uint32_t>(strtoul(argv[2], nullptr, 10)) : 1;
+  if (rngState == 0) {
+    rngState = 1;
+  }
+  bool ok = checkCases();
+  ok = ok && checkTruncations();
+  ok = ok && checkMutations(iterations);
+  return ok ? 0 : 1;
+}
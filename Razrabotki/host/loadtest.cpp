@@ -0,0 +1,514 @@
+// HTTP load generator for the firmwares' web handlers on a host.
+//
+// Links against one firmware's main.cpp and the stand-ins in arduino/, runs
+// setup() and then loop() on a thread of its own, exactly as the device
+// would, and hammers the resulting server from several client threads. The
+// sampler, buttons and display code keep running inside loop() meanwhile, so
+// the numbers include the time the handlers wait for the loop.
+//
+// Build (from this directory), one binary per firmware:
+//   g++ -std=gnu++17 -O2 -pthread -Iarduino -I../common -I../kickshield_counter/src
+//       ../kickshield_counter/src/main.cpp arduino/*.cpp loadtest.cpp -o loadtest_kickshield
+//   g++ -std=gnu++17 -O2 -pthread -Iarduino -I../common -I../schetotgim/src
+//       ../schetotgim/src/main.cpp arduino/*.cpp loadtest.cpp -o loadtest_schetotgim
+//
+// Example, kickshield in simulate mode under status polling:
+//   ./loadtest_kickshield --setup "POST /api/config?simulate=1" --setup "POST /api/start?mode=free"
+//       --req "GET /api/status" --report "GET /api/status"
+//
+// HOST_CLOCK_START_US fast-forwards the firmware clock, e.g. 4294963296000
+// starts 4 s before the 32-bit millis() wrap so a timed session crosses it.
+//
+// HOST_SERIAL=1 shows the firmware's Serial output on stdout; HOST_SERIAL=<file>
+// writes it to a file instead (e.g. a raw-sample capture for tools/capture).
+//
+// Usage:
+//   ./loadtest_kickshield [--port N] [--threads N] [--requests N]
+//                         [--keepalive] [--pipeline N]
+//                         [--setup "METHOD /path[?query]"]... [--quiet-ms N]
+//                         [--req "METHOD /path[?query]"]...
+//                         [--report "METHOD /path[?query]"]...
+//
+// --setup requests run once before the load, then the server gets no traffic
+// for --quiet-ms (e.g. to let kickshield fall idle), --req requests are issued
+// round-robin by every client thread (text after the path is sent as a JSON
+// body), --report requests run after the load
+// and print their bodies (e.g. /api/status to compare the hit count with the
+// configured sim_rate_hpm over the elapsed time).
+//
+// By default every request opens a connection of its own. --keepalive gives
+// each client thread one persistent connection, reopened whenever the server
+// closes it; --pipeline N (implies --keepalive) writes N requests before
+// reading the N responses, and each latency runs from that write. The CPU
+// figure is the firmware thread's own, i.e. loop() plus the server. Build
+// with -DHTTP_KEEPALIVE=0 to measure the core WebServer stand-in instead.
+
+#include <Arduino.h>
+#include <WebServer.h>
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <string>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <thread>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+void setup();
+void loop();
+
+namespace {
+
+struct Request {
+  std::string method;
+  std::string target;
+  std::string body;
+};
+
+struct Options {
+  int port = 18080;
+  unsigned threads = 4;
+  unsigned requests = 500;
+  unsigned quietMs = 0;
+  bool keepAlive = false;
+  unsigned pipeline = 1;
+  std::vector<Request> setup;
+  std::vector<Request> load;
+  std::vector<Request> report;
+};
+
+struct Response {
+  int status = 0;
+  std::string body;
+};
+
+typedef std::chrono::steady_clock Clock;
+
+bool parseRequest(const char *text, Request &out) {
+  const char *space = strchr(text, ' ');
+  if (space == nullptr) {
+    return false;
+  }
+  out.method.assign(text, space - text);
+  out.target = space + 1;
+  // "POST /api/config {json}" sends the JSON as the body.
+  size_t bodyStart = out.target.find(' ');
+  if (bodyStart != std::string::npos) {
+    out.body = out.target.substr(bodyStart + 1);
+    out.target.resize(bodyStart);
+  }
+  return !out.method.empty() && !out.target.empty() && out.target[0] == '/';
+}
+
+int connectTo(int port) {
+  int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(static_cast<uint16_t>(port));
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (::connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0) {
+    ::close(fd);
+    return -1;
+  }
+  int yes = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+  return fd;
+}
+
+std::string formatRequest(const Request &req, bool keepAlive) {
+  std::string msg = req.method + " " + req.target + " HTTP/1.1\r\nHost: localhost\r\n";
+  if (!keepAlive) {
+    msg += "Connection: close\r\n";
+  }
+  if (!req.body.empty()) {
+    msg += "Content-Type: application/json\r\nContent-Length: " + std::to_string(req.body.size()) + "\r\n";
+  }
+  return msg + "\r\n" + req.body;
+}
+
+bool sendAll(int fd, const std::string &data) {
+  return ::send(fd, data.data(), data.size(), MSG_NOSIGNAL) == static_cast<ssize_t>(data.size());
+}
+
+// One request on a fresh connection, read until the server closes it.
+bool perform(int port, const Request &req, Response &out) {
+  int fd = connectTo(port);
+  if (fd < 0) {
+    return false;
+  }
+  bool ok = sendAll(fd, formatRequest(req, false));
+
+  std::string data;
+  char buf[4096];
+  ssize_t n;
+  while (ok && (n = ::recv(fd, buf, sizeof(buf), 0)) > 0) {
+    data.append(buf, static_cast<size_t>(n));
+  }
+  ::close(fd);
+
+  size_t headEnd = data.find("\r\n\r\n");
+  if (!ok || data.compare(0, 9, "HTTP/1.1 ") != 0 || headEnd == std::string::npos) {
+    return false;
+  }
+  out.status = atoi(data.c_str() + 9);
+  out.body = data.substr(headEnd + 4);
+  return true;
+}
+
+// A client thread's persistent connection. Responses are framed by
+// Content-Length or chunked encoding; bytes past one response stay in
+// `pending` for the next.
+class KeepAliveClient {
+public:
+  explicit KeepAliveClient(int port) : port_(port) {}
+  ~KeepAliveClient() { reset(); }
+
+  // Writes the requests back to back and reads one response per request;
+  // done[i] is when response i was complete. Returns how many got one.
+  size_t perform(const std::vector<const Request *> &batch, std::vector<Response> &out,
+                 std::vector<Clock::time_point> &done) {
+    size_t n = 0;
+    while (n < batch.size()) {
+      size_t got = send(batch, n, out, done);
+      if (got == 0) {
+        break;
+      }
+      n += got;
+    }
+    return n;
+  }
+
+private:
+  // Sends batch[first..] and reads responses until the server closes; what
+  // it closed on unanswered was not served and is sent again by the caller.
+  // A reused connection the server dropped while idle (to make room for
+  // another client) gets one retry on a new one, as a browser would.
+  size_t send(const std::vector<const Request *> &batch, size_t first, std::vector<Response> &out,
+              std::vector<Clock::time_point> &done) {
+    std::string msg;
+    for (size_t i = first; i < batch.size(); i++) {
+      msg += formatRequest(*batch[i], true);
+    }
+    bool reused = fd_ >= 0;
+    if (!reused && (fd_ = connectTo(port_)) < 0) {
+      return 0;
+    }
+    bool sent = sendAll(fd_, msg);
+    if (reused && (!sent || !awaitResponse())) {
+      reset();
+      if ((fd_ = connectTo(port_)) < 0) {
+        return 0;
+      }
+      sent = sendAll(fd_, msg);
+    }
+    if (!sent) {
+      reset();
+      return 0;
+    }
+    size_t n = first;
+    for (; n < batch.size(); n++) {
+      bool close = false;
+      if (!readResponse(out[n], close)) {
+        reset();
+        break;
+      }
+      done[n] = Clock::now();
+      if (close) {
+        reset();
+        n++;
+        break;
+      }
+    }
+    return n - first;
+  }
+
+  void reset() {
+    if (fd_ >= 0) {
+      ::close(fd_);
+      fd_ = -1;
+    }
+    pending_.clear();
+  }
+
+  bool fill() {
+    char buf[4096];
+    ssize_t n = ::recv(fd_, buf, sizeof(buf), 0);
+    if (n <= 0) {
+      return false;
+    }
+    pending_.append(buf, static_cast<size_t>(n));
+    return true;
+  }
+
+  bool awaitResponse() {
+    return !pending_.empty() || fill();
+  }
+
+  // Waits for `size` bytes from `from` on.
+  bool need(size_t from, size_t size) {
+    while (pending_.size() < from + size) {
+      if (!fill()) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool readResponse(Response &out, bool &close) {
+    size_t headEnd;
+    while ((headEnd = pending_.find("\r\n\r\n")) == std::string::npos) {
+      if (!fill()) {
+        return false;
+      }
+    }
+    if (pending_.compare(0, 9, "HTTP/1.1 ") != 0) {
+      return false;
+    }
+    std::string head = pending_.substr(0, headEnd + 2);
+    for (char &ch : head) {
+      ch = static_cast<char>(tolower(static_cast<unsigned char>(ch)));
+    }
+    out.status = atoi(pending_.c_str() + 9);
+    close = head.find("\r\nconnection: close\r\n") != std::string::npos;
+    size_t pos = headEnd + 4;
+    out.body.clear();
+
+    size_t lengthAt = head.find("\r\ncontent-length:");
+    if (lengthAt != std::string::npos) {
+      size_t length = strtoul(head.c_str() + lengthAt + 17, nullptr, 10);
+      if (!need(pos, length)) {
+        return false;
+      }
+      out.body = pending_.substr(pos, length);
+      pending_.erase(0, pos + length);
+      return true;
+    }
+    if (head.find("\r\ntransfer-encoding: chunked\r\n") == std::string::npos) {
+      // Neither: the body runs to the end of the connection.
+      while (fill()) {
+      }
+      out.body = pending_.substr(pos);
+      pending_.clear();
+      close = true;
+      return true;
+    }
+    for (;;) {
+      size_t lineEnd;
+      while ((lineEnd = pending_.find("\r\n", pos)) == std::string::npos) {
+        if (!fill()) {
+          return false;
+        }
+      }
+      size_t size = strtoul(pending_.c_str() + pos, nullptr, 16);
+      pos = lineEnd + 2;
+      if (!need(pos, size + 2)) {
+        return false;
+      }
+      out.body.append(pending_, pos, size);
+      pos += size + 2;
+      if (size == 0) {
+        break;
+      }
+    }
+    pending_.erase(0, pos);
+    return true;
+  }
+
+  int port_;
+  int fd_ = -1;
+  std::string pending_;
+};
+
+bool parseArgs(int argc, char **argv, Options &opt) {
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+    if (strcmp(arg, "--keepalive") == 0) {
+      opt.keepAlive = true;
+      continue;
+    }
+    const char *value = (i + 1 < argc) ? argv[i + 1] : nullptr;
+    if (value == nullptr) {
+      return false;
+    }
+    Request req;
+    if (strcmp(arg, "--port") == 0) {
+      opt.port = atoi(value);
+    } else if (strcmp(arg, "--threads") == 0) {
+      opt.threads = static_cast<unsigned>(strtoul(value, nullptr, 10));
+    } else if (strcmp(arg, "--requests") == 0) {
+      opt.requests = static_cast<unsigned>(strtoul(value, nullptr, 10));
+    } else if (strcmp(arg, "--pipeline") == 0) {
+      opt.pipeline = static_cast<unsigned>(strtoul(value, nullptr, 10));
+      opt.keepAlive = true;
+    } else if (strcmp(arg, "--quiet-ms") == 0) {
+      opt.quietMs = static_cast<unsigned>(strtoul(value, nullptr, 10));
+    } else if (strcmp(arg, "--setup") == 0 && parseRequest(value, req)) {
+      opt.setup.push_back(req);
+    } else if (strcmp(arg, "--req") == 0 && parseRequest(value, req)) {
+      opt.load.push_back(req);
+    } else if (strcmp(arg, "--report") == 0 && parseRequest(value, req)) {
+      opt.report.push_back(req);
+    } else {
+      return false;
+    }
+    i++;
+  }
+  return opt.port > 0 && opt.threads > 0 && opt.pipeline > 0 && !opt.load.empty();
+}
+
+uint64_t threadCpuNs(clockid_t clock) {
+  timespec ts;
+  clock_gettime(clock, &ts);
+  return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+}
+
+double percentile(const std::vector<uint32_t> &sorted, double p) {
+  if (sorted.empty()) {
+    return 0.0;
+  }
+  size_t index = static_cast<size_t>(p * (sorted.size() - 1) + 0.5);
+  return sorted[index] / 1000.0;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  Options opt;
+  if (!parseArgs(argc, argv, opt)) {
+    fprintf(stderr,
+            "usage: %s [--port N] [--threads N] [--requests N] [--keepalive] [--pipeline N]\n"
+            "          [--setup \"METHOD /path\"]... [--quiet-ms N]\n"
+            "          --req \"METHOD /path [body]\"... [--report \"METHOD /path\"]...\n",
+            argv[0]);
+    return 2;
+  }
+
+  setenv("HOST_HTTP_PORT", std::to_string(opt.port).c_str(), 1);
+  std::thread firmware([] {
+    setup();
+    for (;;) {
+      loop();
+    }
+  });
+  clockid_t firmwareClock;
+  pthread_getcpuclockid(firmware.native_handle(), &firmwareClock);
+  firmware.detach();
+
+  // The server comes up asynchronously (schetotgim starts it from loop()).
+  int probe = -1;
+  for (int attempt = 0; attempt < 500 && probe < 0; attempt++) {
+    probe = connectTo(opt.port);
+    if (probe < 0) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+  }
+  if (probe < 0) {
+    fprintf(stderr, "server did not come up on port %d\n", opt.port);
+    return 1;
+  }
+  ::close(probe);
+
+  for (const Request &req : opt.setup) {
+    Response res;
+    bool ok = perform(opt.port, req, res);
+    printf("setup  %s %s -> %d\n", req.method.c_str(), req.target.c_str(), ok ? res.status : -1);
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(opt.quietMs));
+
+  HostServerStats &stats = hostServerStats();
+  uint64_t requestsBefore = stats.requests;
+  uint64_t allocsBefore = stats.handlerAllocations;
+  uint64_t nsBefore = stats.handlerNs;
+  uint64_t cpuBefore = threadCpuNs(firmwareClock);
+
+  std::vector<std::vector<uint32_t>> latencies(opt.threads);
+  std::atomic<uint64_t> okCount(0);
+  std::atomic<uint64_t> errorCount(0);
+  std::vector<std::thread> clients;
+  auto loadStart = Clock::now();
+  for (unsigned t = 0; t < opt.threads; t++) {
+    clients.emplace_back([&, t] {
+      latencies[t].reserve(opt.requests);
+      if (opt.keepAlive) {
+        KeepAliveClient client(opt.port);
+        std::vector<const Request *> batch;
+        std::vector<Response> res(opt.pipeline);
+        std::vector<Clock::time_point> done(opt.pipeline);
+        for (unsigned i = 0; i < opt.requests; i += opt.pipeline) {
+          batch.clear();
+          for (unsigned j = i; j < opt.requests && j < i + opt.pipeline; j++) {
+            batch.push_back(&opt.load[(t + j) % opt.load.size()]);
+          }
+          auto start = Clock::now();
+          size_t got = client.perform(batch, res, done);
+          for (size_t j = 0; j < batch.size(); j++) {
+            if (j < got && res[j].status < 400) {
+              okCount++;
+              latencies[t].push_back(static_cast<uint32_t>(
+                  std::chrono::duration_cast<std::chrono::microseconds>(done[j] - start).count()));
+            } else {
+              errorCount++;
+            }
+          }
+        }
+        return;
+      }
+      for (unsigned i = 0; i < opt.requests; i++) {
+        const Request &req = opt.load[(t + i) % opt.load.size()];
+        Response res;
+        auto start = Clock::now();
+        bool ok = perform(opt.port, req, res);
+        auto elapsed = Clock::now() - start;
+        if (ok && res.status < 400) {
+          okCount++;
+          latencies[t].push_back(static_cast<uint32_t>(
+              std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count()));
+        } else {
+          errorCount++;
+        }
+      }
+    });
+  }
+  for (std::thread &c : clients) {
+    c.join();
+  }
+  double seconds = std::chrono::duration<double>(Clock::now() - loadStart).count();
+  uint64_t cpuNs = threadCpuNs(firmwareClock) - cpuBefore;
+
+  std::vector<uint32_t> all;
+  for (const auto &l : latencies) {
+    all.insert(all.end(), l.begin(), l.end());
+  }
+  std::sort(all.begin(), all.end());
+  uint64_t served = stats.requests - requestsBefore;
+  double perRequest = served ? 1.0 / served : 0.0;
+
+  printf("clients=%u requests/client=%u %s elapsed=%.2fs\n", opt.threads, opt.requests,
+         opt.pipeline > 1 ? ("pipeline=" + std::to_string(opt.pipeline)).c_str()
+                          : (opt.keepAlive ? "keepalive" : "close"),
+         seconds);
+  printf("ok=%llu errors=%llu throughput=%.1f req/s\n", static_cast<unsigned long long>(okCount.load()),
+         static_cast<unsigned long long>(errorCount.load()), okCount / seconds);
+  printf("latency ms: p50=%.2f p90=%.2f p99=%.2f max=%.2f\n", percentile(all, 0.50), percentile(all, 0.90),
+         percentile(all, 0.99), percentile(all, 1.0));
+  printf("server: %.1f us/request in handler, %.2f allocations/request\n",
+         (stats.handlerNs - nsBefore) * perRequest / 1000.0, (stats.handlerAllocations - allocsBefore) * perRequest);
+  printf("firmware thread: %.1f us CPU/request, %.0f%% of one core\n", cpuNs * perRequest / 1000.0,
+         cpuNs / 1e7 / seconds);
+
+  for (const Request &req : opt.report) {
+    Response res;
+    bool ok = perform(opt.port, req, res);
+    printf("report %s %s -> %d %s\n", req.method.c_str(), req.target.c_str(), ok ? res.status : -1,
+           res.body.c_str());
+  }
+
+  fflush(stdout);
+  _exit(errorCount > 0 ? 1 : 0);
+}
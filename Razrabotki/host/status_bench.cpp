@@ -0,0 +1,70 @@
+// Side-by-side cost of kickshield's two /api/status encodings.
+//
+// Compiles the firmware's main.cpp into this file so the benchmark can call
+// its status builders directly, with the stand-ins in arduino/ underneath.
+// A session with a few hits is set up first so every field is populated.
+//
+// Build (from this directory):
+//   g++ -std=gnu++17 -O2 -pthread -Iarduino -I../common -I../kickshield_counter/src
+//       status_bench.cpp arduino/*.cpp -o status_bench
+//
+// Usage:
+//   ./status_bench [iterations]
+//
+// Prints bytes per payload and ns per build for each encoding, then both
+// payloads (the frame as hex) so a decoder can be checked against the JSON.
+
+#include "../kickshield_counter/src/main.cpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+namespace {
+
+typedef std::chrono::steady_clock BenchClock;
+
+template <typename Build>
+double nsPerBuild(unsigned iterations, Build build) {
+  auto start = BenchClock::now();
+  for (unsigned i = 0; i < iterations; i++) {
+    statusVersion++;
+    build();
+  }
+  auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(BenchClock::now() - start);
+  return static_cast<double>(elapsed.count()) / iterations;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  unsigned iterations = argc > 1 ? static_cast<unsigned>(strtoul(argv[1], nullptr, 10)) : 200000;
+  if (iterations == 0) {
+    iterations = 1;
+  }
+
+  loadConfig();
+  loadPrograms();
+  startSession(programs[0], -1);
+  uint64_t at = sessionStartUs;
+  for (int i = 0; i < 12; i++) {
+    at += 380000 + i * 7000;
+    recordHit(at, 1500 + i * 170, scoreFromPeak(1500 + i * 170));
+  }
+  uint64_t now = at + 50000;
+
+  double jsonNs = nsPerBuild(iterations, [now] { buildStatusJson(now); });
+  double frameNs = nsPerBuild(iterations, [now] { buildStatusFrame(now); });
+
+  printf("encoding  bytes  ns/build\n");
+  printf("json      %5zu  %8.0f\n", statusJsonLen, jsonNs);
+  printf("binary    %5zu  %8.0f\n", statusFrameLen, frameNs);
+  printf("ratio     %5.1fx %7.1fx\n", static_cast<double>(statusJsonLen) / statusFrameLen, jsonNs / frameNs);
+
+  printf("\n%.*s\n", static_cast<int>(statusJsonLen), statusJson);
+  for (size_t i = 0; i < statusFrameLen; i++) {
+    printf("%02x", statusFrame[i]);
+  }
+  printf("\n");
+  return 0;
+}
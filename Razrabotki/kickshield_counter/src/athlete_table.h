@@ -0,0 +1,229 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Athlete profiles: personal bests and rolling averages across sessions, in
+// fixed-size records so each one is a single NVS blob. A record changes only
+// when a session ends, never while sampling.
+
+static const uint8_t kAthleteMax = 16;
+static const uint8_t kAthleteNameMax = 12;  // including the terminator
+
+struct AthleteRecord {
+  char name[kAthleteNameMax];  // empty = free slot
+  uint16_t sessions;
+  uint16_t bestPeak;
+  uint16_t bestScore;
+  uint16_t bestSeries;
+  uint16_t bestTempoHpm;
+  uint16_t reserved;
+  uint32_t totalHits;
+  uint32_t totalMs;
+  // Exponential moving averages over sessions (weight 1/4), in 1/16 units.
+  uint32_t avgHitsX16;
+  uint32_t avgTempoX16;
+};
+
+// What one finished session contributes to a record.
+struct SessionResult {
+  uint32_t hits;
+  uint32_t durationMs;
+  uint32_t maxSeries;
+  uint32_t tempoHpm;
+  int bestPeak;
+  int bestScore;
+};
+
+enum LeaderboardMetric : uint8_t {
+  BOARD_SCORE,
+  BOARD_PEAK,
+  BOARD_SERIES,
+  BOARD_TEMPO,
+  BOARD_COUNT
+};
+
+// Athlete slots ordered by a key, highest first, ties by slot. Placement is
+// a binary search; the shift behind it moves at most kAthleteMax bytes.
+class LeaderboardIndex {
+public:
+  LeaderboardIndex() {
+    clear();
+  }
+
+  void clear() {
+    count_ = 0;
+    memset(rank_, kAbsent, sizeof(rank_));
+  }
+
+  // Inserts the slot, or moves it if its key changed.
+  void update(uint8_t slot, uint32_t key) {
+    remove(slot);
+    keys_[slot] = key;
+    uint8_t lo = 0;
+    uint8_t hi = count_;
+    while (lo < hi) {
+      uint8_t mid = static_cast<uint8_t>((lo + hi) / 2);
+      if (before(order_[mid], slot)) {
+        lo = static_cast<uint8_t>(mid + 1);
+      } else {
+        hi = mid;
+      }
+    }
+    memmove(order_ + lo + 1, order_ + lo, count_ - lo);
+    order_[lo] = slot;
+    count_++;
+    reindexFrom(lo);
+  }
+
+  void remove(uint8_t slot) {
+    uint8_t at = rank_[slot];
+    if (at == kAbsent) {
+      return;
+    }
+    memmove(order_ + at, order_ + at + 1, count_ - at - 1);
+    count_--;
+    rank_[slot] = kAbsent;
+    reindexFrom(at);
+  }
+
+  uint8_t count() const {
+    return count_;
+  }
+
+  // Slot at a 0-based rank.
+  uint8_t at(uint8_t rank) const {
+    return order_[rank];
+  }
+
+  uint32_t key(uint8_t slot) const {
+    return keys_[slot];
+  }
+
+private:
+  static const uint8_t kAbsent = 0xFF;
+
+  bool before(uint8_t a, uint8_t b) const {
+    return keys_[a] != keys_[b] ? keys_[a] > keys_[b] : a < b;
+  }
+
+  void reindexFrom(uint8_t from) {
+    for (uint8_t i = from; i < count_; i++) {
+      rank_[order_[i]] = i;
+    }
+  }
+
+  uint32_t keys_[kAthleteMax] = {};
+  uint8_t order_[kAthleteMax] = {};
+  uint8_t rank_[kAthleteMax] = {};
+  uint8_t count_ = 0;
+};
+
+inline uint16_t saturate16(uint32_t value) {
+  return value > UINT16_MAX ? UINT16_MAX : static_cast<uint16_t>(value);
+}
+
+inline uint32_t updateAverageX16(uint32_t avgX16, uint32_t value, uint16_t sessions) {
+  uint32_t x16 = value > (UINT32_MAX >> 4) ? UINT32_MAX : value << 4;
+  if (sessions <= 1) {
+    return x16;
+  }
+  return x16 >= avgX16 ? avgX16 + (x16 - avgX16) / 4 : avgX16 - (avgX16 - x16) / 4;
+}
+
+// The records plus one leaderboard index per metric.
+class AthleteTable {
+public:
+  void clear() {
+    memset(records_, 0, sizeof(records_));
+    for (uint8_t m = 0; m < BOARD_COUNT; m++) {
+      boards_[m].clear();
+    }
+  }
+
+  // Takes a record loaded from storage; an unused or damaged one frees the slot.
+  void load(uint8_t slot, const AthleteRecord &record) {
+    records_[slot] = record;
+    if (!used(slot) || memchr(record.name, '\0', sizeof(record.name)) == nullptr) {
+      memset(&records_[slot], 0, sizeof(AthleteRecord));
+    }
+    reindex(slot);
+  }
+
+  bool used(uint8_t slot) const {
+    return slot < kAthleteMax && records_[slot].name[0] != '\0';
+  }
+
+  const AthleteRecord &record(uint8_t slot) const {
+    return records_[slot];
+  }
+
+  // Renames a slot, creating the profile if the slot was free.
+  void setName(uint8_t slot, const char *name, size_t len) {
+    AthleteRecord &r = records_[slot];
+    if (len >= sizeof(r.name)) {
+      len = sizeof(r.name) - 1;
+    }
+    memcpy(r.name, name, len);
+    memset(r.name + len, 0, sizeof(r.name) - len);
+    reindex(slot);
+  }
+
+  void erase(uint8_t slot) {
+    memset(&records_[slot], 0, sizeof(AthleteRecord));
+    reindex(slot);
+  }
+
+  void applySession(uint8_t slot, const SessionResult &s) {
+    AthleteRecord &r = records_[slot];
+    if (r.sessions < UINT16_MAX) {
+      r.sessions++;
+    }
+    r.totalHits += s.hits;
+    r.totalMs += s.durationMs;
+    if (s.bestPeak > r.bestPeak) {
+      r.bestPeak = saturate16(static_cast<uint32_t>(s.bestPeak));
+    }
+    if (s.bestScore > r.bestScore) {
+      r.bestScore = saturate16(static_cast<uint32_t>(s.bestScore));
+    }
+    if (s.maxSeries > r.bestSeries) {
+      r.bestSeries = saturate16(s.maxSeries);
+    }
+    if (s.tempoHpm > r.bestTempoHpm) {
+      r.bestTempoHpm = saturate16(s.tempoHpm);
+    }
+    r.avgHitsX16 = updateAverageX16(r.avgHitsX16, s.hits, r.sessions);
+    r.avgTempoX16 = updateAverageX16(r.avgTempoX16, s.tempoHpm, r.sessions);
+    reindex(slot);
+  }
+
+  const LeaderboardIndex &board(LeaderboardMetric metric) const {
+    return boards_[metric];
+  }
+
+private:
+  static uint32_t metricKey(const AthleteRecord &r, uint8_t metric) {
+    switch (metric) {
+      case BOARD_SCORE: return (static_cast<uint32_t>(r.bestScore) << 16) | r.bestPeak;
+      case BOARD_PEAK: return r.bestPeak;
+      case BOARD_SERIES: return r.bestSeries;
+      default: return r.bestTempoHpm;
+    }
+  }
+
+  // Profiles appear on the boards once they have a session.
+  void reindex(uint8_t slot) {
+    for (uint8_t m = 0; m < BOARD_COUNT; m++) {
+      if (used(slot) && records_[slot].sessions > 0) {
+        boards_[m].update(slot, metricKey(records_[slot], m));
+      } else {
+        boards_[m].remove(slot);
+      }
+    }
+  }
+
+  AthleteRecord records_[kAthleteMax] = {};
+  LeaderboardIndex boards_[BOARD_COUNT];
+};
@@ -0,0 +1,153 @@
+#pragma once
+
+#include <stdint.h>
+
+// Radix-2 decimation-in-time FFT on int32 samples with Q15 twiddles, for the
+// spectral diagnostics (spectrum_diag.h). The twiddle and Hann tables are
+// built by the compiler: a constexpr Taylor series evaluates each entry, and
+// an index pack spreads it over the array, so nothing is computed or stored
+// in RAM at run time. Written for C++11, which the ESP32 core builds with.
+//
+// Scaling is block floating point: before every stage the whole block is
+// halved while any value could overflow in the butterflies, and the halvings
+// are counted. The true spectrum is the output times 2^shift; quiet inputs
+// keep their full resolution instead of losing a bit per stage.
+
+constexpr double kFftPi = 3.14159265358979323846;
+
+// sin(x) for |x| <= pi/2, to well under one Q15 step.
+constexpr double fftSinSeries(double x2, double term, int n) {
+  return n > 25 ? 0.0 : term + fftSinSeries(x2, -term * x2 / ((n + 1) * (n + 2)), n + 2);
+}
+
+constexpr double fftSinSmall(double x) {
+  return fftSinSeries(x * x, x, 1);
+}
+
+// sin(x) for 0 <= x <= pi.
+constexpr double fftSin(double x) {
+  return fftSinSmall(x <= kFftPi / 2 ? x : kFftPi - x);
+}
+
+constexpr int16_t fftQ15(double v) {
+  return static_cast<int16_t>(v >= 0 ? v * 32767.0 + 0.5 : v * 32767.0 - 0.5);
+}
+
+// cos and sin of 2 pi k / n, for k < n / 2.
+constexpr int16_t fftCosQ15(uint16_t k, uint16_t n) {
+  return fftQ15(fftSinSmall(kFftPi / 2 - 2 * kFftPi * k / n));
+}
+
+constexpr int16_t fftSinQ15(uint16_t k, uint16_t n) {
+  return fftQ15(fftSin(2 * kFftPi * k / n));
+}
+
+// Hann window sin^2(pi i / n).
+constexpr int16_t fftHannQ15(uint16_t i, uint16_t n) {
+  return fftQ15(fftSin(kFftPi * i / n) * fftSin(kFftPi * i / n));
+}
+
+template <uint16_t... I>
+struct FftIndexList {};
+
+template <uint16_t N, uint16_t... I>
+struct FftIndexRange : FftIndexRange<N - 1, N - 1, I...> {};
+
+template <uint16_t... I>
+struct FftIndexRange<0, I...> {
+  typedef FftIndexList<I...> type;
+};
+
+template <uint16_t N, typename List = typename FftIndexRange<N / 2>::type>
+struct FftTwiddles;
+
+template <uint16_t N, uint16_t... I>
+struct FftTwiddles<N, FftIndexList<I...>> {
+  static constexpr int16_t kCos[N / 2] = {fftCosQ15(I, N)...};
+  static constexpr int16_t kSin[N / 2] = {fftSinQ15(I, N)...};
+};
+
+template <uint16_t N, uint16_t... I>
+constexpr int16_t FftTwiddles<N, FftIndexList<I...>>::kCos[N / 2];
+template <uint16_t N, uint16_t... I>
+constexpr int16_t FftTwiddles<N, FftIndexList<I...>>::kSin[N / 2];
+
+template <uint16_t N, typename List = typename FftIndexRange<N>::type>
+struct FftHann;
+
+template <uint16_t N, uint16_t... I>
+struct FftHann<N, FftIndexList<I...>> {
+  static constexpr int16_t kWindow[N] = {fftHannQ15(I, N)...};
+};
+
+template <uint16_t N, uint16_t... I>
+constexpr int16_t FftHann<N, FftIndexList<I...>>::kWindow[N];
+
+// Values are kept below this before each stage; a butterfly grows a
+// component by at most 1 + sqrt(2), which still fits an int32.
+static const int32_t kFftHeadroom = 1 << 29;
+
+template <uint16_t N>
+class FixedFft {
+public:
+  static_assert(N >= 4 && (N & (N - 1)) == 0, "FFT size must be a power of two");
+
+  // Forward transform of re/im in place. Returns the number of halvings.
+  static uint8_t transform(int32_t *re, int32_t *im) {
+    for (uint16_t i = 1, j = 0; i < N; i++) {
+      uint16_t bit = N >> 1;
+      for (; j & bit; bit >>= 1) {
+        j ^= bit;
+      }
+      j |= bit;
+      if (i < j) {
+        int32_t t = re[i];
+        re[i] = re[j];
+        re[j] = t;
+        t = im[i];
+        im[i] = im[j];
+        im[j] = t;
+      }
+    }
+    uint8_t shift = 0;
+    for (uint16_t size = 2; size <= N; size <<= 1) {
+      while (peak(re, im) >= kFftHeadroom) {
+        for (uint16_t i = 0; i < N; i++) {
+          re[i] >>= 1;
+          im[i] >>= 1;
+        }
+        shift++;
+      }
+      uint16_t half = size >> 1;
+      uint16_t step = N / size;
+      for (uint16_t start = 0; start < N; start += size) {
+        for (uint16_t k = 0; k < half; k++) {
+          int32_t c = FftTwiddles<N>::kCos[k * step];
+          int32_t s = FftTwiddles<N>::kSin[k * step];
+          uint16_t a = start + k;
+          uint16_t b = a + half;
+          // (re + i im)(c - i s): the forward kernel e^(-2 pi i k / size).
+          int32_t tr = static_cast<int32_t>((static_cast<int64_t>(re[b]) * c + static_cast<int64_t>(im[b]) * s) >> 15);
+          int32_t ti = static_cast<int32_t>((static_cast<int64_t>(im[b]) * c - static_cast<int64_t>(re[b]) * s) >> 15);
+          re[b] = re[a] - tr;
+          im[b] = im[a] - ti;
+          re[a] += tr;
+          im[a] += ti;
+        }
+      }
+    }
+    return shift;
+  }
+
+private:
+  static int32_t peak(const int32_t *re, const int32_t *im) {
+    int32_t m = 0;
+    for (uint16_t i = 0; i < N; i++) {
+      int32_t r = re[i] < 0 ? -re[i] : re[i];
+      int32_t q = im[i] < 0 ? -im[i] : im[i];
+      m = r > m ? r : m;
+      m = q > m ? q : m;
+    }
+    return m;
+  }
+};
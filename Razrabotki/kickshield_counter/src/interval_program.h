@@ -0,0 +1,354 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+// Interval training programs: a short list of work/rest phases repeated for
+// a number of rounds (Tabata is "w20000,r10000" x 8). Programs are plain
+// fixed-size structs so they can be stored in NVS as one blob each.
+//
+// Text form used by the API, one phase per comma: kind ('w' work, 'r' rest),
+// duration in ms, optional "/target" hits, e.g. "w20000/15,r10000". A
+// duration of 0 is open-ended and only allowed for the last phase of a
+// single-round program ("w0" is free mode).
+
+static const uint8_t kProgramMaxPhases = 12;
+static const uint8_t kProgramMaxRounds = 99;
+static const uint8_t kProgramNameMax = 12;  // including the terminator
+static const uint8_t kRoundHistoryMax = 16;
+// Longest text form with its terminator: "w99999999/65535" per phase
+// (parsePhaseSpec() reads at most 8 and 5 digits), comma separated.
+static const size_t kPhaseSpecMax = kProgramMaxPhases * sizeof("w99999999/65535");
+
+enum PhaseKind : uint8_t {
+  PHASE_WORK = 0,
+  PHASE_REST = 1
+};
+
+struct ProgramPhase {
+  uint32_t durationMs;  // 0 = until stopped
+  uint16_t targetHits;  // 0 = no target
+  uint8_t kind;
+  uint8_t reserved;
+};
+
+struct IntervalProgram {
+  char name[kProgramNameMax];
+  uint8_t phaseCount;
+  uint8_t rounds;
+  uint8_t reserved[2];
+  ProgramPhase phases[kProgramMaxPhases];
+};
+
+inline bool programValid(const IntervalProgram &p) {
+  if (p.phaseCount == 0 || p.phaseCount > kProgramMaxPhases || p.rounds == 0 || p.rounds > kProgramMaxRounds) {
+    return false;
+  }
+  if (memchr(p.name, '\0', sizeof(p.name)) == nullptr) {
+    return false;
+  }
+  for (uint8_t i = 0; i < p.phaseCount; i++) {
+    const ProgramPhase &phase = p.phases[i];
+    if (phase.kind > PHASE_REST) {
+      return false;
+    }
+    if (phase.durationMs == 0 && (i + 1 != p.phaseCount || p.rounds != 1)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Total length in microseconds, 0 if the program is open-ended.
+inline uint64_t programDurationUs(const IntervalProgram &p) {
+  uint64_t roundMs = 0;
+  for (uint8_t i = 0; i < p.phaseCount; i++) {
+    if (p.phases[i].durationMs == 0) {
+      return 0;
+    }
+    roundMs += p.phases[i].durationMs;
+  }
+  return roundMs * p.rounds * 1000;
+}
+
+inline void programSetName(IntervalProgram &p, const char *name, size_t len) {
+  if (len >= sizeof(p.name)) {
+    len = sizeof(p.name) - 1;
+  }
+  memcpy(p.name, name, len);
+  memset(p.name + len, 0, sizeof(p.name) - len);
+}
+
+// Parses the text form into p.phases / p.phaseCount; name and rounds are left
+// alone. Returns false on any malformed phase.
+inline bool parsePhaseSpec(const char *text, size_t len, IntervalProgram &p) {
+  uint8_t count = 0;
+  size_t i = 0;
+  while (i < len) {
+    if (count == kProgramMaxPhases) {
+      return false;
+    }
+    ProgramPhase phase = {0, 0, PHASE_WORK, 0};
+    char kind = text[i++];
+    if (kind == 'w' || kind == 'W') {
+      phase.kind = PHASE_WORK;
+    } else if (kind == 'r' || kind == 'R') {
+      phase.kind = PHASE_REST;
+    } else {
+      return false;
+    }
+
+    uint32_t value = 0;
+    size_t digits = 0;
+    for (; i < len && text[i] >= '0' && text[i] <= '9' && digits < 8; i++, digits++) {
+      value = value * 10 + static_cast<uint32_t>(text[i] - '0');
+    }
+    if (digits == 0) {
+      return false;
+    }
+    phase.durationMs = value;
+
+    if (i < len && text[i] == '/') {
+      i++;
+      value = 0;
+      digits = 0;
+      for (; i < len && text[i] >= '0' && text[i] <= '9' && digits < 5; i++, digits++) {
+        value = value * 10 + static_cast<uint32_t>(text[i] - '0');
+      }
+      if (digits == 0 || value > UINT16_MAX) {
+        return false;
+      }
+      phase.targetHits = static_cast<uint16_t>(value);
+    }
+
+    if (i < len) {
+      if (text[i] != ',' || i + 1 == len) {
+        return false;
+      }
+      i++;
+    }
+    p.phases[count++] = phase;
+  }
+  if (count == 0) {
+    return false;
+  }
+  p.phaseCount = count;
+  return true;
+}
+
+inline size_t formatPhaseSpec(const IntervalProgram &p, char *out, size_t size) {
+  size_t len = 0;
+  if (size == 0) {
+    return 0;
+  }
+  out[0] = '\0';
+  for (uint8_t i = 0; i < p.phaseCount && len + 1 < size; i++) {
+    const ProgramPhase &phase = p.phases[i];
+    int written = snprintf(out + len, size - len, "%s%c%lu", i > 0 ? "," : "",
+                           phase.kind == PHASE_REST ? 'r' : 'w', static_cast<unsigned long>(phase.durationMs));
+    if (written > 0 && phase.targetHits > 0 && len + written < size) {
+      written += snprintf(out + len + written, size - len - written, "/%u", phase.targetHits);
+    }
+    if (written > 0) {
+      len = (len + written < size) ? len + written : size - 1;
+    }
+  }
+  return len;
+}
+
+// One finished (or, when the session is stopped early, partial) round.
+struct RoundSummary {
+  uint32_t seq;
+  uint8_t round;     // 1-based
+  bool complete;
+  uint32_t targetHits;
+  uint32_t hits;     // work phases only
+  uint32_t restHits;
+  uint32_t workMs;   // work time covered by this summary
+  int bestPeak;
+};
+
+// Walks a program on the session clock. Phase boundaries are computed from
+// the program start, never from when the loop noticed them, so a late loop
+// does not stretch the phases; hits are assigned to phases by timestamp.
+class ProgramRunner {
+public:
+  void start(const IntervalProgram &program, uint64_t nowUs) {
+    program_ = program;
+    endUs_ = 0;
+    round_ = 0;
+    phaseIndex_ = 0;
+    active_ = true;
+    resetRound();
+    openPhase(nowUs);
+  }
+
+  // Closes every phase boundary at or before nowUs. Returns true if the
+  // phase changed.
+  bool advance(uint64_t nowUs) {
+    bool changed = false;
+    while (active_ && phaseEndUs_ != 0 && nowUs >= phaseEndUs_) {
+      closePhase(phaseEndUs_);
+      changed = true;
+    }
+    return changed;
+  }
+
+  // Returns false if the hit falls after the end of the program.
+  bool recordHit(uint64_t atUs, int peak) {
+    advance(atUs);
+    if (!active_) {
+      return false;
+    }
+    phaseHits_++;
+    if (phase().kind == PHASE_WORK) {
+      roundHits_++;
+      if (peak > roundBestPeak_) {
+        roundBestPeak_ = peak;
+      }
+    } else {
+      roundRestHits_++;
+    }
+    return true;
+  }
+
+  // Stops a running program at nowUs; an unfinished round is summarised as
+  // partial.
+  void stop(uint64_t nowUs) {
+    advance(nowUs);
+    if (!active_) {
+      return;
+    }
+    if (phase().kind == PHASE_WORK && nowUs > phaseStartUs_) {
+      roundWorkMs_ += static_cast<uint32_t>((nowUs - phaseStartUs_) / 1000);
+    }
+    if (phaseIndex_ > 0 || roundHits_ > 0 || roundRestHits_ > 0 || roundWorkMs_ > 0) {
+      pushSummary(false);
+    }
+    active_ = false;
+    endUs_ = nowUs;
+  }
+
+  bool active() const {
+    return active_;
+  }
+
+  // When the program ended (its last boundary, or the stop time).
+  uint64_t endUs() const {
+    return endUs_;
+  }
+
+  const IntervalProgram &program() const {
+    return program_;
+  }
+
+  const ProgramPhase &phase() const {
+    return program_.phases[phaseIndex_];
+  }
+
+  uint8_t phaseIndex() const {
+    return phaseIndex_;
+  }
+
+  uint8_t round() const {
+    return round_ + 1;
+  }
+
+  uint32_t phaseHits() const {
+    return phaseHits_;
+  }
+
+  uint64_t phaseEndUs() const {
+    return phaseEndUs_;
+  }
+
+  // Round summaries, oldest first; seq numbers keep counting across sessions
+  // so clients can ask for "everything after seq N".
+  uint32_t lastSummarySeq() const {
+    return summarySeq_;
+  }
+
+  uint8_t summaryCount() const {
+    return summaryCount_;
+  }
+
+  const RoundSummary &summary(uint8_t i) const {
+    return summaries_[(summaryHead_ + kRoundHistoryMax - summaryCount_ + i) % kRoundHistoryMax];
+  }
+
+private:
+  void resetRound() {
+    roundHits_ = 0;
+    roundRestHits_ = 0;
+    roundWorkMs_ = 0;
+    roundTarget_ = 0;
+    roundBestPeak_ = 0;
+  }
+
+  void openPhase(uint64_t atUs) {
+    phaseStartUs_ = atUs;
+    phaseEndUs_ = phase().durationMs ? atUs + static_cast<uint64_t>(phase().durationMs) * 1000 : 0;
+    phaseHits_ = 0;
+    if (phase().kind == PHASE_WORK) {
+      roundTarget_ += phase().targetHits;
+    }
+  }
+
+  void closePhase(uint64_t atUs) {
+    if (phase().kind == PHASE_WORK) {
+      roundWorkMs_ += phase().durationMs;
+    }
+    if (++phaseIndex_ < program_.phaseCount) {
+      openPhase(atUs);
+      return;
+    }
+    pushSummary(true);
+    phaseIndex_ = 0;
+    if (++round_ >= program_.rounds) {
+      round_ = program_.rounds - 1;
+      phaseIndex_ = program_.phaseCount - 1;
+      active_ = false;
+      endUs_ = atUs;
+      return;
+    }
+    resetRound();
+    openPhase(atUs);
+  }
+
+  void pushSummary(bool complete) {
+    RoundSummary &s = summaries_[summaryHead_];
+    s.seq = ++summarySeq_;
+    s.round = round_ + 1;
+    s.complete = complete;
+    s.targetHits = roundTarget_;
+    s.hits = roundHits_;
+    s.restHits = roundRestHits_;
+    s.workMs = roundWorkMs_;
+    s.bestPeak = roundBestPeak_;
+    summaryHead_ = (summaryHead_ + 1) % kRoundHistoryMax;
+    if (summaryCount_ < kRoundHistoryMax) {
+      summaryCount_++;
+    }
+  }
+
+  IntervalProgram program_ = {};
+  uint64_t endUs_ = 0;
+  uint64_t phaseStartUs_ = 0;
+  uint64_t phaseEndUs_ = 0;
+  uint8_t round_ = 0;
+  uint8_t phaseIndex_ = 0;
+  bool active_ = false;
+  uint32_t phaseHits_ = 0;
+  uint32_t roundHits_ = 0;
+  uint32_t roundRestHits_ = 0;
+  uint32_t roundWorkMs_ = 0;
+  uint32_t roundTarget_ = 0;
+  int roundBestPeak_ = 0;
+
+  RoundSummary summaries_[kRoundHistoryMax];
+  uint8_t summaryHead_ = 0;
+  uint8_t summaryCount_ = 0;
+  uint32_t summarySeq_ = 0;
+};
@@ -0,0 +1,266 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Pull-style scanner for the members of one flat JSON object, e.g. a POST
+// body. It walks the text once, never allocates and never copies: keys and
+// values come back as spans into the caller's buffer. Nested objects and
+// arrays are skipped as whole values, so keys inside them (or inside string
+// values) are never reported as top-level members.
+
+struct JsonSpan {
+  const char *ptr;
+  size_t len;
+
+  bool equals(const char *text) const {
+    size_t n = strlen(text);
+    return n == len && memcmp(ptr, text, n) == 0;
+  }
+};
+
+enum JsonType : uint8_t {
+  JSON_STRING,  // span excludes the quotes, escapes are left as-is
+  JSON_NUMBER,
+  JSON_TRUE,
+  JSON_FALSE,
+  JSON_NULL,
+  JSON_OBJECT,  // span covers the raw nested text including braces
+  JSON_ARRAY
+};
+
+struct JsonMember {
+  JsonSpan key;
+  JsonType type;
+  JsonSpan value;
+};
+
+class JsonObjectScanner {
+public:
+  JsonObjectScanner(const char *data, size_t len) : p_(data), end_(data + len) {}
+
+  // Returns the next top-level member, or false at the closing brace or on
+  // malformed input (see failed()).
+  bool next(JsonMember &out) {
+    if (state_ == kDone) {
+      return false;
+    }
+    skipWhitespace();
+    if (state_ == kStart) {
+      if (!consume('{')) {
+        return fail();
+      }
+      skipWhitespace();
+      if (consume('}')) {
+        state_ = kDone;
+        return false;
+      }
+      state_ = kMembers;
+    } else if (consume(',')) {
+      skipWhitespace();
+    } else if (consume('}')) {
+      state_ = kDone;
+      return false;
+    } else {
+      return fail();
+    }
+
+    if (!scanString(out.key)) {
+      return fail();
+    }
+    skipWhitespace();
+    if (!consume(':')) {
+      return fail();
+    }
+    skipWhitespace();
+    if (!scanValue(out.type, out.value)) {
+      return fail();
+    }
+    return true;
+  }
+
+  bool failed() const {
+    return failed_;
+  }
+
+private:
+  enum State : uint8_t { kStart, kMembers, kDone };
+
+  static const uint8_t kMaxDepth = 64;
+
+  bool fail() {
+    failed_ = true;
+    state_ = kDone;
+    return false;
+  }
+
+  void skipWhitespace() {
+    while (p_ < end_ && (*p_ == ' ' || *p_ == '\t' || *p_ == '\r' || *p_ == '\n')) {
+      p_++;
+    }
+  }
+
+  bool consume(char c) {
+    if (p_ < end_ && *p_ == c) {
+      p_++;
+      return true;
+    }
+    return false;
+  }
+
+  bool consumeLiteral(const char *text) {
+    size_t n = strlen(text);
+    if (static_cast<size_t>(end_ - p_) < n || memcmp(p_, text, n) != 0) {
+      return false;
+    }
+    p_ += n;
+    return true;
+  }
+
+  bool scanString(JsonSpan &out) {
+    if (!consume('"')) {
+      return false;
+    }
+    const char *start = p_;
+    while (p_ < end_) {
+      char c = *p_;
+      if (c == '"') {
+        out.ptr = start;
+        out.len = static_cast<size_t>(p_ - start);
+        p_++;
+        return true;
+      }
+      if (c == '\\') {
+        p_++;
+        if (p_ == end_) {
+          return false;
+        }
+      } else if (static_cast<unsigned char>(c) < 0x20) {
+        return false;
+      }
+      p_++;
+    }
+    return false;
+  }
+
+  // Skips a nested object or array, checking that every bracket closes
+  // the one it should; up to kMaxDepth levels deep.
+  bool skipNested() {
+    uint64_t objects = 0;  // bit n set: level n is an object
+    uint8_t depth = 0;
+    while (p_ < end_) {
+      char c = *p_;
+      if (c == '"') {
+        JsonSpan ignored;
+        if (!scanString(ignored)) {
+          return false;
+        }
+        continue;
+      }
+      p_++;
+      if (c == '{' || c == '[') {
+        if (depth == kMaxDepth) {
+          return false;
+        }
+        uint64_t bit = 1ULL << depth;
+        objects = c == '{' ? (objects | bit) : (objects & ~bit);
+        depth++;
+      } else if (c == '}' || c == ']') {
+        depth--;
+        if (((objects >> depth) & 1) != (c == '}' ? 1U : 0U)) {
+          return false;
+        }
+        if (depth == 0) {
+          return true;
+        }
+      }
+    }
+    return false;
+  }
+
+  bool scanValue(JsonType &type, JsonSpan &out) {
+    if (p_ == end_) {
+      return false;
+    }
+    const char *start = p_;
+    char c = *p_;
+    bool ok = true;
+    if (c == '"') {
+      type = JSON_STRING;
+      return scanString(out);
+    } else if (c == '{' || c == '[') {
+      type = (c == '{') ? JSON_OBJECT : JSON_ARRAY;
+      ok = skipNested();
+    } else if (c == 't') {
+      type = JSON_TRUE;
+      ok = consumeLiteral("true");
+    } else if (c == 'f') {
+      type = JSON_FALSE;
+      ok = consumeLiteral("false");
+    } else if (c == 'n') {
+      type = JSON_NULL;
+      ok = consumeLiteral("null");
+    } else if (c == '-' || (c >= '0' && c <= '9')) {
+      type = JSON_NUMBER;
+      p_++;
+      while (p_ < end_ && ((*p_ >= '0' && *p_ <= '9') || *p_ == '.' || *p_ == 'e' || *p_ == 'E' ||
+                           *p_ == '+' || *p_ == '-')) {
+        p_++;
+      }
+      ok = !(c == '-' && p_ - start == 1);
+    } else {
+      ok = false;
+    }
+    out.ptr = start;
+    out.len = static_cast<size_t>(p_ - start);
+    return ok;
+  }
+
+  const char *p_;
+  const char *end_;
+  State state_ = kStart;
+  bool failed_ = false;
+};
+
+// Integer part of a JSON number ("12.7" -> 12), saturated to int range.
+inline bool jsonSpanToInt(const JsonSpan &span, int &out) {
+  size_t i = 0;
+  bool negative = false;
+  if (i < span.len && span.ptr[i] == '-') {
+    negative = true;
+    i++;
+  }
+  if (i == span.len || span.ptr[i] < '0' || span.ptr[i] > '9') {
+    return false;
+  }
+  int64_t value = 0;
+  for (; i < span.len && span.ptr[i] >= '0' && span.ptr[i] <= '9'; i++) {
+    if (value <= INT32_MAX) {
+      value = value * 10 + (span.ptr[i] - '0');
+    }
+  }
+  if (negative) {
+    value = -value;
+  }
+  if (value > INT32_MAX) {
+    value = INT32_MAX;
+  } else if (value < INT32_MIN) {
+    value = INT32_MIN;
+  }
+  out = static_cast<int>(value);
+  return true;
+}
+
+// Calls handler(const JsonMember &) for each top-level member. Returns false
+// if the body was not a well-formed object; members seen before the error
+// have already been dispatched.
+template <typename Handler>
+bool jsonForEachMember(const char *data, size_t len, Handler &&handler) {
+  JsonObjectScanner scanner(data, len);
+  JsonMember member;
+  while (scanner.next(member)) {
+    handler(member);
+  }
+  return !scanner.failed();
+}
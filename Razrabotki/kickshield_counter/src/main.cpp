@@ -2,6 +2,25 @@
 #include <Preferences.h>
 #include <WebServer.h>
 #include <WiFi.h>
+#include <esp_timer.h>
+
+#include <atomic>
+
+#include "athlete_table.h"
+#include "http_server.h"
+#include "interval_program.h"
+#include "json_scan.h"
+#include "oversample.h"
+#include "sample_stream.h"
+#include "spectrum_diag.h"
+#include "stall_watch.h"
+#include "status_frame.h"
+#include "strike_classifier.h"
+#include "strike_detector.h"
+#include "strike_features.h"
+#include "strike_match.h"
+#include "strike_model.h"
+#include "synth_strikes.h"
 
 namespace {
 
@@ -10,12 +29,55 @@ const char *kApPass = "12345678";
 
 const int kAdcPin = 34;
 const uint32_t kSampleIntervalUs = 100; // 10 kHz target
-const uint32_t kTempoWindowMs = 10000;
+const uint32_t kSampleRateHz = 1000000 / kSampleIntervalUs;
+
+// Raw reads averaged into each detector sample (build flag
+// -DKICKSHIELD_OVERSAMPLE=N). analogRead() takes about 10 us, so up to 8
+// fits the sample interval; 1 disables the stage.
+#ifndef KICKSHIELD_OVERSAMPLE
+#define KICKSHIELD_OVERSAMPLE 1
+#endif
+const uint8_t kOversampleRatio = KICKSHIELD_OVERSAMPLE;
+const uint64_t kTempoWindowUs = 10000000;
+const uint64_t kStatusTickUs = 50000;
+const size_t kStatusJsonMax = 1280;
+const uint8_t kProgramSlots = 4;
+const unsigned long kLogBaud = 115200;
+const unsigned long kCaptureBaud = 921600;
+const size_t kSerialTxBuffer = 4096;
+const int kCaptureMaxDiv = 50;
+const uint32_t kActiveCpuMhz = 240;
+const uint32_t kIdleCpuMhz = 80;  // lowest clock the WiFi driver runs at
+// A strike stays above the wake level for only a few ms, so a slower watch
+// could step over one entirely; each check is a single ~10 us read.
+const uint32_t kIdleWatchMs = 2;
+const uint32_t kWatchCatchUpMax = 1000;
 
 const int kDefaultThreshold = 1200;
 const int kDefaultLockoutMs = 120;
 const int kDefaultSeriesGapMs = 600;
 const int kDefaultSampleWindowMs = 8;
+// The strike tracker finds a strike's peak anywhere in the detector window.
+const int kSampleWindowMaxMs = 50;
+static_assert(kSampleWindowMaxMs * 1000 / kSampleIntervalUs <= kStrikeWindowMax,
+              "sample_window_ms must fit the strike tracker's ring");
+const int kDefaultSimRateHpm = 150;
+const int kDefaultSimNoise = 12;
+const int kDefaultSimBouncePct = 40;
+const int kDefaultIdleAfterS = 60;
+const int kDefaultStallSampleMs = 10;
+const int kDefaultStallHttpMs = 150;
+const int kDefaultStallSessionMs = 20;
+const int kDefaultStallFlashMs = 100;
+const int kDefaultMatchPct = 90;
+const int kDefaultSimDisturbPm = 0;
+const int kDefaultLearnStrikes = 8;
+const int kDefaultDiagWindows = 8;
+const int kDiagWindowsMax = 64;
+const uint32_t kDiagPollMs = 20;
+const uint32_t kDiagTaskStack = 4096;
+// Stalls that end in a burst (a budget set too tight) share one NVS write.
+const uint32_t kStallSaveMinMs = 10000;
 
 struct Config {
   int threshold;
@@ -23,29 +85,110 @@ struct Config {
   int seriesGapMs;
   int sampleWindowMs;
   bool simulate;
+  int simRateHpm;
+  int simNoise;
+  int simBouncePct;
+  int idleAfterS;
+  int stallSampleMs;
+  int stallHttpMs;
+  int stallSessionMs;
+  int stallFlashMs;
+  int matchPct;
+  int simDisturbPm;
 };
 
-enum Mode {
-  MODE_FREE,
-  MODE_10,
-  MODE_20,
-  MODE_30,
-  MODE_60
+enum ConfigType : uint8_t {
+  CONFIG_INT,
+  CONFIG_BOOL
 };
 
-WebServer server(80);
+// One entry per setting. The table drives loadConfig(), handleConfig() and
+// the config part of /api/status; the hot path keeps reading Config fields
+// directly. NVS keys are limited to 15 characters.
+struct ConfigField {
+  const char *key;
+  const char *nvsKey;
+  ConfigType type;
+  int minValue;
+  int maxValue;
+  int defaultValue;
+  int Config::*intMember;
+  bool Config::*boolMember;
+};
+
+const ConfigField kConfigFields[] = {
+  {"threshold", "threshold", CONFIG_INT, 0, 4095, kDefaultThreshold, &Config::threshold, nullptr},
+  {"lockout_ms", "lockout_ms", CONFIG_INT, 0, 5000, kDefaultLockoutMs, &Config::lockoutMs, nullptr},
+  {"series_gap_ms", "series_gap_ms", CONFIG_INT, 0, 10000, kDefaultSeriesGapMs, &Config::seriesGapMs, nullptr},
+  {"sample_window_ms", "sample_win_ms", CONFIG_INT, 1, kSampleWindowMaxMs, kDefaultSampleWindowMs,
+   &Config::sampleWindowMs, nullptr},
+  {"simulate", "simulate", CONFIG_BOOL, 0, 1, 0, nullptr, &Config::simulate},
+  {"sim_rate_hpm", "sim_rate_hpm", CONFIG_INT, 0, 1200, kDefaultSimRateHpm, &Config::simRateHpm, nullptr},
+  {"sim_noise", "sim_noise", CONFIG_INT, 0, 400, kDefaultSimNoise, &Config::simNoise, nullptr},
+  {"sim_bounce_pct", "sim_bounce_pct", CONFIG_INT, 0, 100, kDefaultSimBouncePct, &Config::simBouncePct, nullptr},
+  {"idle_after_s", "idle_after_s", CONFIG_INT, 0, 3600, kDefaultIdleAfterS, &Config::idleAfterS, nullptr},
+  {"stall_sample_ms", "stall_sample_ms", CONFIG_INT, 0, 10000, kDefaultStallSampleMs, &Config::stallSampleMs, nullptr},
+  {"stall_http_ms", "stall_http_ms", CONFIG_INT, 0, 10000, kDefaultStallHttpMs, &Config::stallHttpMs, nullptr},
+  {"stall_session_ms", "stall_sess_ms", CONFIG_INT, 0, 10000, kDefaultStallSessionMs, &Config::stallSessionMs,
+   nullptr},
+  {"stall_flash_ms", "stall_flash_ms", CONFIG_INT, 0, 10000, kDefaultStallFlashMs, &Config::stallFlashMs, nullptr},
+  {"match_pct", "match_pct", CONFIG_INT, 0, 100, kDefaultMatchPct, &Config::matchPct, nullptr},
+  {"sim_disturb_pm", "sim_disturb_pm", CONFIG_INT, 0, 600, kDefaultSimDisturbPm, &Config::simDisturbPm, nullptr},
+};
+const size_t kConfigFieldCount = sizeof(kConfigFields) / sizeof(kConfigFields[0]);
+
+// The original mode buttons, now single-phase programs.
+struct ModePreset {
+  const char *mode;
+  const char *name;
+  uint32_t durationMs;
+};
+
+const ModePreset kModePresets[] = {
+  {"free", "FREE", 0},
+  {"10", "10", 10000},
+  {"20", "20", 20000},
+  {"30", "30", 30000},
+  {"60", "60", 60000},
+};
+
+HttpServer server(80);
 Preferences prefs;
 Config config;
 
 bool running = false;
-Mode currentMode = MODE_FREE;
-uint32_t sessionStartMs = 0;
-uint32_t sessionDurationMs = 0;
-uint32_t sessionStopMs = 0;
+uint64_t sessionStartUs = 0;
+uint64_t sessionStopUs = 0;
+
+// A timed session ends at sessionEndUs (0 = open-ended), the program's last
+// boundary. The sampler stops reading at that time on its own clock, and a
+// one-shot esp_timer armed at the start fires at it so loop() stops the
+// session before it serves HTTP again.
+esp_timer_handle_t sessionTimer = nullptr;
+uint64_t sessionEndUs = 0;
+std::atomic<bool> sessionEndDue(false);
+std::atomic<bool> sessionEndFired(false);
+std::atomic<uint32_t> sessionEndFiredAt(0);  // low 32 bits of nowUs()
+
+// How far the last session's boundaries were from their stamps, for
+// /api/status: the first sample after the start, the timer after the end,
+// and the stop itself after the end.
+bool sessionSampled = false;
+uint32_t startSkewUs = 0;
+uint32_t stopLagUs = 0;
+
+// Stored programs, NVS keys "prog0".."prog3"; phaseCount 0 marks a free slot.
+IntervalProgram programs[kProgramSlots];
+ProgramRunner runner;
+uint32_t roundsLogged = 0;
+
+// Athlete profiles, NVS keys "ath0".."ath15". A session may belong to one;
+// its record is updated and stored once, when the session stops.
+AthleteTable athletes;
+int sessionAthlete = -1;
 
 uint32_t hits = 0;
-uint32_t lastHitMs = 0;
-uint32_t lockoutUntil = 0;
+uint64_t lastHitUs = 0;
 uint32_t series = 0;
 uint32_t maxSeries = 0;
 int lastPeak = 0;
@@ -53,12 +196,157 @@ int lastScore = 0;
 int bestPeak = 0;
 int bestScore = 0;
 
+// Recent hits as intervals to the hit before, newest at hitIndex - 1. The
+// first hit of a session counts from the session start. Saturates at
+// UINT32_MAX (71 min), far beyond any tempo window.
 const uint8_t kHitHistoryMax = 64;
-uint32_t hitTimes[kHitHistoryMax];
+uint32_t hitIntervalsUs[kHitHistoryMax];
 uint8_t hitIndex = 0;
 uint8_t hitCount = 0;
 
-uint32_t nextSimMs = 0;
+// Strike types (strike_classifier.h, weights in strike_model.h). A strike
+// is classified once its tail is in, kStrikeTail samples after the peak;
+// one too close to the session start has no baseline and stays unclassified.
+StrikeFeatureTracker strikeFeatures;
+uint32_t classCounts[kStrikeClassCount];
+int8_t lastClass = -1;
+
+// Template check (strike_match.h): a detected strike is held until
+// kMatchTail samples past its peak, then counted only if it correlates at
+// least match_pct % with a learned template. With no templates, or
+// match_pct 0, every strike counts. While a slot is being learned (POST
+// /api/templates?learn=N) strikes count unchecked and train it; the bank
+// is stored when the session stops.
+StrikeMatcher matcher;
+Strike heldStrike;
+bool strikeHeld = false;
+bool templatesChanged = false;
+uint32_t rejectedHits = 0;
+int lastMatchPct = -1;
+
+// Spectral diagnostics (spectrum_diag.h), POST /api/diag?start=1. While a
+// session runs, the loop hands counted strikes' windows and quiet stretches
+// decimated to noise windows over to diagTask through two slots; a slot
+// that is still busy drops the window. The task runs on core 0, away from
+// the sampling loop on core 1, does the FFTs and publishes a report that
+// loop() picks up. A new run bumps diagRun and the task starts over; slots
+// and reports from an earlier run are dropped.
+enum DiagSlotState : uint8_t {
+  DIAG_EMPTY,
+  DIAG_FULL
+};
+
+struct DiagSlot {
+  int16_t samples[kDiagFftSize];
+  uint32_t rateHz;
+  uint32_t run;
+  std::atomic<uint8_t> state;
+};
+
+DiagSlot diagStrikeSlot;
+DiagSlot diagNoiseSlot;
+std::atomic<uint32_t> diagRun(0);
+bool diagActive = false;
+uint16_t diagWanted = 0;
+uint16_t diagStrikesSent = 0;
+uint16_t diagNoiseSent = 0;
+
+// Noise window being filled: kDiagQuietMs after a detection, then averages
+// of kDiagNoiseDecimation samples; a full window waits kDiagHoldWindows
+// detector windows before it is sent.
+int16_t diagNoise[kDiagFftSize];
+uint16_t diagNoiseFill = 0;
+int32_t diagDecimSum = 0;
+uint8_t diagDecimFill = 0;
+uint32_t diagQuiet = 0;
+uint32_t diagHold = 0;
+
+// Written by diagTask while diagReportReady is false.
+DiagReport diagTaskReport;
+uint32_t diagTaskRun = 0;
+uint32_t diagTaskUs = 0;
+std::atomic<bool> diagReportReady(false);
+DiagReport diagReport;
+uint32_t diagWindowUs = 0;  // last window's FFT and sums on core 0
+
+class AdcSource : public SampleSource {
+public:
+  int read() override {
+    return analogRead(kAdcPin);
+  }
+};
+
+AdcSource adcSource;
+SynthStrikeSource synthSource;
+DecimatingSource<kOversampleRatio> adcInput(adcSource);
+DecimatingSource<kOversampleRatio> synthInput(synthSource);
+StrikeDetector detector;
+
+// Raw-sample capture over Serial (POST /api/capture?div=N). While it runs
+// the port carries only stream frames at kCaptureBaud; text logging pauses.
+SampleStreamEncoder capture;
+uint8_t captureDiv = 0;
+
+// Low-power idle: with no session and no request for idle_after_s the CPU
+// drops to kIdleCpuMhz and the loop blocks between low-rate sensor checks.
+// An impact or any HTTP request wakes it. The times feed /api/power. The
+// chip never sleeps (the SoftAP must stay up); idleWaitUs is only the time
+// the loop spent blocked in those waits at the low clock.
+enum PowerState : uint8_t {
+  POWER_AWAKE,
+  POWER_IDLE
+};
+
+PowerState powerState = POWER_AWAKE;
+uint64_t powerStateSinceUs = 0;
+uint64_t lastActivityUs = 0;
+uint64_t awakeUs = 0;
+uint64_t idleUs = 0;
+uint64_t idleWaitUs = 0;
+uint32_t impactWakes = 0;
+uint32_t httpWakes = 0;
+uint64_t lastWatchUs = 0;
+
+// Loop stages watched for stalls (stall_watch.h). Budgets come from the
+// stall_*_ms settings, 0 = not watched; the sample budget is slack on top
+// of the detector window, which the stage spends by design.
+enum LoopStage : uint8_t {
+  STAGE_SAMPLE,
+  STAGE_HTTP,
+  STAGE_SESSION,
+  STAGE_FLASH,
+  STAGE_COUNT
+};
+
+const char *const kStageNames[STAGE_COUNT] = {"sample", "http", "session", "flash"};
+
+// Kept through resets other than power loss; mirrored to NVS as "stalls".
+RTC_NOINIT_ATTR StallRing stallRing;
+StallWatch stallWatch;
+uint32_t stallsLogged = 0;
+uint32_t stallsSaved = 0;
+uint32_t stallsSavedMs = 0;
+uint32_t bootId = 0;
+
+// POST /api/arm: the session starts on the first impact, not on the button.
+bool armed = false;
+IntervalProgram armedProgram;
+int armedAthlete = -1;
+
+// Anything shown by /api/status bumps stateVersion. The JSON is rebuilt at
+// most once per change (and once per kStatusTickUs while a session runs, for
+// the clock-driven fields); every request in between is served these bytes.
+uint32_t stateVersion = 0;
+char statusJson[kStatusJsonMax];
+size_t statusJsonLen = 0;
+uint32_t statusVersion = 0;
+uint32_t statusBuiltFor = 0;
+uint64_t statusBuiltUs = 0;
+bool statusValid = false;
+// Binary encoding of the same snapshot, built on first request for it.
+uint8_t statusFrame[kStatusFrameMax];
+size_t statusFrameLen = 0;
+uint32_t statusFrameFor = 0;
 
 const char kIndexHtml[] PROGMEM = R"HTML(
 <!DOCTYPE html>
@@ -156,7 +444,7 @@ const char kIndexHtml[] PROGMEM = R"HTML(
       margin-bottom: 6px;
     }
 
-    input[type="number"]{
+    input[type="number"], select {
       width: 100%;
       padding: 10px 10px;
       border-radius: 10px;
@@ -214,6 +502,16 @@ const char kIndexHtml[] PROGMEM = R"HTML(
       <button onclick="startMode('30')">30 сек</button>
       <button onclick="startMode('60')">60 сек</button>
     </div>
+    <div style="height:8px"></div>
+    <div class="controls" id="programs"></div>
+    <div style="height:8px"></div>
+    <div class="toggle">
+      <input id="armStart" type="checkbox" style="transform:scale(1.3);">
+      <span>Старт по первому удару</span>
+    </div>
+    <div style="height:8px"></div>
+    <label for="athlete">Спортсмен</label>
+    <select id="athlete"><option value="-1">— без профиля —</option></select>
   </div>
 
   <div class="panel">
@@ -222,11 +520,13 @@ const char kIndexHtml[] PROGMEM = R"HTML(
         <div class="title">Режим</div>
         <div class="value" id="mode">—</div>
         <div class="subvalue">Осталось: <b id="timeLeft">0</b> сек</div>
+        <div class="subvalue">Фаза: <b id="phase">—</b> <b id="phaseLeft"></b> · Раунд <b id="round">—</b></div>
       </div>
 
       <div class="card">
         <div class="title">Удары</div>
         <div class="value" id="hits">0</div>
+        <div class="subvalue" id="classes">—</div>
       </div>
 
       <div class="card">
@@ -278,9 +578,27 @@ const char kIndexHtml[] PROGMEM = R"HTML(
     <div style="height:10px"></div>
     <div class="statusLine">
       <span>Статус: <b id="running">false</b></span>
+      <span id="armedLine" style="display:none;"><b>Ждёт первого удара</b></span>
     </div>
   </div>
 
+  <div class="panel" id="roundsPanel" style="display:none;">
+    <h1 style="font-size:16px;margin:0 0 10px;">Раунды</h1>
+    <div class="statusLine" id="roundsList" style="flex-direction:column;gap:4px;"></div>
+  </div>
+
+  <div class="panel" id="leaderPanel" style="display:none;">
+    <h1 style="font-size:16px;margin:0 0 10px;">Рейтинг</h1>
+    <select id="boardBy" onchange="loadLeaderboard()">
+      <option value="score">Лучший счёт</option>
+      <option value="peak">Лучший пик</option>
+      <option value="series">Лучшая серия</option>
+      <option value="tempo">Лучший темп</option>
+    </select>
+    <div style="height:8px"></div>
+    <div class="statusLine" id="leaderList" style="flex-direction:column;gap:4px;"></div>
+  </div>
+
   <div class="panel" id="settingsPanel" style="display:none;">
     <h1 style="font-size:16px;margin:0 0 10px;">⚙️ Настройки</h1>
 
@@ -305,6 +623,16 @@ const char kIndexHtml[] PROGMEM = R"HTML(
         <input id="sampleWindow" type="number" min="1" max="50">
       </div>
 
+      <div>
+        <label for="simRate">Темп симуляции (уд/мин)</label>
+        <input id="simRate" type="number" min="0" max="1200">
+      </div>
+
+      <div>
+        <label for="idleAfter">Сон без активности (с, 0 — выкл.)</label>
+        <input id="idleAfter" type="number" min="0" max="3600">
+      </div>
+
       <div class="toggle" style="grid-column:1 / -1;">
         <input id="simulate" type="checkbox" style="transform:scale(1.3);">
         <span>Симуляция (тест без ударов)</span>
@@ -313,13 +641,187 @@ const char kIndexHtml[] PROGMEM = R"HTML(
 
     <div style="height:10px"></div>
     <button class="bigBtn" style="width:100%;" onclick="saveConfig()">СОХРАНИТЬ</button>
+
+    <h1 style="font-size:16px;margin:16px 0 10px;">Программа</h1>
+    <div class="settings">
+      <div>
+        <label for="progSlot">Слот (0–3)</label>
+        <input id="progSlot" type="number" min="0" max="3" value="0" onchange="fillProgramForm()">
+      </div>
+      <div>
+        <label for="progRounds">Раунды</label>
+        <input id="progRounds" type="number" min="1" max="99">
+      </div>
+      <div>
+        <label for="progName">Название</label>
+        <input id="progName" type="text" maxlength="11" style="width:100%;padding:10px;border-radius:10px;border:1px solid rgba(0,0,0,0.18);font-size:16px;">
+      </div>
+      <div>
+        <label for="progPhases">Фазы (w20000/15,r10000)</label>
+        <input id="progPhases" type="text" style="width:100%;padding:10px;border-radius:10px;border:1px solid rgba(0,0,0,0.18);font-size:16px;">
+      </div>
+    </div>
+    <div style="height:10px"></div>
+    <button class="bigBtn" style="width:100%;" onclick="saveProgram()">СОХРАНИТЬ ПРОГРАММУ</button>
+
+    <h1 style="font-size:16px;margin:16px 0 10px;">Спортсмен</h1>
+    <div class="settings">
+      <div>
+        <label for="athSlot">Слот (0–15)</label>
+        <input id="athSlot" type="number" min="0" max="15" value="0" onchange="fillAthleteForm()">
+      </div>
+      <div>
+        <label for="athName">Имя</label>
+        <input id="athName" type="text" maxlength="11" style="width:100%;padding:10px;border-radius:10px;border:1px solid rgba(0,0,0,0.18);font-size:16px;">
+      </div>
+    </div>
+    <div style="height:10px"></div>
+    <div class="footerBar">
+      <button class="bigBtn" onclick="saveAthlete(false)">СОХРАНИТЬ</button>
+      <button class="bigBtn secondary" onclick="saveAthlete(true)">УДАЛИТЬ</button>
+    </div>
   </div>
 
   <script>
     let configHydrated = false;
 
+    let programList = [];
+    let roundSeq = null;
+
+    let athleteList = [];
+    let wasRunning = false;
+
+    function startAction() {
+      const action = document.getElementById('armStart').checked ? 'arm' : 'start';
+      return `/api/${action}?athlete=${document.getElementById('athlete').value}`;
+    }
+
     async function startMode(mode) {
-      await fetch(`/api/start?mode=${mode}`, { method: 'POST' });
+      await fetch(`${startAction()}&mode=${mode}`, { method: 'POST' });
+    }
+
+    async function startProgram(slot) {
+      await fetch(`${startAction()}&program=${slot}`, { method: 'POST' });
+    }
+
+    async function loadAthletes() {
+      try {
+        const res = await fetch('/api/athletes', { cache: 'no-store' });
+        athleteList = (await res.json()).athletes || [];
+      } catch (e) {
+        return;
+      }
+      const select = document.getElementById('athlete');
+      const current = select.value;
+      select.innerHTML = '<option value="-1">— без профиля —</option>';
+      athleteList.forEach(a => {
+        const o = document.createElement('option');
+        o.value = a.slot;
+        o.textContent = a.sessions ? `${a.name} (рекорд ${a.best_score})` : a.name;
+        select.appendChild(o);
+      });
+      select.value = athleteList.some(a => String(a.slot) === current) ? current : '-1';
+      fillAthleteForm();
+      loadLeaderboard();
+    }
+
+    function fillAthleteForm() {
+      const slot = Number(document.getElementById('athSlot').value);
+      const a = athleteList.find(x => x.slot === slot);
+      document.getElementById('athName').value = a ? a.name : '';
+    }
+
+    async function saveAthlete(remove) {
+      const params = new URLSearchParams();
+      params.set('slot', document.getElementById('athSlot').value);
+      if (remove) {
+        params.set('delete', '1');
+      } else {
+        params.set('name', document.getElementById('athName').value);
+      }
+      const res = await fetch(`/api/athlete?${params.toString()}`, { method: 'POST' });
+      if (!res.ok) {
+        alert('Неверное имя');
+      }
+      loadAthletes();
+    }
+
+    async function loadLeaderboard() {
+      const by = document.getElementById('boardBy').value;
+      try {
+        const res = await fetch(`/api/leaderboard?by=${by}&limit=10`, { cache: 'no-store' });
+        const data = await res.json();
+        const list = document.getElementById('leaderList');
+        list.innerHTML = '';
+        data.leaders.forEach(l => {
+          const line = document.createElement('span');
+          line.textContent = `${l.rank}. ${l.name} — ${l.value}`;
+          list.appendChild(line);
+        });
+        document.getElementById('leaderPanel').style.display = data.leaders.length ? 'block' : 'none';
+      } catch (e) {}
+    }
+
+    async function loadPrograms() {
+      try {
+        const res = await fetch('/api/programs', { cache: 'no-store' });
+        programList = (await res.json()).programs || [];
+      } catch (e) {
+        return;
+      }
+      const box = document.getElementById('programs');
+      box.innerHTML = '';
+      programList.forEach(p => {
+        const b = document.createElement('button');
+        b.textContent = `${p.name} ×${p.rounds}`;
+        b.onclick = () => startProgram(p.slot);
+        box.appendChild(b);
+      });
+      fillProgramForm();
+    }
+
+    function fillProgramForm() {
+      const slot = Number(document.getElementById('progSlot').value);
+      const p = programList.find(x => x.slot === slot) || { name: '', rounds: 1, phases: '' };
+      document.getElementById('progName').value = p.name;
+      document.getElementById('progRounds').value = p.rounds;
+      document.getElementById('progPhases').value = p.phases;
+    }
+
+    async function saveProgram() {
+      const params = new URLSearchParams();
+      params.set('slot', document.getElementById('progSlot').value);
+      params.set('name', document.getElementById('progName').value);
+      params.set('rounds', document.getElementById('progRounds').value);
+      params.set('phases', document.getElementById('progPhases').value);
+      const res = await fetch(`/api/program?${params.toString()}`, { method: 'POST' });
+      if (!res.ok) {
+        alert('Неверная программа');
+      }
+      loadPrograms();
+    }
+
+    async function pollRounds(seq) {
+      if (roundSeq === null) {
+        roundSeq = seq;
+        return;
+      }
+      if (seq === roundSeq) {
+        return;
+      }
+      try {
+        const res = await fetch(`/api/rounds?since=${roundSeq}`, { cache: 'no-store' });
+        const data = await res.json();
+        const list = document.getElementById('roundsList');
+        data.rounds.forEach(r => {
+          const line = document.createElement('span');
+          const target = r.target ? `/${r.target}` : '';
+          line.textContent = `Раунд ${r.round}${r.complete ? '' : ' (неполный)'}: ${r.hits}${target} ударов, пик ${r.best_peak}`;
+          list.prepend(line);
+        });
+        document.getElementById('roundsPanel').style.display = 'block';
+        roundSeq = data.seq;
+      } catch (e) {}
     }
 
     async function stopRun() {
@@ -338,15 +840,30 @@ const char kIndexHtml[] PROGMEM = R"HTML(
       params.set('series_gap_ms', document.getElementById('seriesGap').value);
       params.set('sample_window_ms', document.getElementById('sampleWindow').value);
       params.set('simulate', document.getElementById('simulate').checked ? '1' : '0');
+      params.set('sim_rate_hpm', document.getElementById('simRate').value);
+      params.set('idle_after_s', document.getElementById('idleAfter').value);
       await fetch(`/api/config?${params.toString()}`, { method: 'POST' });
     }
 
     function updateStatus(data) {
       document.getElementById('running').textContent = data.running ? 'true' : 'false';
+      document.getElementById('armedLine').style.display = data.armed ? 'inline' : 'none';
+      if (wasRunning && !data.running) {
+        loadAthletes();
+      }
+      wasRunning = data.running;
       document.getElementById('mode').textContent = data.mode || '—';
       document.getElementById('timeLeft').textContent = Math.max(0, Math.floor((data.time_left_ms || 0) / 1000));
+      document.getElementById('phase').textContent = data.running ? (data.phase === 'rest' ? 'отдых' : 'работа') : '—';
+      document.getElementById('phaseLeft').textContent = data.running && data.phase_left_ms ? `${Math.ceil(data.phase_left_ms / 1000)} с` : '';
+      document.getElementById('round').textContent = data.rounds ? `${data.round}/${data.rounds}` : '—';
+      pollRounds(data.round_seq || 0);
 
       document.getElementById('hits').textContent = data.hits || 0;
+      const classes = data.classes || {};
+      document.getElementById('classes').innerHTML = classKeys
+        .map((k, i) => `${k === data.last_class ? '<b>' : ''}${classLabels[i]} ${classes[k] || 0}${k === data.last_class ? '</b>' : ''}`)
+        .join(' · ') + (data.rejected ? ` · отсеяно ${data.rejected}` : '');
       document.getElementById('tempo').textContent = data.tempo_hpm || 0;
       document.getElementById('tempoAvg').textContent = data.tempo_avg_hpm || 0;
 
@@ -364,20 +881,114 @@ const char kIndexHtml[] PROGMEM = R"HTML(
         document.getElementById('seriesGap').value = data.series_gap_ms;
         document.getElementById('sampleWindow').value = data.sample_window_ms;
         document.getElementById('simulate').checked = data.simulate ? true : false;
+        document.getElementById('simRate').value = data.sim_rate_hpm;
+        document.getElementById('idleAfter').value = data.idle_after_s;
         configHydrated = true;
       }
     }
 
+    let statusVersion = null;
+    let binaryStatus = true;
+
+    const configKeys = ['threshold', 'lockout_ms', 'series_gap_ms', 'sample_window_ms', 'simulate',
+                        'sim_rate_hpm', 'sim_noise', 'sim_bounce_pct', 'idle_after_s', 'stall_sample_ms',
+                        'stall_http_ms', 'stall_session_ms', 'stall_flash_ms', 'match_pct', 'sim_disturb_pm'];
+    const classKeys = ['front_kick', 'roundhouse', 'punch', 'bump'];
+    const classLabels = ['прямой', 'боковой', 'рука', 'толчок'];
+    const textDecoder = new TextDecoder();
+
+    // Binary /api/status frame (layout in status_frame.h) into the JSON
+    // shape; null if the version is unknown, and the page falls back to JSON.
+    function decodeStatusFrame(buf) {
+      const v = new DataView(buf);
+      if (v.byteLength < 66 || v.getUint8(0) !== 1) {
+        return null;
+      }
+      const flags = v.getUint8(1);
+      const name = new Uint8Array(buf, 8, 12);
+      const nameEnd = name.indexOf(0);
+      const data = {
+        version: v.getUint32(4, true),
+        running: (flags & 1) !== 0,
+        armed: (flags & 2) !== 0,
+        power: (flags & 4) ? 'idle' : 'awake',
+        phase: (flags & 8) ? 'rest' : 'work',
+        mode: textDecoder.decode(name.subarray(0, nameEnd < 0 ? 12 : nameEnd)),
+        time_left_ms: v.getUint32(20, true),
+        hits: v.getUint32(24, true),
+        tempo_hpm: v.getUint16(28, true),
+        tempo_avg_hpm: v.getUint16(30, true),
+        series: v.getUint16(32, true),
+        maxSeries: v.getUint16(34, true),
+        lastPeak: v.getUint16(36, true),
+        lastScore: v.getUint16(38, true),
+        bestPeak: v.getUint16(40, true),
+        bestScore: v.getUint16(42, true),
+        last_interval_us: v.getUint32(44, true),
+        phase_index: v.getUint8(48),
+        phase_count: v.getUint8(49),
+        round: v.getUint8(50),
+        rounds: v.getUint8(51),
+        phase_left_ms: v.getUint32(52, true),
+        phase_hits: v.getUint16(56, true),
+        phase_target: v.getUint16(58, true),
+        round_seq: v.getUint32(60, true),
+        athlete: v.getInt8(64),
+      };
+      const count = v.getUint8(65);
+      for (let i = 0; i < count && i < configKeys.length && 68 + 2 * i <= v.byteLength; i++) {
+        data[configKeys[i]] = v.getInt16(66 + 2 * i, true);
+      }
+      let at = 66 + 2 * count;
+      if (at < v.byteLength) {
+        const classCount = v.getUint8(at++);
+        data.classes = {};
+        for (let k = 0; k < classCount && at + 2 <= v.byteLength; k++, at += 2) {
+          data.classes[classKeys[k] || `class_${k}`] = v.getUint16(at, true);
+        }
+        const last = at < v.byteLength ? v.getInt8(at++) : -1;
+        data.last_class = last >= 0 ? (classKeys[last] || `class_${last}`) : '';
+      }
+      if (at + 3 <= v.byteLength) {
+        data.rejected = v.getUint16(at, true);
+        data.last_match_pct = v.getInt8(at + 2);
+      }
+      return data;
+    }
+
     async function pollStatus() {
       try {
-        const res = await fetch('/api/status', { cache: 'no-store' });
-        const data = await res.json();
+        const params = new URLSearchParams();
+        if (statusVersion !== null) {
+          params.set('since', statusVersion);
+        }
+        if (binaryStatus) {
+          params.set('format', 'bin');
+        }
+        const query = params.toString();
+        const res = await fetch(`/api/status${query ? '?' + query : ''}`, { cache: 'no-store' });
+        if (res.status === 304) {
+          return;
+        }
+        let data;
+        if (binaryStatus) {
+          data = decodeStatusFrame(await res.arrayBuffer());
+          if (!data) {
+            binaryStatus = false;
+            return;
+          }
+        } else {
+          data = await res.json();
+        }
+        statusVersion = data.version;
         updateStatus(data);
       } catch (e) {}
     }
 
     setInterval(pollStatus, 200);
     pollStatus();
+    loadPrograms();
+    loadAthletes();
   </script>
 
 </body>
@@ -385,46 +996,33 @@ const char kIndexHtml[] PROGMEM = R"HTML(
 )HTML";
 
 
-const char *modeToString(Mode mode) {
-  switch (mode) {
-    case MODE_10:
-      return "10";
-    case MODE_20:
-      return "20";
-    case MODE_30:
-      return "30";
-    case MODE_60:
-      return "60";
-    default:
-      return "FREE";
+void logPrintf(const char *fmt, ...) {
+  if (captureDiv != 0) {
+    return;
   }
+  char line[160];
+  va_list args;
+  va_start(args, fmt);
+  vsnprintf(line, sizeof(line), fmt, args);
+  va_end(args);
+  Serial.print(line);
 }
 
-bool parseMode(const String &value, Mode &outMode, uint32_t &outDurationMs) {
-  if (value == "free") {
-    outMode = MODE_FREE;
-    outDurationMs = 0;
-    return true;
-  }
-  if (value == "10") {
-    outMode = MODE_10;
-    outDurationMs = 10000;
-    return true;
-  }
-  if (value == "20") {
-    outMode = MODE_20;
-    outDurationMs = 20000;
-    return true;
-  }
-  if (value == "30") {
-    outMode = MODE_30;
-    outDurationMs = 30000;
-    return true;
-  }
-  if (value == "60") {
-    outMode = MODE_60;
-    outDurationMs = 60000;
-    return true;
+IntervalProgram singlePhaseProgram(const char *name, uint32_t durationMs) {
+  IntervalProgram program = {};
+  programSetName(program, name, strlen(name));
+  program.phaseCount = 1;
+  program.rounds = 1;
+  program.phases[0] = {durationMs, 0, PHASE_WORK, 0};
+  return program;
+}
+
+bool programForMode(const String &value, IntervalProgram &out) {
+  for (const ModePreset &preset : kModePresets) {
+    if (value == preset.mode) {
+      out = singlePhaseProgram(preset.name, preset.durationMs);
+      return true;
+    }
   }
   return false;
 }
@@ -442,89 +1040,240 @@ bool parseIntValue(const String &value, int &out) {
   return true;
 }
 
-bool extractJsonInt(const String &body, const char *key, int &out) {
-  String pattern = String('"') + key + "\":";
-  int idx = body.indexOf(pattern);
-  if (idx < 0) {
-    return false;
+int clampInt(int value, int minValue, int maxValue) {
+  if (value < minValue) {
+    return minValue;
   }
-  int start = idx + pattern.length();
-  while (start < body.length() && (body[start] == ' ' || body[start] == '\t')) {
-    start++;
+  if (value > maxValue) {
+    return maxValue;
   }
-  int end = start;
-  while (end < body.length() && (body[end] == '-' || (body[end] >= '0' && body[end] <= '9'))) {
-    end++;
+  return value;
+}
+
+int configValue(const Config &c, const ConfigField &field) {
+  if (field.type == CONFIG_BOOL) {
+    return (c.*field.boolMember) ? 1 : 0;
   }
-  if (end == start) {
-    return false;
+  return c.*field.intMember;
+}
+
+void setConfigValue(Config &c, const ConfigField &field, int value) {
+  int next = clampInt(value, field.minValue, field.maxValue);
+  if (field.type == CONFIG_BOOL) {
+    c.*field.boolMember = (next != 0);
+  } else {
+    c.*field.intMember = next;
   }
-  out = body.substring(start, end).toInt();
-  return true;
 }
 
-bool extractJsonBool(const String &body, const char *key, bool &out) {
-  String pattern = String('"') + key + "\":";
-  int idx = body.indexOf(pattern);
-  if (idx < 0) {
-    return false;
+const ConfigField *findConfigField(const JsonSpan &key) {
+  for (size_t i = 0; i < kConfigFieldCount; i++) {
+    if (key.equals(kConfigFields[i].key)) {
+      return &kConfigFields[i];
+    }
   }
-  int start = idx + pattern.length();
-  while (start < body.length() && (body[start] == ' ' || body[start] == '\t')) {
-    start++;
+  return nullptr;
+}
+
+bool parseConfigArg(const ConfigField &field, const String &value, int &out) {
+  if (field.type == CONFIG_BOOL) {
+    out = (value == "1" || value == "true") ? 1 : 0;
+    return true;
   }
-  if (body.startsWith("true", start)) {
-    out = true;
+  return parseIntValue(value, out);
+}
+
+bool parseConfigJson(const ConfigField &field, const JsonMember &member, int &out) {
+  if (member.type == JSON_NUMBER) {
+    if (!jsonSpanToInt(member.value, out)) {
+      return false;
+    }
+    if (field.type == CONFIG_BOOL) {
+      out = (out != 0) ? 1 : 0;
+    }
     return true;
   }
-  if (body.startsWith("false", start)) {
-    out = false;
+  if (field.type == CONFIG_BOOL && (member.type == JSON_TRUE || member.type == JSON_FALSE)) {
+    out = (member.type == JSON_TRUE) ? 1 : 0;
     return true;
   }
-  int val = 0;
-  int end = start;
-  while (end < body.length() && (body[end] >= '0' && body[end] <= '9')) {
-    end++;
+  return false;
+}
+
+// Writes only the settings that differ from the current config, then adopts
+// next. Returns the number of keys written.
+size_t saveConfig(const Config &next) {
+  StallScope flash(stallWatch, STAGE_FLASH);
+  size_t written = 0;
+  for (size_t i = 0; i < kConfigFieldCount; i++) {
+    const ConfigField &field = kConfigFields[i];
+    int value = configValue(next, field);
+    if (value == configValue(config, field)) {
+      continue;
+    }
+    if (field.type == CONFIG_BOOL) {
+      prefs.putBool(field.nvsKey, value != 0);
+    } else {
+      prefs.putInt(field.nvsKey, value);
+    }
+    written++;
+  }
+  config = next;
+  return written;
+}
+
+void loadConfig() {
+  prefs.begin("kickshield", false);
+  for (size_t i = 0; i < kConfigFieldCount; i++) {
+    const ConfigField &field = kConfigFields[i];
+    int value = (field.type == CONFIG_BOOL)
+                    ? (prefs.getBool(field.nvsKey, field.defaultValue != 0) ? 1 : 0)
+                    : prefs.getInt(field.nvsKey, field.defaultValue);
+    setConfigValue(config, field, value);
+  }
+}
+
+IntervalProgram defaultProgram(uint8_t slot) {
+  IntervalProgram program = {};
+  const char *name = nullptr;
+  const char *spec = nullptr;
+  uint8_t rounds = 1;
+  if (slot == 0) {
+    name = "TABATA";
+    spec = "w20000,r10000";
+    rounds = 8;
+  } else if (slot == 1) {
+    name = "PYRAMID";
+    spec = "w10000,r10000,w20000,r10000,w30000,r10000,w20000,r10000,w10000";
+  }
+  if (spec != nullptr) {
+    programSetName(program, name, strlen(name));
+    program.rounds = rounds;
+    parsePhaseSpec(spec, strlen(spec), program);
+  }
+  return program;
+}
+
+void programKey(uint8_t slot, char *out, size_t size) {
+  snprintf(out, size, "prog%u", slot);
+}
+
+void loadPrograms() {
+  for (uint8_t slot = 0; slot < kProgramSlots; slot++) {
+    char key[8];
+    programKey(slot, key, sizeof(key));
+    IntervalProgram &program = programs[slot];
+    if (prefs.getBytes(key, &program, sizeof(program)) != sizeof(program) || !programValid(program)) {
+      program = defaultProgram(slot);
+    }
   }
-  if (end == start) {
+}
+
+// Stores a slot only if it changed; phaseCount 0 clears it.
+bool saveProgram(uint8_t slot, const IntervalProgram &program) {
+  if (memcmp(&programs[slot], &program, sizeof(program)) == 0) {
     return false;
   }
-  val = body.substring(start, end).toInt();
-  out = (val != 0);
+  char key[8];
+  programKey(slot, key, sizeof(key));
+  StallScope flash(stallWatch, STAGE_FLASH);
+  prefs.putBytes(key, &program, sizeof(program));
+  programs[slot] = program;
   return true;
 }
 
-int clampInt(int value, int minValue, int maxValue) {
-  if (value < minValue) {
-    return minValue;
+void athleteKey(uint8_t slot, char *out, size_t size) {
+  snprintf(out, size, "ath%u", slot);
+}
+
+void loadAthletes() {
+  for (uint8_t slot = 0; slot < kAthleteMax; slot++) {
+    char key[8];
+    athleteKey(slot, key, sizeof(key));
+    AthleteRecord record;
+    if (prefs.getBytes(key, &record, sizeof(record)) == sizeof(record)) {
+      athletes.load(slot, record);
+    }
   }
-  if (value > maxValue) {
-    return maxValue;
+}
+
+void saveAthlete(uint8_t slot) {
+  StallScope flash(stallWatch, STAGE_FLASH);
+  char key[8];
+  athleteKey(slot, key, sizeof(key));
+  if (athletes.used(slot)) {
+    prefs.putBytes(key, &athletes.record(slot), sizeof(AthleteRecord));
+  } else {
+    prefs.remove(key);
   }
-  return value;
 }
 
-void saveConfig() {
-  prefs.putInt("threshold", config.threshold);
-  prefs.putInt("lockout_ms", config.lockoutMs);
-  prefs.putInt("series_gap_ms", config.seriesGapMs);
-  prefs.putInt("sample_window_ms", config.sampleWindowMs);
-  prefs.putBool("simulate", config.simulate);
+void loadTemplates() {
+  MatchBank bank;
+  if (prefs.getBytes("templates", &bank, sizeof(bank)) == sizeof(bank)) {
+    matcher.load(bank);
+  }
 }
 
-void loadConfig() {
-  prefs.begin("kickshield", false);
-  config.threshold = prefs.getInt("threshold", kDefaultThreshold);
-  config.lockoutMs = prefs.getInt("lockout_ms", kDefaultLockoutMs);
-  config.seriesGapMs = prefs.getInt("series_gap_ms", kDefaultSeriesGapMs);
-  config.sampleWindowMs = prefs.getInt("sample_window_ms", kDefaultSampleWindowMs);
-  config.simulate = prefs.getBool("simulate", false);
+void saveTemplates() {
+  StallScope flash(stallWatch, STAGE_FLASH);
+  prefs.putBytes("templates", &matcher.bank(), sizeof(MatchBank));
+  templatesChanged = false;
+}
+
+void markStateChanged() {
+  stateVersion++;
+}
+
+void applyStallBudgets() {
+  stallWatch.setBudget(STAGE_SAMPLE, config.stallSampleMs == 0 ? 0 : config.sampleWindowMs + config.stallSampleMs);
+  stallWatch.setBudget(STAGE_HTTP, config.stallHttpMs);
+  stallWatch.setBudget(STAGE_SESSION, config.stallSessionMs);
+  stallWatch.setBudget(STAGE_FLASH, config.stallFlashMs);
+}
+
+// A warm reset keeps the RTC ring, including a stall that never ended;
+// after a power cycle the NVS copy stands in.
+void setupStallWatch() {
+  bootId = prefs.getULong("boot", 0) + 1;
+  prefs.putULong("boot", bootId);
+  bool retained = stallRingValid(stallRing);
+  if (!retained) {
+    prefs.getBytes("stalls", &stallRing, sizeof(stallRing));
+  }
+  stallWatch.begin(&stallRing, bootId);
+  applyStallBudgets();
+  if (retained) {
+    prefs.putBytes("stalls", &stallRing, sizeof(stallRing));
+  }
+  logPrintf("Stall watch: boot %lu, %u recorded, %s\n", static_cast<unsigned long>(bootId), stallRing.count,
+            retained ? "kept over reset" : "from NVS");
+}
+
+// Runs between loop stages: logs stalls once they have ended and persists
+// the ring at most every kStallSaveMinMs. The save is deliberately outside
+// any stage: a slow write recorded as a flash stall would close another
+// stall, and that one's save could stall again, without end.
+void tickStallWatch() {
+  uint32_t closed = stallWatch.closed();
+  if (closed != stallsLogged) {
+    stallsLogged = closed;
+    const StallRecord &r = stallWatch.recent(0);
+    logPrintf("Stall: %s %lums (budget %ums)\n", r.stage < STAGE_COUNT ? kStageNames[r.stage] : "?",
+              static_cast<unsigned long>(r.durationMs), r.budgetMs);
+  }
+  uint32_t now = millis();
+  if (closed == stallsSaved || now - stallsSavedMs < kStallSaveMinMs) {
+    return;
+  }
+  stallsSaved = closed;
+  stallsSavedMs = now;
+  prefs.putBytes("stalls", &stallRing, sizeof(stallRing));
 }
 
 void resetSessionMetrics() {
   hits = 0;
-  lastHitMs = 0;
-  lockoutUntil = 0;
+  lastHitUs = sessionStartUs;
   series = 0;
   maxSeries = 0;
   lastPeak = 0;
@@ -533,7 +1282,11 @@ void resetSessionMetrics() {
   bestScore = 0;
   hitIndex = 0;
   hitCount = 0;
-  memset(hitTimes, 0, sizeof(hitTimes));
+  memset(hitIntervalsUs, 0, sizeof(hitIntervalsUs));
+  memset(classCounts, 0, sizeof(classCounts));
+  lastClass = -1;
+  rejectedHits = 0;
+  lastMatchPct = -1;
 }
 
 int scoreFromPeak(int peak) {
@@ -548,66 +1301,99 @@ int scoreFromPeak(int peak) {
   return clampInt(static_cast<int>(scaled), 0, 999);
 }
 
-uint32_t tempoHpm(uint32_t nowMs) {
-  uint32_t elapsed = nowMs - sessionStartMs;
-  uint32_t window = elapsed < kTempoWindowMs ? elapsed : kTempoWindowMs;
-  if (window == 0) {
-    return 0;
-  }
-  uint32_t since = nowMs - window;
-  uint32_t count = 0;
-  for (uint8_t i = 0; i < kHitHistoryMax; i++) {
-    uint32_t t = hitTimes[i];
-    if (t != 0 && t >= since) {
-      count++;
-    }
+uint64_t nowUs() {
+  return static_cast<uint64_t>(esp_timer_get_time());
+}
+
+uint32_t saturateUs(uint64_t us) {
+  return us > UINT32_MAX ? UINT32_MAX : static_cast<uint32_t>(us);
+}
+
+// Runs in the esp_timer task: only stamps the time and raises the flags.
+// A late tick of a session that was already stopped is ignored by loop().
+void onSessionEnd(void *) {
+  sessionEndFiredAt.store(static_cast<uint32_t>(nowUs()));
+  sessionEndFired.store(true);
+  sessionEndDue.store(true);
+}
+
+void setupSessionTimer() {
+  esp_timer_create_args_t args = {};
+  args.callback = &onSessionEnd;
+  args.dispatch_method = ESP_TIMER_TASK;
+  args.name = "session_end";
+  if (esp_timer_create(&args, &sessionTimer) != ESP_OK) {
+    logPrintf("Session timer unavailable; timed sessions end from loop()\n");
   }
-  return (count * 60000UL) / window;
 }
 
-uint32_t tempoFromSession(uint32_t endMs) {
-  if (hits == 0 || sessionStartMs == 0) {
-    return 0;
+void armSessionTimer() {
+  if (sessionTimer == nullptr) {
+    return;
   }
-  uint32_t duration = (endMs > sessionStartMs) ? (endMs - sessionStartMs) : 0;
-  if (duration == 0) {
-    return 0;
+  esp_timer_stop(sessionTimer);
+  sessionEndDue.store(false);
+  sessionEndFired.store(false);
+  uint64_t now = nowUs();
+  if (sessionEndUs != 0) {
+    esp_timer_start_once(sessionTimer, sessionEndUs > now ? sessionEndUs - now : 1);
   }
-  return (hits * 60000UL) / duration;
 }
 
-uint32_t tempoAvgNow(uint32_t nowMs) {
-  if (hits == 0 || sessionStartMs == 0) {
+// esp_timer never fires early, so this is how late the end tick came.
+uint32_t endSkewUs() {
+  if (sessionEndUs == 0 || !sessionEndFired.load()) {
     return 0;
   }
-  uint32_t duration = nowMs - sessionStartMs;
-  if (duration == 0) {
+  return sessionEndFiredAt.load() - static_cast<uint32_t>(sessionEndUs);
+}
+
+// Hits per minute over the last kTempoWindowUs (or the session so far).
+uint32_t tempoHpm(uint64_t now) {
+  uint64_t elapsed = now - sessionStartUs;
+  uint64_t window = elapsed < kTempoWindowUs ? elapsed : kTempoWindowUs;
+  if (window == 0) {
     return 0;
   }
-  return (hits * 60000UL) / duration;
-}
-
-int readPeak() {
-  uint32_t startUs = micros();
-  uint32_t windowUs = static_cast<uint32_t>(config.sampleWindowMs) * 1000UL;
-  uint32_t lastSampleUs = startUs;
-  int peak = 0;
-  while (micros() - startUs < windowUs) {
-    uint32_t nowUs = micros();
-    if (nowUs - lastSampleUs >= kSampleIntervalUs) {
-      lastSampleUs = nowUs;
-      int value = analogRead(kAdcPin);
-      if (value > peak) {
-        peak = value;
-      }
-    }
+  uint64_t age = now - lastHitUs;
+  uint32_t count = 0;
+  uint8_t slot = hitIndex;
+  while (count < hitCount && age <= window) {
+    count++;
+    slot = (slot + kHitHistoryMax - 1) % kHitHistoryMax;
+    age += hitIntervalsUs[slot];
+  }
+  return static_cast<uint32_t>(count * 60000000ULL / window);
+}
+
+uint32_t tempoOver(uint64_t duration) {
+  if (hits == 0 || duration == 0) {
+    return 0;
   }
-  return peak;
+  return static_cast<uint32_t>(hits * 60000000ULL / duration);
+}
+
+uint32_t tempoFromSession(uint64_t end) {
+  return tempoOver(end > sessionStartUs ? end - sessionStartUs : 0);
 }
 
-void recordHit(uint32_t nowMs, int peak, int score) {
+uint32_t tempoAvgNow(uint64_t now) {
+  return tempoOver(now - sessionStartUs);
+}
+
+uint32_t lastHitIntervalUs() {
+  return hitCount > 1 ? hitIntervalsUs[(hitIndex + kHitHistoryMax - 1) % kHitHistoryMax] : 0;
+}
+
+void recordHit(uint64_t atUs, int peak, int score) {
+  // The runner assigns the hit to its phase by timestamp; hits after the
+  // program's last boundary belong to no session.
+  if (!runner.recordHit(atUs, peak)) {
+    return;
+  }
+  uint32_t intervalUs = saturateUs(atUs - lastHitUs);
   hits++;
-  if (nowMs - lastHitMs <= static_cast<uint32_t>(config.seriesGapMs)) {
+  if (hits > 1 && intervalUs <= static_cast<uint32_t>(config.seriesGapMs) * 1000UL) {
     series++;
   } else {
     series = 1;
@@ -615,8 +1401,7 @@ void recordHit(uint32_t nowMs, int peak, int score) {
   if (series > maxSeries) {
     maxSeries = series;
   }
-  lastHitMs = nowMs;
-  lockoutUntil = nowMs + static_cast<uint32_t>(config.lockoutMs);
+  lastHitUs = atUs;
   lastPeak = peak;
   lastScore = score;
   if (peak > bestPeak) {
@@ -625,218 +1410,1222 @@ void recordHit(uint32_t nowMs, int peak, int score) {
   if (score > bestScore) {
     bestScore = score;
   }
-  hitTimes[hitIndex] = nowMs;
+  markStateChanged();
+  hitIntervalsUs[hitIndex] = intervalUs;
   hitIndex = (hitIndex + 1) % kHitHistoryMax;
   if (hitCount < kHitHistoryMax) {
     hitCount++;
   }
-  Serial.printf("Hit peak=%d score=%d hits=%lu series=%lu\n",
+  logPrintf("Hit peak=%d score=%d hits=%lu series=%lu\n",
                 peak, score, static_cast<unsigned long>(hits),
                 static_cast<unsigned long>(series));
 }
 
-void processSensor() {
-  int peak = readPeak();
-  uint32_t nowMs = millis();
-  if (peak > config.threshold && nowMs > lockoutUntil) {
-    int score = scoreFromPeak(peak);
-    recordHit(nowMs, peak, score);
-  }
+void configureDetector() {
+  StrikeDetectorConfig detectorConfig;
+  detectorConfig.threshold = config.threshold;
+  detectorConfig.lockoutMs = static_cast<uint32_t>(config.lockoutMs);
+  detectorConfig.windowSamples = static_cast<uint32_t>(config.sampleWindowMs) * 1000UL / kSampleIntervalUs;
+  detector.configure(detectorConfig);
 }
 
-void processSimulation() {
-  uint32_t nowMs = millis();
-  if (nowMs < nextSimMs) {
-    return;
-  }
-  if (nowMs <= lockoutUntil) {
-    nextSimMs = lockoutUntil + 1;
-    return;
-  }
-  int maxPeak = clampInt(config.threshold + 800, 0, 4095);
-  int peak = random(config.threshold + 50, maxPeak + 1);
-  int score = scoreFromPeak(peak);
-  recordHit(nowMs, peak, score);
-  nextSimMs = nowMs + static_cast<uint32_t>(random(200, 600));
+// Simulate mode swaps the ADC for synthetic strike waveforms; everything
+// downstream (decimation, window peak, threshold, lockout, scoring) is the
+// same code. The generator runs at the raw, oversampled rate.
+void resetSynthSource() {
+  SynthStrikeConfig synthConfig;
+  synthConfig.sampleRateHz = 1000000UL / kSampleIntervalUs * kOversampleRatio;
+  synthConfig.hitsPerMinute = static_cast<uint32_t>(config.simRateHpm);
+  synthConfig.noise = static_cast<uint16_t>(config.simNoise);
+  synthConfig.bouncePct = static_cast<uint8_t>(config.simBouncePct);
+  synthConfig.disturbPerMinute = static_cast<uint32_t>(config.simDisturbPm);
+  synthConfig.seed = esp_random();
+  synthSource.reset(synthConfig);
 }
 
-void startSession(Mode mode, uint32_t durationMs) {
-  currentMode = mode;
-  sessionDurationMs = durationMs;
-  sessionStartMs = millis();
-  sessionStopMs = 0;
-  resetSessionMetrics();
-  running = true;
-  nextSimMs = sessionStartMs + 200;
-  Serial.printf("Session start mode=%s\n", modeToString(mode));
+SampleSource &sensorInput() {
+  return config.simulate ? static_cast<SampleSource &>(synthInput) : adcInput;
 }
 
-void stopSession() {
-  running = false;
-  sessionStopMs = millis();
-  Serial.println("Session stop");
+void countStrike(const Strike &strike) {
+  recordHit(strike.atUs, strike.peak, scoreFromPeak(strike.peak));
+  if (captureDiv != 0) {
+    capture.pushHit(strike.peak);
+  }
 }
 
-void handleRoot() {
-  server.send_P(200, "text/html", kIndexHtml);
+void countStrikeClass(const StrikeFeatures &features) {
+  StrikeClass k = classifyStrike(kStrikeModel, features);
+  classCounts[k]++;
+  lastClass = static_cast<int8_t>(k);
+  markStateChanged();
 }
 
-void handleStatus() {
-  uint32_t nowMs = millis();
-  uint32_t timeLeft = 0;
-  if (running && sessionDurationMs > 0) {
-    uint32_t elapsed = nowMs - sessionStartMs;
-    timeLeft = (elapsed >= sessionDurationMs) ? 0 : (sessionDurationMs - elapsed);
-  }
-  uint32_t tempoInstant = running ? tempoHpm(nowMs) : tempoFromSession(sessionStopMs);
-  uint32_t tempoAvg = running ? tempoAvgNow(nowMs) : tempoFromSession(sessionStopMs);
-  String json = "{";
-  json += "\"running\":" + String(running ? "true" : "false");
-  json += ",\"mode\":\"" + String(modeToString(currentMode)) + "\"";
-  json += ",\"time_left_ms\":" + String(timeLeft);
-  json += ",\"hits\":" + String(hits);
-  json += ",\"tempo_hpm\":" + String(tempoInstant);
-  json += ",\"tempo_avg_hpm\":" + String(tempoAvg);
-  json += ",\"series\":" + String(series);
-  json += ",\"maxSeries\":" + String(maxSeries);
-  json += ",\"lastPeak\":" + String(lastPeak);
-  json += ",\"lastScore\":" + String(lastScore);
-  json += ",\"bestPeak\":" + String(bestPeak);
-  json += ",\"bestScore\":" + String(bestScore);
-  json += ",\"threshold\":" + String(config.threshold);
-  json += ",\"lockout_ms\":" + String(config.lockoutMs);
-  json += ",\"series_gap_ms\":" + String(config.seriesGapMs);
-  json += ",\"sample_window_ms\":" + String(config.sampleWindowMs);
-  json += ",\"simulate\":" + String(config.simulate ? 1 : 0);
-  json += "}";
-  server.send(200, "application/json", json);
+// Hands a window to diagTask if its slot is free.
+bool sendDiagWindow(DiagSlot &slot, const int16_t *samples, uint32_t rateHz) {
+  if (slot.state.load() != DIAG_EMPTY) {
+    return false;
+  }
+  memcpy(slot.samples, samples, sizeof(slot.samples));
+  slot.rateHz = rateHz;
+  slot.run = diagRun.load();
+  slot.state.store(DIAG_FULL);
+  return true;
 }
 
-void handleStart() {
-  String modeArg = server.arg("mode");
-  Mode mode;
-  uint32_t durationMs = 0;
-  if (!parseMode(modeArg, mode, durationMs)) {
-    server.send(400, "application/json", "{\"error\":\"invalid mode\"}");
-    return;
-  }
-  startSession(mode, durationMs);
-  server.send(200, "application/json", "{\"ok\":true}");
+void restartDiagNoise() {
+  diagNoiseFill = 0;
+  diagDecimSum = 0;
+  diagDecimFill = 0;
+  diagQuiet = 0;
 }
 
-void handleStop() {
-  stopSession();
-  server.send(200, "application/json", "{\"ok\":true}");
+void collectDiagStrike() {
+  if (!diagActive || diagStrikesSent >= diagWanted) {
+    return;
+  }
+  int16_t window[kDiagFftSize];
+  strikeFeatures.copyAround(window, kStrikeLead, kDiagFftSize);
+  diagStrikesSent += sendDiagWindow(diagStrikeSlot, window, kSampleRateHz) ? 1 : 0;
 }
 
-void handleConfig() {
-  bool changed = false;
-  if (server.hasArg("threshold")) {
-    int value = 0;
-    if (parseIntValue(server.arg("threshold"), value)) {
-      int next = clampInt(value, 0, 4095);
-      if (next != config.threshold) {
-        config.threshold = next;
-        changed = true;
-      }
+void collectDiagNoise(int sample) {
+  if (!diagActive || diagNoiseSent >= diagWanted) {
+    return;
+  }
+  if (diagQuiet < kDiagQuietMs * kSampleRateHz / 1000) {
+    diagQuiet++;
+    return;
+  }
+  if (diagNoiseFill < kDiagFftSize) {
+    diagDecimSum += sample;
+    if (++diagDecimFill < kDiagNoiseDecimation) {
+      return;
     }
+    diagNoise[diagNoiseFill++] = static_cast<int16_t>(diagDecimSum / kDiagNoiseDecimation);
+    diagDecimSum = 0;
+    diagDecimFill = 0;
+    diagHold = kDiagHoldWindows * detector.windowSamples();
+    return;
   }
-  if (server.hasArg("lockout_ms")) {
-    int value = 0;
-    if (parseIntValue(server.arg("lockout_ms"), value)) {
-      int next = clampInt(value, 0, 5000);
-      if (next != config.lockoutMs) {
-        config.lockoutMs = next;
-        changed = true;
+  if (--diagHold > 0) {
+    return;
+  }
+  diagNoiseSent += sendDiagWindow(diagNoiseSlot, diagNoise, kSampleRateHz / kDiagNoiseDecimation) ? 1 : 0;
+  diagNoiseFill = 0;
+}
+
+// Checks the held strike against the templates, or learns from it, and
+// counts it if it passes. At the session end its tail may be short.
+void settleStrike() {
+  strikeHeld = false;
+  int16_t window[kMatchWindow];
+  strikeFeatures.copyAround(window, kMatchLead + kMatchLag, kMatchWindow);
+  if (matcher.learningSlot() >= 0) {
+    int slot = matcher.learningSlot();
+    if (matcher.learn(window)) {
+      templatesChanged = true;
+      logPrintf("Template %d learned\n", slot);
+    }
+    markStateChanged();
+    countStrike(heldStrike);
+    return;
+  }
+  lastMatchPct = matcher.best(window);
+  if (config.matchPct > 0 && lastMatchPct >= 0 && lastMatchPct < config.matchPct) {
+    rejectedHits++;
+    strikeFeatures.cancel();
+    markStateChanged();
+    logPrintf("Rejected peak=%d match=%d%%\n", heldStrike.peak, lastMatchPct);
+    return;
+  }
+  countStrike(heldStrike);
+}
+
+// A strike the tracker cannot place (too close to the session start or to
+// the strike before) has no window to check and counts at once.
+void holdStrike(const Strike &strike) {
+  if (!strikeFeatures.mark(detector.windowSamples())) {
+    countStrike(strike);
+    return;
+  }
+  heldStrike = strike;
+  strikeHeld = true;
+  if (strikeFeatures.sinceMark() >= kMatchTail) {
+    settleStrike();
+  }
+}
+
+// Samples one detector window at kSampleIntervalUs, or up to the end of a
+// timed session: nothing is read at or past sessionEndUs, and a window cut
+// short there still counts the strike it holds. A strike held for its
+// template check keeps the loop sampling (at most kMatchTail samples), so
+// it is settled before the loop moves the program past a phase boundary.
+void processSensor() {
+  StallScope stage(stallWatch, STAGE_SAMPLE);
+  SampleSource &source = sensorInput();
+  uint32_t remaining = detector.windowSamples();
+  uint64_t lastSampleUs = nowUs() - kSampleIntervalUs;
+  if (!sessionSampled) {
+    sessionSampled = true;
+    startSkewUs = saturateUs(nowUs() - sessionStartUs);
+  }
+  while (remaining > 0 || strikeHeld) {
+    uint64_t sampleUs = nowUs();
+    if (sampleUs - lastSampleUs < kSampleIntervalUs) {
+      continue;
+    }
+    Strike strike;
+    if (sessionEndUs != 0 && sampleUs >= sessionEndUs) {
+      StrikeFeatures features;
+      if (detector.flush(sampleUs, strike)) {
+        holdStrike(strike);
+      }
+      if (strikeHeld) {
+        settleStrike();
+      }
+      if (strikeFeatures.finish(features)) {
+        countStrikeClass(features);
       }
+      return;
+    }
+    lastSampleUs = sampleUs;
+    remaining -= remaining > 0 ? 1 : 0;
+    int sample = source.read();
+    if (captureDiv != 0) {
+      capture.push(sample);
+    }
+    StrikeFeatures features;
+    if (strikeFeatures.push(sample, features)) {
+      countStrikeClass(features);
+      collectDiagStrike();
+    }
+    if (strikeHeld && strikeFeatures.sinceMark() >= kMatchTail) {
+      settleStrike();
+    }
+    if (detector.push(sample, sampleUs, strike)) {
+      holdStrike(strike);
+      restartDiagNoise();
+    } else {
+      collectDiagNoise(sample);
     }
   }
-  if (server.hasArg("series_gap_ms")) {
-    int value = 0;
-    if (parseIntValue(server.arg("series_gap_ms"), value)) {
-      int next = clampInt(value, 0, 10000);
-      if (next != config.seriesGapMs) {
-        config.seriesGapMs = next;
-        changed = true;
+}
+
+// An armed start keeps the generator running: it holds the strike that
+// tripped the watch.
+void startSession(const IntervalProgram &program, int athlete, bool restartSynth = true) {
+  sessionStartUs = nowUs();
+  sessionAthlete = athlete;
+  sessionStopUs = 0;
+  uint64_t durationUs = programDurationUs(program);
+  sessionEndUs = durationUs ? sessionStartUs + durationUs : 0;
+  sessionSampled = false;
+  startSkewUs = 0;
+  stopLagUs = 0;
+  armSessionTimer();
+  runner.start(program, sessionStartUs);
+  resetSessionMetrics();
+  configureDetector();
+  detector.reset();
+  strikeFeatures.reset();
+  strikeHeld = false;
+  restartDiagNoise();
+  if (config.simulate && restartSynth) {
+    resetSynthSource();
+  }
+  running = true;
+  markStateChanged();
+  logPrintf("Session start program=%s rounds=%u phases=%u athlete=%d\n", program.name, program.rounds,
+                program.phaseCount, athlete);
+}
+
+// Called between sample windows, never inside one.
+void logNewRounds() {
+  for (uint8_t i = 0; i < runner.summaryCount(); i++) {
+    const RoundSummary &r = runner.summary(i);
+    if (r.seq <= roundsLogged) {
+      continue;
+    }
+    logPrintf("Round %u%s: hits=%lu/%lu rest_hits=%lu work=%lums best_peak=%d\n", r.round,
+                  r.complete ? "" : " (partial)", static_cast<unsigned long>(r.hits),
+                  static_cast<unsigned long>(r.targetHits), static_cast<unsigned long>(r.restHits),
+                  static_cast<unsigned long>(r.workMs), r.bestPeak);
+  }
+  roundsLogged = runner.lastSummarySeq();
+}
+
+// The only place athlete records change, so NVS is written once per session
+// and never from the sampling path.
+void recordAthleteSession(uint64_t atUs) {
+  if (!athletes.used(static_cast<uint8_t>(sessionAthlete))) {
+    return;
+  }
+  uint8_t slot = static_cast<uint8_t>(sessionAthlete);
+  SessionResult result;
+  result.hits = hits;
+  result.durationMs = static_cast<uint32_t>((atUs - sessionStartUs) / 1000);
+  result.maxSeries = maxSeries;
+  result.tempoHpm = tempoFromSession(atUs);
+  result.bestPeak = bestPeak;
+  result.bestScore = bestScore;
+  athletes.applySession(slot, result);
+  saveAthlete(slot);
+  logPrintf("Athlete %s: sessions=%u best_score=%u best_peak=%u\n", athletes.record(slot).name,
+            athletes.record(slot).sessions, athletes.record(slot).bestScore, athletes.record(slot).bestPeak);
+}
+
+// atUs is the stop time: the program's final boundary for timed programs.
+void stopSession(uint64_t atUs) {
+  if (sessionTimer != nullptr) {
+    esp_timer_stop(sessionTimer);
+  }
+  if (strikeHeld) {
+    settleStrike();
+  }
+  StrikeFeatures features;
+  if (strikeFeatures.finish(features)) {
+    countStrikeClass(features);
+  }
+  runner.stop(atUs);
+  running = false;
+  sessionStopUs = atUs;
+  if (sessionEndUs != 0 && atUs >= sessionEndUs) {
+    stopLagUs = saturateUs(nowUs() - sessionEndUs);
+  }
+  markStateChanged();
+  logNewRounds();
+  if (sessionAthlete >= 0) {
+    recordAthleteSession(atUs);
+  }
+  if (templatesChanged) {
+    saveTemplates();
+  }
+  if (captureDiv != 0) {
+    capture.flush();
+  }
+  // The idle countdown starts from the end of the session.
+  lastActivityUs = nowUs();
+  logPrintf("Session stop\n");
+}
+
+void setPowerState(PowerState next, uint64_t now) {
+  if (next == powerState) {
+    return;
+  }
+  (powerState == POWER_IDLE ? idleUs : awakeUs) += now - powerStateSinceUs;
+  powerState = next;
+  powerStateSinceUs = now;
+  setCpuFrequencyMhz(next == POWER_IDLE ? kIdleCpuMhz : kActiveCpuMhz);
+  markStateChanged();
+}
+
+// Runs before every request handler.
+void noteActivity() {
+  uint64_t now = nowUs();
+  lastActivityUs = now;
+  if (powerState == POWER_IDLE) {
+    httpWakes++;
+    setPowerState(POWER_AWAKE, now);
+    logPrintf("Wake: http\n");
+  }
+}
+
+// Half the strike threshold: the rising edge of an impact trips the watch
+// early enough for the full-rate detector to catch the peak.
+int wakeLevel() {
+  return config.threshold / 2;
+}
+
+// One sensor check between idle waits. An impact wakes the shield and starts
+// an armed session; the tripping sample opens its first detector window.
+void watchSensor(uint64_t now) {
+  StallScope stage(stallWatch, STAGE_SAMPLE);
+  // The generator counts samples, not time; in simulate mode it is stepped
+  // through the samples since the last check so its strikes keep their rate.
+  uint64_t steps = (now - lastWatchUs) / kSampleIntervalUs;
+  if (!config.simulate || steps == 0 || steps > kWatchCatchUpMax) {
+    steps = 1;
+  }
+  lastWatchUs = now;
+  SampleSource &source = sensorInput();
+  int sample = 0;
+  while (steps-- > 0) {
+    sample = source.read();
+  }
+  if (sample < wakeLevel()) {
+    return;
+  }
+  lastActivityUs = now;
+  if (powerState == POWER_IDLE) {
+    impactWakes++;
+    setPowerState(POWER_AWAKE, now);
+    logPrintf("Wake: impact level=%d\n", sample);
+  }
+  if (armed) {
+    armed = false;
+    startSession(armedProgram, armedAthlete, false);
+    Strike strike;
+    StrikeFeatures features;
+    strikeFeatures.push(sample, features);
+    detector.push(sample, sessionStartUs, strike);
+    sessionSampled = true;
+  }
+}
+
+// Loop body while no session runs. Watching costs one read per
+// kIdleWatchMs, so it only runs when a session is armed or the shield idles.
+void idleStep() {
+  uint64_t now = nowUs();
+  if (powerState == POWER_AWAKE && config.idleAfterS > 0 &&
+      now - lastActivityUs >= static_cast<uint64_t>(config.idleAfterS) * 1000000) {
+    setPowerState(POWER_IDLE, now);
+    logPrintf("Idle\n");
+  }
+  if (!armed && powerState == POWER_AWAKE) {
+    delay(5);
+    return;
+  }
+  watchSensor(now);
+  if (running) {
+    return;
+  }
+  if (powerState == POWER_IDLE) {
+    uint64_t start = nowUs();
+    delay(kIdleWatchMs);
+    idleWaitUs += nowUs() - start;
+  } else {
+    delay(kIdleWatchMs);
+  }
+}
+
+void handleRoot() {
+  server.send_P(200, "text/html", kIndexHtml);
+}
+
+void appendJson(char *out, size_t outSize, size_t &len, const char *fmt, ...) {
+  if (len + 1 >= outSize) {
+    return;
+  }
+  va_list args;
+  va_start(args, fmt);
+  int written = vsnprintf(out + len, outSize - len, fmt, args);
+  va_end(args);
+  if (written > 0) {
+    len = (len + written < outSize) ? len + written : outSize - 1;
+  }
+}
+
+uint32_t msUntil(uint64_t now, uint64_t atUs) {
+  return atUs > now ? static_cast<uint32_t>((atUs - now) / 1000) : 0;
+}
+
+// The clock-driven status fields, shared by the JSON and binary encodings.
+struct StatusTimes {
+  uint32_t timeLeftMs;
+  uint32_t phaseLeftMs;
+  uint32_t tempoInstant;
+  uint32_t tempoAvg;
+};
+
+StatusTimes statusTimes(uint64_t now) {
+  uint64_t durationUs = programDurationUs(runner.program());
+  StatusTimes t;
+  t.timeLeftMs = (running && durationUs > 0) ? msUntil(now, sessionStartUs + durationUs) : 0;
+  t.phaseLeftMs = (running && runner.phaseEndUs() > 0) ? msUntil(now, runner.phaseEndUs()) : 0;
+  t.tempoInstant = running ? tempoHpm(now) : tempoFromSession(sessionStopUs);
+  t.tempoAvg = running ? tempoAvgNow(now) : tempoFromSession(sessionStopUs);
+  return t;
+}
+
+void buildStatusJson(uint64_t now) {
+  const IntervalProgram &program = runner.program();
+  const ProgramPhase &phase = runner.phase();
+  StatusTimes t = statusTimes(now);
+
+  size_t len = 0;
+  appendJson(statusJson, sizeof(statusJson), len,
+             "{\"version\":%lu,\"running\":%s,\"mode\":\"%s\",\"time_left_ms\":%lu,\"hits\":%lu"
+             ",\"tempo_hpm\":%lu,\"tempo_avg_hpm\":%lu,\"series\":%lu,\"maxSeries\":%lu"
+             ",\"lastPeak\":%d,\"lastScore\":%d,\"bestPeak\":%d,\"bestScore\":%d,\"last_interval_us\":%lu",
+             static_cast<unsigned long>(statusVersion), running ? "true" : "false",
+             program.name[0] ? program.name : "FREE", static_cast<unsigned long>(t.timeLeftMs),
+             static_cast<unsigned long>(hits), static_cast<unsigned long>(t.tempoInstant),
+             static_cast<unsigned long>(t.tempoAvg), static_cast<unsigned long>(series),
+             static_cast<unsigned long>(maxSeries), lastPeak, lastScore, bestPeak, bestScore,
+             static_cast<unsigned long>(lastHitIntervalUs()));
+  appendJson(statusJson, sizeof(statusJson), len,
+             ",\"phase\":\"%s\",\"phase_index\":%u,\"phase_count\":%u,\"phase_left_ms\":%lu"
+             ",\"phase_hits\":%lu,\"phase_target\":%u,\"round\":%u,\"rounds\":%u,\"round_seq\":%lu"
+             ",\"armed\":%s,\"power\":\"%s\",\"athlete\":%d,\"start_skew_us\":%lu,\"end_skew_us\":%lu"
+             ",\"stop_lag_us\":%lu",
+             phase.kind == PHASE_REST ? "rest" : "work", runner.phaseIndex(), program.phaseCount,
+             static_cast<unsigned long>(t.phaseLeftMs), static_cast<unsigned long>(runner.phaseHits()),
+             phase.targetHits, runner.round(), program.rounds,
+             static_cast<unsigned long>(runner.lastSummarySeq()), armed ? "true" : "false",
+             powerState == POWER_IDLE ? "idle" : "awake", sessionAthlete, static_cast<unsigned long>(startSkewUs),
+             static_cast<unsigned long>(endSkewUs()), static_cast<unsigned long>(stopLagUs));
+  for (size_t i = 0; i < kConfigFieldCount; i++) {
+    appendJson(statusJson, sizeof(statusJson), len, ",\"%s\":%d",
+               kConfigFields[i].key, configValue(config, kConfigFields[i]));
+  }
+  for (uint8_t k = 0; k < kStrikeClassCount; k++) {
+    appendJson(statusJson, sizeof(statusJson), len, "%s\"%s\":%lu", k == 0 ? ",\"classes\":{" : ",",
+               kStrikeClassNames[k], static_cast<unsigned long>(classCounts[k]));
+  }
+  appendJson(statusJson, sizeof(statusJson), len, "},\"last_class\":\"%s\",\"rejected\":%lu,\"last_match_pct\":%d}",
+             lastClass >= 0 ? kStrikeClassNames[lastClass] : "", static_cast<unsigned long>(rejectedHits),
+             lastMatchPct);
+  statusJsonLen = len;
+}
+
+// Same fields as buildStatusJson() but the session timing skews, in the
+// status_frame.h layout.
+void buildStatusFrame(uint64_t now) {
+  const IntervalProgram &program = runner.program();
+  const ProgramPhase &phase = runner.phase();
+  StatusTimes t = statusTimes(now);
+  uint8_t flags = (running ? STATUS_RUNNING : 0) | (armed ? STATUS_ARMED : 0) |
+                  (powerState == POWER_IDLE ? STATUS_IDLE : 0) | (phase.kind == PHASE_REST ? STATUS_REST : 0);
+
+  FrameWriter w(statusFrame, sizeof(statusFrame));
+  w.u8(kStatusFrameVersion);
+  w.u8(flags);
+  w.u16(0);  // length, patched below
+  w.u32(statusVersion);
+  w.text(program.name[0] ? program.name : "FREE", kProgramNameMax);
+  w.u32(t.timeLeftMs);
+  w.u32(hits);
+  w.u16Sat(t.tempoInstant);
+  w.u16Sat(t.tempoAvg);
+  w.u16Sat(series);
+  w.u16Sat(maxSeries);
+  w.u16Sat(static_cast<uint32_t>(lastPeak));
+  w.u16Sat(static_cast<uint32_t>(lastScore));
+  w.u16Sat(static_cast<uint32_t>(bestPeak));
+  w.u16Sat(static_cast<uint32_t>(bestScore));
+  w.u32(lastHitIntervalUs());
+  w.u8(runner.phaseIndex());
+  w.u8(program.phaseCount);
+  w.u8(runner.round());
+  w.u8(program.rounds);
+  w.u32(t.phaseLeftMs);
+  w.u16Sat(runner.phaseHits());
+  w.u16(phase.targetHits);
+  w.u32(runner.lastSummarySeq());
+  w.u8(static_cast<uint8_t>(static_cast<int8_t>(sessionAthlete)));
+  w.u8(static_cast<uint8_t>(kConfigFieldCount));
+  for (size_t i = 0; i < kConfigFieldCount; i++) {
+    w.i16Sat(configValue(config, kConfigFields[i]));
+  }
+  w.u8(kStrikeClassCount);
+  for (uint8_t k = 0; k < kStrikeClassCount; k++) {
+    w.u16Sat(classCounts[k]);
+  }
+  w.u8(static_cast<uint8_t>(lastClass));
+  w.u16Sat(rejectedHits);
+  w.u8(static_cast<uint8_t>(static_cast<int8_t>(lastMatchPct)));
+  w.patchU16(2, static_cast<uint16_t>(w.length()));
+  statusFrameLen = w.length();
+  statusFrameFor = statusVersion;
+}
+
+void refreshStatusSnapshot(uint64_t now) {
+  bool fresh = statusValid && statusBuiltFor == stateVersion &&
+               (!running || now - statusBuiltUs < kStatusTickUs);
+  if (fresh) {
+    return;
+  }
+  statusVersion++;
+  statusBuiltFor = stateVersion;
+  statusBuiltUs = now;
+  statusValid = true;
+  buildStatusJson(now);
+}
+
+bool wantsStatusFrame() {
+  if (server.hasArg("format")) {
+    return server.arg("format") == "bin";
+  }
+  String accept = server.header("Accept");
+  return strstr(accept.c_str(), "application/octet-stream") != nullptr;
+}
+
+// GET /api/status[?since=<version>][&format=bin]: 304 when the snapshot is
+// still the one the client already has. The binary frame is built from the
+// same snapshot time, so both encodings agree.
+void handleStatus() {
+  refreshStatusSnapshot(nowUs());
+  if (server.hasArg("since")) {
+    int since = 0;
+    if (parseIntValue(server.arg("since"), since) && static_cast<uint32_t>(since) == statusVersion) {
+      server.send(304);
+      return;
+    }
+  }
+  if (wantsStatusFrame()) {
+    if (statusFrameFor != statusVersion) {
+      buildStatusFrame(statusBuiltUs);
+    }
+    server.send_P(200, "application/octet-stream", reinterpret_cast<const char *>(statusFrame), statusFrameLen);
+    return;
+  }
+  server.send_P(200, "application/json", statusJson, statusJsonLen);
+}
+
+// ?mode=free|10|20|30|60 or ?program=<slot>; sends the 400 itself.
+bool programFromArgs(IntervalProgram &program) {
+  if (server.hasArg("program")) {
+    int slot = -1;
+    if (!parseIntValue(server.arg("program"), slot) || slot < 0 || slot >= kProgramSlots ||
+        programs[slot].phaseCount == 0) {
+      server.send(400, "application/json", "{\"error\":\"invalid program\"}");
+      return false;
+    }
+    program = programs[slot];
+  } else if (!programForMode(server.arg("mode"), program)) {
+    server.send(400, "application/json", "{\"error\":\"invalid mode\"}");
+    return false;
+  }
+  return true;
+}
+
+// Optional &athlete=<slot>; -1 when absent. Sends the 400 itself.
+bool athleteFromArgs(int &athlete) {
+  athlete = -1;
+  if (!server.hasArg("athlete")) {
+    return true;
+  }
+  if (!parseIntValue(server.arg("athlete"), athlete) || athlete < -1 ||
+      (athlete >= 0 && !athletes.used(static_cast<uint8_t>(athlete)))) {
+    server.send(400, "application/json", "{\"error\":\"invalid athlete\"}");
+    return false;
+  }
+  return true;
+}
+
+// POST /api/start?mode=...|program=<slot>[&athlete=<slot>].
+void handleStart() {
+  IntervalProgram program;
+  int athlete = -1;
+  if (!programFromArgs(program) || !athleteFromArgs(athlete)) {
+    return;
+  }
+  armed = false;
+  if (running) {
+    // Close the running session so its athlete keeps the result.
+    stopSession(nowUs());
+  }
+  startSession(program, athlete);
+  server.send(200, "application/json", "{\"ok\":true}");
+}
+
+// POST /api/arm?mode=...|program=<slot>: same arguments as /api/start.
+void handleArm() {
+  IntervalProgram program;
+  int athlete = -1;
+  if (!programFromArgs(program) || !athleteFromArgs(athlete)) {
+    return;
+  }
+  if (running) {
+    server.send(409, "application/json", "{\"error\":\"session running\"}");
+    return;
+  }
+  armedProgram = program;
+  armedAthlete = athlete;
+  armed = true;
+  if (config.simulate) {
+    resetSynthSource();
+  }
+  markStateChanged();
+  logPrintf("Armed program=%s\n", program.name);
+  server.send(200, "application/json", "{\"ok\":true}");
+}
+
+void handleStop() {
+  if (running) {
+    stopSession(nowUs());
+  }
+  if (armed) {
+    armed = false;
+    markStateChanged();
+  }
+  server.send(200, "application/json", "{\"ok\":true}");
+}
+
+// Widest /api/programs entry: longest name and phase spec, every number at
+// its widest.
+const size_t kProgramJsonEntryMax =
+    sizeof(",{\"slot\":9,\"name\":\"\",\"rounds\":99,\"phases\":\"\",\"duration_ms\":18446744073709551615}") - 1 +
+    (kProgramNameMax - 1) + (kPhaseSpecMax - 1);
+const size_t kProgramsJsonMax = sizeof("{\"programs\":[]}") + kProgramSlots * kProgramJsonEntryMax;
+static_assert(kProgramSlots <= 10 && kProgramMaxRounds <= 99, "kProgramJsonEntryMax assumes 1-digit slots, 2-digit rounds");
+
+// GET /api/programs: the stored slots in their text form.
+
+void handlePrograms() {
+  // ~1.1 KB at the worst: kept off the loop stack.
+  static char json[kProgramsJsonMax];
+  size_t len = 0;
+  appendJson(json, sizeof(json), len, "{\"programs\":[");
+  bool first = true;
+  for (uint8_t slot = 0; slot < kProgramSlots; slot++) {
+    const IntervalProgram &program = programs[slot];
+    if (program.phaseCount == 0) {
+      continue;
+    }
+    char spec[kPhaseSpecMax];
+    formatPhaseSpec(program, spec, sizeof(spec));
+    appendJson(json, sizeof(json), len,
+               "%s{\"slot\":%u,\"name\":\"%s\",\"rounds\":%u,\"phases\":\"%s\",\"duration_ms\":%llu}",
+               first ? "" : ",", slot, program.name, program.rounds, spec,
+               static_cast<unsigned long long>(programDurationUs(program) / 1000));
+    first = false;
+  }
+  appendJson(json, sizeof(json), len, "]}");
+  server.send_P(200, "application/json", json, len);
+}
+
+// Program and athlete names: printable, no JSON escapes needed.
+bool nameValid(const char *name, size_t len, size_t size) {
+  if (len == 0 || len >= size) {
+    return false;
+  }
+  for (size_t i = 0; i < len; i++) {
+    unsigned char c = static_cast<unsigned char>(name[i]);
+    if (c < 0x20 || c == '"' || c == '\\') {
+      return false;
+    }
+  }
+  return true;
+}
+
+// POST /api/program?slot=N&name=..&rounds=..&phases=w20000,r10000; name,
+// rounds and phases may also come as a flat JSON body. Missing keys keep the
+// slot's current values; an empty phases value clears the slot.
+void handleProgram() {
+  int slot = -1;
+  bool ok = parseIntValue(server.arg("slot"), slot) && slot >= 0 && slot < kProgramSlots;
+  IntervalProgram next = ok ? programs[slot] : IntervalProgram();
+  bool clear = false;
+
+  auto apply = [&](const JsonSpan &key, const char *value, size_t valueLen) {
+    if (key.equals("name")) {
+      ok = ok && nameValid(value, valueLen, kProgramNameMax);
+      if (ok) {
+        programSetName(next, value, valueLen);
       }
+    } else if (key.equals("rounds")) {
+      int rounds = 0;
+      ok = ok && jsonSpanToInt(JsonSpan{value, valueLen}, rounds) && rounds > 0 && rounds <= kProgramMaxRounds;
+      next.rounds = static_cast<uint8_t>(rounds);
+    } else if (key.equals("phases")) {
+      clear = (valueLen == 0);
+      ok = ok && (clear || parsePhaseSpec(value, valueLen, next));
     }
+  };
+
+  for (int i = 0; ok && i < server.args(); i++) {
+    String name = server.argName(i);
+    String value = server.arg(i);
+    apply(JsonSpan{name.c_str(), name.length()}, value.c_str(), value.length());
   }
-  if (server.hasArg("sample_window_ms")) {
-    int value = 0;
-    if (parseIntValue(server.arg("sample_window_ms"), value)) {
-      int next = clampInt(value, 1, 50);
-      if (next != config.sampleWindowMs) {
-        config.sampleWindowMs = next;
-        changed = true;
+  String body = server.arg("plain");
+  if (ok && body.length() > 0) {
+    ok = jsonForEachMember(body.c_str(), body.length(), [&](const JsonMember &member) {
+      if (member.type == JSON_STRING || member.type == JSON_NUMBER) {
+        apply(member.key, member.value.ptr, member.value.len);
       }
+    }) && ok;
+  }
+
+  if (clear) {
+    next = IntervalProgram();
+  } else if (ok && next.rounds == 0) {
+    next.rounds = 1;
+  }
+  if (!ok || (!clear && (next.name[0] == '\0' || !programValid(next)))) {
+    server.send(400, "application/json", "{\"error\":\"invalid program\"}");
+    return;
+  }
+  if (saveProgram(static_cast<uint8_t>(slot), next)) {
+    logPrintf("Program slot %d updated\n", slot);
+  }
+  server.send(200, "application/json", "{\"ok\":true}");
+}
+
+// Widest /api/rounds entry, every number at its widest.
+const size_t kRoundJsonEntryMax =
+    sizeof(",{\"seq\":4294967295,\"round\":255,\"complete\":false,\"hits\":4294967295,\"target\":4294967295"
+           ",\"rest_hits\":4294967295,\"work_ms\":4294967295,\"best_peak\":-2147483648}") -
+    1;
+const size_t kRoundsJsonMax = sizeof("{\"seq\":4294967295,\"rounds\":[]}") + kRoundHistoryMax * kRoundJsonEntryMax;
+
+// GET /api/rounds?since=<seq>: round summaries newer than seq, so clients
+// fetch each summary once as the session progresses.
+
+void handleRounds() {
+  int since = 0;
+  if (server.hasArg("since") && !parseIntValue(server.arg("since"), since)) {
+    since = 0;
+  }
+  // ~2.7 KB with a full history: kept off the loop stack.
+  static char json[kRoundsJsonMax];
+  size_t len = 0;
+  appendJson(json, sizeof(json), len, "{\"seq\":%lu,\"rounds\":[",
+             static_cast<unsigned long>(runner.lastSummarySeq()));
+  bool first = true;
+  for (uint8_t i = 0; i < runner.summaryCount(); i++) {
+    const RoundSummary &r = runner.summary(i);
+    if (r.seq <= static_cast<uint32_t>(since)) {
+      continue;
     }
+    appendJson(json, sizeof(json), len,
+               "%s{\"seq\":%lu,\"round\":%u,\"complete\":%s,\"hits\":%lu,\"target\":%lu"
+               ",\"rest_hits\":%lu,\"work_ms\":%lu,\"best_peak\":%d}",
+               first ? "" : ",", static_cast<unsigned long>(r.seq), r.round, r.complete ? "true" : "false",
+               static_cast<unsigned long>(r.hits), static_cast<unsigned long>(r.targetHits),
+               static_cast<unsigned long>(r.restHits), static_cast<unsigned long>(r.workMs), r.bestPeak);
+    first = false;
   }
-  if (server.hasArg("simulate")) {
-    String value = server.arg("simulate");
-    bool next = (value == "1" || value == "true");
-    if (next != config.simulate) {
-      config.simulate = next;
-      changed = true;
+  appendJson(json, sizeof(json), len, "]}");
+  server.send_P(200, "application/json", json, len);
+}
+
+// GET /api/athletes: every profile with its bests and rolling averages.
+void handleAthletes() {
+  // Up to kAthleteMax entries of ~200 bytes: too big for the loop stack.
+  static char json[3456];
+  size_t len = 0;
+  appendJson(json, sizeof(json), len, "{\"athletes\":[");
+  bool first = true;
+  for (uint8_t slot = 0; slot < kAthleteMax; slot++) {
+    if (!athletes.used(slot)) {
+      continue;
+    }
+    const AthleteRecord &r = athletes.record(slot);
+    appendJson(json, sizeof(json), len,
+               "%s{\"slot\":%u,\"name\":\"%s\",\"sessions\":%u,\"best_peak\":%u,\"best_score\":%u"
+               ",\"best_series\":%u,\"best_tempo_hpm\":%u,\"total_hits\":%lu,\"total_ms\":%lu"
+               ",\"avg_hits\":%lu,\"avg_tempo_hpm\":%lu}",
+               first ? "" : ",", slot, r.name, r.sessions, r.bestPeak, r.bestScore, r.bestSeries, r.bestTempoHpm,
+               static_cast<unsigned long>(r.totalHits), static_cast<unsigned long>(r.totalMs),
+               static_cast<unsigned long>((r.avgHitsX16 + 8) / 16),
+               static_cast<unsigned long>((r.avgTempoX16 + 8) / 16));
+    first = false;
+  }
+  appendJson(json, sizeof(json), len, "]}");
+  server.send_P(200, "application/json", json, len);
+}
+
+// POST /api/athlete?slot=N&name=..  creates or renames; &delete=1 removes
+// the profile and its record.
+void handleAthlete() {
+  int slot = -1;
+  if (!parseIntValue(server.arg("slot"), slot) || slot < 0 || slot >= kAthleteMax) {
+    server.send(400, "application/json", "{\"error\":\"invalid athlete\"}");
+    return;
+  }
+  uint8_t index = static_cast<uint8_t>(slot);
+  if (server.arg("delete") == "1") {
+    if (running && sessionAthlete == slot) {
+      sessionAthlete = -1;
+    }
+    if (armedAthlete == slot) {
+      armedAthlete = -1;
+    }
+    athletes.erase(index);
+  } else {
+    String name = server.arg("name");
+    if (!nameValid(name.c_str(), name.length(), kAthleteNameMax)) {
+      server.send(400, "application/json", "{\"error\":\"invalid name\"}");
+      return;
+    }
+    athletes.setName(index, name.c_str(), name.length());
+  }
+  saveAthlete(index);
+  markStateChanged();
+  server.send(200, "application/json", "{\"ok\":true}");
+}
+
+const char *const kBoardNames[BOARD_COUNT] = {"score", "peak", "series", "tempo"};
+
+uint32_t boardValue(const AthleteRecord &r, LeaderboardMetric metric) {
+  switch (metric) {
+    case BOARD_SCORE: return r.bestScore;
+    case BOARD_PEAK: return r.bestPeak;
+    case BOARD_SERIES: return r.bestSeries;
+    default: return r.bestTempoHpm;
+  }
+}
+
+// GET /api/leaderboard?by=score|peak|series|tempo[&limit=N]: read straight
+// from the sorted index, no scan of the records.
+void handleLeaderboard() {
+  LeaderboardMetric metric = BOARD_SCORE;
+  if (server.hasArg("by")) {
+    String by = server.arg("by");
+    uint8_t m = 0;
+    while (m < BOARD_COUNT && by != kBoardNames[m]) {
+      m++;
+    }
+    if (m == BOARD_COUNT) {
+      server.send(400, "application/json", "{\"error\":\"invalid metric\"}");
+      return;
+    }
+    metric = static_cast<LeaderboardMetric>(m);
+  }
+  int limit = kAthleteMax;
+  if (server.hasArg("limit") && (!parseIntValue(server.arg("limit"), limit) || limit < 1)) {
+    limit = kAthleteMax;
+  }
+
+  const LeaderboardIndex &board = athletes.board(metric);
+  char json[1280];
+  size_t len = 0;
+  appendJson(json, sizeof(json), len, "{\"by\":\"%s\",\"leaders\":[", kBoardNames[metric]);
+  for (uint8_t rank = 0; rank < board.count() && rank < limit; rank++) {
+    uint8_t slot = board.at(rank);
+    const AthleteRecord &r = athletes.record(slot);
+    appendJson(json, sizeof(json), len, "%s{\"rank\":%u,\"slot\":%u,\"name\":\"%s\",\"value\":%lu}",
+               rank ? "," : "", rank + 1, slot, r.name, static_cast<unsigned long>(boardValue(r, metric)));
+  }
+  appendJson(json, sizeof(json), len, "]}");
+  server.send_P(200, "application/json", json, len);
+}
+
+void handleConfig() {
+  Config next = config;
+
+  for (int i = 0; i < server.args(); i++) {
+    String name = server.argName(i);
+    const ConfigField *field = findConfigField(JsonSpan{name.c_str(), name.length()});
+    int value = 0;
+    if (field != nullptr && parseConfigArg(*field, server.arg(i), value)) {
+      setConfigValue(next, *field, value);
     }
   }
 
   String body = server.arg("plain");
   if (body.length() > 0) {
-    int value = 0;
-    bool boolValue = false;
-    if (extractJsonInt(body, "threshold", value)) {
-      int next = clampInt(value, 0, 4095);
-      if (next != config.threshold) {
-        config.threshold = next;
-        changed = true;
+    jsonForEachMember(body.c_str(), body.length(), [&next](const JsonMember &member) {
+      const ConfigField *field = findConfigField(member.key);
+      int value = 0;
+      if (field != nullptr && parseConfigJson(*field, member, value)) {
+        setConfigValue(next, *field, value);
       }
+    });
+  }
+
+  size_t written = saveConfig(next);
+  if (written > 0) {
+    markStateChanged();
+    configureDetector();
+    applyStallBudgets();
+    logPrintf("Config updated (%u keys): threshold=%d lockout=%d series_gap=%d window=%d simulate=%d\n",
+                  static_cast<unsigned>(written), config.threshold, config.lockoutMs,
+                  config.seriesGapMs, config.sampleWindowMs, config.simulate ? 1 : 0);
+  }
+
+  server.send(200, "application/json", "{\"ok\":true}");
+}
+
+// Never blocks: a frame that does not fit the TX buffer is dropped and shows
+// up as a sequence gap on the host.
+bool captureSink(const uint8_t *data, size_t len) {
+  if (Serial.availableForWrite() < static_cast<int>(len)) {
+    return false;
+  }
+  Serial.write(data, len);
+  return true;
+}
+
+void startCapture(uint8_t div) {
+  Serial.flush();
+  Serial.updateBaudRate(kCaptureBaud);
+  // A lone delimiter ends any log text still in the receiver's frame buffer.
+  Serial.write(static_cast<uint8_t>(0));
+  capture.begin(captureSink, div, kSampleIntervalUs);
+  captureDiv = div;
+}
+
+void stopCapture() {
+  capture.flush();
+  Serial.flush();
+  captureDiv = 0;
+  Serial.updateBaudRate(kLogBaud);
+  logPrintf("Capture stopped: frames=%lu dropped=%lu samples=%lu\n", static_cast<unsigned long>(capture.frames()),
+            static_cast<unsigned long>(capture.dropped()), static_cast<unsigned long>(capture.samples()));
+}
+
+// GET /api/capture: stream counters. POST /api/capture?div=N starts
+// streaming every Nth-sample average (1 = every sample), div=0 stops.
+void handleCapture() {
+  if (server.method() == HTTP_POST) {
+    int div = -1;
+    if (!parseIntValue(server.arg("div"), div) || div < 0 || div > kCaptureMaxDiv) {
+      server.send(400, "application/json", "{\"error\":\"invalid div\"}");
+      return;
     }
-    if (extractJsonInt(body, "lockout_ms", value)) {
-      int next = clampInt(value, 0, 5000);
-      if (next != config.lockoutMs) {
-        config.lockoutMs = next;
-        changed = true;
-      }
+    if (captureDiv != 0) {
+      stopCapture();
     }
-    if (extractJsonInt(body, "series_gap_ms", value)) {
-      int next = clampInt(value, 0, 10000);
-      if (next != config.seriesGapMs) {
-        config.seriesGapMs = next;
-        changed = true;
-      }
+    if (div > 0) {
+      startCapture(static_cast<uint8_t>(div));
     }
-    if (extractJsonInt(body, "sample_window_ms", value)) {
-      int next = clampInt(value, 1, 50);
-      if (next != config.sampleWindowMs) {
-        config.sampleWindowMs = next;
-        changed = true;
-      }
+  }
+  char json[160];
+  size_t len = 0;
+  appendJson(json, sizeof(json), len,
+             "{\"capture_div\":%u,\"baud\":%lu,\"frames\":%lu,\"dropped\":%lu,\"samples\":%lu}", captureDiv,
+             captureDiv ? kCaptureBaud : kLogBaud, static_cast<unsigned long>(capture.frames()),
+             static_cast<unsigned long>(capture.dropped()), static_cast<unsigned long>(capture.samples()));
+  server.send_P(200, "application/json", json, len);
+}
+
+// GET /api/power: time awake, idle, and blocked in idle waits. The request
+// itself wakes an idle shield, so "state" reads awake and http_wakes counts it.
+void handlePower() {
+  uint64_t now = nowUs();
+  uint64_t inState = now - powerStateSinceUs;
+  uint64_t awake = awakeUs + (powerState == POWER_AWAKE ? inState : 0);
+  uint64_t idle = idleUs + (powerState == POWER_IDLE ? inState : 0);
+  uint64_t total = awake + idle;
+  char json[320];
+  size_t len = 0;
+  appendJson(json, sizeof(json), len,
+             "{\"state\":\"%s\",\"cpu_mhz\":%lu,\"armed\":%s,\"idle_after_s\":%d,\"watch_ms\":%lu"
+             ",\"wake_level\":%d,\"awake_ms\":%lu,\"idle_ms\":%lu,\"idle_wait_ms\":%lu,\"idle_wait_pct\":%lu"
+             ",\"impact_wakes\":%lu,\"http_wakes\":%lu}",
+             powerState == POWER_IDLE ? "idle" : "awake", static_cast<unsigned long>(getCpuFrequencyMhz()),
+             armed ? "true" : "false", config.idleAfterS, static_cast<unsigned long>(kIdleWatchMs), wakeLevel(),
+             static_cast<unsigned long>(awake / 1000), static_cast<unsigned long>(idle / 1000),
+             static_cast<unsigned long>(idleWaitUs / 1000),
+             static_cast<unsigned long>(total ? idleWaitUs * 100 / total : 0),
+             static_cast<unsigned long>(impactWakes), static_cast<unsigned long>(httpWakes));
+  server.send_P(200, "application/json", json, len);
+}
+
+// GET /api/stalls: loop stages that overran their budget, newest first,
+// from this and earlier boots. POST /api/stalls?clear=1 empties the ring.
+void handleStalls() {
+  if (server.method() == HTTP_POST) {
+    if (server.arg("clear") != "1") {
+      server.send(400, "application/json", "{\"error\":\"clear=1 expected\"}");
+      return;
     }
-    if (extractJsonBool(body, "simulate", boolValue)) {
-      if (boolValue != config.simulate) {
-        config.simulate = boolValue;
-        changed = true;
+    stallWatch.clear();
+    // Not a flash stage, as in tickStallWatch(): a slow save must not record
+    // a stall that calls for another save.
+    prefs.putBytes("stalls", &stallRing, sizeof(stallRing));
+  }
+  // kStallRingSize records of ~110 bytes: kept off the loop stack.
+  static char json[2048];
+  size_t len = 0;
+  appendJson(json, sizeof(json), len, "{\"boot\":%lu,\"check_ms\":%lu,\"total\":%lu,\"budgets_ms\":{",
+             static_cast<unsigned long>(bootId), static_cast<unsigned long>(kStallCheckMs),
+             static_cast<unsigned long>(stallRing.total));
+  for (uint8_t i = 0; i < STAGE_COUNT; i++) {
+    appendJson(json, sizeof(json), len, "%s\"%s\":%u", i == 0 ? "" : ",", kStageNames[i], stallWatch.budget(i));
+  }
+  appendJson(json, sizeof(json), len, "},\"stalls\":[");
+  for (uint8_t i = 0; i < stallRing.count; i++) {
+    const StallRecord &r = stallWatch.recent(i);
+    appendJson(json, sizeof(json), len,
+               "%s{\"stage\":\"%s\",\"boot\":%lu,\"at_ms\":%lu,\"duration_ms\":%lu,\"budget_ms\":%u"
+               ",\"open\":%s}",
+               i == 0 ? "" : ",", r.stage < STAGE_COUNT ? kStageNames[r.stage] : "?",
+               static_cast<unsigned long>(r.bootId), static_cast<unsigned long>(r.atMs),
+               static_cast<unsigned long>(r.durationMs), r.budgetMs, r.open ? "true" : "false");
+  }
+  appendJson(json, sizeof(json), len, "]}");
+  server.send_P(200, "application/json", json, len);
+}
+
+// GET /api/templates: learned strike templates and the check's counters.
+// POST ?learn=<slot>[&count=N] averages the next N strikes (default
+// kDefaultLearnStrikes) into a slot; POST ?clear=<slot> or clear=all
+// empties slots.
+void handleTemplates() {
+  if (server.method() == HTTP_POST) {
+    int slot = -1;
+    int count = kDefaultLearnStrikes;
+    if (server.hasArg("learn")) {
+      if (!parseIntValue(server.arg("learn"), slot) || slot < 0 || slot >= kMatchTemplateMax ||
+          (server.hasArg("count") && (!parseIntValue(server.arg("count"), count) || count < 1 || count > 100))) {
+        server.send(400, "application/json", "{\"error\":\"invalid learn or count\"}");
+        return;
       }
+      matcher.startLearning(static_cast<uint8_t>(slot), static_cast<uint16_t>(count));
+      logPrintf("Template %d: learning from %d strikes\n", slot, count);
+    } else if (server.arg("clear") == "all") {
+      matcher.clear();
+      saveTemplates();
+    } else if (parseIntValue(server.arg("clear"), slot) && slot >= 0 && slot < kMatchTemplateMax) {
+      if (matcher.learningSlot() == slot) {
+        matcher.cancelLearning();
+      }
+      matcher.clear(static_cast<uint8_t>(slot));
+      saveTemplates();
+    } else {
+      server.send(400, "application/json", "{\"error\":\"learn or clear expected\"}");
+      return;
     }
+    markStateChanged();
   }
+  char json[256];
+  size_t len = 0;
+  appendJson(json, sizeof(json), len,
+             "{\"match_pct\":%d,\"used\":%u,\"learning\":%d,\"learn_left\":%u,\"rejected\":%lu"
+             ",\"last_match_pct\":%d,\"templates\":[",
+             config.matchPct, matcher.used(), matcher.learningSlot(), matcher.learnLeft(),
+             static_cast<unsigned long>(rejectedHits), lastMatchPct);
+  for (uint8_t k = 0; k < kMatchTemplateMax; k++) {
+    appendJson(json, sizeof(json), len, "%s{\"slot\":%u,\"strikes\":%u}", k == 0 ? "" : ",", k,
+               matcher.bank().slots[k].strikes);
+  }
+  appendJson(json, sizeof(json), len, "]}");
+  server.send_P(200, "application/json", json, len);
+}
 
-  if (changed) {
-    saveConfig();
-    Serial.printf("Config updated: threshold=%d lockout=%d series_gap=%d window=%d simulate=%d\n",
-                  config.threshold, config.lockoutMs, config.seriesGapMs,
-                  config.sampleWindowMs, config.simulate ? 1 : 0);
+// Copies a full slot out and frees it. False if it is empty or was filled
+// for an earlier run.
+bool takeDiagSlot(DiagSlot &slot, uint32_t run, int16_t *out, uint32_t &rateHz) {
+  if (slot.state.load() != DIAG_FULL) {
+    return false;
+  }
+  bool current = slot.run == run;
+  if (current) {
+    memcpy(out, slot.samples, sizeof(slot.samples));
+    rateHz = slot.rateHz;
   }
+  slot.state.store(DIAG_EMPTY);
+  return current;
+}
 
-  server.send(200, "application/json", "{\"ok\":true}");
+void diagTask(void *) {
+  // Power sums and FFT buffers, ~3 KB: kept off the task stack.
+  static SpectrumDiag analyzer;
+  static int16_t window[kDiagFftSize];
+  uint32_t run = 0;
+  uint32_t windowUs = 0;
+  bool changed = false;
+  for (;;) {
+    delay(kDiagPollMs);
+    if (diagRun.load() != run) {
+      run = diagRun.load();
+      analyzer.reset();
+      changed = false;
+    }
+    uint32_t rateHz = 0;
+    uint64_t start = nowUs();
+    if (takeDiagSlot(diagStrikeSlot, run, window, rateHz)) {
+      analyzer.addStrike(window, rateHz);
+      windowUs = saturateUs(nowUs() - start);
+      changed = true;
+    } else if (takeDiagSlot(diagNoiseSlot, run, window, rateHz)) {
+      analyzer.addNoise(window, rateHz);
+      windowUs = saturateUs(nowUs() - start);
+      changed = true;
+    }
+    // Until loop() has taken the last report the sums keep growing and
+    // the next one covers them too.
+    if (changed && !diagReportReady.load()) {
+      changed = false;
+      diagTaskUs = windowUs;
+      analyzer.report(diagTaskReport);
+      diagTaskRun = run;
+      diagReportReady.store(true);
+    }
+  }
+}
+
+void pollDiagReport() {
+  if (!diagReportReady.load()) {
+    return;
+  }
+  if (diagTaskRun == diagRun.load()) {
+    diagReport = diagTaskReport;
+    diagWindowUs = diagTaskUs;
+  }
+  diagReportReady.store(false);
+}
+
+void startDiag(uint16_t windows) {
+  diagRun++;
+  diagActive = true;
+  diagWanted = windows;
+  diagStrikesSent = 0;
+  diagNoiseSent = 0;
+  memset(&diagReport, 0, sizeof(diagReport));
+  diagWindowUs = 0;
+  restartDiagNoise();
+  logPrintf("Diagnostics: %u strike and noise windows\n", windows);
+}
+
+// GET /api/diag: spectral health report of the pad and sensor. Windows are
+// collected only during a session, so start one and strike the pad.
+// POST ?start=1[&windows=N] starts over with N windows of each kind
+// (default kDefaultDiagWindows); POST ?stop=1 stops collecting and keeps the
+// report.
+//   resonance_hz   the pad's ringing, from counted strikes; 0 = none found
+//   noise_rms      sensor noise between strikes, ADC counts
+//   hum_rms        of it at 50 Hz; hum_pct its share of the noise power
+//   bands          noise RMS per band_hz wide band, from 0 Hz up
+void handleDiag() {
+  if (server.method() == HTTP_POST) {
+    int windows = kDefaultDiagWindows;
+    if (server.arg("stop") == "1") {
+      diagActive = false;
+    } else if (server.arg("start") != "1" ||
+               (server.hasArg("windows") &&
+                (!parseIntValue(server.arg("windows"), windows) || windows < 1 || windows > kDiagWindowsMax))) {
+      server.send(400, "application/json", "{\"error\":\"start=1 with valid windows or stop=1 expected\"}");
+      return;
+    } else {
+      startDiag(static_cast<uint16_t>(windows));
+    }
+  }
+  pollDiagReport();
+  bool collecting = diagActive && (diagStrikesSent < diagWanted || diagNoiseSent < diagWanted);
+  const DiagReport &r = diagReport;
+  char json[640];
+  size_t len = 0;
+  appendJson(json, sizeof(json), len,
+             "{\"collecting\":%s,\"session\":%s,\"wanted\":%u,\"strikes\":%u,\"noise_windows\":%u"
+             ",\"resonance_hz\":%.1f,\"bin_hz\":%.1f,\"noise_rms\":%.2f,\"hum_rms\":%.2f,\"hum_pct\":%.1f"
+             ",\"window_us\":%lu,\"band_hz\":%.1f,\"bands\":[",
+             collecting ? "true" : "false", running ? "true" : "false", diagWanted, r.strikes, r.noiseWindows,
+             r.resonanceHz, r.resonanceBinHz, r.noiseRms, r.humRms, r.humPct,
+             static_cast<unsigned long>(diagWindowUs), r.bandHz);
+  for (uint8_t b = 0; b < kDiagBands; b++) {
+    appendJson(json, sizeof(json), len, "%s%.2f", b == 0 ? "" : ",", r.bands[b]);
+  }
+  appendJson(json, sizeof(json), len, "]}");
+  server.send_P(200, "application/json", json, len);
+}
+
+// Registers a handler that first counts the request as activity.
+void route(const char *path, HTTPMethod method, void (*handler)()) {
+  server.on(path, method, [handler]() {
+    noteActivity();
+    handler();
+  });
 }
 
 } // namespace
 
 void setup() {
-  Serial.begin(115200);
+  Serial.setTxBufferSize(kSerialTxBuffer);
+  Serial.begin(kLogBaud);
   delay(200);
   loadConfig();
-  randomSeed(esp_random());
+  setupStallWatch();
+  setupSessionTimer();
+  loadPrograms();
+  loadAthletes();
+  loadTemplates();
+  configureDetector();
 
   analogReadResolution(12);
   analogSetPinAttenuation(kAdcPin, ADC_11db);
@@ -844,34 +2633,74 @@ void setup() {
   WiFi.mode(WIFI_AP);
   WiFi.softAP(kApSsid, kApPass);
   IPAddress ip = WiFi.softAPIP();
-  Serial.printf("AP started: %s IP=%s\n", kApSsid, ip.toString().c_str());
-
-  server.on("/", HTTP_GET, handleRoot);
-  server.on("/api/status", HTTP_GET, handleStatus);
-  server.on("/api/start", HTTP_POST, handleStart);
-  server.on("/api/stop", HTTP_POST, handleStop);
-  server.on("/api/config", HTTP_POST, handleConfig);
+  logPrintf("AP started: %s IP=%s\n", kApSsid, ip.toString().c_str());
+
+  route("/", HTTP_GET, handleRoot);
+  route("/api/status", HTTP_GET, handleStatus);
+  route("/api/start", HTTP_POST, handleStart);
+  route("/api/arm", HTTP_POST, handleArm);
+  route("/api/stop", HTTP_POST, handleStop);
+  route("/api/config", HTTP_POST, handleConfig);
+  route("/api/programs", HTTP_GET, handlePrograms);
+  route("/api/program", HTTP_POST, handleProgram);
+  route("/api/rounds", HTTP_GET, handleRounds);
+  route("/api/capture", HTTP_ANY, handleCapture);
+  route("/api/power", HTTP_GET, handlePower);
+  route("/api/athletes", HTTP_GET, handleAthletes);
+  route("/api/athlete", HTTP_POST, handleAthlete);
+  route("/api/leaderboard", HTTP_GET, handleLeaderboard);
+  route("/api/stalls", HTTP_ANY, handleStalls);
+  route("/api/templates", HTTP_ANY, handleTemplates);
+  route("/api/diag", HTTP_ANY, handleDiag);
+  static const char *kCollectedHeaders[] = {"Accept"};
+  server.collectHeaders(kCollectedHeaders, 1);
   server.begin();
+
+  if (xTaskCreatePinnedToCore(diagTask, "diag", kDiagTaskStack, nullptr, 1, nullptr, 0) != pdPASS) {
+    logPrintf("Diagnostics task failed to start\n");
+  }
+
+  setCpuFrequencyMhz(kActiveCpuMhz);
+  powerStateSinceUs = nowUs();
+  lastActivityUs = powerStateSinceUs;
+}
+
+// Phase changes are handled here, between sample windows. A hit may already
+// have moved the runner past a boundary inside the window. Returns true once
+// the program is over and the session stopped at its last boundary.
+bool advanceSession() {
+  StallScope session(stallWatch, STAGE_SESSION);
+  if (runner.advance(nowUs())) {
+    markStateChanged();
+  }
+  if (runner.lastSummarySeq() != roundsLogged) {
+    logNewRounds();
+  }
+  if (runner.active()) {
+    return false;
+  }
+  stopSession(runner.endUs());
+  return true;
 }
 
 void loop() {
-  server.handleClient();
+  // The end timer gets the stop in ahead of any HTTP request.
+  if (sessionEndDue.exchange(false) && running && advanceSession()) {
+    return;
+  }
+  {
+    StallScope http(stallWatch, STAGE_HTTP);
+    server.handleClient();
+  }
+  tickStallWatch();
+  pollDiagReport();
 
   if (running) {
-    if (sessionDurationMs > 0) {
-      uint32_t elapsed = millis() - sessionStartMs;
-      if (elapsed >= sessionDurationMs) {
-        stopSession();
-        return;
-      }
-    }
-
-    if (config.simulate) {
-      processSimulation();
-    } else {
-      processSensor();
+    if (advanceSession()) {
+      return;
     }
+    processSensor();
   } else {
-    delay(5);
+    idleStep();
   }
 }
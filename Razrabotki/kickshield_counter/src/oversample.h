@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "strike_detector.h"
+
+// Oversample-and-decimate front end: every read() takes Ratio raw samples
+// back to back from the wrapped source and returns their rounded mean. The
+// result stays in 12-bit ADC counts, so thresholds and scores keep their
+// meaning, while uncorrelated noise drops by sqrt(Ratio). Ratio is fixed at
+// compile time so the mean is a shift or a multiply, not a division.
+template <uint8_t Ratio>
+class DecimatingSource : public SampleSource {
+  static_assert(Ratio >= 1 && Ratio <= 16, "oversampling ratio must be 1..16");
+
+public:
+  explicit DecimatingSource(SampleSource &raw) : raw_(raw) {}
+
+  int read() override {
+    uint32_t sum = 0;
+    for (uint8_t i = 0; i < Ratio; i++) {
+      sum += static_cast<uint32_t>(raw_.read());
+    }
+    return static_cast<int>((sum + Ratio / 2) / Ratio);
+  }
+
+private:
+  SampleSource &raw_;
+};
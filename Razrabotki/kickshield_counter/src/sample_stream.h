@@ -0,0 +1,319 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Binary raw-sample stream for capture over the serial port, plus the file
+// format the host capture tool writes and the replay harness reads.
+//
+// Each frame is COBS-encoded and ends with a 0x00 byte, so a receiver can
+// resync at the next zero after line noise or a dropped byte. Decoded frame:
+//   u8  type           STREAM_SAMPLES or STREAM_HIT
+//   u16 seq            per frame, wraps; a jump means lost frames
+//   u32 index          sample index of the first sample (or of the hit)
+//   STREAM_SAMPLES: u16 intervalUs, u8 count, count 12-bit samples packed
+//                   two per three bytes
+//   STREAM_HIT:     u16 peak
+//   u16 crc            CRC-16/CCITT-FALSE over everything before it
+// All integers are little-endian.
+
+static const uint8_t kStreamBlockSamples = 128;
+static const size_t kStreamHeaderBytes = 7;
+static const size_t kStreamMaxFrame = kStreamHeaderBytes + 3 + kStreamBlockSamples * 3 / 2 + 2;
+// COBS adds one byte per 254 plus one, then the 0x00 delimiter.
+static const size_t kStreamMaxEncoded = kStreamMaxFrame + kStreamMaxFrame / 254 + 2;
+
+enum StreamFrameType : uint8_t {
+  STREAM_SAMPLES = 1,
+  STREAM_HIT = 2
+};
+
+inline uint16_t crc16Ccitt(const uint8_t *data, size_t len) {
+  uint16_t crc = 0xFFFF;
+  for (size_t i = 0; i < len; i++) {
+    crc ^= static_cast<uint16_t>(data[i]) << 8;
+    for (uint8_t b = 0; b < 8; b++) {
+      crc = (crc & 0x8000) ? static_cast<uint16_t>((crc << 1) ^ 0x1021) : static_cast<uint16_t>(crc << 1);
+    }
+  }
+  return crc;
+}
+
+// Encodes len bytes into out (at least len + len / 254 + 1 bytes), without
+// the trailing delimiter. Returns the encoded length.
+inline size_t cobsEncode(const uint8_t *data, size_t len, uint8_t *out) {
+  size_t codePos = 0;
+  size_t o = 1;
+  uint8_t code = 1;
+  for (size_t i = 0; i < len; i++) {
+    if (data[i] == 0) {
+      out[codePos] = code;
+      codePos = o++;
+      code = 1;
+      continue;
+    }
+    out[o++] = data[i];
+    if (++code == 0xFF) {
+      out[codePos] = code;
+      codePos = o++;
+      code = 1;
+    }
+  }
+  out[codePos] = code;
+  return o;
+}
+
+// Decodes one frame (delimiter already stripped) into out. Returns the
+// decoded length, or 0 on malformed input or overflow.
+inline size_t cobsDecode(const uint8_t *data, size_t len, uint8_t *out, size_t outSize) {
+  size_t i = 0;
+  size_t o = 0;
+  while (i < len) {
+    uint8_t code = data[i++];
+    if (code == 0 || i + code - 1 > len) {
+      return 0;
+    }
+    for (uint8_t k = 1; k < code; k++) {
+      if (o == outSize) {
+        return 0;
+      }
+      out[o++] = data[i++];
+    }
+    if (code != 0xFF && i < len) {
+      if (o == outSize) {
+        return 0;
+      }
+      out[o++] = 0;
+    }
+  }
+  return o;
+}
+
+inline void putU16(uint8_t *p, uint16_t v) {
+  p[0] = static_cast<uint8_t>(v);
+  p[1] = static_cast<uint8_t>(v >> 8);
+}
+
+inline void putU32(uint8_t *p, uint32_t v) {
+  putU16(p, static_cast<uint16_t>(v));
+  putU16(p + 2, static_cast<uint16_t>(v >> 16));
+}
+
+inline uint16_t getU16(const uint8_t *p) {
+  return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+inline uint32_t getU32(const uint8_t *p) {
+  return getU16(p) | (static_cast<uint32_t>(getU16(p + 2)) << 16);
+}
+
+// Builds frames from the sampler. Every `decimation` input samples are
+// averaged into one stream sample; full blocks go to the sink right away, so
+// the caller never holds more than one block. The sink returns false when
+// the link has no room, and the frame is dropped (the receiver sees the seq
+// gap) instead of stalling the sampler.
+class SampleStreamEncoder {
+public:
+  typedef bool (*Sink)(const uint8_t *data, size_t len);
+
+  void begin(Sink sink, uint8_t decimation, uint16_t inputIntervalUs) {
+    sink_ = sink;
+    decimation_ = decimation ? decimation : 1;
+    intervalUs_ = static_cast<uint16_t>(inputIntervalUs * decimation_);
+    seq_ = 0;
+    index_ = 0;
+    blockStart_ = 0;
+    count_ = 0;
+    acc_ = 0;
+    accCount_ = 0;
+    frames_ = 0;
+    dropped_ = 0;
+  }
+
+  void push(int sample) {
+    acc_ += static_cast<uint32_t>(sample);
+    if (++accCount_ < decimation_) {
+      return;
+    }
+    uint16_t value = static_cast<uint16_t>((acc_ + decimation_ / 2) / decimation_);
+    acc_ = 0;
+    accCount_ = 0;
+    if (value > 0x0FFF) {
+      value = 0x0FFF;
+    }
+    if (count_ == 0) {
+      blockStart_ = index_;
+    }
+    block_[count_++] = value;
+    index_++;
+    if (count_ == kStreamBlockSamples) {
+      flush();
+    }
+  }
+
+  // Marks a detected hit at the current stream position.
+  void pushHit(int peak) {
+    uint8_t frame[kStreamHeaderBytes + 4];
+    writeHeader(frame, STREAM_HIT, index_);
+    putU16(frame + kStreamHeaderBytes, static_cast<uint16_t>(peak));
+    emit(frame, kStreamHeaderBytes + 2);
+  }
+
+  // Sends a partial block, e.g. when capture stops.
+  void flush() {
+    if (count_ == 0) {
+      return;
+    }
+    uint8_t frame[kStreamMaxFrame];
+    writeHeader(frame, STREAM_SAMPLES, blockStart_);
+    putU16(frame + kStreamHeaderBytes, intervalUs_);
+    frame[kStreamHeaderBytes + 2] = count_;
+    uint8_t *p = frame + kStreamHeaderBytes + 3;
+    for (uint8_t i = 0; i < count_; i += 2) {
+      uint16_t a = block_[i];
+      uint16_t b = (i + 1 < count_) ? block_[i + 1] : 0;
+      *p++ = static_cast<uint8_t>(a);
+      *p++ = static_cast<uint8_t>((a >> 8) | (b << 4));
+      *p++ = static_cast<uint8_t>(b >> 4);
+    }
+    count_ = 0;
+    emit(frame, static_cast<size_t>(p - frame));
+  }
+
+  uint32_t frames() const {
+    return frames_;
+  }
+
+  uint32_t dropped() const {
+    return dropped_;
+  }
+
+  uint32_t samples() const {
+    return index_;
+  }
+
+private:
+  void writeHeader(uint8_t *frame, uint8_t type, uint32_t index) {
+    frame[0] = type;
+    putU16(frame + 1, seq_++);
+    putU32(frame + 3, index);
+  }
+
+  void emit(uint8_t *frame, size_t len) {
+    putU16(frame + len, crc16Ccitt(frame, len));
+    uint8_t encoded[kStreamMaxEncoded];
+    size_t n = cobsEncode(frame, len + 2, encoded);
+    encoded[n++] = 0;
+    if (sink_ != nullptr && sink_(encoded, n)) {
+      frames_++;
+    } else {
+      dropped_++;
+    }
+  }
+
+  Sink sink_ = nullptr;
+  uint8_t decimation_ = 1;
+  uint16_t intervalUs_ = 0;
+  uint16_t seq_ = 0;
+  uint32_t index_ = 0;
+  uint32_t blockStart_ = 0;
+  uint16_t block_[kStreamBlockSamples];
+  uint8_t count_ = 0;
+  uint32_t acc_ = 0;
+  uint8_t accCount_ = 0;
+  uint32_t frames_ = 0;
+  uint32_t dropped_ = 0;
+};
+
+struct StreamFrame {
+  uint8_t type;
+  uint16_t seq;
+  uint32_t index;
+  uint16_t intervalUs;  // STREAM_SAMPLES
+  uint8_t count;
+  uint16_t samples[kStreamBlockSamples];
+  uint16_t peak;        // STREAM_HIT
+};
+
+// Feeds raw bytes from the link; returns true when `out` holds a frame that
+// passed COBS and CRC checks. Damaged frames are counted and skipped.
+class SampleStreamDecoder {
+public:
+  bool feed(uint8_t byte, StreamFrame &out) {
+    if (byte != 0) {
+      if (len_ < sizeof(buf_)) {
+        buf_[len_] = byte;
+      }
+      len_++;
+      return false;
+    }
+    size_t len = len_;
+    len_ = 0;
+    if (len == 0) {
+      return false;
+    }
+    if (len > sizeof(buf_)) {
+      badFrames_++;
+      return false;
+    }
+    uint8_t frame[kStreamMaxFrame];
+    size_t n = cobsDecode(buf_, len, frame, sizeof(frame));
+    if (n < kStreamHeaderBytes + 4 || crc16Ccitt(frame, n - 2) != getU16(frame + n - 2) || !parse(frame, n - 2, out)) {
+      badFrames_++;
+      return false;
+    }
+    return true;
+  }
+
+  uint32_t badFrames() const {
+    return badFrames_;
+  }
+
+private:
+  static bool parse(const uint8_t *frame, size_t len, StreamFrame &out) {
+    out.type = frame[0];
+    out.seq = getU16(frame + 1);
+    out.index = getU32(frame + 3);
+    const uint8_t *p = frame + kStreamHeaderBytes;
+    if (out.type == STREAM_HIT) {
+      out.peak = getU16(p);
+      out.count = 0;
+      return len == kStreamHeaderBytes + 2;
+    }
+    if (out.type != STREAM_SAMPLES || len < kStreamHeaderBytes + 3) {
+      return false;
+    }
+    out.intervalUs = getU16(p);
+    out.count = p[2];
+    p += 3;
+    if (out.count == 0 || out.count > kStreamBlockSamples || len != kStreamHeaderBytes + 3 + (out.count + 1) / 2 * 3) {
+      return false;
+    }
+    for (uint8_t i = 0; i < out.count; i += 2) {
+      out.samples[i] = static_cast<uint16_t>(p[0] | ((p[1] & 0x0F) << 8));
+      if (i + 1 < out.count) {
+        out.samples[i + 1] = static_cast<uint16_t>((p[1] >> 4) | (p[2] << 4));
+      }
+      p += 3;
+    }
+    return true;
+  }
+
+  uint8_t buf_[kStreamMaxEncoded];
+  size_t len_ = 0;
+  uint32_t badFrames_ = 0;
+};
+
+// Capture file (.ksr): this header, then sampleCount little-endian uint16
+// samples spaced intervalUs apart. Samples lost on the link are written as 0
+// so the time base stays intact.
+struct RawCaptureHeader {
+  uint32_t magic;        // "KSR1"
+  uint16_t intervalUs;
+  uint16_t reserved;
+  uint32_t sampleCount;
+  uint32_t lostSamples;
+};
+
+static const uint32_t kRawCaptureMagic = 0x3152534B;
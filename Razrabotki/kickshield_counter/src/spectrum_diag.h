@@ -0,0 +1,186 @@
+#pragma once
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "fixed_fft.h"
+
+// Spectral health check of pad and sensor, from two kinds of windows of
+// kDiagFftSize samples:
+//   strike windows   the samples around a counted strike at the detector
+//                    rate; the dominant resonance is the pad's ringing, and
+//                    it drifts as the foam breaks down or a mount loosens
+//   noise windows    the signal between strikes, averaged down by
+//                    kDiagNoiseDecimation; its spectrum shows sensor noise,
+//                    and mains pickup from a loose shield shows at 50 Hz
+// Each window goes through the fixed-point FFT and its power is summed per
+// bin, so the report averages every window since reset(). Float is used
+// only for the power sums and the report, which run off the sampling path.
+
+static const uint16_t kDiagFftSize = 256;
+static const uint16_t kDiagBins = kDiagFftSize / 2;
+static const uint8_t kDiagNoiseDecimation = 8;
+static const uint8_t kDiagBands = 16;
+static const uint16_t kDiagResonanceMinHz = 60;
+static const uint16_t kDiagHumHz = 50;
+static const uint8_t kDiagHumBins = 2;  // either side; the Hann main lobe
+// Noise windows start this long after a detection, past the strike's decay
+// and rebounds.
+static const uint16_t kDiagQuietMs = 100;
+// A full noise window is kept only after this many detector windows more
+// without a strike: the detector reports a strike up to two windows after
+// its rise began, and the rise must not count as noise.
+static const uint8_t kDiagHoldWindows = 2;
+
+struct DiagReport {
+  uint16_t strikes;
+  uint16_t noiseWindows;
+  float resonanceHz;      // 0 = no peak found
+  float resonanceBinHz;   // strike spectrum resolution
+  float noiseRms;         // ADC counts, between strikes
+  float humRms;           // 50 Hz +-kDiagHumBins bins, noise floor included
+  float humPct;           // share of the noise power
+  float bandHz;           // width of each noise band
+  float bands[kDiagBands];  // noise RMS per band, from 0 Hz up
+};
+
+// Bin k of a first-difference spectrum with the difference's gain
+// |1 - e^(-2 pi i k / N)|^2 taken back out.
+inline float diagUndifferenced(const float *power, uint16_t k) {
+  float s = sinf(static_cast<float>(kFftPi) * k / kDiagFftSize);
+  return power[k] / (4.0f * s * s) + 1e-6f;
+}
+
+// Strongest local maximum of a strike power spectrum (of first differences,
+// see SpectrumDiag::addStrike) above kDiagResonanceMinHz. It is placed
+// between bins on a parabola through the log power of its neighbours with
+// the difference's gain removed, which would otherwise pull it upwards.
+// 0 if there is none.
+inline float diagResonanceHz(const float *power, float binHz) {
+  uint16_t first = static_cast<uint16_t>(kDiagResonanceMinHz / binHz) + 1;
+  uint16_t best = 0;
+  for (uint16_t k = first < 2 ? 2 : first; k + 1 < kDiagBins; k++) {
+    if (power[k] > power[k - 1] && power[k] >= power[k + 1] && (best == 0 || power[k] > power[best])) {
+      best = k;
+    }
+  }
+  if (best == 0) {
+    return 0.0f;
+  }
+  float a = logf(diagUndifferenced(power, best - 1));
+  float b = logf(diagUndifferenced(power, best));
+  float c = logf(diagUndifferenced(power, best + 1));
+  float denom = a - 2.0f * b + c;
+  float offset = denom < 0.0f ? 0.5f * (a - c) / denom : 0.0f;
+  return (best + offset) * binHz;
+}
+
+// Noise figures of out from power summed over windows Hann-windowed noise
+// windows (window in Q15). One-sided power as variance is
+// 2 |X|^2 / (N sum w^2).
+inline void diagNoiseReport(const float *power, uint16_t windows, float binHz, DiagReport &out) {
+  float windowPower = 0.0f;
+  for (uint16_t i = 0; i < kDiagFftSize; i++) {
+    float w = FftHann<kDiagFftSize>::kWindow[i];
+    windowPower += w * w;
+  }
+  float scale = 2.0f / (kDiagFftSize * windowPower * windows);
+  uint16_t humBin = static_cast<uint16_t>(kDiagHumHz / binHz + 0.5f);
+  const uint16_t perBand = kDiagBins / kDiagBands;
+  float total = 0.0f;
+  float hum = 0.0f;
+  memset(out.bands, 0, sizeof(out.bands));
+  for (uint16_t k = 1; k < kDiagBins; k++) {
+    float p = power[k] * scale;
+    total += p;
+    out.bands[k / perBand] += p;
+    if (k + kDiagHumBins >= humBin && k <= humBin + kDiagHumBins) {
+      hum += p;
+    }
+  }
+  for (uint8_t b = 0; b < kDiagBands; b++) {
+    out.bands[b] = sqrtf(out.bands[b]);
+  }
+  out.bandHz = binHz * perBand;
+  out.noiseRms = sqrtf(total);
+  out.humRms = sqrtf(hum);
+  out.humPct = total > 0.0f ? 100.0f * hum / total : 0.0f;
+}
+
+class SpectrumDiag {
+public:
+  SpectrumDiag() {
+    reset();
+  }
+
+  void reset() {
+    memset(strikePower_, 0, sizeof(strikePower_));
+    memset(noisePower_, 0, sizeof(noisePower_));
+    strikes_ = 0;
+    noiseWindows_ = 0;
+  }
+
+  // A strike window at strikeRateHz. Rectangular window: it starts and ends
+  // on the baseline. The first difference flattens the decay envelope, which
+  // would otherwise bury the ringing under its low-frequency hump.
+  void addStrike(const int16_t *samples, uint32_t strikeRateHz) {
+    re_[0] = 0;
+    for (uint16_t i = 1; i < kDiagFftSize; i++) {
+      re_[i] = static_cast<int32_t>(samples[i] - samples[i - 1]) * 32768;
+    }
+    accumulate(strikePower_, 15);
+    strikeRateHz_ = strikeRateHz;
+    strikes_++;
+  }
+
+  // A noise window at noiseRateHz, mean removed, Hann window.
+  void addNoise(const int16_t *samples, uint32_t noiseRateHz) {
+    int32_t mean = 0;
+    for (uint16_t i = 0; i < kDiagFftSize; i++) {
+      mean += samples[i];
+    }
+    mean /= kDiagFftSize;
+    for (uint16_t i = 0; i < kDiagFftSize; i++) {
+      re_[i] = (samples[i] - mean) * FftHann<kDiagFftSize>::kWindow[i];
+    }
+    accumulate(noisePower_, 0);
+    noiseRateHz_ = noiseRateHz;
+    noiseWindows_++;
+  }
+
+  void report(DiagReport &out) const {
+    memset(&out, 0, sizeof(out));
+    out.strikes = strikes_;
+    out.noiseWindows = noiseWindows_;
+    if (strikes_ > 0) {
+      out.resonanceBinHz = static_cast<float>(strikeRateHz_) / kDiagFftSize;
+      out.resonanceHz = diagResonanceHz(strikePower_, out.resonanceBinHz);
+    }
+    if (noiseWindows_ > 0) {
+      diagNoiseReport(noisePower_, noiseWindows_, static_cast<float>(noiseRateHz_) / kDiagFftSize, out);
+    }
+  }
+
+private:
+  // inputBits: how far the input was scaled up before the transform.
+  void accumulate(float *power, uint8_t inputBits) {
+    memset(im_, 0, sizeof(im_));
+    uint8_t shift = FixedFft<kDiagFftSize>::transform(re_, im_);
+    float gain = ldexpf(1.0f, 2 * (shift - inputBits));
+    for (uint16_t k = 0; k < kDiagBins; k++) {
+      float r = static_cast<float>(re_[k]);
+      float q = static_cast<float>(im_[k]);
+      power[k] += (r * r + q * q) * gain;
+    }
+  }
+
+  int32_t re_[kDiagFftSize];
+  int32_t im_[kDiagFftSize];
+  float strikePower_[kDiagBins];
+  float noisePower_[kDiagBins];
+  uint32_t strikeRateHz_ = 0;
+  uint32_t noiseRateHz_ = 0;
+  uint16_t strikes_ = 0;
+  uint16_t noiseWindows_ = 0;
+};
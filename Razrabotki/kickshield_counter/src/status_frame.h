@@ -0,0 +1,103 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Binary form of /api/status, served for ?format=bin or an Accept header
+// naming application/octet-stream. Fixed layout, little-endian, decoded in
+// the web UI with a DataView:
+//
+//   0 u8  version (kStatusFrameVersion)   1 u8  flags (StatusFrameFlag)
+//   2 u16 frame length                    4 u32 status version
+//   8 char[12] mode, NUL-padded          20 u32 time_left_ms
+//  24 u32 hits                           28 u16 tempo_hpm
+//  30 u16 tempo_avg_hpm                  32 u16 series
+//  34 u16 maxSeries                      36 u16 lastPeak
+//  38 u16 lastScore                      40 u16 bestPeak
+//  42 u16 bestScore                      44 u32 last_interval_us
+//  48 u8  phase_index                    49 u8  phase_count
+//  50 u8  round                          51 u8  rounds
+//  52 u32 phase_left_ms                  56 u16 phase_hits
+//  58 u16 phase_target                   60 u32 round_seq
+//  64 i8  athlete (-1 = none)            65 u8  config value count N
+//  66 i16 x N config values, in kConfigFields order
+//     then u8 strike class count K, u16 x K class counts in StrikeClass
+//     order, i8 last class (-1 = none), u16 rejected, i8 last_match_pct
+//
+// New fields go at the end and readers use the length, so an older page
+// keeps working; the version changes only if an offset above moves.
+
+static const uint8_t kStatusFrameVersion = 1;
+static const size_t kStatusFrameFixed = 66;
+static const size_t kStatusFrameMax = 128;
+
+enum StatusFrameFlag : uint8_t {
+  STATUS_RUNNING = 1,
+  STATUS_ARMED = 2,
+  STATUS_IDLE = 4,
+  STATUS_REST = 8
+};
+
+// Appends little-endian fields to a fixed buffer; anything past the end is
+// dropped and flagged.
+class FrameWriter {
+public:
+  FrameWriter(uint8_t *buf, size_t size) : buf_(buf), size_(size) {}
+
+  void u8(uint8_t v) {
+    if (len_ + 1 > size_) {
+      overflow_ = true;
+      return;
+    }
+    buf_[len_++] = v;
+  }
+
+  void u16(uint16_t v) {
+    u8(static_cast<uint8_t>(v));
+    u8(static_cast<uint8_t>(v >> 8));
+  }
+
+  void u32(uint32_t v) {
+    u16(static_cast<uint16_t>(v));
+    u16(static_cast<uint16_t>(v >> 16));
+  }
+
+  // Clamps instead of wrapping.
+  void u16Sat(uint32_t v) {
+    u16(v > UINT16_MAX ? UINT16_MAX : static_cast<uint16_t>(v));
+  }
+
+  void i16Sat(int v) {
+    u16(static_cast<uint16_t>(static_cast<int16_t>(v < INT16_MIN ? INT16_MIN : (v > INT16_MAX ? INT16_MAX : v))));
+  }
+
+  // A NUL-padded text field of exactly size bytes.
+  void text(const char *s, size_t size) {
+    size_t n = strnlen(s, size);
+    for (size_t i = 0; i < size; i++) {
+      u8(i < n ? static_cast<uint8_t>(s[i]) : 0);
+    }
+  }
+
+  void patchU16(size_t offset, uint16_t v) {
+    if (offset + 2 <= len_) {
+      buf_[offset] = static_cast<uint8_t>(v);
+      buf_[offset + 1] = static_cast<uint8_t>(v >> 8);
+    }
+  }
+
+  size_t length() const {
+    return len_;
+  }
+
+  bool overflow() const {
+    return overflow_;
+  }
+
+private:
+  uint8_t *buf_;
+  size_t size_;
+  size_t len_ = 0;
+  bool overflow_ = false;
+};
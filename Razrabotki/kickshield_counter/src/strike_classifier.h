@@ -0,0 +1,69 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "strike_features.h"
+
+// Strike-type classifier: a 6-8-4 perceptron in int8 with int32
+// accumulators, about 80 multiply-adds per strike. The weights come from
+// tools/train_classifier, which writes them to strike_model.h as constexpr
+// arrays; this file only holds the layout and the inference.
+//
+// Quantization, as the training tool sets it up:
+//   x[i] = clamp((f[i] - offset[i]) * scale[i] >> 8, +-127)   ~32 per std dev
+//   h[j] = clamp((b1[j] + sum w1[j][i] * x[i]) * m1 >> 16, 0..127)   ReLU
+//   y[k] = b2[k] + sum w2[k][j] * h[j]; the class is the largest y[k]
+
+static const uint8_t kStrikeHidden = 8;
+
+enum StrikeClass : uint8_t {
+  STRIKE_FRONT_KICK,
+  STRIKE_ROUNDHOUSE,
+  STRIKE_PUNCH,
+  STRIKE_BUMP,
+  kStrikeClassCount
+};
+
+static const char *const kStrikeClassNames[kStrikeClassCount] = {"front_kick", "roundhouse", "punch", "bump"};
+
+struct StrikeModel {
+  const int32_t *offset;                    // [kStrikeFeatureCount]
+  const int16_t *scale;                     // [kStrikeFeatureCount], Q8
+  const int8_t (*w1)[kStrikeFeatureCount];  // [kStrikeHidden]
+  const int32_t *b1;                        // [kStrikeHidden]
+  int32_t m1;                               // hidden requantization, Q16
+  const int8_t (*w2)[kStrikeHidden];        // [kStrikeClassCount]
+  const int32_t *b2;                        // [kStrikeClassCount]
+};
+
+inline int8_t saturateStrikeValue(int64_t v, int64_t lo) {
+  return static_cast<int8_t>(v < lo ? lo : (v > 127 ? 127 : v));
+}
+
+inline StrikeClass classifyStrike(const StrikeModel &model, const StrikeFeatures &f) {
+  int8_t x[kStrikeFeatureCount];
+  for (uint8_t i = 0; i < kStrikeFeatureCount; i++) {
+    x[i] = saturateStrikeValue(static_cast<int64_t>(f.v[i] - model.offset[i]) * model.scale[i] >> 8, -127);
+  }
+  int8_t h[kStrikeHidden];
+  for (uint8_t j = 0; j < kStrikeHidden; j++) {
+    int32_t acc = model.b1[j];
+    for (uint8_t i = 0; i < kStrikeFeatureCount; i++) {
+      acc += model.w1[j][i] * x[i];
+    }
+    h[j] = saturateStrikeValue(static_cast<int64_t>(acc) * model.m1 >> 16, 0);
+  }
+  uint8_t best = 0;
+  int32_t bestScore = INT32_MIN;
+  for (uint8_t k = 0; k < kStrikeClassCount; k++) {
+    int32_t acc = model.b2[k];
+    for (uint8_t j = 0; j < kStrikeHidden; j++) {
+      acc += model.w2[k][j] * h[j];
+    }
+    if (acc > bestScore) {
+      bestScore = acc;
+      best = k;
+    }
+  }
+  return static_cast<StrikeClass>(best);
+}
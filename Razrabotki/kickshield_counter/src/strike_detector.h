@@ -0,0 +1,87 @@
+#pragma once
+
+#include <stdint.h>
+
+// Source of raw sensor samples in ADC counts (0..4095). The firmware reads
+// the real ADC or the synthetic strike generator through this interface, and
+// host tools feed the same detector from files or the generator.
+class SampleSource {
+public:
+  virtual ~SampleSource() {}
+  virtual int read() = 0;
+};
+
+struct StrikeDetectorConfig {
+  int threshold;
+  uint32_t lockoutMs;
+  uint32_t windowSamples;
+};
+
+struct Strike {
+  uint64_t atUs;  // when the peak sample was taken
+  int peak;
+};
+
+// Streaming form of the original readPeak()/processSensor() pair: samples are
+// grouped into windows of windowSamples, and a window whose peak exceeds the
+// threshold outside the lockout period is a strike. Times are microseconds
+// on the 64-bit monotonic clock, so the lockout compare never wraps.
+class StrikeDetector {
+public:
+  void configure(const StrikeDetectorConfig &config) {
+    config_ = config;
+    if (config_.windowSamples == 0) {
+      config_.windowSamples = 1;
+    }
+  }
+
+  void reset() {
+    windowPeak_ = 0;
+    windowPeakUs_ = 0;
+    windowFill_ = 0;
+    lockoutUntilUs_ = 0;
+  }
+
+  uint32_t windowSamples() const {
+    return config_.windowSamples;
+  }
+
+  // Feeds one sample taken at nowUs. Returns true and fills out when the
+  // sample closes a window that holds a strike.
+  bool push(int sample, uint64_t nowUs, Strike &out) {
+    if (sample > windowPeak_) {
+      windowPeak_ = sample;
+      windowPeakUs_ = nowUs;
+    }
+    if (++windowFill_ < config_.windowSamples) {
+      return false;
+    }
+    return closeWindow(nowUs, out);
+  }
+
+  // Closes a partly filled window as if it were complete, e.g. at the end
+  // of a timed session, so no sample past the end joins it.
+  bool flush(uint64_t nowUs, Strike &out) {
+    return windowFill_ > 0 && closeWindow(nowUs, out);
+  }
+
+private:
+  bool closeWindow(uint64_t nowUs, Strike &out) {
+    int peak = windowPeak_;
+    windowPeak_ = 0;
+    windowFill_ = 0;
+    if (peak <= config_.threshold || nowUs <= lockoutUntilUs_) {
+      return false;
+    }
+    lockoutUntilUs_ = nowUs + static_cast<uint64_t>(config_.lockoutMs) * 1000;
+    out.atUs = windowPeakUs_;
+    out.peak = peak;
+    return true;
+  }
+
+  StrikeDetectorConfig config_ = {1200, 120, 80};
+  int windowPeak_ = 0;
+  uint64_t windowPeakUs_ = 0;
+  uint32_t windowFill_ = 0;
+  uint64_t lockoutUntilUs_ = 0;
+};
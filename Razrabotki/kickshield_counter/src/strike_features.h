@@ -0,0 +1,207 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+// Waveform features of one strike, for the strike-type classifier
+// (strike_classifier.h). The tracker follows the detector's sample stream in
+// a ring of the last kStrikeHistory samples; when the detector reports a
+// strike it finds the peak among the samples of that window, then waits for
+// kStrikeTail more samples and measures the whole strike in one pass. The
+// firmware and the host tools run this same code, so features from a
+// capture replay match the device's.
+//
+// All features are integers on the detector's sample clock (10 kHz):
+//   amp      peak height above the baseline, ADC counts
+//   rise     samples from the 10 % level to the peak
+//   decay    samples from the peak until it first falls below 25 %
+//   width    area above the baseline / amp, in 1/16 samples
+//   ring     local maxima above 10 % after the peak (pad and limb ringing)
+//   rebound  highest point after the decay, % of amp
+
+static const uint16_t kStrikeLead = 64;        // samples kept before the peak
+static const uint16_t kStrikeTail = 192;       // samples measured after it
+static const uint16_t kStrikeWindowMax = 500;  // longest detector window, 50 ms
+static const uint16_t kStrikeHistory = 1024;   // power of two
+// mark() looks for the peak anywhere in the detector window, and a peak at
+// its far end still needs kStrikeLead samples before it in the ring; by the
+// time its tail is in, the ring must also hold lead and tail.
+static_assert(kStrikeLead + kStrikeWindowMax <= kStrikeHistory && kStrikeLead + kStrikeTail <= kStrikeHistory,
+              "kStrikeHistory too short for the window or the tail");
+static_assert((kStrikeHistory & (kStrikeHistory - 1)) == 0, "kStrikeHistory must be a power of two");
+static const uint8_t kStrikeBaselineSamples = 8;
+
+enum StrikeFeature : uint8_t {
+  FEATURE_AMP,
+  FEATURE_RISE,
+  FEATURE_DECAY,
+  FEATURE_WIDTH,
+  FEATURE_RING,
+  FEATURE_REBOUND,
+  kStrikeFeatureCount
+};
+
+struct StrikeFeatures {
+  int32_t v[kStrikeFeatureCount];
+};
+
+class StrikeFeatureTracker {
+public:
+  void reset() {
+    total_ = 0;
+    pending_ = false;
+  }
+
+  // Feeds one detector-rate sample. Returns true and fills out once the
+  // strike marked last has its full tail.
+  bool push(int sample, StrikeFeatures &out) {
+    ring_[total_ & kMask] = static_cast<uint16_t>(sample);
+    total_++;
+    if (!pending_ || total_ - peakIndex_ < kStrikeTail) {
+      return false;
+    }
+    measure(total_, out);
+    pending_ = false;
+    return true;
+  }
+
+  // The detector has just reported a strike from its last windowSamples
+  // samples, at most kStrikeWindowMax. Ignored, returning false, while the
+  // previous strike still collects its tail, and in the first kStrikeLead
+  // samples after reset(), which have no baseline.
+  bool mark(uint32_t windowSamples) {
+    if (pending_ || total_ < kStrikeLead + windowSamples) {
+      return false;
+    }
+    uint32_t peak = total_ - 1;
+    for (uint32_t i = total_ - windowSamples; i < total_; i++) {
+      if (ring_[i & kMask] > ring_[peak & kMask]) {
+        peak = i;
+      }
+    }
+    peakIndex_ = peak;
+    pending_ = true;
+    return true;
+  }
+
+  // Drops the marked strike unmeasured.
+  void cancel() {
+    pending_ = false;
+  }
+
+  // Measures a marked strike on whatever tail it has, e.g. when the session
+  // stops. Returns false if none is pending.
+  bool finish(StrikeFeatures &out) {
+    if (!pending_) {
+      return false;
+    }
+    measure(total_, out);
+    pending_ = false;
+    return true;
+  }
+
+  bool pending() const {
+    return pending_;
+  }
+
+  // Sample index (since reset()) of the peak of the strike measured last.
+  uint32_t peakIndex() const {
+    return peakIndex_;
+  }
+
+  // Samples seen since the marked peak.
+  uint32_t sinceMark() const {
+    return total_ - peakIndex_;
+  }
+
+  // Copies count samples starting before samples ahead of the marked peak;
+  // any not seen yet repeat the newest. before must not exceed kStrikeLead.
+  void copyAround(int16_t *out, uint16_t before, uint16_t count) const {
+    uint32_t index = peakIndex_ - before;
+    for (uint16_t i = 0; i < count; i++, index++) {
+      out[i] = static_cast<int16_t>(at(index < total_ ? index : total_ - 1));
+    }
+  }
+
+private:
+  static const uint32_t kMask = kStrikeHistory - 1;
+
+  int32_t at(uint32_t index) const {
+    return ring_[index & kMask];
+  }
+
+  // Measures up to end, but never past kStrikeTail samples after the peak:
+  // a peak found early in a long window is marked with more tail already
+  // in, and the features must not depend on the window length.
+  void measure(uint32_t end, StrikeFeatures &out) {
+    if (end - peakIndex_ > kStrikeTail) {
+      end = peakIndex_ + kStrikeTail;
+    }
+    uint32_t start = peakIndex_ - kStrikeLead;
+    int32_t baseline = 0;
+    for (uint32_t i = start; i < start + kStrikeBaselineSamples; i++) {
+      baseline += at(i);
+    }
+    baseline /= kStrikeBaselineSamples;
+    int32_t amp = at(peakIndex_) - baseline;
+    if (amp < 1) {
+      amp = 1;
+    }
+    int32_t tenth = amp / 10;
+    int32_t quarter = amp / 4;
+
+    uint32_t rise = 0;
+    while (rise < kStrikeLead - kStrikeBaselineSamples && at(peakIndex_ - rise - 1) - baseline > tenth) {
+      rise++;
+    }
+    uint32_t onset = peakIndex_ - rise;
+
+    int32_t area = 0;
+    for (uint32_t i = onset; i <= peakIndex_; i++) {
+      int32_t v = at(i) - baseline;
+      area += v > 0 ? v : 0;
+    }
+    // One pass over the tail. A ring peak counts once the signal has come
+    // down amp/16 from it, so sensor noise on the decay is not counted.
+    int32_t hysteresis = amp / 16;
+    uint32_t decay = 0;
+    uint32_t ring = 0;
+    int32_t rebound = 0;
+    int32_t extreme = amp;
+    bool rising = false;
+    for (uint32_t i = peakIndex_ + 1; i < end; i++) {
+      int32_t v = at(i) - baseline;
+      area += v > 0 ? v : 0;
+      if (decay == 0 && v < quarter) {
+        decay = i - peakIndex_;
+      } else if (decay != 0 && v > rebound) {
+        rebound = v;
+      }
+      if (rising ? v > extreme : v < extreme) {
+        extreme = v;
+      } else if (rising && v < extreme - hysteresis) {
+        ring += extreme > tenth ? 1 : 0;
+        rising = false;
+        extreme = v;
+      } else if (!rising && v > extreme + hysteresis) {
+        rising = true;
+        extreme = v;
+      }
+    }
+    if (decay == 0) {
+      decay = end - peakIndex_ - 1;
+    }
+
+    out.v[FEATURE_AMP] = amp;
+    out.v[FEATURE_RISE] = static_cast<int32_t>(rise);
+    out.v[FEATURE_DECAY] = static_cast<int32_t>(decay);
+    out.v[FEATURE_WIDTH] = area * 16 / amp;
+    out.v[FEATURE_RING] = static_cast<int32_t>(ring);
+    out.v[FEATURE_REBOUND] = rebound * 100 / amp;
+  }
+
+  uint16_t ring_[kStrikeHistory];
+  uint32_t total_ = 0;
+  uint32_t peakIndex_ = 0;
+  bool pending_ = false;
+};
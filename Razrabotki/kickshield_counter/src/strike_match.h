@@ -0,0 +1,227 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+// Template check for detected strikes. A candidate's samples around its peak
+// are compared with up to kMatchTemplateMax learned strike shapes by
+// normalized cross-correlation, at lags of +-kMatchLag samples to absorb the
+// peak search jitter. A bag swinging back into the sensor, a hit on the next
+// pad carried through the frame or a footstep on the platform crosses the
+// threshold like a light strike, but its shape is slower or rings lower, so
+// it correlates poorly with every template whatever its height. That lets
+// the threshold stay low enough for light strikes.
+//
+// The correlation is amplitude-free: each template is stored zero-mean in
+// int8, and the candidate's mean and energy come out of the same pass as the
+// dot product. The per-lag sums are plain int16 x int8 loops into int32,
+// which the host compiler vectorizes; on the ESP32 a full check is
+// templates x 5 lags x 64 multiply-adds, a few tens of microseconds once
+// per strike.
+
+static const uint16_t kMatchLead = 16;    // template samples before the peak
+static const uint16_t kMatchLength = 64;
+static const uint8_t kMatchLag = 2;
+static const uint16_t kMatchWindow = kMatchLength + 2 * kMatchLag;
+// Samples needed after the peak before a strike can be checked.
+static const uint16_t kMatchTail = kMatchLength - kMatchLead + kMatchLag;
+static const uint8_t kMatchTemplateMax = 4;
+static const uint32_t kMatchBankMagic = 0x314D544B;  // "KTM1"
+
+struct MatchTemplate {
+  int8_t v[kMatchLength];  // zero-mean, largest |v| is 127
+  uint16_t strikes;        // strikes averaged into it, 0 = empty slot
+};
+
+// All templates, stored in NVS as one blob.
+struct MatchBank {
+  uint32_t magic;
+  MatchTemplate slots[kMatchTemplateMax];
+};
+
+inline uint32_t matchSqrt(uint64_t v) {
+  uint64_t root = 0;
+  uint64_t bit = 1ULL << 62;
+  while (bit > v) {
+    bit >>= 2;
+  }
+  while (bit != 0) {
+    if (v >= root + bit) {
+      v -= root + bit;
+      root = (root >> 1) + bit;
+    } else {
+      root >>= 1;
+    }
+    bit >>= 2;
+  }
+  return static_cast<uint32_t>(root);
+}
+
+// Correlation of x[0..kMatchLength) with a template whose sum is tSum and
+// whose kMatchLength-scaled variance root is tRoot, in percent; 0 when
+// they are uncorrelated or anti-correlated. Samples are 12-bit, so the
+// squares of a whole window still fit an int32.
+inline int matchPercent(const int16_t *x, const int8_t *t, int32_t tSum, uint32_t tRoot) {
+  int32_t sx = 0;
+  int32_t sxx = 0;
+  int32_t sxt = 0;
+  for (uint16_t i = 0; i < kMatchLength; i++) {
+    int32_t v = x[i];
+    sx += v;
+    sxx += v * v;
+    sxt += v * t[i];
+  }
+  int64_t cov = static_cast<int64_t>(kMatchLength) * sxt - static_cast<int64_t>(sx) * tSum;
+  int64_t var = static_cast<int64_t>(kMatchLength) * sxx - static_cast<int64_t>(sx) * sx;
+  uint32_t root = matchSqrt(var > 0 ? static_cast<uint64_t>(var) : 0);
+  if (cov <= 0 || root == 0 || tRoot == 0) {
+    return 0;
+  }
+  int64_t pct = cov * 100 / (static_cast<int64_t>(root) * tRoot);
+  return pct > 100 ? 100 : static_cast<int>(pct);
+}
+
+class StrikeMatcher {
+public:
+  StrikeMatcher() {
+    clear();
+  }
+
+  void clear() {
+    memset(&bank_, 0, sizeof(bank_));
+    bank_.magic = kMatchBankMagic;
+    for (uint8_t k = 0; k < kMatchTemplateMax; k++) {
+      prepare(k);
+    }
+    learnSlot_ = -1;
+  }
+
+  void clear(uint8_t slot) {
+    memset(&bank_.slots[slot], 0, sizeof(MatchTemplate));
+    prepare(slot);
+  }
+
+  // Returns false, keeping the current templates, if the blob is not a bank.
+  bool load(const MatchBank &bank) {
+    if (bank.magic != kMatchBankMagic) {
+      return false;
+    }
+    bank_ = bank;
+    for (uint8_t k = 0; k < kMatchTemplateMax; k++) {
+      prepare(k);
+    }
+    return true;
+  }
+
+  const MatchBank &bank() const {
+    return bank_;
+  }
+
+  uint8_t used() const {
+    uint8_t n = 0;
+    for (uint8_t k = 0; k < kMatchTemplateMax; k++) {
+      n += bank_.slots[k].strikes > 0 ? 1 : 0;
+    }
+    return n;
+  }
+
+  // Best match, in percent, of a window of kMatchWindow samples starting
+  // kMatchLead + kMatchLag before the peak, over all templates and lags.
+  // -1 without templates. slot, if given, gets the best template.
+  int best(const int16_t *window, uint8_t *slot = nullptr) const {
+    int bestPct = -1;
+    for (uint8_t k = 0; k < kMatchTemplateMax; k++) {
+      if (bank_.slots[k].strikes == 0) {
+        continue;
+      }
+      for (uint8_t lag = 0; lag <= 2 * kMatchLag; lag++) {
+        int pct = matchPercent(window + lag, bank_.slots[k].v, sum_[k], root_[k]);
+        if (pct > bestPct) {
+          bestPct = pct;
+          if (slot != nullptr) {
+            *slot = k;
+          }
+        }
+      }
+    }
+    return bestPct;
+  }
+
+  // The next count strikes passed to learn() are averaged into slot,
+  // replacing what it held.
+  void startLearning(uint8_t slot, uint16_t count) {
+    memset(acc_, 0, sizeof(acc_));
+    learnSlot_ = static_cast<int8_t>(slot);
+    learnLeft_ = count;
+    learnCount_ = 0;
+  }
+
+  void cancelLearning() {
+    learnSlot_ = -1;
+  }
+
+  // Slot being learned, -1 if none.
+  int learningSlot() const {
+    return learnSlot_;
+  }
+
+  uint16_t learnLeft() const {
+    return learnSlot_ >= 0 ? learnLeft_ : 0;
+  }
+
+  // Adds one strike window (as for best(), aligned on its peak). Returns
+  // true when it completes the slot.
+  bool learn(const int16_t *window) {
+    if (learnSlot_ < 0) {
+      return false;
+    }
+    const int16_t *x = window + kMatchLag;
+    int32_t mean = 0;
+    for (uint16_t i = 0; i < kMatchLength; i++) {
+      mean += x[i];
+    }
+    mean /= kMatchLength;
+    for (uint16_t i = 0; i < kMatchLength; i++) {
+      acc_[i] += x[i] - mean;
+    }
+    learnCount_++;
+    if (--learnLeft_ > 0) {
+      return false;
+    }
+    int32_t peak = 1;
+    for (uint16_t i = 0; i < kMatchLength; i++) {
+      int32_t a = acc_[i] < 0 ? -acc_[i] : acc_[i];
+      peak = a > peak ? a : peak;
+    }
+    MatchTemplate &t = bank_.slots[learnSlot_];
+    for (uint16_t i = 0; i < kMatchLength; i++) {
+      t.v[i] = static_cast<int8_t>(acc_[i] * 127 / peak);
+    }
+    t.strikes = learnCount_;
+    prepare(static_cast<uint8_t>(learnSlot_));
+    learnSlot_ = -1;
+    return true;
+  }
+
+private:
+  void prepare(uint8_t k) {
+    const int8_t *t = bank_.slots[k].v;
+    int32_t sum = 0;
+    int32_t sumSq = 0;
+    for (uint16_t i = 0; i < kMatchLength; i++) {
+      sum += t[i];
+      sumSq += t[i] * t[i];
+    }
+    sum_[k] = sum;
+    int64_t var = static_cast<int64_t>(kMatchLength) * sumSq - static_cast<int64_t>(sum) * sum;
+    root_[k] = matchSqrt(var > 0 ? static_cast<uint64_t>(var) : 0);
+  }
+
+  MatchBank bank_;
+  int32_t sum_[kMatchTemplateMax];
+  uint32_t root_[kMatchTemplateMax];
+  int32_t acc_[kMatchLength];
+  int8_t learnSlot_ = -1;
+  uint16_t learnLeft_ = 0;
+  uint16_t learnCount_ = 0;
+};
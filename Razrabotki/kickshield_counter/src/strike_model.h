@@ -0,0 +1,28 @@
+#pragma once
+
+// Generated by tools/train_classifier from --synth 400 --seed 1;
+// do not edit. 1600 strikes, held-out accuracy 100.0 % float, 100.0 % int8.
+
+#include "strike_classifier.h"
+
+constexpr int32_t kStrikeModelOffset[kStrikeFeatureCount] = {2226, 16, 73, 970, 1, 32};
+constexpr int16_t kStrikeModelScale[kStrikeFeatureCount] = {11, 550, 127, 12, 7188, 428};
+constexpr int8_t kStrikeModelW1[kStrikeHidden][kStrikeFeatureCount] = {{11, -2, -7, -42, 63, 58},
+    {26, -34, 90, -22, -98, 38},
+    {33, 39, -65, -6, -38, -45},
+    {-29, -58, 8, -20, -14, -38},
+    {-17, 127, 53, 33, -13, 7},
+    {15, 16, -69, 86, -8, 42},
+    {11, -96, -24, -103, 3, -29},
+    {-9, 69, -77, -20, 5, 62}};
+constexpr int32_t kStrikeModelB1[kStrikeHidden] = {78, 2038, 342, 857, 0, 3039, -639, 539};
+constexpr int32_t kStrikeModelM1 = 512;
+constexpr int8_t kStrikeModelW2[kStrikeClassCount][kStrikeHidden] = {{-59, 85, 5, 43, -55, 98, -100, -12},
+    {20, -123, 73, -22, -53, 74, 9, 62},
+    {20, 47, -15, 30, -14, -89, 113, -75},
+    {14, 11, -29, -57, 127, -37, -31, -36}};
+constexpr int32_t kStrikeModelB2[kStrikeClassCount] = {780, -222, -583, 26};
+
+constexpr StrikeModel kStrikeModel = {kStrikeModelOffset, kStrikeModelScale, kStrikeModelW1,
+                                     kStrikeModelB1,     kStrikeModelM1,    kStrikeModelW2,
+                                     kStrikeModelB2};
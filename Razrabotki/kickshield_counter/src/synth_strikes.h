@@ -0,0 +1,383 @@
+#pragma once
+
+#include <math.h>
+#include <stdint.h>
+
+#include "strike_detector.h"
+
+// Synthetic piezo signal for simulate mode and host load runs: baseline with
+// slow drift, sensor noise and optional 50 Hz pickup, plus strike impulses
+// (fast rise, ringing exponential decay) and occasional pad rebounds. The
+// output depends only on the config and sample index, never on wall time, so
+// a given seed produces the same waveform on the device and on a host.
+//
+// disturbPerMinute adds events that are not strikes but cross the threshold
+// all the same: the bag swinging back into the sensor (a slow hump), a hit
+// on a neighbouring pad carried through the frame (slower, deeper and lower
+// ringing) and footsteps on the platform (a dull thud). They draw from their
+// own random stream, so a seed keeps its strikes whatever the rate.
+
+struct SynthStrikeConfig {
+  uint32_t sampleRateHz = 10000;
+  uint32_t hitsPerMinute = 150;  // 0 = idle signal only
+  uint8_t jitterPct = 30;        // +- spread of the interval between strikes
+  uint16_t minPeak = 1500;       // absolute ADC peak range of a strike
+  uint16_t maxPeak = 3900;
+  uint16_t baseline = 150;
+  uint16_t noise = 12;           // approx. standard deviation, ADC counts
+  uint16_t driftAmp = 60;        // bound of the slow baseline wander
+  uint16_t humAmp = 0;           // 50 Hz mains pickup amplitude
+  uint8_t bouncePct = 40;        // chance that a strike is followed by a rebound
+  uint32_t disturbPerMinute = 0;  // swings, crosstalk and footsteps
+  uint16_t minDisturb = 1250;     // absolute ADC peak range of a disturbance
+  uint16_t maxDisturb = 2400;
+  uint32_t seed = 1;
+};
+
+enum SynthEventKind : uint8_t {
+  SYNTH_STRIKE,
+  SYNTH_BOUNCE,
+  SYNTH_SWING,
+  SYNTH_CROSSTALK,
+  SYNTH_FOOTSTEP
+};
+
+class SynthStrikeSource : public SampleSource {
+public:
+  static const uint16_t kTemplateMax = 512;
+  static const uint8_t kVoices = 4;
+
+  explicit SynthStrikeSource(const SynthStrikeConfig &config = SynthStrikeConfig()) {
+    reset(config);
+  }
+
+  void reset(const SynthStrikeConfig &config) {
+    config_ = config;
+    if (config_.sampleRateHz == 0) {
+      config_.sampleRateHz = 10000;
+    }
+    if (config_.maxPeak < config_.minPeak) {
+      config_.maxPeak = config_.minPeak;
+    }
+    if (config_.maxDisturb < config_.minDisturb) {
+      config_.maxDisturb = config_.minDisturb;
+    }
+    rng_ = config_.seed != 0 ? config_.seed : 1;
+    disturbRng_ = rng_ ^ 0x5DEECE66u;
+    sampleIndex_ = 0;
+    drift_ = 0;
+    humPhase_ = 0;
+    humStep_ = static_cast<uint32_t>((50.0 * 4294967296.0) / config_.sampleRateHz);
+    strikes_ = 0;
+    bounces_ = 0;
+    bouncePending_ = false;
+    for (uint8_t i = 0; i < kVoices; i++) {
+      voices_[i].amp = 0;
+    }
+    disturbances_ = 0;
+    disturb_.amp = 0;
+    eventCount_ = 0;
+    buildTemplate();
+    nextStrikeAt_ = config_.hitsPerMinute > 0 ? nextInterval() : UINT32_MAX;
+    nextDisturbAt_ = config_.disturbPerMinute > 0 ? nextDisturbInterval() : UINT32_MAX;
+  }
+
+  int read() override {
+    uint32_t n = sampleIndex_++;
+
+    if (n == nextStrikeAt_) {
+      int32_t amp = static_cast<int32_t>(uniform(config_.minPeak, config_.maxPeak)) - config_.baseline;
+      startVoice(n, amp);
+      noteEvent(n + templatePeak_, SYNTH_STRIKE);
+      strikes_++;
+      if (uniform(0, 99) < config_.bouncePct) {
+        bouncePending_ = true;
+        bounceAt_ = n + msToSamples(uniform(15, 60));
+        bounceAmp_ = amp * static_cast<int32_t>(uniform(20, 45)) / 100;
+      }
+      nextStrikeAt_ = n + nextInterval();
+    }
+    if (bouncePending_ && n == bounceAt_) {
+      startVoice(n, bounceAmp_);
+      noteEvent(n + templatePeak_, SYNTH_BOUNCE);
+      bounces_++;
+      bouncePending_ = false;
+    }
+    if (n == nextDisturbAt_) {
+      startDisturbance(n);
+      nextDisturbAt_ = n + nextDisturbInterval();
+    }
+
+    if ((n & 31) == 0) {
+      drift_ += (rng() & 1) ? 1 : -1;
+      if (drift_ > config_.driftAmp) {
+        drift_ = config_.driftAmp;
+      } else if (drift_ < -static_cast<int32_t>(config_.driftAmp)) {
+        drift_ = -static_cast<int32_t>(config_.driftAmp);
+      }
+    }
+
+    int32_t value = config_.baseline + drift_ + gaussianNoise();
+    if (config_.humAmp > 0) {
+      humPhase_ += humStep_;
+      value += config_.humAmp * kSine64[humPhase_ >> 26] / 127;
+    }
+    for (uint8_t i = 0; i < kVoices; i++) {
+      Voice &v = voices_[i];
+      if (v.amp == 0) {
+        continue;
+      }
+      uint32_t t = n - v.start;
+      if (t >= templateLen_) {
+        v.amp = 0;
+        continue;
+      }
+      value += (v.amp * template_[t]) >> 12;
+    }
+    if (disturb_.amp != 0) {
+      value += disturbanceAt(n);
+    }
+
+    if (value < 0) {
+      return 0;
+    }
+    return value > 4095 ? 4095 : static_cast<int>(value);
+  }
+
+  // Ground truth for load runs: strikes and rebounds emitted so far.
+  uint32_t strikes() const {
+    return strikes_;
+  }
+
+  uint32_t bounces() const {
+    return bounces_;
+  }
+
+  uint32_t disturbances() const {
+    return disturbances_;
+  }
+
+  uint32_t samples() const {
+    return sampleIndex_;
+  }
+
+  // Kind of the recent event whose peak is nearest sample n, for labelling
+  // detections; false if none is remembered.
+  bool eventNear(uint32_t n, SynthEventKind &kind) const {
+    uint32_t best = UINT32_MAX;
+    for (uint8_t i = 0; i < kEventHistory && i < eventCount_; i++) {
+      const Event &e = events_[i];
+      uint32_t d = e.peakAt > n ? e.peakAt - n : n - e.peakAt;
+      if (d < best) {
+        best = d;
+        kind = e.kind;
+      }
+    }
+    return best != UINT32_MAX;
+  }
+
+private:
+  struct Voice {
+    uint32_t start;
+    int32_t amp;
+  };
+
+  struct Disturbance {
+    uint32_t start;
+    uint32_t length;
+    int32_t amp;
+    SynthEventKind kind;
+    float riseS;
+    float decayS;
+    float ringHz;
+  };
+
+  struct Event {
+    uint32_t peakAt;
+    SynthEventKind kind;
+  };
+
+  static const uint8_t kEventHistory = 8;
+
+  static constexpr int8_t kSine64[64] = {
+    0, 12, 25, 37, 49, 60, 71, 81, 90, 98, 106, 112, 117, 122, 125, 126,
+    127, 126, 125, 122, 117, 112, 106, 98, 90, 81, 71, 60, 49, 37, 25, 12,
+    0, -12, -25, -37, -49, -60, -71, -81, -90, -98, -106, -112, -117, -122, -125, -126,
+    -127, -126, -125, -122, -117, -112, -106, -98, -90, -81, -71, -60, -49, -37, -25, -12,
+  };
+
+  // Impulse shape in Q12: 0.6 ms linear rise, then a 2.5 ms exponential
+  // decay carrying a 220 Hz ring of the pad. Cut off below 1 % of the peak.
+  static float shapeAt(float t) {
+    const float riseS = 0.0006f;
+    const float decayS = 0.0025f;
+    const float ringHz = 220.0f;
+    float env = (t < riseS) ? t / riseS : expf(-(t - riseS) / decayS);
+    return env * (0.8f + 0.2f * cosf(6.2831853f * ringHz * t));
+  }
+
+  void buildTemplate() {
+    const float rate = static_cast<float>(config_.sampleRateHz);
+    float peak = 0.0f;
+    templateLen_ = 0;
+    while (templateLen_ < kTemplateMax) {
+      float t = templateLen_ / rate;
+      float s = shapeAt(t);
+      if (s > peak) {
+        peak = s;
+        templatePeak_ = templateLen_;
+      } else if (s < 0.01f * peak) {
+        break;
+      }
+      templateLen_++;
+    }
+    for (uint16_t i = 0; i < templateLen_; i++) {
+      template_[i] = static_cast<int16_t>(shapeAt(i / rate) / peak * 4096.0f);
+    }
+  }
+
+  // One disturbance at a time; one due while another plays is dropped.
+  void startDisturbance(uint32_t n) {
+    if (disturb_.amp != 0) {
+      return;
+    }
+    uint32_t pick = uniform(0, 2, disturbRng_);
+    Disturbance &d = disturb_;
+    d.start = n;
+    d.amp = static_cast<int32_t>(uniform(config_.minDisturb, config_.maxDisturb, disturbRng_)) - config_.baseline;
+    d.kind = static_cast<SynthEventKind>(SYNTH_SWING + pick);
+    if (d.kind == SYNTH_SWING) {
+      d.riseS = uniform(150, 300, disturbRng_) / 1000.0f;  // full hump
+      d.decayS = 0.0f;
+      d.ringHz = 0.0f;
+    } else if (d.kind == SYNTH_CROSSTALK) {
+      d.riseS = uniform(15, 30, disturbRng_) / 10000.0f;
+      d.decayS = uniform(100, 200, disturbRng_) / 10000.0f;
+      d.ringHz = static_cast<float>(uniform(55, 90, disturbRng_));
+    } else {
+      d.riseS = uniform(40, 80, disturbRng_) / 10000.0f;
+      d.decayS = uniform(150, 250, disturbRng_) / 10000.0f;
+      d.ringHz = 0.0f;
+    }
+    float seconds = d.kind == SYNTH_SWING ? d.riseS : d.riseS + 5.0f * d.decayS;
+    d.length = static_cast<uint32_t>(seconds * config_.sampleRateHz);
+    float peakS = d.kind == SYNTH_SWING ? d.riseS / 2 : d.riseS;
+    noteEvent(n + static_cast<uint32_t>(peakS * config_.sampleRateHz), d.kind);
+    disturbances_++;
+  }
+
+  int32_t disturbanceAt(uint32_t n) {
+    Disturbance &d = disturb_;
+    uint32_t i = n - d.start;
+    if (i >= d.length) {
+      d.amp = 0;
+      return 0;
+    }
+    float t = static_cast<float>(i) / config_.sampleRateHz;
+    float s;
+    if (d.kind == SYNTH_SWING) {
+      s = 0.5f - 0.5f * cosf(6.2831853f * t / d.riseS);
+    } else {
+      s = (t < d.riseS) ? t / d.riseS : expf(-(t - d.riseS) / d.decayS);
+      if (d.ringHz > 0.0f) {
+        s *= 0.4f + 0.6f * cosf(6.2831853f * d.ringHz * (t - d.riseS));
+      }
+    }
+    return static_cast<int32_t>(d.amp * s);
+  }
+
+  void noteEvent(uint32_t peakAt, SynthEventKind kind) {
+    events_[eventCount_ % kEventHistory] = Event{peakAt, kind};
+    eventCount_++;
+  }
+
+  void startVoice(uint32_t n, int32_t amp) {
+    uint8_t slot = 0;
+    for (uint8_t i = 0; i < kVoices; i++) {
+      if (voices_[i].amp == 0) {
+        slot = i;
+        break;
+      }
+      if (voices_[i].start < voices_[slot].start) {
+        slot = i;
+      }
+    }
+    voices_[slot].start = n;
+    voices_[slot].amp = amp;
+  }
+
+  uint32_t msToSamples(uint32_t ms) const {
+    return static_cast<uint32_t>(static_cast<uint64_t>(ms) * config_.sampleRateHz / 1000);
+  }
+
+  uint32_t nextInterval() {
+    uint64_t mean = static_cast<uint64_t>(config_.sampleRateHz) * 60 / config_.hitsPerMinute;
+    uint32_t spread = static_cast<uint32_t>(mean * config_.jitterPct / 100);
+    uint64_t interval = mean - spread + uniform(0, 2 * spread);
+    return interval > 0 ? static_cast<uint32_t>(interval) : 1;
+  }
+
+  uint32_t nextDisturbInterval() {
+    uint64_t mean = static_cast<uint64_t>(config_.sampleRateHz) * 60 / config_.disturbPerMinute;
+    uint64_t interval = mean / 2 + uniform(0, static_cast<uint32_t>(mean), disturbRng_);
+    return interval > 0 ? static_cast<uint32_t>(interval) : 1;
+  }
+
+  static uint32_t xorshift(uint32_t &state) {
+    uint32_t x = state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    state = x;
+    return x;
+  }
+
+  uint32_t rng() {
+    return xorshift(rng_);
+  }
+
+  uint32_t uniform(uint32_t lo, uint32_t hi) {
+    return lo + rng() % (hi - lo + 1);
+  }
+
+  static uint32_t uniform(uint32_t lo, uint32_t hi, uint32_t &state) {
+    return lo + xorshift(state) % (hi - lo + 1);
+  }
+
+  // Sum of four uniforms, scaled so the standard deviation is config_.noise.
+  int32_t gaussianNoise() {
+    if (config_.noise == 0) {
+      return 0;
+    }
+    int32_t acc = 0;
+    for (uint8_t i = 0; i < 4; i++) {
+      acc += static_cast<int32_t>(rng() & 0xFFFF) - 32768;
+    }
+    return static_cast<int32_t>(static_cast<int64_t>(acc) * config_.noise / 37837);
+  }
+
+  SynthStrikeConfig config_;
+  int16_t template_[kTemplateMax];
+  uint16_t templateLen_ = 0;
+  uint16_t templatePeak_ = 0;
+  Voice voices_[kVoices];
+  Disturbance disturb_;
+  Event events_[kEventHistory];
+  uint32_t eventCount_ = 0;
+  uint32_t rng_ = 1;
+  uint32_t disturbRng_ = 1;
+  uint32_t nextDisturbAt_ = 0;
+  uint32_t disturbances_ = 0;
+  uint32_t sampleIndex_ = 0;
+  uint32_t nextStrikeAt_ = 0;
+  uint32_t bounceAt_ = 0;
+  int32_t bounceAmp_ = 0;
+  bool bouncePending_ = false;
+  int32_t drift_ = 0;
+  uint32_t humPhase_ = 0;
+  uint32_t humStep_ = 0;
+  uint32_t strikes_ = 0;
+  uint32_t bounces_ = 0;
+};
+
+constexpr int8_t SynthStrikeSource::kSine64[64];
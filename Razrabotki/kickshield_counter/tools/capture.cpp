@@ -0,0 +1,189 @@
+// Host capture tool for the kickshield raw-sample stream.
+//
+// Reads the COBS-framed stream that POST /api/capture?div=N turns on, checks
+// CRCs and sequence numbers, and writes a .ksr capture file for replay
+// (--input) plus <out>.hits.csv with the hits the device detected, as
+// labels. Samples lost on the link are filled with 0 and reported.
+//
+// Build (from this directory):
+//   g++ -std=gnu++17 -O2 -I../src capture.cpp -o capture
+//
+// Usage:
+//   ./capture [--baud N] [--seconds N] <serial-port | file | -> <out.ksr>
+//
+// The firmware streams at 921600 baud. Stop with Ctrl-C, after --seconds, or
+// at the end of a file.
+
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <string>
+#include <termios.h>
+#include <unistd.h>
+
+#include "sample_stream.h"
+
+namespace {
+
+volatile sig_atomic_t stopRequested = 0;
+
+void onSignal(int) {
+  stopRequested = 1;
+}
+
+speed_t baudConstant(unsigned long baud) {
+  switch (baud) {
+    case 115200: return B115200;
+    case 230400: return B230400;
+    case 460800: return B460800;
+    case 921600: return B921600;
+    case 1500000: return B1500000;
+    case 2000000: return B2000000;
+    default: return B0;
+  }
+}
+
+bool configurePort(int fd, unsigned long baud) {
+  termios tio;
+  if (tcgetattr(fd, &tio) != 0) {
+    return false;
+  }
+  cfmakeraw(&tio);
+  tio.c_cc[VMIN] = 0;
+  tio.c_cc[VTIME] = 2;
+  speed_t speed = baudConstant(baud);
+  return speed != B0 && cfsetspeed(&tio, speed) == 0 && tcsetattr(fd, TCSANOW, &tio) == 0;
+}
+
+struct Stats {
+  uint32_t frames = 0;
+  uint32_t samples = 0;
+  uint32_t lostSamples = 0;
+  uint32_t lostFrames = 0;
+  uint32_t hits = 0;
+  uint32_t rewinds = 0;
+};
+
+} // namespace
+
+int main(int argc, char **argv) {
+  unsigned long baud = 921600;
+  unsigned long seconds = 0;
+  int argi = 1;
+  for (; argi + 1 < argc && strncmp(argv[argi], "--", 2) == 0; argi += 2) {
+    if (strcmp(argv[argi], "--baud") == 0) {
+      baud = strtoul(argv[argi + 1], nullptr, 10);
+    } else if (strcmp(argv[argi], "--seconds") == 0) {
+      seconds = strtoul(argv[argi + 1], nullptr, 10);
+    } else {
+      break;
+    }
+  }
+  if (argc - argi != 2) {
+    fprintf(stderr, "usage: %s [--baud N] [--seconds N] <serial-port | file | -> <out.ksr>\n", argv[0]);
+    return 2;
+  }
+  const char *inputPath = argv[argi];
+  const char *outPath = argv[argi + 1];
+
+  int in = strcmp(inputPath, "-") == 0 ? STDIN_FILENO : open(inputPath, O_RDONLY | O_NOCTTY);
+  if (in < 0) {
+    perror(inputPath);
+    return 1;
+  }
+  if (isatty(in) && !configurePort(in, baud)) {
+    fprintf(stderr, "%s: cannot set %lu baud\n", inputPath, baud);
+    return 1;
+  }
+  FILE *out = fopen(outPath, "wb");
+  std::string hitsPath = std::string(outPath) + ".hits.csv";
+  FILE *hitsOut = fopen(hitsPath.c_str(), "w");
+  if (out == nullptr || hitsOut == nullptr) {
+    perror(out == nullptr ? outPath : hitsPath.c_str());
+    return 1;
+  }
+  fprintf(hitsOut, "sample_index,peak\n");
+
+  RawCaptureHeader header = {kRawCaptureMagic, 0, 0, 0, 0};
+  fwrite(&header, sizeof(header), 1, out);
+
+  signal(SIGINT, onSignal);
+  signal(SIGTERM, onSignal);
+  time_t deadline = seconds ? time(nullptr) + static_cast<time_t>(seconds) : 0;
+
+  SampleStreamDecoder decoder;
+  StreamFrame frame;
+  Stats stats;
+  bool haveSeq = false;
+  uint16_t nextSeq = 0;
+  uint32_t nextIndex = 0;
+  uint8_t buf[4096];
+  static const uint16_t kZeros[kStreamBlockSamples] = {};
+
+  while (!stopRequested && (deadline == 0 || time(nullptr) < deadline)) {
+    ssize_t n = read(in, buf, sizeof(buf));
+    if (n == 0 && !isatty(in)) {
+      break;
+    }
+    if (n < 0) {
+      if (stopRequested) {
+        break;
+      }
+      perror("read");
+      return 1;
+    }
+    for (ssize_t i = 0; i < n; i++) {
+      if (!decoder.feed(buf[i], frame)) {
+        continue;
+      }
+      stats.frames++;
+      if (haveSeq && frame.seq != nextSeq) {
+        stats.lostFrames += static_cast<uint16_t>(frame.seq - nextSeq);
+      }
+      haveSeq = true;
+      nextSeq = static_cast<uint16_t>(frame.seq + 1);
+
+      if (frame.type == STREAM_HIT) {
+        stats.hits++;
+        fprintf(hitsOut, "%lu,%u\n", static_cast<unsigned long>(frame.index), frame.peak);
+        continue;
+      }
+      if (header.intervalUs == 0) {
+        header.intervalUs = frame.intervalUs;
+      }
+      if (frame.index < nextIndex) {
+        // Capture restarted on the device; keep one continuous file.
+        stats.rewinds++;
+        nextIndex = frame.index;
+      }
+      uint32_t gap = frame.index - nextIndex;
+      stats.lostSamples += gap;
+      while (gap > 0) {
+        uint32_t chunk = gap < kStreamBlockSamples ? gap : kStreamBlockSamples;
+        fwrite(kZeros, sizeof(uint16_t), chunk, out);
+        gap -= chunk;
+      }
+      fwrite(frame.samples, sizeof(uint16_t), frame.count, out);
+      stats.samples += frame.count;
+      nextIndex = frame.index + frame.count;
+    }
+  }
+
+  header.sampleCount = stats.samples + stats.lostSamples;
+  header.lostSamples = stats.lostSamples;
+  fseek(out, 0, SEEK_SET);
+  fwrite(&header, sizeof(header), 1, out);
+  fclose(out);
+  fclose(hitsOut);
+
+  double captured = header.intervalUs ? header.sampleCount * (header.intervalUs / 1e6) : 0.0;
+  printf("frames=%u bad=%u lost_frames=%u rewinds=%u\n", stats.frames, decoder.badFrames(), stats.lostFrames,
+         stats.rewinds);
+  printf("samples=%u lost_samples=%u interval=%uus (%.2f s of signal) hits=%u\n", stats.samples,
+         stats.lostSamples, header.intervalUs, captured, stats.hits);
+  printf("wrote %s and %s\n", outPath, hitsPath.c_str());
+  return 0;
+}
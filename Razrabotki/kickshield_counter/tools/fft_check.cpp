@@ -0,0 +1,426 @@
+// Host check of the fixed-point FFT and spectral diagnostics.
+//
+// Compares the firmware's FixedFft (fixed_fft.h) with a double-precision
+// FFT of the same input, for the compile-time twiddle and Hann tables and
+// for a set of signals: white noise at full scale and at sensor-noise
+// level, pure tones on and between bins, an impulse, and the strike and
+// noise windows the diagnostics feed it. Errors are reported as SNR of the
+// fixed-point spectrum against the reference and as the largest bin error
+// relative to the largest bin.
+//
+// It then runs the firmware's SpectrumDiag over a pad signal, collected the
+// way processSensor() does, next to the same report computed from double
+// FFTs of the same windows, and with what the signal was made of: strikes
+// ringing at --ring Hz and decaying over --decay ms, white sensor noise of
+// --noise counts and --hum counts of 50 Hz pickup. (The simulate-mode
+// generator is not used here: its ring dies within half a period, so it has
+// no resonance to find.)
+//
+// Build (from this directory):
+//   g++ -std=gnu++17 -O2 -I../src fft_check.cpp -o fft_check
+//
+// Usage:
+//   ./fft_check [--seconds N] [--seed N] [--noise N] [--hum N] [--ring HZ] [--decay MS]
+//
+// Exits non-zero if any FFT case falls below kMinSnrDb.
+
+#include <chrono>
+#include <cmath>
+#include <complex>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "fixed_fft.h"
+#include "spectrum_diag.h"
+#include "strike_detector.h"
+#include "strike_features.h"
+#include "synth_strikes.h"  // strike window for the FFT cases
+
+namespace {
+
+const uint16_t kN = kDiagFftSize;
+const uint32_t kSampleRateHz = 10000;
+const double kMinSnrDb = 60.0;
+
+struct Options {
+  uint32_t seconds = 60;
+  uint32_t seed = 1;
+  uint32_t noise = 12;
+  uint32_t hum = 30;
+  uint32_t ringHz = 180;
+  uint32_t decayMs = 8;
+};
+
+typedef std::complex<double> Complex;
+
+void referenceFft(std::vector<Complex> &x) {
+  const size_t n = x.size();
+  for (size_t i = 1, j = 0; i < n; i++) {
+    size_t bit = n >> 1;
+    for (; j & bit; bit >>= 1) {
+      j ^= bit;
+    }
+    j |= bit;
+    if (i < j) {
+      std::swap(x[i], x[j]);
+    }
+  }
+  for (size_t size = 2; size <= n; size <<= 1) {
+    Complex w(cos(2 * M_PI / size), -sin(2 * M_PI / size));
+    for (size_t start = 0; start < n; start += size) {
+      Complex wk(1.0, 0.0);
+      for (size_t k = 0; k < size / 2; k++) {
+        Complex t = wk * x[start + k + size / 2];
+        x[start + k + size / 2] = x[start + k] - t;
+        x[start + k] += t;
+        wk *= w;
+      }
+    }
+  }
+}
+
+uint32_t rngState = 1;
+
+uint32_t rng() {
+  uint32_t x = rngState;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  rngState = x;
+  return x;
+}
+
+double gaussian() {
+  double acc = 0.0;
+  for (int i = 0; i < 12; i++) {
+    acc += rng() / 4294967296.0;
+  }
+  return acc - 6.0;
+}
+
+// Fixed-point spectrum of input against the double reference.
+bool compare(const char *name, const int32_t *input) {
+  int32_t re[kN];
+  int32_t im[kN] = {};
+  memcpy(re, input, sizeof(re));
+  uint8_t shift = FixedFft<kN>::transform(re, im);
+
+  std::vector<Complex> ref(kN);
+  for (uint16_t i = 0; i < kN; i++) {
+    ref[i] = Complex(input[i], 0.0);
+  }
+  referenceFft(ref);
+
+  double signal = 0.0;
+  double error = 0.0;
+  double peak = 0.0;
+  double worst = 0.0;
+  for (uint16_t k = 0; k < kN; k++) {
+    Complex got(ldexp(re[k], shift), ldexp(im[k], shift));
+    double e = std::abs(got - ref[k]);
+    signal += std::norm(ref[k]);
+    error += e * e;
+    peak = std::max(peak, std::abs(ref[k]));
+    worst = std::max(worst, e);
+  }
+  double snr = error > 0.0 ? 10.0 * log10(signal / error) : 200.0;
+  bool ok = snr >= kMinSnrDb;
+  printf("%-28s shift=%u snr=%6.1f dB  max_err=%.2e of peak  %s\n", name, shift, snr, peak > 0 ? worst / peak : 0.0,
+         ok ? "ok" : "FAIL");
+  return ok;
+}
+
+bool checkTables() {
+  double cosErr = 0.0;
+  double sinErr = 0.0;
+  double hannErr = 0.0;
+  for (uint16_t k = 0; k < kN / 2; k++) {
+    cosErr = std::max(cosErr, fabs(FftTwiddles<kN>::kCos[k] - 32767.0 * cos(2 * M_PI * k / kN)));
+    sinErr = std::max(sinErr, fabs(FftTwiddles<kN>::kSin[k] - 32767.0 * sin(2 * M_PI * k / kN)));
+  }
+  for (uint16_t i = 0; i < kN; i++) {
+    double s = sin(M_PI * i / kN);
+    hannErr = std::max(hannErr, fabs(FftHann<kN>::kWindow[i] - 32767.0 * s * s));
+  }
+  // Rounded to nearest, so half a step at most (up to float noise on ties).
+  bool ok = cosErr <= 0.5001 && sinErr <= 0.5001 && hannErr <= 0.5001;
+  printf("tables: max error cos=%.3f sin=%.3f hann=%.3f Q15 steps  %s\n", cosErr, sinErr, hannErr,
+         ok ? "ok" : "FAIL");
+  return ok;
+}
+
+bool checkSignals(const Options &opt) {
+  bool ok = true;
+  int32_t x[kN];
+
+  for (uint16_t i = 0; i < kN; i++) {
+    x[i] = static_cast<int32_t>((rng() & 0xFFF) - 2048) * 32768;
+  }
+  ok &= compare("white, full scale", x);
+
+  for (uint16_t i = 0; i < kN; i++) {
+    x[i] = static_cast<int32_t>(lround(opt.noise * gaussian())) * FftHann<kN>::kWindow[i];
+  }
+  ok &= compare("white, sensor noise + hann", x);
+
+  for (uint16_t i = 0; i < kN; i++) {
+    x[i] = static_cast<int32_t>(lround(1000.0 * sin(2 * M_PI * 12 * i / kN))) * 32768;
+  }
+  ok &= compare("tone on bin 12", x);
+
+  for (uint16_t i = 0; i < kN; i++) {
+    x[i] = static_cast<int32_t>(lround(3.0 * sin(2 * M_PI * 10.24 * i / kN))) * FftHann<kN>::kWindow[i];
+  }
+  ok &= compare("tone 3 counts, bin 10.24", x);
+
+  memset(x, 0, sizeof(x));
+  x[0] = 4095 * 32768;
+  ok &= compare("impulse", x);
+
+  // One strike window of the generator, as addStrike() feeds it.
+  SynthStrikeConfig synthConfig;
+  synthConfig.hitsPerMinute = 600;
+  synthConfig.seed = opt.seed;
+  SynthStrikeSource source(synthConfig);
+  std::vector<int16_t> signal(kSampleRateHz);
+  for (int16_t &v : signal) {
+    v = static_cast<int16_t>(source.read());
+  }
+  size_t peakAt = kN;
+  for (size_t i = kN; i + kN < signal.size(); i++) {
+    peakAt = signal[i] > signal[peakAt] ? i : peakAt;
+  }
+  const int16_t *w = &signal[peakAt - kStrikeLead];
+  x[0] = 0;
+  for (uint16_t i = 1; i < kN; i++) {
+    x[i] = static_cast<int32_t>(w[i] - w[i - 1]) * 32768;
+  }
+  ok &= compare("strike window, differenced", x);
+  return ok;
+}
+
+// Pad signal at kSampleRateHz: baseline, white noise, mains hum and a strike
+// every 300-500 ms whose ring is a damped cosine on a decaying envelope.
+class PadSignal {
+public:
+  explicit PadSignal(const Options &opt) : opt_(opt) {}
+
+  int read() {
+    double t = n_ / static_cast<double>(kSampleRateHz);
+    if (n_ == nextStrike_) {
+      strikeAt_ = n_;
+      amp_ = 2000.0 + (rng() % 1900);
+      nextStrike_ = n_ + kSampleRateHz * 3 / 10 + rng() % (kSampleRateHz / 5);
+    }
+    double v = 150.0 + opt_.noise * gaussian() + opt_.hum * sin(2 * M_PI * 50.0 * t);
+    if (strikeAt_ != UINT32_MAX) {
+      double s = (n_ - strikeAt_) / static_cast<double>(kSampleRateHz);
+      const double riseS = 0.0006;
+      double env = s < riseS ? s / riseS : exp(-(s - riseS) * 1000.0 / opt_.decayMs);
+      v += amp_ * env * (0.5 + 0.5 * cos(2 * M_PI * opt_.ringHz * s));
+    }
+    n_++;
+    return static_cast<int>(std::min(4095.0, std::max(0.0, v)));
+  }
+
+private:
+  const Options &opt_;
+  uint32_t n_ = 0;
+  uint32_t nextStrike_ = kSampleRateHz / 2;
+  uint32_t strikeAt_ = UINT32_MAX;
+  double amp_ = 0.0;
+};
+
+// Power spectrum of input by the double FFT, added to power with the
+// fixed-point path's scaling.
+void referencePower(const int32_t *input, int inputBits, double *power) {
+  std::vector<Complex> x(kN);
+  for (uint16_t i = 0; i < kN; i++) {
+    x[i] = Complex(input[i], 0.0);
+  }
+  referenceFft(x);
+  for (uint16_t k = 0; k < kDiagBins; k++) {
+    power[k] += std::norm(x[k]) * ldexp(1.0, -2 * inputBits);
+  }
+}
+
+void printReport(const char *name, const DiagReport &r) {
+  printf("%-9s resonance=%7.1f Hz  noise=%6.2f  hum=%6.2f (%5.1f %%)  bands:", name, r.resonanceHz, r.noiseRms,
+         r.humRms, r.humPct);
+  for (uint8_t b = 0; b < kDiagBands; b++) {
+    printf(" %.2f", r.bands[b]);
+  }
+  printf("\n");
+}
+
+// The firmware's collection: strike windows from the tracker when a
+// strike's tail is in, noise windows from runs of kDiagNoiseDecimation-sample
+// averages starting kDiagQuietMs after the last detection, each held back
+// until the detector could no longer report a strike inside it.
+void checkDiagnostics(const Options &opt) {
+  const uint32_t quietSamples = kDiagQuietMs * kSampleRateHz / 1000;
+  const uint32_t noiseRateHz = kSampleRateHz / kDiagNoiseDecimation;
+  PadSignal pad(opt);
+
+  StrikeDetectorConfig detectorConfig;
+  detectorConfig.threshold = 1200;
+  detectorConfig.lockoutMs = 120;
+  detectorConfig.windowSamples = 80;
+  StrikeDetector detector;
+  detector.configure(detectorConfig);
+  detector.reset();
+  StrikeFeatureTracker tracker;
+  tracker.reset();
+  SpectrumDiag diag;
+  double strikeRef[kDiagBins] = {};
+  double noiseRef[kDiagBins] = {};
+
+  int16_t window[kN];
+  int32_t input[kN];
+  uint16_t noiseFill = 0;
+  int32_t decimAcc = 0;
+  uint8_t decimFill = 0;
+  uint32_t quiet = 0;
+  uint32_t hold = 0;
+  std::chrono::nanoseconds diagTime{0};
+  uint32_t windows = 0;
+  const uint32_t total = opt.seconds * kSampleRateHz;
+  for (uint32_t n = 0; n < total; n++) {
+    int sample = pad.read();
+    StrikeFeatures features;
+    if (tracker.push(sample, features)) {
+      tracker.copyAround(window, kStrikeLead, kN);
+      auto start = std::chrono::steady_clock::now();
+      diag.addStrike(window, kSampleRateHz);
+      diagTime += std::chrono::steady_clock::now() - start;
+      windows++;
+      input[0] = 0;
+      for (uint16_t i = 1; i < kN; i++) {
+        input[i] = static_cast<int32_t>(window[i] - window[i - 1]) * 32768;
+      }
+      referencePower(input, 15, strikeRef);
+    }
+    Strike strike;
+    if (detector.push(sample, static_cast<uint64_t>(n) * (1000000 / kSampleRateHz), strike)) {
+      tracker.mark(detector.windowSamples());
+      quiet = 0;
+      noiseFill = 0;
+      decimAcc = 0;
+      decimFill = 0;
+      continue;
+    }
+    if (quiet < quietSamples) {
+      quiet++;
+      continue;
+    }
+    if (noiseFill < kN) {
+      decimAcc += sample;
+      if (++decimFill < kDiagNoiseDecimation) {
+        continue;
+      }
+      window[noiseFill++] = static_cast<int16_t>(decimAcc / kDiagNoiseDecimation);
+      decimAcc = 0;
+      decimFill = 0;
+      hold = kDiagHoldWindows * detector.windowSamples();
+      continue;
+    }
+    if (--hold > 0) {
+      continue;
+    }
+    noiseFill = 0;
+    auto start = std::chrono::steady_clock::now();
+    diag.addNoise(window, noiseRateHz);
+    diagTime += std::chrono::steady_clock::now() - start;
+    windows++;
+    int32_t mean = 0;
+    for (uint16_t i = 0; i < kN; i++) {
+      mean += window[i];
+    }
+    mean /= kN;
+    for (uint16_t i = 0; i < kN; i++) {
+      input[i] = (window[i] - mean) * FftHann<kN>::kWindow[i];
+    }
+    referencePower(input, 0, noiseRef);
+  }
+
+  DiagReport fixed;
+  diag.report(fixed);
+  DiagReport reference = fixed;
+  float strikePower[kDiagBins];
+  float noisePower[kDiagBins];
+  for (uint16_t k = 0; k < kDiagBins; k++) {
+    strikePower[k] = static_cast<float>(strikeRef[k]);
+    noisePower[k] = static_cast<float>(noiseRef[k]);
+  }
+  reference.resonanceHz = diagResonanceHz(strikePower, fixed.resonanceBinHz);
+  diagNoiseReport(noisePower, fixed.noiseWindows, static_cast<float>(noiseRateHz) / kN, reference);
+
+  printf("\ndiagnostics over %u s: strikes=%u noise_windows=%u, %.0f ns per window (FFT + sums)\n", opt.seconds,
+         fixed.strikes, fixed.noiseWindows, windows ? static_cast<double>(diagTime.count()) / windows : 0.0);
+  printReport("fixed", fixed);
+  printReport("double", reference);
+  // Averaging kDiagNoiseDecimation samples leaves 1/sqrt(8) of white noise.
+  double white = opt.noise / sqrt(static_cast<double>(kDiagNoiseDecimation));
+  double hum = opt.hum / sqrt(2.0);
+  printf("%-9s resonance=%7.1f Hz  noise=%6.2f  hum=%6.2f, strike bins of %.1f Hz\n", "signal",
+         static_cast<double>(opt.ringHz), sqrt(white * white + hum * hum), hum, fixed.resonanceBinHz);
+}
+
+void timeFft() {
+  int32_t input[kN];
+  for (uint16_t i = 0; i < kN; i++) {
+    input[i] = static_cast<int32_t>((rng() & 0xFFF) - 2048) * 32768;
+  }
+  const uint32_t rounds = 20000;
+  uint32_t sink = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t r = 0; r < rounds; r++) {
+    int32_t re[kN];
+    int32_t im[kN] = {};
+    memcpy(re, input, sizeof(re));
+    sink += FixedFft<kN>::transform(re, im) + static_cast<uint32_t>(re[r % kN]);
+  }
+  double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / rounds;
+  printf("fixed FFT, %u points: %.0f ns (checksum %u)\n", kN, ns, sink);
+}
+
+bool parseArgs(int argc, char **argv, Options &opt) {
+  for (int i = 1; i + 1 < argc; i += 2) {
+    unsigned long v = strtoul(argv[i + 1], nullptr, 10);
+    if (strcmp(argv[i], "--seconds") == 0) {
+      opt.seconds = v;
+    } else if (strcmp(argv[i], "--seed") == 0) {
+      opt.seed = v ? v : 1;
+    } else if (strcmp(argv[i], "--noise") == 0) {
+      opt.noise = v;
+    } else if (strcmp(argv[i], "--hum") == 0) {
+      opt.hum = v;
+    } else if (strcmp(argv[i], "--ring") == 0) {
+      opt.ringHz = v;
+    } else if (strcmp(argv[i], "--decay") == 0) {
+      opt.decayMs = v;
+    } else {
+      return false;
+    }
+  }
+  return argc % 2 == 1 && opt.seconds > 0 && opt.decayMs > 0;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  Options opt;
+  if (!parseArgs(argc, argv, opt)) {
+    fprintf(stderr, "usage: %s [--seconds N] [--seed N] [--noise N] [--hum N] [--ring HZ] [--decay MS]\n",
+            argv[0]);
+    return 2;
+  }
+  rngState = opt.seed;
+  bool ok = checkTables();
+  ok &= checkSignals(opt);
+  timeFft();
+  checkDiagnostics(opt);
+  return ok ? 0 : 1;
+}
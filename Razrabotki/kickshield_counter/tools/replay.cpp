@@ -0,0 +1,467 @@
+// Host replay harness for the kickshield detector.
+//
+// Runs the firmware's StrikeDetector over the same synthetic strike
+// generator that simulate mode uses on the device, and reports detections
+// against the generator's ground truth. --sweep raises the strike rate step
+// by step to find the highest rate the detector settings can follow.
+//
+// --oversample R puts the firmware's DecimatingSource in front of the
+// detector, with the generator running R times faster; --compare runs
+// R = 1, 2, 4, 8 side by side. noise_sd is the standard deviation of the
+// idle signal at the detector input, peak_sd the spread of detected peaks
+// (use --peak to give every strike the same amplitude), ns/sample the host
+// cost per detector sample including the R raw reads.
+//
+// --input FILE.ksr replays a capture written by tools/capture instead of the
+// generator, and compares with the device's hits in FILE.ksr.hits.csv.
+//
+// --disturb N mixes N bag swings, neighbour hits and footsteps per minute
+// into the generator's signal; detections they cause are counted as false.
+// --match PCT runs the firmware's template check (strike_match.h) behind
+// the detector: the first --learn N true strikes are averaged into a
+// template, and every later detection must correlate at least PCT % with
+// it. The gate line reports true and false detections before and after the
+// check, false detections per minute and the host cost of one check.
+//
+// Build (from this directory):
+//   g++ -std=gnu++17 -O2 -I../src replay.cpp -o replay
+//
+// Usage:
+//   ./replay [--seconds N] [--rate HPM] [--seed N] [--noise N] [--bounce PCT]
+//            [--threshold N] [--lockout MS] [--window MS] [--start-us N]
+//            [--oversample R] [--peak N] [--compare] [--sweep] [--input FILE.ksr]
+//            [--disturb N] [--match PCT] [--learn N]
+//
+// Defaults match the firmware defaults (threshold 1200, lockout 120 ms,
+// window 8 ms, 10 kHz sampling). --start-us fast-forwards the clock the
+// detector sees; e.g. 4294960000000 starts 7 s before the 32-bit millis()
+// wrap, and the detections must match a run from 0.
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "oversample.h"
+#include "sample_stream.h"
+#include "strike_detector.h"
+#include "strike_features.h"
+#include "strike_match.h"
+#include "synth_strikes.h"
+
+namespace {
+
+const uint32_t kSampleIntervalUs = 100;
+
+struct Options {
+  uint32_t seconds = 60;
+  uint32_t rateHpm = 150;
+  uint32_t seed = 1;
+  uint32_t noise = 12;
+  uint32_t bouncePct = 40;
+  int threshold = 1200;
+  uint32_t lockoutMs = 120;
+  uint32_t windowMs = 8;
+  uint64_t startUs = 0;
+  uint32_t oversample = 1;
+  uint32_t peak = 0;  // 0 = generator's default amplitude range
+  uint32_t disturb = 0;
+  uint32_t matchPct = 0;  // 0 = no template check
+  uint32_t learn = 8;
+  bool compare = false;
+  bool sweep = false;
+  const char *input = nullptr;
+};
+
+struct RunResult {
+  uint32_t strikes;
+  uint32_t bounces;
+  uint32_t detected;
+  uint32_t samples;
+  double nsPerSample;
+  double noiseSd;
+  double peakSd;
+  uint32_t disturbances;
+  uint32_t falseDetected;  // detections caused by a disturbance
+  uint32_t learned;
+  uint32_t keptTrue;       // after the template check
+  uint32_t keptFalse;
+  uint32_t checks;
+  double nsPerCheck;
+};
+
+SynthStrikeConfig synthConfigFor(const Options &opt, uint32_t rateHpm, uint32_t ratio) {
+  SynthStrikeConfig synthConfig;
+  synthConfig.sampleRateHz = 1000000UL / kSampleIntervalUs * ratio;
+  synthConfig.hitsPerMinute = rateHpm;
+  synthConfig.noise = static_cast<uint16_t>(opt.noise);
+  synthConfig.bouncePct = static_cast<uint8_t>(opt.bouncePct);
+  synthConfig.seed = opt.seed;
+  synthConfig.disturbPerMinute = opt.disturb;
+  if (opt.peak > 0) {
+    synthConfig.minPeak = static_cast<uint16_t>(opt.peak);
+    synthConfig.maxPeak = static_cast<uint16_t>(opt.peak);
+  }
+  return synthConfig;
+}
+
+double standardDeviation(double sum, double sumSq, uint32_t n) {
+  if (n < 2) {
+    return 0.0;
+  }
+  double mean = sum / n;
+  double var = sumSq / n - mean * mean;
+  return var > 0.0 ? sqrt(var) : 0.0;
+}
+
+// Idle signal (no strikes, no drift) at the detector input.
+template <uint8_t Ratio>
+double idleNoiseSd(const Options &opt) {
+  SynthStrikeConfig synthConfig = synthConfigFor(opt, 0, Ratio);
+  synthConfig.driftAmp = 0;
+  SynthStrikeSource raw(synthConfig);
+  DecimatingSource<Ratio> source(raw);
+  const uint32_t n = 1000000 / kSampleIntervalUs;
+  double sum = 0.0;
+  double sumSq = 0.0;
+  for (uint32_t i = 0; i < n; i++) {
+    double v = source.read();
+    sum += v;
+    sumSq += v * v;
+  }
+  return standardDeviation(sum, sumSq, n);
+}
+
+// Detections that follow the template check, as processSensor() runs it: a
+// strike is held until kMatchTail samples after its peak, then checked or,
+// while the template is still being learned, learned from.
+struct MatchGate {
+  StrikeFeatureTracker tracker;
+  StrikeMatcher matcher;
+  Strike held;
+  bool heldTrue = false;
+  bool holding = false;
+  uint32_t matchPct = 0;
+  uint32_t learned = 0;
+  uint32_t keptTrue = 0;
+  uint32_t keptFalse = 0;
+  uint32_t checks = 0;
+  std::chrono::nanoseconds checkTime{0};
+
+  void begin(uint32_t pct, uint32_t learnCount) {
+    tracker.reset();
+    matcher.clear();
+    matchPct = pct;
+    if (learnCount > 0) {
+      matcher.startLearning(0, static_cast<uint16_t>(learnCount));
+    }
+  }
+
+  void push(int sample) {
+    StrikeFeatures features;
+    tracker.push(sample, features);
+    if (holding && tracker.sinceMark() >= kMatchTail) {
+      settle();
+    }
+  }
+
+  void detected(const Strike &strike, bool isTrue, uint32_t windowSamples) {
+    if (!tracker.mark(windowSamples)) {
+      keep(isTrue);
+      return;
+    }
+    held = strike;
+    heldTrue = isTrue;
+    holding = true;
+    if (tracker.sinceMark() >= kMatchTail) {
+      settle();
+    }
+  }
+
+  void settle() {
+    holding = false;
+    tracker.cancel();
+    int16_t window[kMatchWindow];
+    tracker.copyAround(window, kMatchLead + kMatchLag, kMatchWindow);
+    // Learning takes clean strikes only, as a coach would hit the pad.
+    if (matcher.learningSlot() >= 0) {
+      if (heldTrue) {
+        matcher.learn(window);
+        learned++;
+      }
+      keep(heldTrue);
+      return;
+    }
+    auto start = std::chrono::steady_clock::now();
+    int pct = matcher.best(window);
+    checkTime += std::chrono::steady_clock::now() - start;
+    checks++;
+    if (pct < 0 || pct >= static_cast<int>(matchPct)) {
+      keep(heldTrue);
+    }
+  }
+
+  void keep(bool isTrue) {
+    (isTrue ? keptTrue : keptFalse)++;
+  }
+};
+
+template <uint8_t Ratio>
+RunResult runWith(const Options &opt, uint32_t rateHpm) {
+  SynthStrikeSource raw(synthConfigFor(opt, rateHpm, Ratio));
+  DecimatingSource<Ratio> source(raw);
+
+  StrikeDetectorConfig detectorConfig;
+  detectorConfig.threshold = opt.threshold;
+  detectorConfig.lockoutMs = opt.lockoutMs;
+  detectorConfig.windowSamples = opt.windowMs * 1000 / kSampleIntervalUs;
+  StrikeDetector detector;
+  detector.configure(detectorConfig);
+  detector.reset();
+
+  MatchGate gate;
+  gate.begin(opt.matchPct, opt.learn);
+
+  const uint32_t total = opt.seconds * (1000000UL / kSampleIntervalUs);
+  uint32_t detected = 0;
+  uint32_t falseDetected = 0;
+  double peakSum = 0.0;
+  double peakSumSq = 0.0;
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t n = 0; n < total; n++) {
+    Strike strike;
+    uint64_t nowUs = opt.startUs + static_cast<uint64_t>(n) * kSampleIntervalUs;
+    int sample = source.read();
+    if (opt.matchPct > 0) {
+      gate.push(sample);
+    }
+    if (detector.push(sample, nowUs, strike)) {
+      detected++;
+      peakSum += strike.peak;
+      peakSumSq += static_cast<double>(strike.peak) * strike.peak;
+      // The event behind the peak, in generator samples.
+      uint32_t peakSample = static_cast<uint32_t>((strike.atUs - opt.startUs) / kSampleIntervalUs);
+      SynthEventKind kind = SYNTH_STRIKE;
+      raw.eventNear(peakSample * Ratio + Ratio - 1, kind);
+      bool isTrue = kind == SYNTH_STRIKE || kind == SYNTH_BOUNCE;
+      falseDetected += isTrue ? 0 : 1;
+      if (opt.matchPct > 0) {
+        gate.detected(strike, isTrue, detector.windowSamples());
+      }
+    }
+  }
+  auto elapsed = std::chrono::steady_clock::now() - start;
+
+  RunResult result;
+  result.strikes = raw.strikes();
+  result.bounces = raw.bounces();
+  result.detected = detected;
+  result.samples = total;
+  result.nsPerSample = std::chrono::duration<double, std::nano>(elapsed).count() / total;
+  result.noiseSd = idleNoiseSd<Ratio>(opt);
+  result.peakSd = standardDeviation(peakSum, peakSumSq, detected);
+  result.disturbances = raw.disturbances();
+  result.falseDetected = falseDetected;
+  result.learned = gate.learned;
+  result.keptTrue = gate.keptTrue;
+  result.keptFalse = gate.keptFalse;
+  result.checks = gate.checks;
+  result.nsPerCheck = gate.checks ? static_cast<double>(gate.checkTime.count()) / gate.checks : 0.0;
+  return result;
+}
+
+RunResult runOnce(const Options &opt, uint32_t rateHpm, uint32_t ratio) {
+  switch (ratio) {
+    case 2:
+      return runWith<2>(opt, rateHpm);
+    case 4:
+      return runWith<4>(opt, rateHpm);
+    case 8:
+      return runWith<8>(opt, rateHpm);
+    default:
+      return runWith<1>(opt, rateHpm);
+  }
+}
+
+// Runs the detector over a capture file at its recorded sample interval.
+int replayCapture(const Options &opt) {
+  FILE *in = fopen(opt.input, "rb");
+  RawCaptureHeader header;
+  if (in == nullptr || fread(&header, sizeof(header), 1, in) != 1 || header.magic != kRawCaptureMagic ||
+      header.intervalUs == 0) {
+    fprintf(stderr, "%s: not a capture file\n", opt.input);
+    return 1;
+  }
+
+  StrikeDetectorConfig detectorConfig;
+  detectorConfig.threshold = opt.threshold;
+  detectorConfig.lockoutMs = opt.lockoutMs;
+  detectorConfig.windowSamples = opt.windowMs * 1000 / header.intervalUs;
+  if (detectorConfig.windowSamples > kStrikeWindowMax) {
+    fprintf(stderr, "%s: --window %lu ms is more than %u samples at %lu us\n", opt.input,
+            static_cast<unsigned long>(opt.windowMs), kStrikeWindowMax, static_cast<unsigned long>(header.intervalUs));
+    fclose(in);
+    return 1;
+  }
+  StrikeDetector detector;
+  detector.configure(detectorConfig);
+  detector.reset();
+
+  uint32_t detected = 0;
+  uint16_t samples[1024];
+  uint64_t n = 0;
+  size_t got;
+  while ((got = fread(samples, sizeof(uint16_t), 1024, in)) > 0) {
+    for (size_t i = 0; i < got; i++, n++) {
+      Strike strike;
+      if (detector.push(samples[i], opt.startUs + n * header.intervalUs, strike)) {
+        detected++;
+      }
+    }
+  }
+  fclose(in);
+
+  uint32_t deviceHits = 0;
+  std::string hitsPath = std::string(opt.input) + ".hits.csv";
+  if (FILE *hits = fopen(hitsPath.c_str(), "r")) {
+    char line[64];
+    while (fgets(line, sizeof(line), hits) != nullptr) {
+      deviceHits += (line[0] >= '0' && line[0] <= '9') ? 1 : 0;
+    }
+    fclose(hits);
+  }
+
+  printf("capture %s: %llu samples at %u us (%.2f s), %u lost\n", opt.input, static_cast<unsigned long long>(n),
+         header.intervalUs, n * header.intervalUs / 1e6, header.lostSamples);
+  printf("threshold=%d lockout=%ums window=%ums: detected=%u device_hits=%u\n", opt.threshold, opt.lockoutMs,
+         opt.windowMs, detected, deviceHits);
+  return 0;
+}
+
+void printRun(uint32_t rateHpm, uint32_t ratio, const RunResult &r) {
+  double detectedRatio = r.strikes ? static_cast<double>(r.detected) / r.strikes : 0.0;
+  printf("%8u %3u %8u %8u %9u %7.3f %8.2f %8.1f %10.1f\n", rateHpm, ratio, r.strikes, r.bounces, r.detected,
+         detectedRatio, r.noiseSd, r.peakSd, r.nsPerSample);
+}
+
+void printGate(const Options &opt, const RunResult &r) {
+  double minutes = opt.seconds / 60.0;
+  printf("disturbances=%u true=%u false=%u false/min=%.2f\n", r.disturbances, r.detected - r.falseDetected,
+         r.falseDetected, r.falseDetected / minutes);
+  if (opt.matchPct == 0) {
+    return;
+  }
+  uint32_t trueBefore = r.detected - r.falseDetected;
+  printf("gate match>=%u%% learned=%u: true kept=%u/%u (%.1f %%) false kept=%u/%u false/min=%.2f"
+         " checks=%u ns/check=%.0f\n",
+         opt.matchPct, r.learned, r.keptTrue, trueBefore, trueBefore ? 100.0 * r.keptTrue / trueBefore : 0.0,
+         r.keptFalse, r.falseDetected, r.keptFalse / minutes, r.checks, r.nsPerCheck);
+}
+
+bool parseArgs(int argc, char **argv, Options &opt) {
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+    const char *value = (i + 1 < argc) ? argv[i + 1] : nullptr;
+    if (strcmp(arg, "--sweep") == 0) {
+      opt.sweep = true;
+      continue;
+    }
+    if (strcmp(arg, "--compare") == 0) {
+      opt.compare = true;
+      continue;
+    }
+    if (value == nullptr) {
+      return false;
+    }
+    unsigned long v = strtoul(value, nullptr, 10);
+    if (strcmp(arg, "--seconds") == 0) {
+      opt.seconds = v;
+    } else if (strcmp(arg, "--rate") == 0) {
+      opt.rateHpm = v;
+    } else if (strcmp(arg, "--seed") == 0) {
+      opt.seed = v;
+    } else if (strcmp(arg, "--noise") == 0) {
+      opt.noise = v;
+    } else if (strcmp(arg, "--bounce") == 0) {
+      opt.bouncePct = v;
+    } else if (strcmp(arg, "--threshold") == 0) {
+      opt.threshold = static_cast<int>(v);
+    } else if (strcmp(arg, "--lockout") == 0) {
+      opt.lockoutMs = v;
+    } else if (strcmp(arg, "--window") == 0) {
+      opt.windowMs = v;
+    } else if (strcmp(arg, "--start-us") == 0) {
+      opt.startUs = strtoull(value, nullptr, 10);
+    } else if (strcmp(arg, "--oversample") == 0) {
+      opt.oversample = v;
+    } else if (strcmp(arg, "--peak") == 0) {
+      opt.peak = v;
+    } else if (strcmp(arg, "--input") == 0) {
+      opt.input = value;
+    } else if (strcmp(arg, "--disturb") == 0) {
+      opt.disturb = v;
+    } else if (strcmp(arg, "--match") == 0) {
+      opt.matchPct = v;
+    } else if (strcmp(arg, "--learn") == 0) {
+      opt.learn = v;
+    } else {
+      return false;
+    }
+    i++;
+  }
+  bool ratioOk = opt.oversample == 1 || opt.oversample == 2 || opt.oversample == 4 || opt.oversample == 8;
+  return opt.seconds > 0 && opt.windowMs > 0 && opt.windowMs * 1000 / kSampleIntervalUs <= kStrikeWindowMax &&
+         ratioOk && opt.peak <= 4095 && opt.matchPct <= 100 && opt.learn <= UINT16_MAX;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  Options opt;
+  if (!parseArgs(argc, argv, opt)) {
+    fprintf(stderr,
+            "usage: %s [--seconds N] [--rate HPM] [--seed N] [--noise N] [--bounce PCT]\n"
+            "          [--threshold N] [--lockout MS] [--window MS] [--start-us N]\n"
+            "          [--oversample 1|2|4|8] [--peak N] [--compare] [--sweep] [--input FILE.ksr]\n"
+            "          [--disturb N] [--match PCT] [--learn N]\n",
+            argv[0]);
+    return 2;
+  }
+  if (opt.input != nullptr) {
+    return replayCapture(opt);
+  }
+
+  printf("threshold=%d lockout=%ums window=%ums seconds=%u seed=%u\n", opt.threshold,
+         opt.lockoutMs, opt.windowMs, opt.seconds, opt.seed);
+  printf("%8s %3s %8s %8s %9s %7s %8s %8s %10s\n", "rate", "R", "strikes", "bounces", "detected", "ratio",
+         "noise_sd", "peak_sd", "ns/sample");
+
+  if (opt.compare) {
+    for (uint32_t ratio = 1; ratio <= 8; ratio *= 2) {
+      printRun(opt.rateHpm, ratio, runOnce(opt, opt.rateHpm, ratio));
+    }
+    return 0;
+  }
+  if (!opt.sweep) {
+    RunResult r = runOnce(opt, opt.rateHpm, opt.oversample);
+    printRun(opt.rateHpm, opt.oversample, r);
+    if (opt.disturb > 0 || opt.matchPct > 0) {
+      printGate(opt, r);
+    }
+    return 0;
+  }
+
+  // A rate is sustained while detections stay within 1 % of emitted strikes.
+  uint32_t maxSustained = 0;
+  for (uint32_t rate = 60; rate <= 1200; rate += 60) {
+    RunResult r = runOnce(opt, rate, opt.oversample);
+    printRun(rate, opt.oversample, r);
+    if (r.strikes > 0 && r.detected * 100 >= r.strikes * 99 && r.detected * 100 <= r.strikes * 101) {
+      maxSustained = rate;
+    }
+  }
+  printf("max sustained rate: %u hits/min\n", maxSustained);
+  return 0;
+}
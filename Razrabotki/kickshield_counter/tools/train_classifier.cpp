@@ -0,0 +1,581 @@
+// Host trainer for the kickshield strike-type classifier.
+//
+// Runs the firmware's StrikeDetector and StrikeFeatureTracker over labelled
+// strikes, trains the 6-8-4 perceptron of strike_classifier.h in floating
+// point, quantizes it to int8 and writes the weights as a header for the
+// firmware (../src/strike_model.h by default). Accuracy is reported on a
+// held-out fifth of the strikes, for the float and the int8 model, and the
+// int8 inference is timed.
+//
+// Labelled captures are .ksr files from tools/capture whose .hits.csv got a
+// third column by hand, one of front_kick, roundhouse, punch, bump:
+//   sample_index,peak,label
+//   18231,2417,roundhouse
+// Hits without a label are left out. --synth N adds N generated strikes per
+// class, with a shape per class (rise, decay, ring, rebound), for trying the
+// pipeline without a device; a model trained only on those is a
+// placeholder, not something to ship to a gym.
+//
+// Build (from this directory):
+//   g++ -std=gnu++17 -O2 -I../src train_classifier.cpp -o train_classifier
+//
+// Usage:
+//   ./train_classifier [--synth N] [--seed N] [--epochs N] [--threshold N]
+//                      [--window MS] [--out FILE] [capture.ksr]...
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "sample_stream.h"
+#include "strike_classifier.h"
+#include "strike_detector.h"
+#include "strike_features.h"
+
+namespace {
+
+const uint32_t kSampleRateHz = 10000;
+
+struct Options {
+  uint32_t synth = 0;
+  uint32_t seed = 1;
+  uint32_t epochs = 300;
+  int threshold = 1200;
+  uint32_t lockoutMs = 120;
+  uint32_t windowMs = 8;
+  const char *out = "../src/strike_model.h";
+  std::vector<const char *> inputs;
+};
+
+struct Example {
+  StrikeFeatures features;
+  int label;
+};
+
+// A labelled strike: where its label says it is, in samples.
+struct Label {
+  uint32_t index;
+  int label;
+};
+
+uint32_t rngState = 1;
+
+uint32_t rng() {
+  uint32_t x = rngState;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  rngState = x;
+  return x;
+}
+
+double uniform(double lo, double hi) {
+  return lo + (hi - lo) * (rng() / 4294967296.0);
+}
+
+int classFromName(const char *name) {
+  for (uint8_t k = 0; k < kStrikeClassCount; k++) {
+    if (strcmp(name, kStrikeClassNames[k]) == 0) {
+      return k;
+    }
+  }
+  return -1;
+}
+
+// Runs detector and tracker over a signal the way processSensor() does and
+// labels each measured strike with the nearest label within maxDistance.
+void extract(const std::vector<uint16_t> &signal, const std::vector<Label> &labels, const Options &opt,
+             std::vector<Example> &out) {
+  StrikeDetectorConfig config;
+  config.threshold = opt.threshold;
+  config.lockoutMs = opt.lockoutMs;
+  config.windowSamples = opt.windowMs * kSampleRateHz / 1000;
+  StrikeDetector detector;
+  detector.configure(config);
+  detector.reset();
+  StrikeFeatureTracker tracker;
+  tracker.reset();
+
+  const uint32_t maxDistance = 2 * config.windowSamples;
+  auto take = [&](const StrikeFeatures &f) {
+    uint32_t peak = tracker.peakIndex();
+    const Label *best = nullptr;
+    for (const Label &l : labels) {
+      uint32_t d = l.index > peak ? l.index - peak : peak - l.index;
+      if (d <= maxDistance && (best == nullptr || d < (best->index > peak ? best->index - peak : peak - best->index))) {
+        best = &l;
+      }
+    }
+    if (best != nullptr) {
+      out.push_back(Example{f, best->label});
+    }
+  };
+  for (size_t n = 0; n < signal.size(); n++) {
+    StrikeFeatures f;
+    if (tracker.push(signal[n], f)) {
+      take(f);
+    }
+    Strike strike;
+    if (detector.push(signal[n], n * (1000000 / kSampleRateHz), strike)) {
+      tracker.mark(detector.windowSamples());
+    }
+  }
+  StrikeFeatures f;
+  if (tracker.finish(f)) {
+    take(f);
+  }
+}
+
+// ---- synthetic strikes --------------------------------------------------
+
+struct SynthShape {
+  double riseMs;
+  double decayMs;
+  double ringHz;
+  double ringDepth;
+  double minPeak;
+  double maxPeak;
+  double reboundChance;
+};
+
+// Indexed by StrikeClass.
+const SynthShape kShapes[kStrikeClassCount] = {
+    {1.6, 7.0, 110.0, 0.15, 1800.0, 3900.0, 0.3},  // front kick: heavy, broad push
+    {0.7, 4.5, 240.0, 0.45, 2000.0, 3900.0, 0.5},  // roundhouse: shin slap, rings the pad
+    {0.4, 1.6, 320.0, 0.25, 1400.0, 3200.0, 0.2},  // punch: short and sharp
+    {4.5, 12.0, 0.0, 0.0, 1250.0, 2000.0, 0.0},    // bump: slow, just over the threshold
+};
+
+double shapeAt(const SynthShape &s, double riseS, double decayS, double ringHz, double t) {
+  double env = t < riseS ? t / riseS : exp(-(t - riseS) / decayS);
+  return env * (1.0 - s.ringDepth + s.ringDepth * cos(2.0 * M_PI * ringHz * t));
+}
+
+void addStrike(std::vector<double> &signal, size_t at, const SynthShape &s, double amp) {
+  double riseS = s.riseMs / 1000.0 * uniform(0.75, 1.25);
+  double decayS = s.decayMs / 1000.0 * uniform(0.75, 1.25);
+  double ringHz = s.ringHz * uniform(0.8, 1.2);
+  double peak = 0.0;
+  for (size_t i = 0; i < 2000 && at + i < signal.size(); i++) {
+    peak = std::max(peak, shapeAt(s, riseS, decayS, ringHz, i / static_cast<double>(kSampleRateHz)));
+  }
+  for (size_t i = 0; i < 2000 && at + i < signal.size(); i++) {
+    signal[at + i] += amp * shapeAt(s, riseS, decayS, ringHz, i / static_cast<double>(kSampleRateHz)) / peak;
+  }
+}
+
+// perClass strikes of every class, shuffled, 400 ms apart on a noisy
+// baseline, some followed by a rebound.
+void synthesize(uint32_t perClass, const Options &opt, std::vector<Example> &out) {
+  std::vector<int> order;
+  for (uint8_t k = 0; k < kStrikeClassCount; k++) {
+    order.insert(order.end(), perClass, k);
+  }
+  for (size_t i = order.size(); i > 1; i--) {
+    std::swap(order[i - 1], order[rng() % i]);
+  }
+  const size_t spacing = kSampleRateHz * 4 / 10;
+  std::vector<double> signal(spacing * (order.size() + 1), 150.0);
+  std::vector<Label> labels;
+  for (size_t i = 0; i < order.size(); i++) {
+    const SynthShape &s = kShapes[order[i]];
+    size_t at = spacing * (i + 1) - static_cast<size_t>(uniform(0, spacing / 4));
+    double amp = uniform(s.minPeak, s.maxPeak) - 150.0;
+    addStrike(signal, at, s, amp);
+    labels.push_back(Label{static_cast<uint32_t>(at + s.riseMs * kSampleRateHz / 1000), order[i]});
+    if (uniform(0, 1) < s.reboundChance) {
+      addStrike(signal, at + static_cast<size_t>(uniform(0.015, 0.060) * kSampleRateHz), s, amp * uniform(0.2, 0.45));
+    }
+  }
+  std::vector<uint16_t> samples(signal.size());
+  for (size_t n = 0; n < signal.size(); n++) {
+    double noise = (uniform(-1, 1) + uniform(-1, 1) + uniform(-1, 1) + uniform(-1, 1)) * 12.0 / 1.1547;
+    samples[n] = static_cast<uint16_t>(std::min(4095.0, std::max(0.0, signal[n] + noise)));
+  }
+  extract(samples, labels, opt, out);
+}
+
+// ---- captures -------------------------------------------------------------
+
+bool loadCapture(const char *path, const Options &opt, std::vector<Example> &out) {
+  FILE *in = fopen(path, "rb");
+  RawCaptureHeader header;
+  if (in == nullptr || fread(&header, sizeof(header), 1, in) != 1 || header.magic != kRawCaptureMagic ||
+      header.intervalUs != 1000000 / kSampleRateHz) {
+    fprintf(stderr, "%s: not a capture file at %u us\n", path, 1000000 / kSampleRateHz);
+    return false;
+  }
+  std::vector<uint16_t> samples(header.sampleCount);
+  samples.resize(fread(samples.data(), sizeof(uint16_t), samples.size(), in));
+  fclose(in);
+
+  std::vector<Label> labels;
+  std::string hitsPath = std::string(path) + ".hits.csv";
+  if (FILE *hits = fopen(hitsPath.c_str(), "r")) {
+    char line[128];
+    while (fgets(line, sizeof(line), hits) != nullptr) {
+      unsigned long index;
+      unsigned peak;
+      char name[32];
+      if (sscanf(line, "%lu,%u,%31[a-z_]", &index, &peak, name) == 3 && classFromName(name) >= 0) {
+        labels.push_back(Label{static_cast<uint32_t>(index), classFromName(name)});
+      }
+    }
+    fclose(hits);
+  }
+  size_t before = out.size();
+  extract(samples, labels, opt, out);
+  printf("%s: %zu labelled hits, %zu strikes matched\n", path, labels.size(), out.size() - before);
+  return true;
+}
+
+// ---- model ----------------------------------------------------------------
+
+struct FloatModel {
+  double mean[kStrikeFeatureCount];
+  double sd[kStrikeFeatureCount];
+  double w1[kStrikeHidden][kStrikeFeatureCount];
+  double b1[kStrikeHidden];
+  double w2[kStrikeClassCount][kStrikeHidden];
+  double b2[kStrikeClassCount];
+};
+
+void standardize(const FloatModel &m, const StrikeFeatures &f, double *x) {
+  for (uint8_t i = 0; i < kStrikeFeatureCount; i++) {
+    x[i] = (f.v[i] - m.mean[i]) / m.sd[i];
+  }
+}
+
+void forward(const FloatModel &m, const double *x, double *h, double *y) {
+  for (uint8_t j = 0; j < kStrikeHidden; j++) {
+    double acc = m.b1[j];
+    for (uint8_t i = 0; i < kStrikeFeatureCount; i++) {
+      acc += m.w1[j][i] * x[i];
+    }
+    h[j] = acc > 0 ? acc : 0;
+  }
+  for (uint8_t k = 0; k < kStrikeClassCount; k++) {
+    double acc = m.b2[k];
+    for (uint8_t j = 0; j < kStrikeHidden; j++) {
+      acc += m.w2[k][j] * h[j];
+    }
+    y[k] = acc;
+  }
+}
+
+int predict(const FloatModel &m, const StrikeFeatures &f) {
+  double x[kStrikeFeatureCount], h[kStrikeHidden], y[kStrikeClassCount];
+  standardize(m, f, x);
+  forward(m, x, h, y);
+  return static_cast<int>(std::max_element(y, y + kStrikeClassCount) - y);
+}
+
+// Plain SGD on softmax cross-entropy.
+FloatModel train(const std::vector<Example> &data, uint32_t epochs) {
+  FloatModel m;
+  for (uint8_t i = 0; i < kStrikeFeatureCount; i++) {
+    double sum = 0.0, sumSq = 0.0;
+    for (const Example &e : data) {
+      sum += e.features.v[i];
+      sumSq += static_cast<double>(e.features.v[i]) * e.features.v[i];
+    }
+    m.mean[i] = sum / data.size();
+    double var = sumSq / data.size() - m.mean[i] * m.mean[i];
+    m.sd[i] = var > 1e-6 ? sqrt(var) : 1.0;
+  }
+  for (uint8_t j = 0; j < kStrikeHidden; j++) {
+    for (uint8_t i = 0; i < kStrikeFeatureCount; i++) {
+      m.w1[j][i] = uniform(-1, 1) * sqrt(6.0 / kStrikeFeatureCount);
+    }
+    m.b1[j] = 0.1;
+  }
+  for (uint8_t k = 0; k < kStrikeClassCount; k++) {
+    for (uint8_t j = 0; j < kStrikeHidden; j++) {
+      m.w2[k][j] = uniform(-1, 1) * sqrt(6.0 / kStrikeHidden);
+    }
+    m.b2[k] = 0.0;
+  }
+
+  std::vector<size_t> order(data.size());
+  for (size_t i = 0; i < order.size(); i++) {
+    order[i] = i;
+  }
+  for (uint32_t epoch = 0; epoch < epochs; epoch++) {
+    double rate = 0.02 * (1.0 - 0.9 * epoch / epochs);
+    for (size_t i = order.size(); i > 1; i--) {
+      std::swap(order[i - 1], order[rng() % i]);
+    }
+    for (size_t idx : order) {
+      const Example &e = data[idx];
+      double x[kStrikeFeatureCount], h[kStrikeHidden], y[kStrikeClassCount];
+      standardize(m, e.features, x);
+      forward(m, x, h, y);
+      double top = *std::max_element(y, y + kStrikeClassCount);
+      double sum = 0.0;
+      for (double &v : y) {
+        v = exp(v - top);
+        sum += v;
+      }
+      double dy[kStrikeClassCount];
+      for (uint8_t k = 0; k < kStrikeClassCount; k++) {
+        dy[k] = y[k] / sum - (k == e.label ? 1.0 : 0.0);
+      }
+      double dh[kStrikeHidden] = {};
+      for (uint8_t k = 0; k < kStrikeClassCount; k++) {
+        for (uint8_t j = 0; j < kStrikeHidden; j++) {
+          dh[j] += dy[k] * m.w2[k][j];
+          m.w2[k][j] -= rate * dy[k] * h[j];
+        }
+        m.b2[k] -= rate * dy[k];
+      }
+      for (uint8_t j = 0; j < kStrikeHidden; j++) {
+        if (h[j] <= 0) {
+          continue;
+        }
+        for (uint8_t i = 0; i < kStrikeFeatureCount; i++) {
+          m.w1[j][i] -= rate * dh[j] * x[i];
+        }
+        m.b1[j] -= rate * dh[j];
+      }
+    }
+  }
+  return m;
+}
+
+struct QuantModel {
+  int32_t offset[kStrikeFeatureCount];
+  int16_t scale[kStrikeFeatureCount];
+  int8_t w1[kStrikeHidden][kStrikeFeatureCount];
+  int32_t b1[kStrikeHidden];
+  int32_t m1;
+  int8_t w2[kStrikeClassCount][kStrikeHidden];
+  int32_t b2[kStrikeClassCount];
+
+  StrikeModel view() const {
+    return StrikeModel{offset, scale, w1, b1, m1, w2, b2};
+  }
+};
+
+// Inputs at 32 per standard deviation; hidden units scaled so the largest
+// activation seen in training maps to 127.
+QuantModel quantize(const FloatModel &m, const std::vector<Example> &data) {
+  const double inputScale = 32.0;
+  QuantModel q;
+  for (uint8_t i = 0; i < kStrikeFeatureCount; i++) {
+    q.offset[i] = static_cast<int32_t>(lround(m.mean[i]));
+    q.scale[i] = static_cast<int16_t>(std::min(32767.0, std::max(1.0, round(256.0 * inputScale / m.sd[i]))));
+  }
+  double max1 = 0.0;
+  for (auto &row : m.w1) {
+    for (double w : row) {
+      max1 = std::max(max1, fabs(w));
+    }
+  }
+  double s1 = 127.0 / max1;
+  for (uint8_t j = 0; j < kStrikeHidden; j++) {
+    for (uint8_t i = 0; i < kStrikeFeatureCount; i++) {
+      q.w1[j][i] = static_cast<int8_t>(lround(m.w1[j][i] * s1));
+    }
+    q.b1[j] = static_cast<int32_t>(lround(m.b1[j] * s1 * inputScale));
+  }
+  double hMax = 1e-6;
+  for (const Example &e : data) {
+    double x[kStrikeFeatureCount], h[kStrikeHidden], y[kStrikeClassCount];
+    standardize(m, e.features, x);
+    forward(m, x, h, y);
+    hMax = std::max(hMax, *std::max_element(h, h + kStrikeHidden));
+  }
+  double hScale = 127.0 / hMax;
+  q.m1 = static_cast<int32_t>(lround(65536.0 * hScale / (s1 * inputScale)));
+  double max2 = 0.0;
+  for (auto &row : m.w2) {
+    for (double w : row) {
+      max2 = std::max(max2, fabs(w));
+    }
+  }
+  double s2 = 127.0 / max2;
+  for (uint8_t k = 0; k < kStrikeClassCount; k++) {
+    for (uint8_t j = 0; j < kStrikeHidden; j++) {
+      q.w2[k][j] = static_cast<int8_t>(lround(m.w2[k][j] * s2));
+    }
+    q.b2[k] = static_cast<int32_t>(lround(m.b2[k] * s2 * hScale));
+  }
+  return q;
+}
+
+template <typename Predict>
+double accuracy(const std::vector<Example> &data, Predict predictFn, uint32_t confusion[][kStrikeClassCount]) {
+  size_t right = 0;
+  for (const Example &e : data) {
+    int k = predictFn(e.features);
+    right += k == e.label ? 1 : 0;
+    if (confusion != nullptr) {
+      confusion[e.label][k]++;
+    }
+  }
+  return data.empty() ? 0.0 : 100.0 * right / data.size();
+}
+
+// rowLength > 0 writes a two-dimensional array one row per line.
+template <typename T>
+void writeArray(FILE *out, const char *type, const char *name, const char *dims, const T *values, size_t n,
+                size_t rowLength) {
+  fprintf(out, "constexpr %s %s%s = {", type, name, dims);
+  for (size_t i = 0; i < n; i++) {
+    bool rowStart = rowLength > 0 && i % rowLength == 0;
+    fprintf(out, "%s%s%ld", i == 0 ? "" : (rowStart ? "},\n    " : ", "), rowStart ? "{" : "",
+            static_cast<long>(values[i]));
+  }
+  fprintf(out, "%s};\n", rowLength > 0 ? "}" : "");
+}
+
+bool writeHeader(const char *path, const QuantModel &q, const std::string &source, size_t strikes,
+                 double floatAcc, double quantAcc) {
+  FILE *out = fopen(path, "w");
+  if (out == nullptr) {
+    perror(path);
+    return false;
+  }
+  fprintf(out, "#pragma once\n\n");
+  fprintf(out, "// Generated by tools/train_classifier from %s;\n", source.c_str());
+  fprintf(out, "// do not edit. %zu strikes, held-out accuracy %.1f %% float, %.1f %% int8.\n\n", strikes, floatAcc,
+          quantAcc);
+  fprintf(out, "#include \"strike_classifier.h\"\n\n");
+  writeArray(out, "int32_t", "kStrikeModelOffset", "[kStrikeFeatureCount]", q.offset, kStrikeFeatureCount, 0);
+  writeArray(out, "int16_t", "kStrikeModelScale", "[kStrikeFeatureCount]", q.scale, kStrikeFeatureCount, 0);
+  writeArray(out, "int8_t", "kStrikeModelW1", "[kStrikeHidden][kStrikeFeatureCount]", &q.w1[0][0],
+             kStrikeHidden * kStrikeFeatureCount, kStrikeFeatureCount);
+  writeArray(out, "int32_t", "kStrikeModelB1", "[kStrikeHidden]", q.b1, kStrikeHidden, 0);
+  fprintf(out, "constexpr int32_t kStrikeModelM1 = %ld;\n", static_cast<long>(q.m1));
+  writeArray(out, "int8_t", "kStrikeModelW2", "[kStrikeClassCount][kStrikeHidden]", &q.w2[0][0],
+             kStrikeClassCount * kStrikeHidden, kStrikeHidden);
+  writeArray(out, "int32_t", "kStrikeModelB2", "[kStrikeClassCount]", q.b2, kStrikeClassCount, 0);
+  fprintf(out, "\nconstexpr StrikeModel kStrikeModel = {kStrikeModelOffset, kStrikeModelScale, kStrikeModelW1,\n"
+               "                                     kStrikeModelB1,     kStrikeModelM1,    kStrikeModelW2,\n"
+               "                                     kStrikeModelB2};\n");
+  fclose(out);
+  return true;
+}
+
+bool parseArgs(int argc, char **argv, Options &opt) {
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+    if (strncmp(arg, "--", 2) != 0) {
+      opt.inputs.push_back(arg);
+      continue;
+    }
+    if (i + 1 >= argc) {
+      return false;
+    }
+    const char *value = argv[++i];
+    unsigned long v = strtoul(value, nullptr, 10);
+    if (strcmp(arg, "--synth") == 0) {
+      opt.synth = v;
+    } else if (strcmp(arg, "--seed") == 0) {
+      opt.seed = v ? v : 1;
+    } else if (strcmp(arg, "--epochs") == 0) {
+      opt.epochs = v;
+    } else if (strcmp(arg, "--threshold") == 0) {
+      opt.threshold = static_cast<int>(v);
+    } else if (strcmp(arg, "--window") == 0) {
+      opt.windowMs = v;
+    } else if (strcmp(arg, "--out") == 0) {
+      opt.out = value;
+    } else {
+      return false;
+    }
+  }
+  return (opt.synth > 0 || !opt.inputs.empty()) && opt.windowMs > 0 &&
+         opt.windowMs * kSampleRateHz / 1000 <= kStrikeWindowMax;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  Options opt;
+  if (!parseArgs(argc, argv, opt)) {
+    fprintf(stderr,
+            "usage: %s [--synth N] [--seed N] [--epochs N] [--threshold N] [--window MS] [--out FILE]\n"
+            "          [capture.ksr]...\n",
+            argv[0]);
+    return 2;
+  }
+  rngState = opt.seed;
+
+  std::vector<Example> data;
+  std::string source;
+  for (const char *path : opt.inputs) {
+    if (!loadCapture(path, opt, data)) {
+      return 1;
+    }
+    source += (source.empty() ? "" : ", ") + std::string(path);
+  }
+  if (opt.synth > 0) {
+    size_t before = data.size();
+    synthesize(opt.synth, opt, data);
+    printf("synthetic: %zu strikes matched of %u\n", data.size() - before, opt.synth * kStrikeClassCount);
+    source += (source.empty() ? "" : ", ") + std::string("--synth ") + std::to_string(opt.synth) + " --seed " +
+              std::to_string(opt.seed);
+  }
+  if (data.size() < 20) {
+    fprintf(stderr, "only %zu labelled strikes; need at least 20\n", data.size());
+    return 1;
+  }
+
+  for (size_t i = data.size(); i > 1; i--) {
+    std::swap(data[i - 1], data[rng() % i]);
+  }
+  size_t testCount = data.size() / 5;
+  std::vector<Example> test(data.begin(), data.begin() + testCount);
+  std::vector<Example> trainSet(data.begin() + testCount, data.end());
+
+  FloatModel m = train(trainSet, opt.epochs);
+  QuantModel q = quantize(m, trainSet);
+  StrikeModel model = q.view();
+
+  uint32_t confusion[kStrikeClassCount][kStrikeClassCount] = {};
+  double floatAcc = accuracy(test, [&](const StrikeFeatures &f) { return predict(m, f); }, nullptr);
+  double quantAcc =
+      accuracy(test, [&](const StrikeFeatures &f) { return static_cast<int>(classifyStrike(model, f)); }, confusion);
+  double trainAcc =
+      accuracy(trainSet, [&](const StrikeFeatures &f) { return static_cast<int>(classifyStrike(model, f)); }, nullptr);
+
+  printf("train=%zu test=%zu epochs=%u\n", trainSet.size(), test.size(), opt.epochs);
+  printf("accuracy: float %.1f %%, int8 %.1f %% (int8 on train %.1f %%)\n", floatAcc, quantAcc, trainAcc);
+  printf("%-12s", "true\\pred");
+  for (uint8_t k = 0; k < kStrikeClassCount; k++) {
+    printf("%12s", kStrikeClassNames[k]);
+  }
+  printf("\n");
+  for (uint8_t t = 0; t < kStrikeClassCount; t++) {
+    printf("%-12s", kStrikeClassNames[t]);
+    for (uint8_t k = 0; k < kStrikeClassCount; k++) {
+      printf("%12u", confusion[t][k]);
+    }
+    printf("\n");
+  }
+
+  // Host cost of one int8 inference, the part that runs per strike.
+  const uint32_t rounds = 2000000 / static_cast<uint32_t>(test.size()) + 1;
+  uint32_t sink = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t r = 0; r < rounds; r++) {
+    for (const Example &e : test) {
+      sink += classifyStrike(model, e.features);
+    }
+  }
+  double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() /
+              (static_cast<double>(rounds) * test.size());
+  printf("inference: %.1f ns/strike (checksum %u)\n", ns, sink);
+
+  if (!writeHeader(opt.out, q, source, data.size(), floatAcc, quantAcc)) {
+    return 1;
+  }
+  printf("wrote %s\n", opt.out);
+  return 0;
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+// Large count digits for the SSD1306, pre-rendered at compile time.
+//
+// Each glyph is the 5x7 GFX font digit scaled x3 into an 18x24 cell, stored
+// in SSD1306 page order (one byte = 8 vertical pixels, LSB on top). Drawing a
+// digit is three 15-byte copies into the framebuffer instead of the ~300
+// fillRect/drawPixel calls Adafruit_GFX makes for setTextSize(3).
+
+static const uint8_t BIG_DIGIT_SCALE = 3;
+static const uint8_t BIG_DIGIT_WIDTH = 5 * BIG_DIGIT_SCALE;
+static const uint8_t BIG_DIGIT_ADVANCE = 6 * BIG_DIGIT_SCALE;
+static const uint8_t BIG_DIGIT_PAGES = BIG_DIGIT_SCALE;  // 8 font rows x3 = 3 pages
+
+// Columns of '0'..'9' from Adafruit_GFX glcdfont.c, so the output matches
+// what oled.print() drew before.
+static constexpr uint8_t BIG_DIGIT_FONT[10][5] = {
+  { 0x3E, 0x51, 0x49, 0x45, 0x3E },
+  { 0x00, 0x42, 0x7F, 0x40, 0x00 },
+  { 0x72, 0x49, 0x49, 0x49, 0x46 },
+  { 0x21, 0x41, 0x49, 0x4D, 0x33 },
+  { 0x18, 0x14, 0x12, 0x7F, 0x10 },
+  { 0x27, 0x45, 0x45, 0x45, 0x39 },
+  { 0x3C, 0x4A, 0x49, 0x49, 0x31 },
+  { 0x41, 0x21, 0x11, 0x09, 0x07 },
+  { 0x36, 0x49, 0x49, 0x49, 0x36 },
+  { 0x46, 0x49, 0x49, 0x29, 0x1E },
+};
+
+struct BigDigitTable {
+  uint8_t cols[10][BIG_DIGIT_PAGES][BIG_DIGIT_WIDTH];
+};
+
+static constexpr BigDigitTable makeBigDigitTable() {
+  BigDigitTable t {};
+  for (uint8_t d = 0; d < 10; d++) {
+    for (uint8_t page = 0; page < BIG_DIGIT_PAGES; page++) {
+      for (uint8_t x = 0; x < BIG_DIGIT_WIDTH; x++) {
+        uint8_t src = BIG_DIGIT_FONT[d][x / BIG_DIGIT_SCALE];
+        uint8_t out = 0;
+        for (uint8_t bit = 0; bit < 8; bit++) {
+          uint8_t srcRow = (page * 8 + bit) / BIG_DIGIT_SCALE;
+          if ((src >> srcRow) & 1) {
+            out |= static_cast<uint8_t>(1 << bit);
+          }
+        }
+        t.cols[d][page][x] = out;
+      }
+    }
+  }
+  return t;
+}
+
+static constexpr BigDigitTable BIG_DIGITS = makeBigDigitTable();
+
+// The stem of '1' covers font rows 0..6, i.e. pixel rows 0..20.
+static_assert(BIG_DIGITS.cols[1][0][7] == 0xFF && BIG_DIGITS.cols[1][2][7] == 0x1F, "big digit table");
+
+// Writes value at column x, starting on page `page`, into a page-ordered
+// framebuffer `width` pixels wide. A value with more digits than fit shows
+// as all nines, the largest count that fits, rather than losing its low
+// digits. The area under each written cell is fully overwritten, so no
+// clear is needed beforehand.
+static inline void blitBigNumber(uint8_t *fb, uint8_t width, uint8_t page, uint8_t x, uint32_t value) {
+  uint8_t fit = x < width ? static_cast<uint8_t>((width - x) / BIG_DIGIT_ADVANCE) : 0;
+  char digits[10];
+  uint8_t n = 0;
+  do {
+    digits[n++] = static_cast<char>(value % 10);
+    value /= 10;
+  } while (value != 0);
+  if (n > fit) {
+    n = fit;
+    memset(digits, 9, n);
+  }
+
+  while (n > 0) {
+    uint8_t d = static_cast<uint8_t>(digits[--n]);
+    for (uint8_t p = 0; p < BIG_DIGIT_PAGES; p++) {
+      uint8_t *row = fb + (page + p) * width + x;
+      memcpy(row, BIG_DIGITS.cols[d][p], BIG_DIGIT_WIDTH);
+      memset(row + BIG_DIGIT_WIDTH, 0, BIG_DIGIT_ADVANCE - BIG_DIGIT_WIDTH);
+    }
+    x += BIG_DIGIT_ADVANCE;
+  }
+}
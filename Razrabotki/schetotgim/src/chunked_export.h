@@ -0,0 +1,252 @@
+#pragma once
+
+#include <Arduino.h>
+#include <WiFi.h>
+
+// Streams a table as a chunked HTTP response, CSV or NDJSON, through one
+// fixed buffer: rows are pulled from a source only after the previous chunk
+// has gone out, so memory stays constant whatever the row count and the
+// export runs at link speed. The export outlives its request and sends one
+// chunk per loop pass, so buttons, events and other requests keep being
+// served while it runs. A client that disconnects stops the pull.
+//
+// A row source is any type with `bool next(ExportRow &row)`, which adds one
+// value per column in order and returns false when there are no more rows.
+
+static const size_t EXPORT_CHUNK_SIZE = 512;
+static const size_t EXPORT_ROW_MAX = 192;
+
+enum ExportFormat : uint8_t {
+  EXPORT_CSV = 0,
+  EXPORT_NDJSON = 1,
+};
+
+struct ExportColumn {
+  const char *name;
+};
+
+// "ndjson" selects NDJSON; anything else, including no value, is CSV.
+static inline ExportFormat exportFormatFromArg(const String &value) {
+  return value == "ndjson" ? EXPORT_NDJSON : EXPORT_CSV;
+}
+
+// Encodes the values of one row into a row-sized buffer. Output past
+// EXPORT_ROW_MAX is cut; the firmware's rows are a fraction of that.
+class ExportRow {
+public:
+  ExportRow(ExportFormat format, const ExportColumn *columns, size_t columnCount)
+    : format_(format), columns_(columns), columnCount_(columnCount) {}
+
+  void number(uint32_t value) {
+    char digits[11];
+    int n = snprintf(digits, sizeof(digits), "%lu", static_cast<unsigned long>(value));
+    field();
+    raw(digits, static_cast<size_t>(n));
+  }
+
+  void text(const char *value) {
+    field();
+    if (format_ == EXPORT_NDJSON) {
+      put('"');
+      for (const char *p = value; *p != '\0'; p++) {
+        if (*p == '"' || *p == '\\') {
+          put('\\');
+          put(*p);
+        } else if (static_cast<unsigned char>(*p) >= 0x20) {
+          put(*p);
+        }
+      }
+      put('"');
+      return;
+    }
+    if (strpbrk(value, ",\"\r\n") == nullptr) {
+      raw(value, strlen(value));
+      return;
+    }
+    put('"');
+    for (const char *p = value; *p != '\0'; p++) {
+      if (*p == '"') {
+        put('"');
+      }
+      put(*p);
+    }
+    put('"');
+  }
+
+  // Opens a row; the writer calls these, not row sources.
+  void begin() {
+    len_ = 0;
+    column_ = 0;
+    if (format_ == EXPORT_NDJSON) {
+      put('{');
+    }
+  }
+
+  // Closes the row and returns its length, or 0 if the source added the
+  // wrong number of values.
+  size_t end() {
+    if (column_ != columnCount_) {
+      return 0;
+    }
+    // Room for the closing bytes is always kept back by put().
+    if (format_ == EXPORT_NDJSON) {
+      buf_[len_++] = '}';
+    }
+    buf_[len_++] = '\n';
+    return len_;
+  }
+
+  const char *data() const {
+    return buf_;
+  }
+
+private:
+  void field() {
+    if (column_ >= columnCount_) {
+      column_++;
+      return;
+    }
+    if (column_ > 0) {
+      put(',');
+    }
+    if (format_ == EXPORT_NDJSON) {
+      put('"');
+      raw(columns_[column_].name, strlen(columns_[column_].name));
+      put('"');
+      put(':');
+    }
+    column_++;
+  }
+
+  void put(char c) {
+    if (len_ + 2 < sizeof(buf_)) {
+      buf_[len_++] = c;
+    }
+  }
+
+  void raw(const char *text, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+      put(text[i]);
+    }
+  }
+
+  ExportFormat format_;
+  const ExportColumn *columns_;
+  size_t columnCount_;
+  size_t column_ = 0;
+  size_t len_ = 0;
+  char buf_[EXPORT_ROW_MAX];
+};
+
+// One export at a time. start() takes over the request's client and
+// writes the response head; tick() then sends the next chunk on every loop
+// pass until the rows run out or the client goes away. Rows is copied in,
+// so it must be assignable.
+template <typename Rows>
+class ExportStream {
+public:
+  explicit ExportStream(const Rows &rows) : rows_(rows) {}
+
+  // An export to a client that is still connected; start() would cut it.
+  bool busy() {
+    return active_ && client_.connected();
+  }
+
+  // filename is the download name without extension.
+  void start(WiFiClient client, ExportFormat format, const char *filename, const ExportColumn *columns,
+             size_t columnCount, const Rows &rows) {
+    client_.stop();
+    client_ = client;
+    rows_ = rows;
+    row_ = ExportRow(format, columns, columnCount);
+    len_ = 0;
+    carryLen_ = 0;
+    active_ = true;
+
+    client_.printf(
+      "HTTP/1.1 200 OK\r\n"
+      "Content-Type: %s\r\n"
+      "Content-Disposition: attachment; filename=\"%s.%s\"\r\n"
+      "Cache-Control: no-store\r\n"
+      "Transfer-Encoding: chunked\r\n"
+      "Connection: close\r\n"
+      "\r\n",
+      format == EXPORT_NDJSON ? "application/x-ndjson" : "text/csv; charset=utf-8", filename,
+      format == EXPORT_NDJSON ? "ndjson" : "csv");
+    if (format == EXPORT_CSV) {
+      for (size_t i = 0; i < columnCount; i++) {
+        len_ += snprintf(chunk_ + len_, sizeof(chunk_) - len_, "%s%s", i > 0 ? "," : "", columns[i].name);
+      }
+      chunk_[len_++] = '\n';
+    }
+  }
+
+  // Fills the buffer and sends it as one chunk. The write returns once the
+  // chunk is in the socket, which is the backpressure: no row is read ahead
+  // of the link.
+  void tick() {
+    if (!active_) {
+      return;
+    }
+    if (!client_.connected()) {
+      finish();
+      return;
+    }
+
+    if (carryLen_ > 0) {
+      memcpy(chunk_ + len_, row_.data(), carryLen_);
+      len_ += carryLen_;
+      carryLen_ = 0;
+    }
+    bool more = true;
+    for (;;) {
+      row_.begin();
+      if (!rows_.next(row_)) {
+        more = false;
+        break;
+      }
+      size_t rowLen = row_.end();
+      if (rowLen == 0) {
+        continue;
+      }
+      if (len_ + rowLen > sizeof(chunk_)) {
+        // Stays in row_ for the next chunk.
+        carryLen_ = rowLen;
+        break;
+      }
+      memcpy(chunk_ + len_, row_.data(), rowLen);
+      len_ += rowLen;
+    }
+
+    bool ok = len_ == 0 || writeChunk(chunk_, len_);
+    len_ = 0;
+    if (ok && !more) {
+      ok = client_.write(reinterpret_cast<const uint8_t *>("0\r\n\r\n"), 5) == 5;
+    }
+    if (!ok || !more) {
+      finish();
+    }
+  }
+
+private:
+  bool writeChunk(const char *data, size_t len) {
+    char size[8];
+    int n = snprintf(size, sizeof(size), "%x\r\n", static_cast<unsigned>(len));
+    return client_.write(reinterpret_cast<const uint8_t *>(size), n) == static_cast<size_t>(n) &&
+           client_.write(reinterpret_cast<const uint8_t *>(data), len) == len &&
+           client_.write(reinterpret_cast<const uint8_t *>("\r\n"), 2) == 2;
+  }
+
+  void finish() {
+    client_.stop();
+    active_ = false;
+  }
+
+  Rows rows_;
+  WiFiClient client_;
+  ExportRow row_ { EXPORT_CSV, nullptr, 0 };
+  char chunk_[EXPORT_CHUNK_SIZE];
+  size_t len_ = 0;
+  size_t carryLen_ = 0;
+  bool active_ = false;
+};
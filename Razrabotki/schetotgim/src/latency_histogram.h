@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Power-of-two histogram of durations in microseconds. Bucket 0 counts 0-1
+// us, bucket i counts [2^i, 2^(i+1)) us and the last bucket everything above,
+// so 16 buckets reach past 32 ms. Recording is a count-leading-zeros and two
+// adds, cheap enough to wrap every loop pass.
+
+static const uint8_t LATENCY_BUCKETS = 16;
+
+class LatencyHistogram {
+public:
+  void record(uint32_t us) {
+    uint8_t bucket = us < 2 ? 0 : static_cast<uint8_t>(31 - __builtin_clz(us));
+    if (bucket >= LATENCY_BUCKETS) {
+      bucket = LATENCY_BUCKETS - 1;
+    }
+    buckets_[bucket]++;
+    count_++;
+    totalUs_ += us;
+    if (us > maxUs_) {
+      maxUs_ = us;
+    }
+  }
+
+  uint32_t bucket(uint8_t i) const {
+    return buckets_[i];
+  }
+
+  uint32_t count() const {
+    return count_;
+  }
+
+  uint32_t maxUs() const {
+    return maxUs_;
+  }
+
+  uint32_t avgUs() const {
+    return count_ > 0 ? static_cast<uint32_t>(totalUs_ / count_) : 0;
+  }
+
+private:
+  uint32_t buckets_[LATENCY_BUCKETS] = {};
+  uint32_t count_ = 0;
+  uint32_t maxUs_ = 0;
+  uint64_t totalUs_ = 0;
+};
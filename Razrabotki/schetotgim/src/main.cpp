@@ -5,8 +5,16 @@
 #include <WebServer.h>
 #include <Adafruit_GFX.h>
 #include <Adafruit_SSD1306.h>
-#include <TM1637Display.h>
 
+#include <atomic>
+
+#include "big_digits.h"
+#include "chunked_export.h"
+#include "http_server.h"
+#include "latency_histogram.h"
+#include "rep_log.h"
+#include "stall_watch.h"
+#include "tm1637_async.h"
 #include "web_ui.h"
 
 #if defined(CONFIG_IDF_TARGET_ESP32C3) || defined(ARDUINO_ESP32C3_DEV) || defined(ARDUINO_LOLIN_C3_MINI)
@@ -35,6 +43,7 @@ static const unsigned long HOLD_MS = 2000;
 static const uint8_t SCREEN_WIDTH = 128;
 static const uint8_t SCREEN_HEIGHT = 64;
 static const int8_t OLED_RESET = -1;
+static const uint8_t OLED_COUNT_PAGE = 2;  // count occupies rows 16..39
 
 static const char *WIFI_AP_SSID = "PUSHUP-COUNTER";
 static const char *WIFI_AP_PASSWORD = "";
@@ -43,6 +52,90 @@ static const IPAddress WIFI_AP_IP(192, 168, 4, 2);
 static const IPAddress WIFI_AP_GATEWAY(192, 168, 4, 2);
 static const IPAddress WIFI_AP_SUBNET(255, 255, 255, 0);
 
+static const uint8_t SSE_MAX_CLIENTS = 4;
+static const unsigned long SSE_KEEPALIVE_MS = 15000;
+static const unsigned long SSE_RETRY_MS = 2000;
+
+// Stalls that end in a burst (a budget set too tight) share one NVS write.
+static const unsigned long STALL_SAVE_MIN_MS = 10000;
+
+static const uint8_t INC_RECENT_KEYS = 16;
+static const uint32_t INC_MAX_DELTA = 100;
+
+static const size_t STATE_JSON_MAX = 640;
+static const size_t METRICS_JSON_MAX = 1024;
+static const size_t STALLS_JSON_MAX = 2048;
+
+static const uint8_t BOOT_MARKS_MAX = 16;
+static const uint32_t WIFI_TASK_STACK = 4096;
+
+struct ExerciseDef {
+  const char *id;
+  const char *oledLabel;
+  const char *nvsKey;
+};
+
+// Exercise 0 keeps the original "count" key so existing totals survive.
+static const ExerciseDef EXERCISES[] = {
+  { "pushups", "PUSHUPS", "count" },
+  { "squats", "SQUATS", "count1" },
+  { "situps", "SITUPS", "count2" },
+};
+static const uint8_t EXERCISE_COUNT = sizeof(EXERCISES) / sizeof(EXERCISES[0]);
+
+// Idempotency key of a batched /api/inc request: random per page load plus a
+// per-batch sequence number that stays the same across retries.
+struct IncKey {
+  uint32_t client;
+  uint32_t seq;
+};
+
+// Running summary of one set, updated on every rep.
+struct SetStats {
+  uint16_t reps;
+  uint32_t firstRepMs;
+  uint32_t lastRepMs;
+};
+
+struct ExerciseState {
+  uint32_t total;
+  uint16_t setsDone;
+  SetStats current;
+  SetStats last;
+};
+
+// Loop stages watched for stalls. Budgets are in ms, 0 = not watched, and
+// can be changed through POST /api/stalls.
+enum LoopStage : uint8_t {
+  STAGE_INPUT,
+  STAGE_HTTP,
+  STAGE_RENDER,
+  STAGE_EVENTS,
+  STAGE_FLASH,
+  STAGE_COUNT
+};
+
+struct StageDef {
+  const char *name;
+  const char *nvsKey;
+  uint16_t defaultBudgetMs;
+};
+
+// A full OLED frame is about 25 ms of I2C; a flash sector erase can take
+// 40 ms or more.
+static const StageDef STAGES[STAGE_COUNT] = {
+  { "input", "stall_input", 20 },
+  { "http", "stall_http", 150 },
+  { "render", "stall_render", 60 },
+  { "events", "stall_events", 50 },
+  { "flash", "stall_flash", 100 },
+};
+
+struct BootMark {
+  const char *phase;
+  uint32_t atUs;
+};
+
 struct ButtonState {
   uint8_t pin;
   bool stableLevel;
@@ -53,8 +146,13 @@ struct ButtonState {
 };
 
 static Preferences prefs;
-static WebServer server(80);
-static uint32_t countValue = 0;
+static HttpServer server(80);
+static ExerciseState exercises[EXERCISE_COUNT];
+static uint8_t activeExercise = 0;
+static RepLog repLog;
+static uint32_t stateVersion = 0;
+static IncKey incRecentKeys[INC_RECENT_KEYS];
+static uint8_t incRecentNext = 0;
 static unsigned long lastCountAcceptedMs = 0;
 
 static ButtonState btnPlus { PIN_PLUS, true, true, 0, 0, false };
@@ -67,13 +165,60 @@ static unsigned long pressedSinceMs = 0;
 static bool holdHandled = false;
 
 static Adafruit_SSD1306 oled(SCREEN_WIDTH, SCREEN_HEIGHT, &Wire, OLED_RESET);
-static TM1637Display tm(TM_CLK, TM_DIO);
+static Tm1637Async tm(TM_CLK, TM_DIO);
 static bool oledReady = false;
 static uint8_t oledAddrUsed = 0;
 static String wifiIpText = "0.0.0.0";
 
+// WiFi comes up in its own task while the displays are probed. The task only
+// fills wifiIpBuf and then raises networkReady; loop() picks it up from there.
+static char wifiIpBuf[16];
+static std::atomic<bool> networkReady(false);
+static bool httpStarted = false;
+
+static BootMark bootMarks[BOOT_MARKS_MAX];
+static std::atomic<uint8_t> bootMarkCount(0);
+
+// Open /api/events streams. WiFiClient is a shared handle, so keeping a copy
+// here keeps the socket alive after the server drops its own reference.
+static WiFiClient sseClients[SSE_MAX_CLIENTS];
+static uint32_t sseSentVersion = 0;
+static unsigned long sseLastWriteMs = 0;
+
+// Time spent per loop pass (without the trailing delay) and per display
+// update, served by /api/metrics.
+static LatencyHistogram loopUs;
+static LatencyHistogram tmUpdateUs;
+static LatencyHistogram oledUpdateUs;
+
+// Kept through resets other than power loss; mirrored to NVS as "stalls".
+RTC_NOINIT_ATTR static StallRing stallRing;
+static StallWatch stallWatch;
+static uint32_t stallsLogged = 0;
+static uint32_t stallsSaved = 0;
+static unsigned long stallsSavedMs = 0;
+static uint32_t bootId = 0;
+
 static void applyCountAndSync();
 
+static void bootMark(const char *phase) {
+  uint8_t i = bootMarkCount.fetch_add(1);
+  if (i < BOOT_MARKS_MAX) {
+    bootMarks[i] = { phase, static_cast<uint32_t>(micros()) };
+  }
+}
+
+static void printBootTimeline() {
+  uint8_t count = bootMarkCount.load();
+  if (count > BOOT_MARKS_MAX) {
+    count = BOOT_MARKS_MAX;
+  }
+  Serial.println("Boot timeline (us since start):");
+  for (uint8_t i = 0; i < count; i++) {
+    Serial.printf("  %8lu  %s\r\n", static_cast<unsigned long>(bootMarks[i].atUs), bootMarks[i].phase);
+  }
+}
+
 static bool i2cDevicePresent(uint8_t addr) {
   Wire.beginTransmission(addr);
   return Wire.endTransmission() == 0;
@@ -99,29 +244,36 @@ static void drawOLED() {
   oled.clearDisplay();
   oled.setTextColor(SSD1306_WHITE);
 
+  const ExerciseState &ex = exercises[activeExercise];
+
   oled.setTextSize(1);
   oled.setCursor(0, 0);
-  oled.print(WIFI_AP_LABEL);
+  oled.printf("%s  SET %u", EXERCISES[activeExercise].oledLabel, ex.setsDone + 1);
 
-  oled.setTextSize(3);
-  oled.setCursor(0, 14);
-  oled.print(countValue);
+  blitBigNumber(oled.getBuffer(), SCREEN_WIDTH, OLED_COUNT_PAGE, 0, ex.total);
 
   oled.setTextSize(1);
   oled.setCursor(0, 52);
-  oled.print(wifiIpText);
+  oled.printf("%s %s", WIFI_AP_LABEL, wifiIpText.c_str());
 
   oled.display();
 }
 
+// Queues the digits for the timer to clock out; an unchanged count costs
+// a compare.
 static void drawTM() {
-  uint16_t v = static_cast<uint16_t>(countValue % 10000);
-  tm.showNumberDec(v, true);
+  uint16_t v = static_cast<uint16_t>(exercises[activeExercise].total % 10000);
+  tm.show(tm1637Number(v));
 }
 
 static void renderDisplay() {
+  StallScope render(stallWatch, STAGE_RENDER);
+  uint32_t startUs = micros();
   drawTM();
+  uint32_t tmDoneUs = micros();
   drawOLED();
+  tmUpdateUs.record(tmDoneUs - startUs);
+  oledUpdateUs.record(micros() - tmDoneUs);
 }
 
 static void initDisplays() {
@@ -134,8 +286,11 @@ static void initDisplays() {
     initOLEDAtAddress(OLED_ADDR_1) || initOLEDAtAddress(OLED_ADDR_2);
   }
 
+  if (!tm.begin()) {
+    Serial.println("TM1637: timer unavailable");
+  }
   tm.setBrightness(7, true);
-  tm.clear();
+  tm.show(0);
 
   if (oledReady) {
     Serial.printf("OLED: OK at 0x%02X\r\n", oledAddrUsed);
@@ -147,24 +302,127 @@ static void initDisplays() {
 }
 
 static void saveCount() {
-  prefs.putULong("count", static_cast<unsigned long>(countValue));
+  StallScope flash(stallWatch, STAGE_FLASH);
+  prefs.putULong(EXERCISES[activeExercise].nvsKey, static_cast<unsigned long>(exercises[activeExercise].total));
+}
+
+static void markStateChanged() {
+  stateVersion++;
+  renderDisplay();
 }
 
 static void applyCountAndSync() {
   saveCount();
-  renderDisplay();
+  markStateChanged();
+}
+
+static uint32_t setDurationMs(const SetStats &set) {
+  return set.reps > 1 ? set.lastRepMs - set.firstRepMs : 0;
+}
+
+// Reps per minute over the intervals between reps of the set.
+static uint32_t setCadenceRpm(const SetStats &set) {
+  uint32_t duration = setDurationMs(set);
+  if (duration == 0) {
+    return 0;
+  }
+  return static_cast<uint32_t>((set.reps - 1) * 60000ULL / duration);
+}
+
+static void appendRepLog(RepLogKind kind, uint32_t nowMs) {
+  StallScope flash(stallWatch, STAGE_FLASH);
+  repLog.append(kind, activeExercise, nowMs);
 }
 
 static void resetCountValue() {
-  countValue = 0;
+  ExerciseState &ex = exercises[activeExercise];
+  ex.total = 0;
+  ex.setsDone = 0;
+  ex.current = SetStats {};
+  ex.last = SetStats {};
+  appendRepLog(REPLOG_RESET, millis());
   applyCountAndSync();
 }
 
-static void incrementCountValue() {
-  countValue++;
+// Counts reps made at the given times, oldest first and none before the
+// newest rep log event.
+static void countReps(const uint32_t *repMs, uint32_t count) {
+  ExerciseState &ex = exercises[activeExercise];
+  if (ex.current.reps == 0) {
+    ex.current.firstRepMs = repMs[0];
+  }
+  ex.current.reps += count;
+  ex.current.lastRepMs = repMs[count - 1];
+  {
+    StallScope flash(stallWatch, STAGE_FLASH);
+    repLog.appendBatch(REPLOG_REP, activeExercise, repMs, count);
+  }
+  ex.total += count;
   applyCountAndSync();
 }
 
+static void incrementCountValue() {
+  uint32_t now = millis();
+  countReps(&now, 1);
+}
+
+static void endCurrentSet() {
+  ExerciseState &ex = exercises[activeExercise];
+  if (ex.current.reps == 0) {
+    return;
+  }
+  ex.last = ex.current;
+  ex.current = SetStats {};
+  ex.setsDone++;
+  appendRepLog(REPLOG_SET_END, millis());
+  Serial.printf("Set %u of %s: reps=%u duration=%lums cadence=%lu/min\r\n",
+                ex.setsDone, EXERCISES[activeExercise].id, ex.last.reps,
+                static_cast<unsigned long>(setDurationMs(ex.last)),
+                static_cast<unsigned long>(setCadenceRpm(ex.last)));
+  markStateChanged();
+}
+
+static void selectExercise(uint8_t id) {
+  if (id == activeExercise) {
+    return;
+  }
+  endCurrentSet();
+  activeExercise = id;
+  {
+    StallScope flash(stallWatch, STAGE_FLASH);
+    prefs.putUChar("exercise", id);
+  }
+  markStateChanged();
+}
+
+static bool incKeySeen(const IncKey &key) {
+  for (uint8_t i = 0; i < INC_RECENT_KEYS; i++) {
+    if (incRecentKeys[i].client == key.client && incRecentKeys[i].seq == key.seq) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static void rememberIncKey(const IncKey &key) {
+  incRecentKeys[incRecentNext] = key;
+  incRecentNext = (incRecentNext + 1) % INC_RECENT_KEYS;
+}
+
+static bool parseUintArg(const char *name, uint32_t &out) {
+  String value = server.arg(name);
+  if (value.length() == 0) {
+    return false;
+  }
+  char *endptr = nullptr;
+  unsigned long parsed = strtoul(value.c_str(), &endptr, 10);
+  if (endptr == value.c_str() || *endptr != '\0') {
+    return false;
+  }
+  out = static_cast<uint32_t>(parsed);
+  return true;
+}
+
 static void setupResetButton() {
   pinMode(PIN_RESET, INPUT_PULLUP);
   bool s = digitalRead(PIN_RESET);
@@ -187,6 +445,9 @@ static void tickResetButton(unsigned long now) {
     if (stableLevel == LOW) {
       pressedSinceMs = now;
       holdHandled = false;
+    } else if (!holdHandled) {
+      // Short press closes the current set; holding resets the counter.
+      endCurrentSet();
     }
   }
 
@@ -224,21 +485,382 @@ static bool isPressed(const ButtonState &b) {
   return b.stableLevel == false;
 }
 
-static void sendStateJson() {
-  char json[160];
-  snprintf(
-    json,
-    sizeof(json),
-    "{\"count\":%lu,\"ssid\":\"%s\",\"ip\":\"%s\"}",
-    static_cast<unsigned long>(countValue),
+static void jsonAppend(char *out, size_t outSize, size_t &len, const char *fmt, ...) {
+  if (len + 1 >= outSize) {
+    return;
+  }
+  va_list args;
+  va_start(args, fmt);
+  int written = vsnprintf(out + len, outSize - len, fmt, args);
+  va_end(args);
+  if (written > 0) {
+    len = (len + written < outSize) ? len + written : outSize - 1;
+  }
+}
+
+static size_t formatStateJson(char *out, size_t outSize) {
+  size_t len = 0;
+  jsonAppend(
+    out,
+    outSize,
+    len,
+    "{\"count\":%lu,\"version\":%lu,\"exercise\":%u,\"ssid\":\"%s\",\"ip\":\"%s\",\"exercises\":[",
+    static_cast<unsigned long>(exercises[activeExercise].total),
+    static_cast<unsigned long>(stateVersion),
+    activeExercise,
     WIFI_AP_SSID,
     wifiIpText.c_str()
   );
+  for (uint8_t i = 0; i < EXERCISE_COUNT; i++) {
+    const ExerciseState &ex = exercises[i];
+    jsonAppend(
+      out,
+      outSize,
+      len,
+      "%s{\"id\":\"%s\",\"count\":%lu,\"sets\":%u,\"set_reps\":%u,"
+      "\"last_set\":{\"reps\":%u,\"duration_ms\":%lu,\"cadence_rpm\":%lu}}",
+      i == 0 ? "" : ",",
+      EXERCISES[i].id,
+      static_cast<unsigned long>(ex.total),
+      ex.setsDone,
+      ex.current.reps,
+      ex.last.reps,
+      static_cast<unsigned long>(setDurationMs(ex.last)),
+      static_cast<unsigned long>(setCadenceRpm(ex.last))
+    );
+  }
+  jsonAppend(out, outSize, len, "]}");
+  return len;
+}
+
+static void appendHistogramJson(char *out, size_t outSize, size_t &len, const char *name,
+                                const LatencyHistogram &h) {
+  jsonAppend(out, outSize, len, "\"%s\":{\"count\":%lu,\"avg_us\":%lu,\"max_us\":%lu,\"buckets\":[", name,
+             static_cast<unsigned long>(h.count()), static_cast<unsigned long>(h.avgUs()),
+             static_cast<unsigned long>(h.maxUs()));
+  for (uint8_t i = 0; i < LATENCY_BUCKETS; i++) {
+    jsonAppend(out, outSize, len, "%s%lu", i == 0 ? "" : ",", static_cast<unsigned long>(h.bucket(i)));
+  }
+  jsonAppend(out, outSize, len, "]},");
+}
+
+// GET /api/metrics: loop and display timing histograms (bucket i counts
+// durations of [2^i, 2^(i+1)) us) plus the TM1637 driver counters.
+static void handleMetrics() {
+  char json[METRICS_JSON_MAX];
+  size_t len = 0;
+  jsonAppend(json, sizeof(json), len, "{");
+  appendHistogramJson(json, sizeof(json), len, "loop", loopUs);
+  appendHistogramJson(json, sizeof(json), len, "tm_update", tmUpdateUs);
+  appendHistogramJson(json, sizeof(json), len, "oled_update", oledUpdateUs);
+  jsonAppend(json, sizeof(json), len, "\"tm1637\":{\"frames\":%lu,\"skipped\":%lu,\"nacks\":%lu,\"idle\":%s}}",
+             static_cast<unsigned long>(tm.frames()), static_cast<unsigned long>(tm.skipped()),
+             static_cast<unsigned long>(tm.nacks()), tm.idle() ? "true" : "false");
+
+  server.sendHeader("Cache-Control", "no-store, no-cache, must-revalidate");
+  server.send(200, "application/json; charset=utf-8", json);
+}
+
+// A warm reset keeps the RTC ring, including a stall that never ended;
+// after a power cycle the NVS copy stands in.
+static void setupStallWatch() {
+  bool retained = stallRingValid(stallRing);
+  if (!retained) {
+    prefs.getBytes("stalls", &stallRing, sizeof(stallRing));
+  }
+  stallWatch.begin(&stallRing, bootId);
+  for (uint8_t i = 0; i < STAGE_COUNT; i++) {
+    stallWatch.setBudget(i, prefs.getUShort(STAGES[i].nvsKey, STAGES[i].defaultBudgetMs));
+  }
+  if (retained) {
+    prefs.putBytes("stalls", &stallRing, sizeof(stallRing));
+  }
+  Serial.printf("Stall watch: %u recorded, %s\r\n", stallRing.count, retained ? "kept over reset" : "from NVS");
+}
+
+// Called from loop(): logs stalls once they have ended and persists the ring
+// at most every STALL_SAVE_MIN_MS. The save is not a flash stage: a slow
+// write recorded as a stall would call for another save, and so on.
+static void tickStallWatch() {
+  uint32_t closed = stallWatch.closed();
+  if (closed != stallsLogged) {
+    stallsLogged = closed;
+    const StallRecord &r = stallWatch.recent(0);
+    Serial.printf("Stall: %s %lums (budget %ums)\r\n", STAGES[r.stage < STAGE_COUNT ? r.stage : 0].name,
+                  static_cast<unsigned long>(r.durationMs), r.budgetMs);
+  }
+  unsigned long now = millis();
+  if (closed == stallsSaved || now - stallsSavedMs < STALL_SAVE_MIN_MS) {
+    return;
+  }
+  stallsSaved = closed;
+  stallsSavedMs = now;
+  prefs.putBytes("stalls", &stallRing, sizeof(stallRing));
+}
+
+static void sendStallsJson() {
+  char json[STALLS_JSON_MAX];
+  size_t len = 0;
+  jsonAppend(json, sizeof(json), len, "{\"boot\":%lu,\"check_ms\":%lu,\"total\":%lu,\"budgets_ms\":{",
+             static_cast<unsigned long>(bootId), static_cast<unsigned long>(kStallCheckMs),
+             static_cast<unsigned long>(stallRing.total));
+  for (uint8_t i = 0; i < STAGE_COUNT; i++) {
+    jsonAppend(json, sizeof(json), len, "%s\"%s\":%u", i == 0 ? "" : ",", STAGES[i].name, stallWatch.budget(i));
+  }
+  jsonAppend(json, sizeof(json), len, "},\"stalls\":[");
+  for (uint8_t i = 0; i < stallRing.count; i++) {
+    const StallRecord &r = stallWatch.recent(i);
+    jsonAppend(json, sizeof(json), len,
+               "%s{\"stage\":\"%s\",\"boot\":%lu,\"at_ms\":%lu,\"duration_ms\":%lu,\"budget_ms\":%u,\"open\":%s}",
+               i == 0 ? "" : ",", r.stage < STAGE_COUNT ? STAGES[r.stage].name : "?",
+               static_cast<unsigned long>(r.bootId), static_cast<unsigned long>(r.atMs),
+               static_cast<unsigned long>(r.durationMs), r.budgetMs, r.open ? "true" : "false");
+  }
+  jsonAppend(json, sizeof(json), len, "]}");
 
   server.sendHeader("Cache-Control", "no-store, no-cache, must-revalidate");
   server.send(200, "application/json; charset=utf-8", json);
 }
 
+// POST /api/stalls[?<stage>=ms...][&clear=1]: sets stage budgets (0 stops
+// watching a stage) and optionally empties the ring. Every budget is checked
+// before any is applied, so a rejected request changes nothing.
+static void handleStallsUpdate() {
+  uint32_t budgets[STAGE_COUNT];
+  for (uint8_t i = 0; i < STAGE_COUNT; i++) {
+    budgets[i] = stallWatch.budget(i);
+    if (server.hasArg(STAGES[i].name) && (!parseUintArg(STAGES[i].name, budgets[i]) || budgets[i] > UINT16_MAX)) {
+      server.send(400, "application/json; charset=utf-8", "{\"error\":\"invalid budget\"}");
+      return;
+    }
+  }
+  for (uint8_t i = 0; i < STAGE_COUNT; i++) {
+    if (budgets[i] != stallWatch.budget(i)) {
+      stallWatch.setBudget(i, static_cast<uint16_t>(budgets[i]));
+      prefs.putUShort(STAGES[i].nvsKey, static_cast<uint16_t>(budgets[i]));
+    }
+  }
+  if (server.arg("clear") == "1") {
+    stallWatch.clear();
+    prefs.putBytes("stalls", &stallRing, sizeof(stallRing));
+  }
+  sendStallsJson();
+}
+
+static void sendStateJson(int code = 200) {
+  char json[STATE_JSON_MAX];
+  formatStateJson(json, sizeof(json));
+
+  server.sendHeader("Cache-Control", "no-store, no-cache, must-revalidate");
+  server.send(code, "application/json; charset=utf-8", json);
+}
+
+static bool writeStateEvent(WiFiClient &client) {
+  char event[STATE_JSON_MAX + 32];
+  size_t len = 0;
+  jsonAppend(event, sizeof(event), len, "id: %lu\ndata: ", static_cast<unsigned long>(stateVersion));
+  len += formatStateJson(event + len, sizeof(event) - len);
+  jsonAppend(event, sizeof(event), len, "\n\n");
+  return client.write(reinterpret_cast<const uint8_t *>(event), len) == len;
+}
+
+static void handleEventsSubscribe() {
+  int8_t slot = -1;
+  for (uint8_t i = 0; i < SSE_MAX_CLIENTS; i++) {
+    if (!sseClients[i].connected()) {
+      sseClients[i].stop();
+      slot = i;
+      break;
+    }
+  }
+  if (slot < 0) {
+    server.send(503, "text/plain; charset=utf-8", "Too many event streams");
+    return;
+  }
+
+  WiFiClient client = server.client();
+  client.setNoDelay(true);
+  client.print(
+    "HTTP/1.1 200 OK\r\n"
+    "Content-Type: text/event-stream\r\n"
+    "Cache-Control: no-store\r\n"
+    "Connection: keep-alive\r\n"
+    "\r\n"
+  );
+  client.printf("retry: %lu\n\n", SSE_RETRY_MS);
+  if (!writeStateEvent(client)) {
+    client.stop();
+    return;
+  }
+  sseClients[slot] = client;
+  Serial.printf("SSE: client %d subscribed\r\n", slot);
+}
+
+static void tickEventStreams(unsigned long now) {
+  bool changed = stateVersion != sseSentVersion;
+  bool keepalive = !changed && (now - sseLastWriteMs >= SSE_KEEPALIVE_MS);
+  if (!changed && !keepalive) {
+    return;
+  }
+
+  for (uint8_t i = 0; i < SSE_MAX_CLIENTS; i++) {
+    WiFiClient &client = sseClients[i];
+    if (!client.connected()) {
+      continue;
+    }
+    bool ok = changed
+      ? writeStateEvent(client)
+      : client.write(reinterpret_cast<const uint8_t *>(":\n\n"), 3) == 3;
+    if (!ok) {
+      client.stop();
+    }
+  }
+
+  sseSentVersion = stateVersion;
+  sseLastWriteMs = now;
+}
+
+// Comma-separated list of exactly count unsigned values.
+static bool parseUintListArg(const char *name, uint32_t *out, uint32_t count) {
+  String value = server.arg(name);
+  const char *p = value.c_str();
+  for (uint32_t i = 0; i < count; i++) {
+    char *endptr = nullptr;
+    if (*p < '0' || *p > '9') {
+      return false;
+    }
+    out[i] = static_cast<uint32_t>(strtoul(p, &endptr, 10));
+    if (*endptr != (i + 1 < count ? ',' : '\0')) {
+      return false;
+    }
+    p = endptr + 1;
+  }
+  return count > 0 || value.length() == 0;
+}
+
+// POST /api/inc[?delta=N][&client=C&seq=S][&exercise=E&set=S][&ago=A[&gaps=G,...]]
+// Without a key every request counts; with one, a retried batch is applied
+// only once as long as its key is still in the recent-keys table.
+// With an exercise and set (its sets done so far) the batch gets 409 once
+// those are no longer current, instead of landing in another one.
+// ago is how many ms before the request the newest rep was made and gaps
+// the ms between consecutive reps, delta - 1 of them; no rep is dated
+// before the newest rep log event.
+static void handleIncrement() {
+  uint32_t delta = 1;
+  if (server.hasArg("delta") && (!parseUintArg("delta", delta) || delta == 0 || delta > INC_MAX_DELTA)) {
+    server.send(400, "application/json; charset=utf-8", "{\"error\":\"invalid delta\"}");
+    return;
+  }
+
+  IncKey key { 0, 0 };
+  bool keyed = server.hasArg("client") || server.hasArg("seq");
+  if (keyed && (!parseUintArg("client", key.client) || !parseUintArg("seq", key.seq) || key.client == 0)) {
+    server.send(400, "application/json; charset=utf-8", "{\"error\":\"invalid key\"}");
+    return;
+  }
+
+  uint32_t exercise = 0;
+  uint32_t set = 0;
+  bool bound = server.hasArg("exercise") || server.hasArg("set");
+  if (bound && (!parseUintArg("exercise", exercise) || !parseUintArg("set", set) || exercise >= EXERCISE_COUNT)) {
+    server.send(400, "application/json; charset=utf-8", "{\"error\":\"invalid exercise or set\"}");
+    return;
+  }
+
+  uint32_t ago = 0;
+  uint32_t gaps[INC_MAX_DELTA] = {};
+  if ((server.hasArg("ago") && !parseUintArg("ago", ago)) ||
+      (server.hasArg("gaps") && !parseUintListArg("gaps", gaps, delta - 1))) {
+    server.send(400, "application/json; charset=utf-8", "{\"error\":\"invalid rep times\"}");
+    return;
+  }
+
+  if (keyed && incKeySeen(key)) {
+    Serial.printf("INC: duplicate client=%lu seq=%lu\r\n",
+                  static_cast<unsigned long>(key.client), static_cast<unsigned long>(key.seq));
+    sendStateJson();
+    return;
+  }
+
+  if (bound && (exercise != activeExercise || set != exercises[activeExercise].setsDone)) {
+    Serial.printf("INC: +%lu for exercise %lu set %lu refused, now %u set %u\r\n",
+                  static_cast<unsigned long>(delta), static_cast<unsigned long>(exercise),
+                  static_cast<unsigned long>(set), activeExercise, exercises[activeExercise].setsDone);
+    sendStateJson(409);
+    return;
+  }
+
+  if (keyed) {
+    rememberIncKey(key);
+  }
+
+  // Offsets from the newest logged event, walked back from the newest rep.
+  uint32_t repMs[INC_MAX_DELTA];
+  uint32_t floorMs = repLog.lastMs();
+  uint32_t span = millis() - floorMs;
+  uint32_t at = span - (ago < span ? ago : span);
+  for (uint32_t i = delta; i-- > 0;) {
+    repMs[i] = floorMs + at;
+    if (i > 0) {
+      at -= gaps[i - 1] < at ? gaps[i - 1] : at;
+    }
+  }
+  countReps(repMs, delta);
+  sendStateJson();
+}
+
+static void handleExerciseSelect() {
+  uint32_t id = 0;
+  if (!parseUintArg("id", id) || id >= EXERCISE_COUNT) {
+    server.send(400, "application/json; charset=utf-8", "{\"error\":\"invalid exercise\"}");
+    return;
+  }
+  selectExercise(static_cast<uint8_t>(id));
+  sendStateJson();
+}
+
+static const ExportColumn REPLOG_COLUMNS[] = { { "boot" }, { "ms" }, { "exercise" }, { "event" } };
+
+// Rep log events as export rows, decoded from flash as they are pulled.
+class RepLogRows {
+public:
+  explicit RepLogRows(const RepLog &log) : reader_(log) {}
+
+  bool next(ExportRow &row) {
+    static const char *const KIND_NAMES[] = { "rep", "set_end", "reset" };
+    RepLogEvent ev;
+    if (!reader_.next(ev)) {
+      return false;
+    }
+    row.number(ev.bootId);
+    row.number(ev.ms);
+    row.text(ev.exercise < EXERCISE_COUNT ? EXERCISES[ev.exercise].id : "?");
+    row.text(KIND_NAMES[ev.kind]);
+    return true;
+  }
+
+private:
+  RepLogReader reader_;
+};
+
+static ExportStream<RepLogRows> logExport { RepLogRows(repLog) };
+
+// GET /api/log[?format=csv|ndjson]: the whole rep log, decoded from flash
+// and streamed a chunk per loop pass by tickLogExport().
+static void handleLogExport() {
+  if (logExport.busy()) {
+    server.send(503, "text/plain; charset=utf-8", "Export already running");
+    return;
+  }
+  logExport.start(server.client(), exportFormatFromArg(server.arg("format")), "replog", REPLOG_COLUMNS,
+                  sizeof(REPLOG_COLUMNS) / sizeof(REPLOG_COLUMNS[0]), RepLogRows(repLog));
+}
+
+static void tickLogExport() {
+  logExport.tick();
+}
+
 static void setupHttpServer() {
   server.on("/", HTTP_GET, []() {
     server.sendHeader("Cache-Control", "no-store, no-cache, must-revalidate");
@@ -249,9 +871,12 @@ static void setupHttpServer() {
     sendStateJson();
   });
 
+  server.on("/api/events", HTTP_GET, []() {
+    handleEventsSubscribe();
+  });
+
   server.on("/api/inc", HTTP_POST, []() {
-    incrementCountValue();
-    sendStateJson();
+    handleIncrement();
   });
 
   server.on("/api/reset", HTTP_POST, []() {
@@ -259,6 +884,31 @@ static void setupHttpServer() {
     sendStateJson();
   });
 
+  server.on("/api/set", HTTP_POST, []() {
+    endCurrentSet();
+    sendStateJson();
+  });
+
+  server.on("/api/exercise", HTTP_POST, []() {
+    handleExerciseSelect();
+  });
+
+  server.on("/api/log", HTTP_GET, []() {
+    handleLogExport();
+  });
+
+  server.on("/api/stalls", HTTP_GET, []() {
+    sendStallsJson();
+  });
+
+  server.on("/api/stalls", HTTP_POST, []() {
+    handleStallsUpdate();
+  });
+
+  server.on("/api/metrics", HTTP_GET, []() {
+    handleMetrics();
+  });
+
   server.on("/favicon.ico", HTTP_GET, []() {
     server.send(204);
   });
@@ -283,23 +933,60 @@ static void setupWiFi() {
     apOk = WiFi.softAP(WIFI_AP_SSID, WIFI_AP_PASSWORD);
   }
 
-  wifiIpText = WiFi.softAPIP().toString();
+  snprintf(wifiIpBuf, sizeof(wifiIpBuf), "%s", WiFi.softAPIP().toString().c_str());
   Serial.printf("WiFi AP: %s\r\n", apOk ? "OK" : "FAIL");
   Serial.printf("SSID: %s\r\n", WIFI_AP_SSID);
-  Serial.printf("Open: http://%s\r\n", wifiIpText.c_str());
+  Serial.printf("Open: http://%s\r\n", wifiIpBuf);
+}
+
+static void wifiTask(void *) {
+  setupWiFi();
+  bootMark("wifi ap up");
+  networkReady.store(true);
+  vTaskDelete(nullptr);
+}
+
+// Runs from loop() once the WiFi task is done, so everything that touches
+// the server or wifiIpText stays on the loop task.
+static void startNetworkServices() {
+  wifiIpText = wifiIpBuf;
+  setupHttpServer();
+  httpStarted = true;
+  bootMark("http up");
+  markStateChanged();
+  printBootTimeline();
 }
 
 void setup() {
+  bootMark("setup");
   pinMode(PIN_PLUS, INPUT_PULLUP);
 
   Serial.begin(115200);
-  delay(250);
   Serial.println("Boot...");
   Serial.printf("Board profile: %s\r\n", BOARD_NAME);
   Serial.printf("Buttons: plus=%u reset=%u\r\n", PIN_PLUS, PIN_RESET);
 
   prefs.begin("pushup", false);
-  countValue = prefs.getULong("count", 0);
+  for (uint8_t i = 0; i < EXERCISE_COUNT; i++) {
+    exercises[i].total = prefs.getULong(EXERCISES[i].nvsKey, 0);
+  }
+  activeExercise = prefs.getUChar("exercise", 0);
+  if (activeExercise >= EXERCISE_COUNT) {
+    activeExercise = 0;
+  }
+  bootMark("nvs");
+
+  bootId = prefs.getULong("boot", 0) + 1;
+  prefs.putULong("boot", bootId);
+  if (repLog.begin(bootId)) {
+    Serial.printf("Rep log: boot %lu, %lu sectors\r\n",
+                  static_cast<unsigned long>(bootId), static_cast<unsigned long>(repLog.sectorCount()));
+  } else {
+    Serial.println("Rep log: no data partition");
+  }
+  bootMark("rep log");
+
+  setupStallWatch();
 
   btnPlus.stableLevel = (digitalRead(btnPlus.pin) != LOW);
   btnPlus.lastSampled = btnPlus.stableLevel;
@@ -307,30 +994,55 @@ void setup() {
   btnPlus.pressedSinceMs = isPressed(btnPlus) ? millis() : 0;
 
   setupResetButton();
-  setupWiFi();
+  bootMark("buttons");
+
+  if (xTaskCreate(wifiTask, "wifi_up", WIFI_TASK_STACK, nullptr, 1, nullptr) != pdPASS) {
+    setupWiFi();
+    bootMark("wifi ap up");
+    networkReady.store(true);
+  }
+
   initDisplays();
+  bootMark("displays");
   renderDisplay();
-  setupHttpServer();
+  bootMark("first render");
 }
 
 void loop() {
+  uint32_t loopStartUs = micros();
   unsigned long now = millis();
 
-  server.handleClient();
+  if (httpStarted) {
+    StallScope http(stallWatch, STAGE_HTTP);
+    server.handleClient();
+    tickLogExport();
+  } else if (networkReady.load()) {
+    startNetworkServices();
+  }
 
-  updateButton(btnPlus);
-  tickResetButton(now);
+  {
+    StallScope input(stallWatch, STAGE_INPUT);
+    updateButton(btnPlus);
+    tickResetButton(now);
 
-  static bool plusWasPressed = false;
-  if (isPressed(btnPlus)) {
-    plusWasPressed = true;
-  } else if (plusWasPressed) {
-    plusWasPressed = false;
-    if (now - lastCountAcceptedMs >= ANTI_MULTICLICK_MS) {
-      lastCountAcceptedMs = now;
-      incrementCountValue();
+    static bool plusWasPressed = false;
+    if (isPressed(btnPlus)) {
+      plusWasPressed = true;
+    } else if (plusWasPressed) {
+      plusWasPressed = false;
+      if (now - lastCountAcceptedMs >= ANTI_MULTICLICK_MS) {
+        lastCountAcceptedMs = now;
+        incrementCountValue();
+      }
     }
   }
 
+  {
+    StallScope events(stallWatch, STAGE_EVENTS);
+    tickEventStreams(now);
+  }
+  tickStallWatch();
+
+  loopUs.record(micros() - loopStartUs);
   delay(5);
 }
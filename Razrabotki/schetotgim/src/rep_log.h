@@ -0,0 +1,330 @@
+#pragma once
+
+#include <Arduino.h>
+#include <esp_partition.h>
+
+// Append-only rep log kept in a raw data partition (the SPIFFS slot of the
+// default partition table, which this firmware does not otherwise use). The
+// partition is a ring of 4 KB sectors; the oldest sector is erased when the
+// head runs out of room.
+//
+// Sector layout: RepLogSectorHeader, then 4-byte records. Record byte 0 holds
+// the kind (top 2 bits) and exercise id (low 6 bits), bytes 1..3 the
+// little-endian milliseconds since the previous record of the same boot.
+// Erased flash reads 0xFF, so an all-ones word ends the sector.
+
+static const uint32_t REPLOG_MAGIC = 0x31474C52;  // "RLG1"
+static const uint32_t REPLOG_SECTOR_SIZE = 4096;
+static const uint32_t REPLOG_EMPTY = 0xFFFFFFFF;
+static const uint32_t REPLOG_DT_MAX = 0xFFFFFF;
+static const uint32_t REPLOG_BATCH_WORDS = 64;  // staging buffer of appendBatch()
+
+enum RepLogKind : uint8_t {
+  REPLOG_REP = 0,
+  REPLOG_SET_END = 1,
+  REPLOG_RESET = 2,
+  REPLOG_MARK = 3,  // id field selects a RepLogMark, value is not a time
+};
+
+enum RepLogMark : uint8_t {
+  REPLOG_MARK_BOOT = 0,  // value = boot id (low 24 bits), time restarts at 0
+  REPLOG_MARK_GAP = 1,   // value = whole seconds skipped before next record
+};
+
+struct RepLogSectorHeader {
+  uint32_t magic;
+  uint32_t seq;
+  uint32_t bootId;
+  uint32_t baseMs;  // time of the last record written before this sector
+};
+
+struct RepLogEvent {
+  uint32_t bootId;
+  uint32_t ms;  // since boot
+  RepLogKind kind;
+  uint8_t exercise;
+};
+
+static inline uint32_t repLogPack(uint8_t kind, uint8_t id, uint32_t value) {
+  return (static_cast<uint32_t>(kind & 0x03) << 6) | (id & 0x3F) | ((value & REPLOG_DT_MAX) << 8);
+}
+
+class RepLog {
+public:
+  bool begin(uint32_t bootId) {
+    part_ = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_SPIFFS, nullptr);
+    if (part_ == nullptr || part_->size < 2 * REPLOG_SECTOR_SIZE) {
+      part_ = nullptr;
+      return false;
+    }
+    sectorCount_ = part_->size / REPLOG_SECTOR_SIZE;
+    bootId_ = bootId;
+    lastMs_ = 0;
+
+    bool found = false;
+    for (uint32_t s = 0; s < sectorCount_; s++) {
+      RepLogSectorHeader hdr;
+      if (readHeader(s, hdr) && (!found || static_cast<int32_t>(hdr.seq - headSeq_) > 0)) {
+        found = true;
+        head_ = s;
+        headSeq_ = hdr.seq;
+      }
+    }
+
+    if (!found) {
+      head_ = sectorCount_ - 1;
+      headSeq_ = 0;
+      writeOffset_ = REPLOG_SECTOR_SIZE;
+    } else {
+      writeOffset_ = findWriteOffset(head_);
+    }
+
+    return appendWord(repLogPack(REPLOG_MARK, REPLOG_MARK_BOOT, bootId));
+  }
+
+  bool ready() const {
+    return part_ != nullptr;
+  }
+
+  bool append(RepLogKind kind, uint8_t exercise, uint32_t nowMs) {
+    return appendBatch(kind, exercise, &nowMs, 1);
+  }
+
+  // Events of one kind, oldest first and none before lastMs(). They reach
+  // flash with one write per sector they land in.
+  bool appendBatch(RepLogKind kind, uint8_t exercise, const uint32_t *nowMs, uint32_t count) {
+    if (part_ == nullptr) {
+      return false;
+    }
+    uint32_t words[REPLOG_BATCH_WORDS];
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < count; i++) {
+      // A 32-bit dt needs at most one gap mark ahead of the event.
+      if (n + 2 > REPLOG_BATCH_WORDS) {
+        if (!appendWords(words, n)) {
+          return false;
+        }
+        n = 0;
+      }
+      uint32_t dt = nowMs[i] - lastMs_;
+      while (dt > REPLOG_DT_MAX) {
+        uint32_t gapSec = dt / 1000;
+        if (gapSec > REPLOG_DT_MAX) {
+          gapSec = REPLOG_DT_MAX;
+        }
+        words[n++] = repLogPack(REPLOG_MARK, REPLOG_MARK_GAP, gapSec);
+        lastMs_ += gapSec * 1000;
+        dt = nowMs[i] - lastMs_;
+      }
+      words[n++] = repLogPack(kind, exercise, dt);
+      lastMs_ = nowMs[i];
+    }
+    return appendWords(words, n);
+  }
+
+  // Time of the newest event, in millis() of this boot.
+  uint32_t lastMs() const {
+    return lastMs_;
+  }
+
+  // Oldest sector still holding data; the ring has wrapped once the sector
+  // after the head carries a valid header.
+  uint32_t oldestSector() const {
+    RepLogSectorHeader hdr;
+    uint32_t next = (head_ + 1) % sectorCount_;
+    return readHeader(next, hdr) ? next : 0;
+  }
+
+  uint32_t headSector() const {
+    return head_;
+  }
+
+  uint32_t headSeq() const {
+    return headSeq_;
+  }
+
+  uint32_t sectorCount() const {
+    return sectorCount_;
+  }
+
+  bool readHeader(uint32_t sector, RepLogSectorHeader &hdr) const {
+    if (esp_partition_read(part_, sector * REPLOG_SECTOR_SIZE, &hdr, sizeof(hdr)) != ESP_OK) {
+      return false;
+    }
+    return hdr.magic == REPLOG_MAGIC;
+  }
+
+  bool readWords(uint32_t sector, uint32_t offset, uint32_t *out, size_t count) const {
+    return esp_partition_read(part_, sector * REPLOG_SECTOR_SIZE + offset, out, count * sizeof(uint32_t)) == ESP_OK;
+  }
+
+private:
+  // First erased slot in a sector; written slots are always contiguous.
+  uint32_t findWriteOffset(uint32_t sector) const {
+    uint32_t lo = 0;
+    uint32_t hi = (REPLOG_SECTOR_SIZE - sizeof(RepLogSectorHeader)) / sizeof(uint32_t);
+    while (lo < hi) {
+      uint32_t mid = (lo + hi) / 2;
+      uint32_t word = REPLOG_EMPTY;
+      readWords(sector, sizeof(RepLogSectorHeader) + mid * sizeof(uint32_t), &word, 1);
+      if (word == REPLOG_EMPTY) {
+        hi = mid;
+      } else {
+        lo = mid + 1;
+      }
+    }
+    return sizeof(RepLogSectorHeader) + lo * sizeof(uint32_t);
+  }
+
+  bool startNextSector() {
+    uint32_t next = (head_ + 1) % sectorCount_;
+    if (esp_partition_erase_range(part_, next * REPLOG_SECTOR_SIZE, REPLOG_SECTOR_SIZE) != ESP_OK) {
+      return false;
+    }
+    RepLogSectorHeader hdr { REPLOG_MAGIC, headSeq_ + 1, bootId_, lastMs_ };
+    if (esp_partition_write(part_, next * REPLOG_SECTOR_SIZE, &hdr, sizeof(hdr)) != ESP_OK) {
+      return false;
+    }
+    head_ = next;
+    headSeq_ = hdr.seq;
+    writeOffset_ = sizeof(hdr);
+    return true;
+  }
+
+  bool appendWord(uint32_t word) {
+    return appendWords(&word, 1);
+  }
+
+  bool appendWords(const uint32_t *words, uint32_t count) {
+    while (count > 0) {
+      if (writeOffset_ + sizeof(uint32_t) > REPLOG_SECTOR_SIZE && !startNextSector()) {
+        return false;
+      }
+      uint32_t fit = (REPLOG_SECTOR_SIZE - writeOffset_) / sizeof(uint32_t);
+      uint32_t n = count < fit ? count : fit;
+      if (esp_partition_write(part_, head_ * REPLOG_SECTOR_SIZE + writeOffset_, words, n * sizeof(uint32_t)) != ESP_OK) {
+        return false;
+      }
+      writeOffset_ += n * sizeof(uint32_t);
+      words += n;
+      count -= n;
+    }
+    return true;
+  }
+
+  const esp_partition_t *part_ = nullptr;
+  uint32_t sectorCount_ = 0;
+  uint32_t head_ = 0;
+  uint32_t headSeq_ = 0;
+  uint32_t writeOffset_ = 0;
+  uint32_t bootId_ = 0;
+  uint32_t lastMs_ = 0;
+};
+
+// Walks the log from the oldest sector to the head through a 64-byte window,
+// so a full partition can be streamed without holding it in RAM. The walk
+// may span loop passes while events are appended: it ends at the head
+// sector it started with, and skips the rest of a sector the ring has
+// recycled under it.
+class RepLogReader {
+public:
+  explicit RepLogReader(const RepLog &log) : log_(&log) {
+    if (log_->ready()) {
+      sector_ = log_->oldestSector();
+      endSeq_ = log_->headSeq();
+      remainingSectors_ = (log_->headSector() + log_->sectorCount() - sector_) % log_->sectorCount() + 1;
+      openSector();
+    }
+  }
+
+  bool next(RepLogEvent &out) {
+    while (remainingSectors_ > 0) {
+      if (bufPos_ == bufLen_ && !refill()) {
+        nextSector();
+        continue;
+      }
+      uint32_t word = buf_[bufPos_++];
+      if (word == REPLOG_EMPTY) {
+        nextSector();
+        continue;
+      }
+
+      uint8_t kind = (word >> 6) & 0x03;
+      uint8_t id = word & 0x3F;
+      uint32_t value = word >> 8;
+      if (kind == REPLOG_MARK) {
+        if (id == REPLOG_MARK_BOOT) {
+          bootId_ = value;
+          ms_ = 0;
+        } else if (id == REPLOG_MARK_GAP) {
+          ms_ += value * 1000;
+        }
+        continue;
+      }
+
+      ms_ += value;
+      out.bootId = bootId_;
+      out.ms = ms_;
+      out.kind = static_cast<RepLogKind>(kind);
+      out.exercise = id;
+      return true;
+    }
+    return false;
+  }
+
+private:
+  static const size_t BUF_WORDS = 16;
+
+  void openSector() {
+    RepLogSectorHeader hdr;
+    offset_ = sizeof(hdr);
+    bufPos_ = 0;
+    bufLen_ = 0;
+    // A sector recycled since the walk began holds events past its end.
+    if (log_->readHeader(sector_, hdr) && static_cast<int32_t>(hdr.seq - endSeq_) <= 0) {
+      seq_ = hdr.seq;
+      bootId_ = hdr.bootId;
+      ms_ = hdr.baseMs;
+    } else {
+      offset_ = REPLOG_SECTOR_SIZE;
+    }
+  }
+
+  void nextSector() {
+    remainingSectors_--;
+    sector_ = (sector_ + 1) % log_->sectorCount();
+    if (remainingSectors_ > 0) {
+      openSector();
+    }
+  }
+
+  bool refill() {
+    size_t words = (REPLOG_SECTOR_SIZE - offset_) / sizeof(uint32_t);
+    if (words == 0) {
+      return false;
+    }
+    if (words > BUF_WORDS) {
+      words = BUF_WORDS;
+    }
+    RepLogSectorHeader hdr;
+    if (!log_->readHeader(sector_, hdr) || hdr.seq != seq_ || !log_->readWords(sector_, offset_, buf_, words)) {
+      return false;
+    }
+    offset_ += words * sizeof(uint32_t);
+    bufPos_ = 0;
+    bufLen_ = words;
+    return true;
+  }
+
+  const RepLog *log_;
+  uint32_t sector_ = 0;
+  uint32_t remainingSectors_ = 0;
+  uint32_t offset_ = 0;
+  uint32_t seq_ = 0;
+  uint32_t endSeq_ = 0;
+  uint32_t buf_[BUF_WORDS];
+  size_t bufPos_ = 0;
+  size_t bufLen_ = 0;
+  uint32_t bootId_ = 0;
+  uint32_t ms_ = 0;
+};
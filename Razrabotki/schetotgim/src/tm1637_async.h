@@ -0,0 +1,246 @@
+#pragma once
+
+#include <Arduino.h>
+#include <esp_timer.h>
+
+#include <atomic>
+
+// TM1637 driver that never blocks the caller. show() only stores the four
+// segment bytes; a periodic esp_timer clocks the frame out one bit-phase per
+// tick and stops itself once the display matches the latest request. A frame
+// is three transfers (data command, address + 4 digits, display control),
+// 138 phases, so about 7 ms on the timer and nothing on the loop.
+//
+// The bus is open-drain like the original library: a line is driven low by
+// switching the pin to OUTPUT with the latch at LOW and released to the
+// external pull-up by switching it back to INPUT.
+
+static const uint32_t TM1637_PHASE_US = 50;
+static const uint8_t TM1637_DIGITS = 4;
+static const uint8_t TM1637_CMD_DATA = 0x40;     // write, auto-increment
+static const uint8_t TM1637_CMD_ADDRESS = 0xC0;  // first digit
+static const uint8_t TM1637_CMD_DISPLAY = 0x80;  // | 0x08 on, | brightness 0..7
+
+static const uint8_t TM1637_DIGIT_SEGMENTS[10] = {
+  0x3F, 0x06, 0x5B, 0x4F, 0x66, 0x6D, 0x7D, 0x07, 0x7F, 0x6F,
+};
+
+// Four digits with leading zeros, as showNumberDec(value, true) drew them.
+static inline uint32_t tm1637Number(uint16_t value) {
+  uint32_t packed = 0;
+  for (uint8_t i = 0; i < TM1637_DIGITS; i++) {
+    packed |= static_cast<uint32_t>(TM1637_DIGIT_SEGMENTS[value % 10]) << (8 * (TM1637_DIGITS - 1 - i));
+    value /= 10;
+  }
+  return packed;
+}
+
+class Tm1637Async {
+public:
+  Tm1637Async(uint8_t clk, uint8_t dio) : clk_(clk), dio_(dio) {}
+
+  bool begin() {
+    pinMode(clk_, INPUT);
+    pinMode(dio_, INPUT);
+    digitalWrite(clk_, LOW);
+    digitalWrite(dio_, LOW);
+    esp_timer_create_args_t args = {};
+    args.callback = &Tm1637Async::onTimer;
+    args.arg = this;
+    args.dispatch_method = ESP_TIMER_TASK;
+    args.name = "tm1637";
+    return esp_timer_create(&args, &timer_) == ESP_OK;
+  }
+
+  // Segments are packed digit 0 (leftmost) in the high byte. Returns false,
+  // and sends nothing, when the request matches the previous one.
+  bool show(uint32_t segments) {
+    if (requested_.load() == segments && started_) {
+      skipped_++;
+      return false;
+    }
+    started_ = true;
+    requested_.store(segments);
+    kick();
+    return true;
+  }
+
+  // Takes effect with the next frame, which it also triggers.
+  void setBrightness(uint8_t level, bool on) {
+    uint8_t control = static_cast<uint8_t>(TM1637_CMD_DISPLAY | (on ? 0x08 : 0) | (level & 0x07));
+    if (control_.load() == control && started_) {
+      return;
+    }
+    control_.store(control);
+    started_ = true;
+    kick();
+  }
+
+  // Completion flag: true once the display shows the latest request.
+  bool idle() const {
+    return !busy_.load();
+  }
+
+  uint32_t frames() const {
+    return frames_.load();
+  }
+
+  uint32_t skipped() const {
+    return skipped_;
+  }
+
+  uint32_t nacks() const {
+    return nacks_.load();
+  }
+
+private:
+  enum Phase : uint8_t {
+    PHASE_START,
+    PHASE_BIT_LOW,
+    PHASE_BIT_HIGH,
+    PHASE_ACK_LOW,
+    PHASE_ACK_HIGH,
+    PHASE_STOP_LOW,
+    PHASE_STOP_CLK,
+    PHASE_STOP_DIO,
+  };
+
+  static const uint8_t FRAME_BYTES = 3 + TM1637_DIGITS;
+
+  static void onTimer(void *arg) {
+    static_cast<Tm1637Async *>(arg)->tick();
+  }
+
+  void kick() {
+    if (timer_ != nullptr && !busy_.exchange(true)) {
+      loadFrame();
+      esp_timer_start_periodic(timer_, TM1637_PHASE_US);
+    }
+  }
+
+  bool pendingChange() const {
+    return requested_.load() != sentSegments_ || control_.load() != sentControl_;
+  }
+
+  // Called only while no frame is in flight: by kick() before the timer
+  // starts, or by the timer itself between frames.
+  void loadFrame() {
+    sentSegments_ = requested_.load();
+    sentControl_ = control_.load();
+    bytes_[0] = TM1637_CMD_DATA;
+    bytes_[1] = TM1637_CMD_ADDRESS;
+    for (uint8_t i = 0; i < TM1637_DIGITS; i++) {
+      bytes_[2 + i] = static_cast<uint8_t>(sentSegments_ >> (8 * (TM1637_DIGITS - 1 - i)));
+    }
+    bytes_[FRAME_BYTES - 1] = sentControl_;
+    byte_ = 0;
+    bit_ = 0;
+    phase_ = PHASE_START;
+  }
+
+  // The data command and the display control are one-byte transfers; the
+  // address and the digits share the one in between.
+  bool transferEndsAfter(uint8_t index) const {
+    return index == 0 || index == FRAME_BYTES - 2 || index == FRAME_BYTES - 1;
+  }
+
+  void low(uint8_t pin) {
+    pinMode(pin, OUTPUT);
+  }
+
+  void release(uint8_t pin) {
+    pinMode(pin, INPUT);
+  }
+
+  void tick() {
+    switch (phase_) {
+      case PHASE_START:
+        low(dio_);
+        phase_ = PHASE_BIT_LOW;
+        break;
+      case PHASE_BIT_LOW:
+        low(clk_);
+        if ((bytes_[byte_] >> bit_) & 1) {
+          release(dio_);
+        } else {
+          low(dio_);
+        }
+        phase_ = PHASE_BIT_HIGH;
+        break;
+      case PHASE_BIT_HIGH:
+        release(clk_);
+        phase_ = ++bit_ == 8 ? PHASE_ACK_LOW : PHASE_BIT_LOW;
+        break;
+      case PHASE_ACK_LOW:
+        low(clk_);
+        release(dio_);
+        phase_ = PHASE_ACK_HIGH;
+        break;
+      case PHASE_ACK_HIGH:
+        release(clk_);
+        if (digitalRead(dio_) != LOW) {
+          nacks_++;
+        }
+        bit_ = 0;
+        phase_ = transferEndsAfter(byte_) ? PHASE_STOP_LOW : PHASE_BIT_LOW;
+        byte_++;
+        break;
+      case PHASE_STOP_LOW:
+        low(clk_);
+        low(dio_);
+        phase_ = PHASE_STOP_CLK;
+        break;
+      case PHASE_STOP_CLK:
+        release(clk_);
+        phase_ = PHASE_STOP_DIO;
+        break;
+      case PHASE_STOP_DIO:
+        release(dio_);
+        if (byte_ < FRAME_BYTES) {
+          phase_ = PHASE_START;
+        } else {
+          finishFrame();
+        }
+        break;
+    }
+  }
+
+  void finishFrame() {
+    frames_++;
+    if (pendingChange()) {
+      loadFrame();
+      return;
+    }
+    esp_timer_stop(timer_);
+    busy_.store(false);
+    // A show() that landed between the check above and clearing busy_ saw
+    // the timer as running and left the restart to us.
+    if (pendingChange() && !busy_.exchange(true)) {
+      loadFrame();
+      esp_timer_start_periodic(timer_, TM1637_PHASE_US);
+    }
+  }
+
+  uint8_t clk_;
+  uint8_t dio_;
+  esp_timer_handle_t timer_ = nullptr;
+
+  // Loop side.
+  bool started_ = false;
+  uint32_t skipped_ = 0;
+
+  // Shared with the timer.
+  std::atomic<uint32_t> requested_{0};
+  std::atomic<uint8_t> control_{TM1637_CMD_DISPLAY | 0x08 | 0x07};
+  std::atomic<bool> busy_{false};
+  std::atomic<uint32_t> frames_{0};
+  std::atomic<uint32_t> nacks_{0};
+
+  // Timer side, once a frame is loaded.
+  uint32_t sentSegments_ = 0;
+  uint8_t sentControl_ = 0;
+  uint8_t bytes_[FRAME_BYTES] = {};
+  uint8_t byte_ = 0;
+  uint8_t bit_ = 0;
+  Phase phase_ = PHASE_START;
+};
@@ -97,6 +97,27 @@ static const char INDEX_HTML[] PROGMEM = R"rawliteral(
       padding: 22px;
     }
 
+    .exercises {
+      display: grid;
+      grid-template-columns: repeat(3, 1fr);
+      gap: 10px;
+      margin-bottom: 18px;
+    }
+
+    .exercise {
+      min-height: 48px;
+      font-size: 16px;
+      background: rgba(255, 255, 255, 0.06);
+      color: var(--text);
+      border: 1px solid var(--line);
+    }
+
+    .exercise.active {
+      background: rgba(133, 215, 255, 0.18);
+      border-color: rgba(133, 215, 255, 0.4);
+      color: var(--blue);
+    }
+
     .count-label {
       font-size: 14px;
       text-transform: uppercase;
@@ -120,7 +141,7 @@ static const char INDEX_HTML[] PROGMEM = R"rawliteral(
     .actions {
       margin-top: 22px;
       display: grid;
-      grid-template-columns: 1fr;
+      grid-template-columns: 2fr 1fr 1fr;
       gap: 14px;
     }
 
@@ -147,6 +168,18 @@ static const char INDEX_HTML[] PROGMEM = R"rawliteral(
       cursor: wait;
     }
 
+    .plus {
+      background: linear-gradient(135deg, var(--green), #3fd68c);
+      color: var(--green-deep);
+      box-shadow: 0 16px 30px rgba(100, 240, 168, 0.2);
+    }
+
+    .set {
+      background: linear-gradient(135deg, var(--blue), #5fb6ff);
+      color: #06243a;
+      box-shadow: 0 16px 30px rgba(133, 215, 255, 0.2);
+    }
+
     .reset {
       background: linear-gradient(135deg, var(--red), #ff6d7f);
       color: #2b0904;
@@ -179,6 +212,10 @@ static const char INDEX_HTML[] PROGMEM = R"rawliteral(
       word-break: break-word;
     }
 
+    .meta-value a {
+      color: var(--blue);
+    }
+
     .footer {
       margin-top: 18px;
       color: var(--muted);
@@ -219,17 +256,33 @@ static const char INDEX_HTML[] PROGMEM = R"rawliteral(
 
     <section class="hero">
       <div class="count-card">
-        <div class="count-label">Текущий счёт</div>
+        <div class="exercises" id="exercises">
+          <button class="exercise" data-id="0">Отжимания</button>
+          <button class="exercise" data-id="1">Приседания</button>
+          <button class="exercise" data-id="2">Пресс</button>
+        </div>
+
+        <div class="count-label" id="countLabel">Текущий счёт</div>
         <div class="count" id="count">0</div>
         <div class="status" id="status">Подключено к устройству</div>
 
         <div class="actions">
+          <button class="plus" id="plusBtn">+1</button>
+          <button class="set" id="setBtn">Подход</button>
           <button class="reset" id="resetBtn">Сбросить</button>
         </div>
       </div>
 
       <aside class="info-card">
         <div class="meta">
+          <div class="meta-row">
+            <div class="meta-key">Текущий подход</div>
+            <div class="meta-value" id="setReps">...</div>
+          </div>
+          <div class="meta-row">
+            <div class="meta-key">Прошлый подход</div>
+            <div class="meta-value" id="lastSet">...</div>
+          </div>
           <div class="meta-row">
             <div class="meta-key">Точка доступа</div>
             <div class="meta-value" id="ssid">...</div>
@@ -240,14 +293,18 @@ static const char INDEX_HTML[] PROGMEM = R"rawliteral(
           </div>
           <div class="meta-row">
             <div class="meta-key">Обновление</div>
-            <div class="meta-value">Авто каждые 500 мс</div>
+            <div class="meta-value" id="sync">...</div>
+          </div>
+          <div class="meta-row">
+            <div class="meta-key">Журнал повторов</div>
+            <div class="meta-value"><a href="/api/log" download>replog.csv</a> · <a href="/api/log?format=ndjson" download>ndjson</a></div>
           </div>
         </div>
       </aside>
     </section>
 
     <div class="footer">
-      Подключись к Wi-Fi устройства, затем открой этот адрес в браузере. Аппаратные кнопки на самом устройстве продолжают работать.
+      Подключись к Wi-Fi устройства, затем открой этот адрес в браузере. Аппаратные кнопки на самом устройстве продолжают работать: короткое нажатие RESET закрывает подход, удержание 2 с сбрасывает счёт.
     </div>
   </main>
 
@@ -258,12 +315,58 @@ static const char INDEX_HTML[] PROGMEM = R"rawliteral(
     const ipEl = document.getElementById("ip");
     const badgeEl = document.getElementById("badge");
     const resetBtn = document.getElementById("resetBtn");
+    const plusBtn = document.getElementById("plusBtn");
+    const syncEl = document.getElementById("sync");
+    const setBtn = document.getElementById("setBtn");
+    const countLabelEl = document.getElementById("countLabel");
+    const setRepsEl = document.getElementById("setReps");
+    const lastSetEl = document.getElementById("lastSet");
+    const exerciseBtns = document.querySelectorAll(".exercise");
 
     let busy = false;
 
     function setBusy(nextBusy) {
       busy = nextBusy;
       resetBtn.disabled = nextBusy;
+      setBtn.disabled = nextBusy;
+    }
+
+    const POLL_FALLBACK_MS = 2000;
+    let pollTimer = null;
+
+    function describeSet(set) {
+      if (!set || set.reps === 0) {
+        return "—";
+      }
+      let text = set.reps + " повт.";
+      if (set.duration_ms > 0) {
+        text += " · " + (set.duration_ms / 1000).toFixed(1) + " с · " + set.cadence_rpm + "/мин";
+      }
+      return text;
+    }
+
+    function applyState(state) {
+      countEl.textContent = String(state.count);
+      if (state.exercises) {
+        const active = state.exercises[state.exercise];
+        exerciseBtns.forEach((btn) => {
+          btn.classList.toggle("active", Number(btn.dataset.id) === state.exercise);
+        });
+        countLabelEl.textContent = exerciseBtns[state.exercise].textContent + " · подход " + (active.sets + 1);
+        setRepsEl.textContent = active.set_reps + " повт.";
+        lastSetEl.textContent = describeSet(active.last_set);
+        incView = { exercise: state.exercise, set: active.sets };
+      }
+      ssidEl.textContent = state.ssid;
+      ipEl.textContent = state.ip;
+      statusEl.textContent = "Устройство на связи";
+      badgeEl.textContent = "Wi-Fi control";
+      releaseHeldTaps();
+    }
+
+    function setOffline(message) {
+      statusEl.textContent = "Нет связи: " + message;
+      badgeEl.textContent = "Offline";
     }
 
     async function refreshState() {
@@ -273,18 +376,49 @@ static const char INDEX_HTML[] PROGMEM = R"rawliteral(
           throw new Error("HTTP " + response.status);
         }
 
-        const state = await response.json();
-        countEl.textContent = String(state.count);
-        ssidEl.textContent = state.ssid;
-        ipEl.textContent = state.ip;
-        statusEl.textContent = "Устройство на связи";
-        badgeEl.textContent = "Wi-Fi control";
+        applyState(await response.json());
       } catch (error) {
-        statusEl.textContent = "Нет связи: " + error.message;
-        badgeEl.textContent = "Offline";
+        setOffline(error.message);
+      }
+    }
+
+    function startPolling() {
+      if (pollTimer === null) {
+        syncEl.textContent = "Опрос каждые " + POLL_FALLBACK_MS / 1000 + " с";
+        pollTimer = setInterval(refreshState, POLL_FALLBACK_MS);
+      }
+    }
+
+    function stopPolling() {
+      if (pollTimer !== null) {
+        clearInterval(pollTimer);
+        pollTimer = null;
+      }
+    }
+
+    function subscribe() {
+      if (!window.EventSource) {
+        startPolling();
+        return;
       }
+
+      const events = new EventSource("/api/events");
+      events.onopen = () => {
+        stopPolling();
+        syncEl.textContent = "Мгновенно (push)";
+      };
+      events.onmessage = (event) => {
+        applyState(JSON.parse(event.data));
+      };
+      events.onerror = () => {
+        // EventSource reconnects on its own; poll slowly until it does.
+        setOffline("поток событий прерван");
+        startPolling();
+      };
     }
 
+    // Actions wait until every tap made before them has reached the device,
+    // so the taps are counted in the exercise and set they were made in.
     async function sendAction(path) {
       if (busy) {
         return;
@@ -292,6 +426,7 @@ static const char INDEX_HTML[] PROGMEM = R"rawliteral(
 
       try {
         setBusy(true);
+        await drainIncrements();
         const response = await fetch(path, {
           method: "POST",
           cache: "no-store"
@@ -301,18 +436,159 @@ static const char INDEX_HTML[] PROGMEM = R"rawliteral(
           throw new Error("HTTP " + response.status);
         }
 
-        await refreshState();
+        applyState(await response.json());
       } catch (error) {
         statusEl.textContent = "Ошибка: " + error.message;
       } finally {
         setBusy(false);
+        releaseHeldTaps();
+      }
+    }
+
+    // Taps are collected for INC_BATCH_MS and sent as one /api/inc with a
+    // client id and sequence number. A failed batch is retried with the same
+    // key, so the device counts it once even if the first attempt got through.
+    // Every tap remembers the exercise and set it was made in; the device
+    // refuses a batch with 409 once those changed. Taps made while an action
+    // waits are held and take the state the action leaves. The batch also
+    // carries the newest tap's age and the gaps between taps, which the
+    // device uses as rep times.
+    const INC_BATCH_MS = 150;
+    const INC_RETRY_MS = 500;
+    const INC_MAX_DELTA = 100;
+    const INC_MAX_GAPS_CHARS = 600;
+    const incClient = 1 + Math.floor(Math.random() * 0xfffffffe);
+    let incSeq = 0;
+    let incView = null;
+    let incHeld = [];
+    let incPending = [];
+    let incInFlight = null;
+    let incTimer = null;
+    let incDrainWaiters = [];
+
+    function scheduleIncFlush(delayMs) {
+      if (incTimer === null) {
+        incTimer = setTimeout(() => {
+          incTimer = null;
+          flushIncrements();
+        }, delayMs);
+      }
+    }
+
+    function showIncPending() {
+      const unsent = incHeld.length + incPending.length + (incInFlight ? incInFlight.delta : 0);
+      if (unsent > 0) {
+        statusEl.textContent = "Отправка +" + unsent + "…";
+      }
+    }
+
+    function releaseHeldTaps() {
+      if (busy || incView === null || incHeld.length === 0) {
+        return;
+      }
+      incHeld.forEach((at) => {
+        incPending.push({ at: at, exercise: incView.exercise, set: incView.set });
+      });
+      incHeld = [];
+      if (incInFlight === null) {
+        scheduleIncFlush(INC_BATCH_MS);
       }
     }
 
+    function notifyIncDrained() {
+      if (incPending.length === 0 && incInFlight === null) {
+        incDrainWaiters.splice(0).forEach((resolve) => resolve());
+      }
+    }
+
+    // Resolves once every pending tap has been answered by the device; a
+    // batch still in its collection window goes out right away.
+    function drainIncrements() {
+      return new Promise((resolve) => {
+        incDrainWaiters.push(resolve);
+        if (incTimer !== null && incInFlight === null) {
+          clearTimeout(incTimer);
+          incTimer = null;
+          flushIncrements();
+        }
+        notifyIncDrained();
+      });
+    }
+
+    // Leading taps of one exercise and set, as many as fit one request.
+    function takeIncBatch() {
+      const first = incPending[0];
+      let delta = 1;
+      let gaps = "";
+      while (delta < incPending.length && delta < INC_MAX_DELTA && gaps.length < INC_MAX_GAPS_CHARS) {
+        const tap = incPending[delta];
+        if (tap.exercise !== first.exercise || tap.set !== first.set) {
+          break;
+        }
+        gaps += (delta > 1 ? "," : "") + Math.round(tap.at - incPending[delta - 1].at);
+        delta++;
+      }
+      const newestAt = incPending[delta - 1].at;
+      incPending.splice(0, delta);
+      incSeq++;
+      return { seq: incSeq, delta: delta, exercise: first.exercise, set: first.set, gaps: gaps, newestAt: newestAt };
+    }
+
+    async function flushIncrements() {
+      if (incInFlight === null) {
+        if (incPending.length === 0) {
+          notifyIncDrained();
+          return;
+        }
+        incInFlight = takeIncBatch();
+      }
+
+      const batch = incInFlight;
+      let query = "client=" + incClient + "&seq=" + batch.seq + "&delta=" + batch.delta +
+        "&exercise=" + batch.exercise + "&set=" + batch.set +
+        "&ago=" + Math.round(performance.now() - batch.newestAt);
+      if (batch.gaps !== "") {
+        query += "&gaps=" + batch.gaps;
+      }
+      try {
+        const response = await fetch("/api/inc?" + query, {
+          method: "POST",
+          cache: "no-store"
+        });
+        if (!response.ok && response.status !== 409) {
+          throw new Error("HTTP " + response.status);
+        }
+
+        incInFlight = null;
+        applyState(await response.json());
+        if (response.status === 409) {
+          statusEl.textContent = "Не засчитано +" + batch.delta + ": подход уже сменился";
+        }
+        if (incPending.length > 0) {
+          flushIncrements();
+        } else {
+          notifyIncDrained();
+        }
+      } catch (error) {
+        statusEl.textContent = "Повтор отправки: " + error.message;
+        scheduleIncFlush(INC_RETRY_MS);
+      }
+    }
+
+    plusBtn.addEventListener("click", () => {
+      incHeld.push(performance.now());
+      releaseHeldTaps();
+      showIncPending();
+    });
+
     resetBtn.addEventListener("click", () => sendAction("/api/reset"));
+    setBtn.addEventListener("click", () => sendAction("/api/set"));
+    exerciseBtns.forEach((btn) => {
+      btn.addEventListener("click", () => sendAction("/api/exercise?id=" + btn.dataset.id));
+    });
 
     refreshState();
-    setInterval(refreshState, 500);
+    subscribe();
   </script>
 </body>
 </html>